@@ -94,6 +94,10 @@ typedef struct aas_entity_s
 	aas_link_t *areas;
 	//links into the BSP leaves
 	bsp_link_t *leaves;
+	//origin the entity was linked at and how far it can move from there
+	//before its bounding box reaches any of the planes the links depend on
+	vec3_t linkorigin;
+	float linkmargin;
 } aas_entity_t;
 
 typedef struct aas_settings_s
@@ -157,6 +161,18 @@ typedef struct aas_routingcache_s
 	unsigned short int traveltimes[1];			//travel time for every area (variable sized)
 } aas_routingcache_t;
 
+#define MAX_ROUTETABLES		4
+
+//precomputed routing tables for one combination of travel flags
+typedef struct aas_routetable_s
+{
+	int travelflags;							//travel flags the tables were calculated with
+	unsigned short int **clustertraveltimes;	//per cluster [goal][area] travel times, NULL if invalid
+	unsigned char **clusterreachabilities;		//per cluster [goal][area] reachabilities
+	unsigned short int *portaltraveltimes;		//[goal area][portal] travel times, NULL if invalid
+	unsigned char *portalreachabilities;		//[portal] reachabilities, always zero like in the portal cache
+} aas_routetable_t;
+
 //fields for the routing algorithm
 typedef struct aas_routingupdate_s
 {
@@ -271,6 +287,13 @@ typedef struct aas_s
 	int frameroutingupdates;
 	//reversed reachability links
 	aas_reversedreachability_t *reversedreachability;
+	//the reversed links of all areas packed in the same order
+	int *reversedlinkfirst;						//first packed link of each area, numareas + 1 entries
+	int *reversedlinkarea;						//area the reachability starts in
+	int *reversedlinkcluster;					//cluster of that area
+	int *reversedlinktravelflags;				//travel flag for the type of the reachability
+	unsigned short *reversedlinktraveltime;		//travel time of the reachability
+	unsigned char *reversedlinkreach;			//number of the reachability within its area
 	//travel times within the areas
 	unsigned short ***areatraveltimes;
 	//array of size numclusters with cluster cache
@@ -284,6 +307,10 @@ typedef struct aas_s
 	//areas the reachabilities go through
 	int *reachabilityareaindex;
 	aas_reachabilityareas_t *reachabilityareas;
+	//precomputed routing tables
+	int numroutetables;
+	aas_routetable_t *routetables;
+	byte *routetabledata;						//the table file as it was read
 } aas_t;
 
 #define AASINTERN
@@ -44,6 +44,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "be_aas_def.h"
 
 #define MASK_SOLID		CONTENTS_PLAYERCLIP
+//keeps the link margin clear of rounding differences
+#define LINK_EPSILON	0.125
 
 //FIXME: these might change
 enum {
@@ -62,9 +64,10 @@ enum {
 //===========================================================================
 int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 {
-	int relink;
+	int relink, oldsolid, oldmodelindex;
 	aas_entity_t *ent;
-	vec3_t absmins, absmaxs;
+	vec3_t absmins, absmaxs, mins, maxs, move;
+	vec3_t linkmins, linkmaxs;
 
 	if (!aasworld.loaded)
 	{
@@ -92,6 +95,8 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 	ent->i.ltime = AAS_Time();
 	VectorCopy(ent->i.origin, ent->i.lastvisorigin);
 	VectorCopy(state->old_origin, ent->i.old_origin);
+	oldsolid = ent->i.solid;
+	oldmodelindex = ent->i.modelindex;
 	ent->i.solid = state->solid;
 	ent->i.groundent = state->groundent;
 	ent->i.modelindex = state->modelindex;
@@ -119,9 +124,18 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 			VectorCopy(state->angles, ent->i.angles);
 			relink = qtrue;
 		} //end if
-		//get the mins and maxs of the model
+		//get the mins and maxs of the model, they only change with the model or the angles
 		//FIXME: rotate mins and maxs
-		AAS_BSPModelMinsMaxsOrigin(ent->i.modelindex, ent->i.angles, ent->i.mins, ent->i.maxs, NULL);
+		if (relink || oldsolid != SOLID_BSP || oldmodelindex != ent->i.modelindex)
+		{
+			AAS_BSPModelMinsMaxsOrigin(ent->i.modelindex, ent->i.angles, mins, maxs, NULL);
+			if (!VectorCompare(mins, ent->i.mins) || !VectorCompare(maxs, ent->i.maxs))
+			{
+				VectorCopy(mins, ent->i.mins);
+				VectorCopy(maxs, ent->i.maxs);
+				relink = qtrue;
+			} //end if
+		} //end if
 	} //end if
 	else if (ent->i.solid == SOLID_BBOX)
 	{
@@ -139,7 +153,13 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 	if (!VectorCompare(state->origin, ent->i.origin))
 	{
 		VectorCopy(state->origin, ent->i.origin);
-		relink = qtrue;
+		//the areas only change when the bounding box gets to one of
+		//the planes the area links were decided by
+		VectorSubtract(ent->i.origin, ent->linkorigin, move);
+		if (!ent->areas || VectorLength(move) + LINK_EPSILON >= ent->linkmargin)
+		{
+			relink = qtrue;
+		} //end if
 	} //end if
 	//if the entity should be relinked
 	if (relink)
@@ -153,7 +173,11 @@ int AAS_UpdateEntity(int entnum, bot_entitystate_t *state)
 			//unlink the entity
 			AAS_UnlinkFromAreas(ent->areas);
 			//relink the entity to the AAS areas (use the larges bbox)
-			ent->areas = AAS_LinkEntityClientBBox(absmins, absmaxs, entnum, PRESENCE_NORMAL);
+			AAS_PresenceTypeBoundingBox(PRESENCE_NORMAL, mins, maxs);
+			VectorSubtract(absmins, maxs, linkmins);
+			VectorSubtract(absmaxs, mins, linkmaxs);
+			ent->areas = AAS_AASLinkEntityMargin(linkmins, linkmaxs, entnum, &ent->linkmargin);
+			VectorCopy(ent->i.origin, ent->linkorigin);
 			//unlink the entity from the BSP leaves
 			AAS_UnlinkFromBSPLeaves(ent->leaves);
 			//link the entity to the world BSP tree
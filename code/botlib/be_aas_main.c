@@ -272,6 +272,12 @@ int AAS_StartFrame(float time)
 		LibVarSet("saveroutingcache", "0");
 	} //end if
 	//
+	if (LibVarGetValue("routingcachedump"))
+	{
+		AAS_DumpRoutingCache();
+		LibVarSet("routingcachedump", "0");
+	} //end if
+	//
 	aasworld.numframes++;
 	return BLERR_NOERROR;
 } //end of the function AAS_StartFrame
@@ -82,7 +82,16 @@ int numportalcacheupdates;
 #endif //ROUTING_DEBUG
 
 int routingcachesize;
+//bytes in caches that are never evicted, these don't count against the budget
+int routingcachepinnedsize;
 int max_routingcachesize;
+//routing cache statistics, the hits and misses are indexed with the cache type
+int routingcachehits[2];
+int routingcachemisses[2];
+int routingcacheevictions;
+int routingcacheevictedsize;
+int routingcachepeaksize;
+int routetablelookups;
 
 //===========================================================================
 //
@@ -90,14 +99,23 @@ int max_routingcachesize;
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
-#ifdef ROUTING_DEBUG
 void AAS_RoutingInfo(void)
 {
+#ifdef ROUTING_DEBUG
 	botimport.Print(PRT_MESSAGE, "%d area cache updates\n", numareacacheupdates);
 	botimport.Print(PRT_MESSAGE, "%d portal cache updates\n", numportalcacheupdates);
-	botimport.Print(PRT_MESSAGE, "%d bytes routing cache\n", routingcachesize);
-} //end of the function AAS_RoutingInfo
 #endif //ROUTING_DEBUG
+	botimport.Print(PRT_MESSAGE, "%d bytes routing cache, %d bytes peak, %d bytes budget\n",
+						routingcachesize, routingcachepeaksize, max_routingcachesize);
+	botimport.Print(PRT_MESSAGE, "%d bytes pinned routing cache\n", routingcachepinnedsize);
+	botimport.Print(PRT_MESSAGE, "area cache: %d hits, %d misses\n",
+						routingcachehits[CACHETYPE_AREA], routingcachemisses[CACHETYPE_AREA]);
+	botimport.Print(PRT_MESSAGE, "portal cache: %d hits, %d misses\n",
+						routingcachehits[CACHETYPE_PORTAL], routingcachemisses[CACHETYPE_PORTAL]);
+	botimport.Print(PRT_MESSAGE, "%d caches evicted, %d bytes\n",
+						routingcacheevictions, routingcacheevictedsize);
+	botimport.Print(PRT_MESSAGE, "%d routing table lookups\n", routetablelookups);
+} //end of the function AAS_RoutingInfo
 //===========================================================================
 // returns the number of the area in the cluster
 // assumes the given area is in the given cluster or a portal of the cluster
@@ -192,6 +210,18 @@ int AAS_TravelFlagForType(int traveltype)
 	return AAS_TravelFlagForType_inline(traveltype);
 } //end of the function AAS_TravelFlagForType_inline
 //===========================================================================
+// area cache leading towards a portal is used by every portal cache
+// update through the cluster and is never freed to stay within budget
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+__inline int AAS_PinnedCache(aas_routingcache_t *cache)
+{
+	return cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0;
+} //end of the function AAS_PinnedCache
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -199,6 +229,8 @@ int AAS_TravelFlagForType(int traveltype)
 //===========================================================================
 void AAS_UnlinkCache(aas_routingcache_t *cache)
 {
+	//pinned caches are never in the list
+	if (!cache->time_prev && aasworld.oldestcache != cache) return;
 	if (cache->time_next) cache->time_next->time_prev = cache->time_prev;
 	else aasworld.newestcache = cache->time_prev;
 	if (cache->time_prev) cache->time_prev->time_next = cache->time_next;
@@ -214,6 +246,8 @@ void AAS_UnlinkCache(aas_routingcache_t *cache)
 //===========================================================================
 void AAS_LinkCache(aas_routingcache_t *cache)
 {
+	//pinned caches are kept out of the list so the oldest cache can always be freed
+	if (AAS_PinnedCache(cache)) return;
 	if (aasworld.newestcache)
 	{
 		aasworld.newestcache->time_next = cache;
@@ -228,6 +262,51 @@ void AAS_LinkCache(aas_routingcache_t *cache)
 	aasworld.newestcache = cache;
 } //end of the function AAS_LinkCache
 //===========================================================================
+// prints the routing cache statistics and the routing cache memory
+// used per cluster and by the portal cache
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_DumpRoutingCache(void)
+{
+	int i, j, numcaches, size, numpinned;
+	aas_routingcache_t *cache;
+
+	AAS_RoutingInfo();
+	if (!aasworld.clusterareacache || !aasworld.portalcache) return;
+	for (i = 1; i < aasworld.numclusters; i++)
+	{
+		numcaches = 0;
+		numpinned = 0;
+		size = 0;
+		for (j = 0; j < aasworld.clusters[i].numareas; j++)
+		{
+			for (cache = aasworld.clusterareacache[i][j]; cache; cache = cache->next)
+			{
+				if (AAS_PinnedCache(cache)) numpinned++;
+				numcaches++;
+				size += cache->size;
+			} //end for
+		} //end for
+		if (!numcaches) continue;
+		botimport.Print(PRT_MESSAGE, "cluster %3d: %5d area caches (%d to portals), %d bytes\n",
+							i, numcaches, numpinned, size);
+	} //end for
+	numcaches = 0;
+	size = 0;
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		for (cache = aasworld.portalcache[i]; cache; cache = cache->next)
+		{
+			numcaches++;
+			size += cache->size;
+		} //end for
+	} //end for
+	botimport.Print(PRT_MESSAGE, "portals    : %5d portal caches, %d bytes\n", numcaches, size);
+} //end of the function AAS_DumpRoutingCache
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -237,6 +316,7 @@ void AAS_FreeRoutingCache(aas_routingcache_t *cache)
 {
 	AAS_UnlinkCache(cache);
 	routingcachesize -= cache->size;
+	if (AAS_PinnedCache(cache)) routingcachepinnedsize -= cache->size;
 	FreeMemory(cache);
 } //end of the function AAS_FreeRoutingCache
 //===========================================================================
@@ -263,6 +343,8 @@ void AAS_RemoveRoutingCacheInCluster( int clusternum )
 		} //end for
 		aasworld.clusterareacache[clusternum][i] = NULL;
 	} //end for
+	//the routing tables can't be used for the cluster anymore
+	AAS_InvalidateRouteTable( clusternum );
 } //end of the function AAS_RemoveRoutingCacheInCluster
 //===========================================================================
 //
@@ -344,6 +426,60 @@ __inline float AAS_RoutingTime(void)
 	return AAS_Time();
 } //end of the function AAS_RoutingTime
 //===========================================================================
+// true while other threads may read the routing caches at the same time,
+// the caches are then only added to under the routing lock and never freed
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RoutingShared(void)
+{
+	return botimport.RoutingShared && botimport.RoutingShared();
+} //end of the function AAS_RoutingShared
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RoutingCount(int *counter, int shared)
+{
+	if (shared) botimport.AtomicAdd(counter, 1);
+	else (*counter)++;
+} //end of the function AAS_RoutingCount
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static aas_routingcache_t *AAS_FindRoutingCache(aas_routingcache_t *cache, int travelflags)
+{
+	for (; cache; cache = cache->next)
+	{
+		//if there aren't used any undesired travel types for the cache
+		if (cache->travelflags == travelflags) break;
+	} //end for
+	return cache;
+} //end of the function AAS_FindRoutingCache
+//===========================================================================
+// reading threads don't move the cache up in the access order, instead
+// AAS_FreeOldestCache gives caches accessed in the meantime another chance
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RoutingCacheHit(aas_routingcache_t *cache, int shared)
+{
+	if (!shared) AAS_UnlinkCache(cache);
+	//the cache has been accessed
+	cache->time = AAS_RoutingTime();
+	if (!shared) AAS_LinkCache(cache);
+	AAS_RoutingCount(&routingcachehits[cache->type], shared);
+} //end of the function AAS_RoutingCacheHit
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -466,6 +602,60 @@ void AAS_CreateReversedReachability(void)
 #endif
 } //end of the function AAS_CreateReversedReachability
 //===========================================================================
+// packs the reversed reachability links of every area next to each other,
+// in the order of the lists so the link index still selects the travel
+// time in aasworld.areatraveltimes
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_CreateReversedLinkArrays(void)
+{
+	int i, n, numlinks;
+	aas_reversedlink_t *revlink;
+	aas_reachability_t *reach;
+	char *ptr;
+
+	if (aasworld.reversedlinkfirst) FreeMemory(aasworld.reversedlinkfirst);
+	//the number of links that were actually created
+	numlinks = 0;
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		numlinks += aasworld.reversedreachability[i].numlinks;
+	} //end for
+	//
+	ptr = (char *) GetClearedMemory((aasworld.numareas + 1) * sizeof(int) +
+							numlinks * (3 * sizeof(int) + sizeof(unsigned short) + sizeof(unsigned char)));
+	aasworld.reversedlinkfirst = (int *) ptr;
+	ptr += (aasworld.numareas + 1) * sizeof(int);
+	aasworld.reversedlinkarea = (int *) ptr;
+	ptr += numlinks * sizeof(int);
+	aasworld.reversedlinkcluster = (int *) ptr;
+	ptr += numlinks * sizeof(int);
+	aasworld.reversedlinktravelflags = (int *) ptr;
+	ptr += numlinks * sizeof(int);
+	aasworld.reversedlinktraveltime = (unsigned short *) ptr;
+	ptr += numlinks * sizeof(unsigned short);
+	aasworld.reversedlinkreach = (unsigned char *) ptr;
+	//
+	n = 0;
+	for (i = 0; i < aasworld.numareas; i++)
+	{
+		aasworld.reversedlinkfirst[i] = n;
+		for (revlink = aasworld.reversedreachability[i].first; revlink; revlink = revlink->next, n++)
+		{
+			reach = &aasworld.reachability[revlink->linknum];
+			aasworld.reversedlinkarea[n] = revlink->areanum;
+			aasworld.reversedlinkcluster[n] = aasworld.areasettings[revlink->areanum].cluster;
+			aasworld.reversedlinktravelflags[n] = AAS_TravelFlagForType_inline(reach->traveltype);
+			aasworld.reversedlinktraveltime[n] = reach->traveltime;
+			aasworld.reversedlinkreach[n] = revlink->linknum - aasworld.areasettings[revlink->areanum].firstreachablearea;
+		} //end for
+	} //end for
+	aasworld.reversedlinkfirst[aasworld.numareas] = n;
+} //end of the function AAS_CreateReversedLinkArrays
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -697,12 +887,13 @@ int AAS_FreeOldestCache(void)
 	int clusterareanum;
 	aas_routingcache_t *cache;
 
-	for (cache = aasworld.oldestcache; cache; cache = cache->time_next) {
-		// never free area cache leading towards a portal
-		if (cache->type == CACHETYPE_AREA && aasworld.areasettings[cache->areanum].cluster < 0) {
-			continue;
-		}
-		break;
+	// area cache leading towards a portal is never in the list
+	cache = aasworld.oldestcache;
+	// a cache accessed after the one following it was read by another thread
+	while (cache && cache->time_next && cache->time > cache->time_next->time) {
+		AAS_UnlinkCache(cache);
+		AAS_LinkCache(cache);
+		cache = aasworld.oldestcache;
 	}
 	if (cache) {
 		// unlink the cache
@@ -720,6 +911,8 @@ int AAS_FreeOldestCache(void)
 			else aasworld.portalcache[cache->areanum] = cache->next;
 			if (cache->next) cache->next->prev = cache->prev;
 		}
+		routingcacheevictions++;
+		routingcacheevictedsize += cache->size;
 		AAS_FreeRoutingCache(cache);
 		return qtrue;
 	}
@@ -742,6 +935,7 @@ aas_routingcache_t *AAS_AllocRoutingCache(int numtraveltimes)
 						+ numtraveltimes * sizeof(unsigned char);
 	//
 	routingcachesize += size;
+	if (routingcachesize > routingcachepeaksize) routingcachepeaksize = routingcachesize;
 	//
 	cache = (aas_routingcache_t *) GetClearedMemory(size);
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t)
@@ -1039,6 +1233,11 @@ aas_routingcache_t *AAS_ReadCache(fileHandle_t fp)
 	botimport.FS_Read((unsigned char *)cache + sizeof(size), size - sizeof(size), fp);
 	cache->reachabilities = (unsigned char *) cache + sizeof(aas_routingcache_t) - sizeof(unsigned short) +
 		(size - sizeof(aas_routingcache_t) + sizeof(unsigned short)) / 3 * 2;
+	//the time list pointers in the dump are stale
+	cache->time_prev = NULL;
+	cache->time_next = NULL;
+	routingcachesize += size;
+	if (routingcachesize > routingcachepeaksize) routingcachepeaksize = routingcachesize;
 	return cache;
 } //end of the function AAS_ReadCache
 //===========================================================================
@@ -1103,6 +1302,8 @@ int AAS_ReadRouteCache(void)
 		if (aasworld.portalcache[cache->areanum])
 			aasworld.portalcache[cache->areanum]->prev = cache;
 		aasworld.portalcache[cache->areanum] = cache;
+		cache->type = CACHETYPE_PORTAL;
+		AAS_LinkCache(cache);
 	} //end for
 	//read all the cluster area cache
 	for (i = 0; i < routecacheheader.numareacache; i++)
@@ -1114,6 +1315,9 @@ int AAS_ReadRouteCache(void)
 		if (aasworld.clusterareacache[cache->cluster][clusterareanum])
 			aasworld.clusterareacache[cache->cluster][clusterareanum]->prev = cache;
 		aasworld.clusterareacache[cache->cluster][clusterareanum] = cache;
+		cache->type = CACHETYPE_AREA;
+		if (AAS_PinnedCache(cache)) routingcachepinnedsize += cache->size;
+		AAS_LinkCache(cache);
 	} //end for
 	// read the visareas
 	/*
@@ -1221,6 +1425,8 @@ void AAS_InitRouting(void)
 	AAS_InitRoutingUpdate();
 	//create reversed reachability links used by the routing update algorithm
 	AAS_CreateReversedReachability();
+	//pack the reversed links for the routing updates
+	AAS_CreateReversedLinkArrays();
 	//initialize the cluster cache
 	AAS_InitClusterAreaCache();
 	//initialize portal cache
@@ -1238,9 +1444,18 @@ void AAS_InitRouting(void)
 #endif //ROUTING_DEBUG
 	//
 	routingcachesize = 0;
+	routingcachepinnedsize = 0;
 	max_routingcachesize = 1024 * (int) LibVarValue("max_routingcache", "4096");
+	Com_Memset(routingcachehits, 0, sizeof(routingcachehits));
+	Com_Memset(routingcachemisses, 0, sizeof(routingcachemisses));
+	routingcacheevictions = 0;
+	routingcacheevictedsize = 0;
+	routingcachepeaksize = 0;
+	routetablelookups = 0;
 	// read any routing cache if available
 	AAS_ReadRouteCache();
+	// read the precomputed routing tables if available
+	AAS_ReadRouteTable();
 } //end of the function AAS_InitRouting
 //===========================================================================
 //
@@ -1263,6 +1478,9 @@ void AAS_FreeRoutingCaches(void)
 	// free reversed reachability links
 	if (aasworld.reversedreachability) FreeMemory(aasworld.reversedreachability);
 	aasworld.reversedreachability = NULL;
+	// free the packed reversed links
+	if (aasworld.reversedlinkfirst) FreeMemory(aasworld.reversedlinkfirst);
+	aasworld.reversedlinkfirst = NULL;
 	// free routing algorithm memory
 	if (aasworld.areaupdate) FreeMemory(aasworld.areaupdate);
 	aasworld.areaupdate = NULL;
@@ -1277,23 +1495,29 @@ void AAS_FreeRoutingCaches(void)
 	// free area contents travel flags look up table
 	if (aasworld.areacontentstravelflags) FreeMemory(aasworld.areacontentstravelflags);
 	aasworld.areacontentstravelflags = NULL;
+	// free the precomputed routing tables
+	AAS_FreeRouteTable();
 } //end of the function AAS_FreeRoutingCaches
 //===========================================================================
 // update the given routing cache
 //
+// the updates are handled in the order they are found.  An area only
+// keeps the reachability it was last reached with and the travel time
+// through the area depends on that reachability, so the travel times
+// depend on the order of the updates.  Taking the updates in order of
+// travel time, per area or per area and reachability, finds different
+// and often shorter routes, which is why this isn't a sorted queue.
+//
 // Parameter:			areacache		: routing cache to update
 // Returns:				-
 // Changes Globals:		-
 //===========================================================================
 void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 {
-	int i, nextareanum, cluster, badtravelflags, clusterareanum, linknum;
+	int i, first, last, nextareanum, cluster, badtravelflags, clusterareanum, reachnum;
 	int numreachabilityareas;
 	unsigned short int t, startareatraveltimes[128]; //NOTE: not more than 128 reachabilities per area allowed
 	aas_routingupdate_t *updateliststart, *updatelistend, *curupdate, *nextupdate;
-	aas_reachability_t *reach;
-	aas_reversedreachability_t *revreach;
-	aas_reversedlink_t *revlink;
 
 #ifdef ROUTING_DEBUG
 	numareacacheupdates++;
@@ -1302,6 +1526,7 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 	numreachabilityareas = aasworld.clusters[areacache->cluster].numreachabilityareas;
 	//
 	aasworld.frameroutingupdates++;
+	//
 	//clear the routing update fields
 //	Com_Memset(aasworld.areaupdate, 0, aasworld.numareas * sizeof(aas_routingupdate_t));
 	//
@@ -1334,25 +1559,25 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 		updateliststart = curupdate->next;
 		//
 		curupdate->inlist = qfalse;
+		//all reversed links lead into the current area so the checks
+		//on the area entered only have to be done once
+		//if not allowed to enter the current area
+		if (aasworld.areasettings[curupdate->areanum].areaflags & AREA_DISABLED) continue;
+		//if the current area has a not allowed travel flag
+		if (AAS_AreaContentsTravelFlags_inline(curupdate->areanum) & badtravelflags) continue;
 		//check all reversed reachability links
-		revreach = &aasworld.reversedreachability[curupdate->areanum];
-		//
-		for (i = 0, revlink = revreach->first; revlink; revlink = revlink->next, i++)
+		first = aasworld.reversedlinkfirst[curupdate->areanum];
+		last = aasworld.reversedlinkfirst[curupdate->areanum + 1];
+		for (i = first; i < last; i++)
 		{
-			linknum = revlink->linknum;
-			reach = &aasworld.reachability[linknum];
 			//if there is used an undesired travel type
-			if (AAS_TravelFlagForType_inline(reach->traveltype) & badtravelflags) continue;
-			//if not allowed to enter the next area
-			if (aasworld.areasettings[reach->areanum].areaflags & AREA_DISABLED) continue;
-			//if the next area has a not allowed travel flag
-			if (AAS_AreaContentsTravelFlags_inline(reach->areanum) & badtravelflags) continue;
-			//number of the area the reversed reachability leads to
-			nextareanum = revlink->areanum;
-			//get the cluster number of the area
-			cluster = aasworld.areasettings[nextareanum].cluster;
+			if (aasworld.reversedlinktravelflags[i] & badtravelflags) continue;
+			//get the cluster number of the area the reversed reachability leads to
+			cluster = aasworld.reversedlinkcluster[i];
 			//don't leave the cluster
 			if (cluster > 0 && cluster != areacache->cluster) continue;
+			//number of the area the reversed reachability leads to
+			nextareanum = aasworld.reversedlinkarea[i];
 			//get the number of the area in the cluster
 			clusterareanum = AAS_ClusterAreaNum(areacache->cluster, nextareanum);
 			if (clusterareanum >= numreachabilityareas) continue;
@@ -1360,25 +1585,24 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 			//the current area plus the travel time from the reachability
 			t = curupdate->tmptraveltime +
 						//AAS_AreaTravelTime(curupdate->areanum, curupdate->start, reach->end) +
-						curupdate->areatraveltimes[i] +
-							reach->traveltime;
+						curupdate->areatraveltimes[i - first] +
+							aasworld.reversedlinktraveltime[i];
 			//
 			if (!areacache->traveltimes[clusterareanum] ||
 					areacache->traveltimes[clusterareanum] > t)
 			{
+				reachnum = aasworld.reversedlinkreach[i];
 				areacache->traveltimes[clusterareanum] = t;
-				areacache->reachabilities[clusterareanum] = linknum - aasworld.areasettings[nextareanum].firstreachablearea;
+				areacache->reachabilities[clusterareanum] = reachnum;
 				nextupdate = &aasworld.areaupdate[clusterareanum];
 				nextupdate->areanum = nextareanum;
 				nextupdate->tmptraveltime = t;
 				//VectorCopy(reach->start, nextupdate->start);
-				nextupdate->areatraveltimes = aasworld.areatraveltimes[nextareanum][linknum -
-													aasworld.areasettings[nextareanum].firstreachablearea];
+				nextupdate->areatraveltimes = aasworld.areatraveltimes[nextareanum][reachnum];
 				if (!nextupdate->inlist)
 				{
-					// we add the update to the end of the list
-					// we could also use a B+ tree to have a real sorted list
-					// on travel time which makes for faster routing updates
+					// we add the update to the end of the list, the
+					// order is part of the result (see above)
 					nextupdate->next = NULL;
 					nextupdate->prev = updatelistend;
 					if (updatelistend) updatelistend->next = nextupdate;
@@ -1398,42 +1622,51 @@ void AAS_UpdateAreaRoutingCache(aas_routingcache_t *areacache)
 //===========================================================================
 aas_routingcache_t *AAS_GetAreaRoutingCache(int clusternum, int areanum, int travelflags)
 {
-	int clusterareanum;
+	int clusterareanum, shared;
 	aas_routingcache_t *cache, *clustercache;
 
 	//number of the area in the cluster
 	clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
-	//pointer to the cache for the area in the cluster
-	clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
+	shared = AAS_RoutingShared();
 	//find the cache without undesired travel flags
-	for (cache = clustercache; cache; cache = cache->next)
+	cache = AAS_FindRoutingCache(aasworld.clusterareacache[clusternum][clusterareanum], travelflags);
+	if (cache)
 	{
-		//if there aren't used any undesired travel types for the cache
-		if (cache->travelflags == travelflags) break;
-	} //end for
-	//if there was no cache
-	if (!cache)
-	{
-		cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		cache->prev = NULL;
-		cache->next = clustercache;
-		if (clustercache) clustercache->prev = cache;
-		aasworld.clusterareacache[clusternum][clusterareanum] = cache;
-		AAS_UpdateAreaRoutingCache(cache);
+		AAS_RoutingCacheHit(cache, shared);
+		return cache;
 	} //end if
-	else
+	//only one thread at a time adds to the routing cache
+	if (shared)
 	{
-		AAS_UnlinkCache(cache);
-	} //end else
-	//the cache has been accessed
-	cache->time = AAS_RoutingTime();
+		botimport.RoutingLock(qtrue);
+		cache = AAS_FindRoutingCache(aasworld.clusterareacache[clusternum][clusterareanum], travelflags);
+		if (cache)
+		{
+			AAS_RoutingCacheHit(cache, shared);
+			botimport.RoutingLock(qfalse);
+			return cache;
+		} //end if
+	} //end if
+	cache = AAS_AllocRoutingCache(aasworld.clusters[clusternum].numreachabilityareas);
 	cache->type = CACHETYPE_AREA;
+	cache->time = AAS_RoutingTime();
+	cache->cluster = clusternum;
+	cache->areanum = areanum;
+	VectorCopy(aasworld.areas[areanum].center, cache->origin);
+	cache->starttraveltime = 1;
+	cache->travelflags = travelflags;
+	AAS_UpdateAreaRoutingCache(cache);
+	//the atomic add also makes sure the cache is complete before the other threads can find it
+	AAS_RoutingCount(&routingcachemisses[CACHETYPE_AREA], shared);
+	//pointer to the cache for the area in the cluster
+	clustercache = aasworld.clusterareacache[clusternum][clusterareanum];
+	cache->prev = NULL;
+	cache->next = clustercache;
+	if (clustercache) clustercache->prev = cache;
+	aasworld.clusterareacache[clusternum][clusterareanum] = cache;
+	if (AAS_PinnedCache(cache)) routingcachepinnedsize += cache->size;
 	AAS_LinkCache(cache);
+	if (shared) botimport.RoutingLock(qfalse);
 	return cache;
 } //end of the function AAS_GetAreaRoutingCache
 //===========================================================================
@@ -1542,41 +1775,427 @@ void AAS_UpdatePortalRoutingCache(aas_routingcache_t *portalcache)
 //===========================================================================
 aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int travelflags)
 {
+	int shared;
 	aas_routingcache_t *cache;
 
+	shared = AAS_RoutingShared();
 	//find the cached portal routing if existing
-	for (cache = aasworld.portalcache[areanum]; cache; cache = cache->next)
+	cache = AAS_FindRoutingCache(aasworld.portalcache[areanum], travelflags);
+	if (cache)
 	{
-		if (cache->travelflags == travelflags) break;
-	} //end for
-	//if the portal routing isn't cached
-	if (!cache)
-	{
-		cache = AAS_AllocRoutingCache(aasworld.numportals);
-		cache->cluster = clusternum;
-		cache->areanum = areanum;
-		VectorCopy(aasworld.areas[areanum].center, cache->origin);
-		cache->starttraveltime = 1;
-		cache->travelflags = travelflags;
-		//add the cache to the cache list
-		cache->prev = NULL;
-		cache->next = aasworld.portalcache[areanum];
-		if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
-		aasworld.portalcache[areanum] = cache;
-		//update the cache
-		AAS_UpdatePortalRoutingCache(cache);
+		AAS_RoutingCacheHit(cache, shared);
+		return cache;
 	} //end if
-	else
+	//only one thread at a time adds to the routing cache
+	if (shared)
 	{
-		AAS_UnlinkCache(cache);
-	} //end else
-	//the cache has been accessed
-	cache->time = AAS_RoutingTime();
+		botimport.RoutingLock(qtrue);
+		cache = AAS_FindRoutingCache(aasworld.portalcache[areanum], travelflags);
+		if (cache)
+		{
+			AAS_RoutingCacheHit(cache, shared);
+			botimport.RoutingLock(qfalse);
+			return cache;
+		} //end if
+	} //end if
+	cache = AAS_AllocRoutingCache(aasworld.numportals);
 	cache->type = CACHETYPE_PORTAL;
+	cache->time = AAS_RoutingTime();
+	cache->cluster = clusternum;
+	cache->areanum = areanum;
+	VectorCopy(aasworld.areas[areanum].center, cache->origin);
+	cache->starttraveltime = 1;
+	cache->travelflags = travelflags;
+	//update the cache
+	AAS_UpdatePortalRoutingCache(cache);
+	//the atomic add also makes sure the cache is complete before the other threads can find it
+	AAS_RoutingCount(&routingcachemisses[CACHETYPE_PORTAL], shared);
+	//add the cache to the cache list
+	cache->prev = NULL;
+	cache->next = aasworld.portalcache[areanum];
+	if (aasworld.portalcache[areanum]) aasworld.portalcache[areanum]->prev = cache;
+	aasworld.portalcache[areanum] = cache;
 	AAS_LinkCache(cache);
+	if (shared) botimport.RoutingLock(qfalse);
 	return cache;
 } //end of the function AAS_GetPortalRoutingCache
 //===========================================================================
+// the routing tables are written by bspc next to the AAS file and hold
+// the cluster area routing cache of every goal area and the portal
+// routing cache of every area for a few combinations of travel flags
+//
+// the header is followed by every table in turn, each table is
+//	unsigned short clustertraveltimes[numreachabilityareas][numreachabilityareas] for every cluster
+//	unsigned short portaltraveltimes[numareas][numportals]
+//	unsigned char clusterreachabilities[numreachabilityareas][numreachabilityareas] for every cluster
+// padded to a multiple of four bytes
+//===========================================================================
+
+typedef struct routetableheader_s
+{
+	int ident;
+	int version;
+	int numareas;
+	int numclusters;
+	int numportals;
+	int areacrc;
+	int clustercrc;
+	int reachabilitycrc;
+	int numtables;
+	int travelflags[MAX_ROUTETABLES];
+} routetableheader_t;
+
+#define RTID						(('T'<<24)+('R'<<16)+('E'<<8)+'M')
+#define RTVERSION					1
+
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_RouteTableHeader(routetableheader_t *header)
+{
+	Com_Memset(header, 0, sizeof(routetableheader_t));
+	header->ident = RTID;
+	header->version = RTVERSION;
+	header->numareas = aasworld.numareas;
+	header->numclusters = aasworld.numclusters;
+	header->numportals = aasworld.numportals;
+	header->areacrc = CRC_ProcessString( (unsigned char *)aasworld.areas, sizeof(aas_area_t) * aasworld.numareas );
+	header->clustercrc = CRC_ProcessString( (unsigned char *)aasworld.clusters, sizeof(aas_cluster_t) * aasworld.numclusters );
+	header->reachabilitycrc = CRC_ProcessString( (unsigned char *)aasworld.reachability, sizeof(aas_reachability_t) * aasworld.reachabilitysize );
+} //end of the function AAS_RouteTableHeader
+//===========================================================================
+// size of one routing table in the file without the padding
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static int AAS_RouteTableSize(void)
+{
+	int i, size, numreachabilityareas;
+
+	size = 0;
+	for (i = 1; i < aasworld.numclusters; i++)
+	{
+		numreachabilityareas = aasworld.clusters[i].numreachabilityareas;
+		size += numreachabilityareas * numreachabilityareas * (sizeof(unsigned short int) + sizeof(unsigned char));
+	} //end for
+	size += aasworld.numareas * aasworld.numportals * sizeof(unsigned short int);
+	return size;
+} //end of the function AAS_RouteTableSize
+//===========================================================================
+// fills in the goal area for every reachability area of the cluster
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+static void AAS_ClusterGoalAreas(int clusternum, int *goalareas)
+{
+	int i, areacluster, clusterareanum;
+	aas_portal_t *portal;
+
+	for (i = 1; i < aasworld.numareas; i++)
+	{
+		areacluster = aasworld.areasettings[i].cluster;
+		if (areacluster < 0)
+		{
+			portal = &aasworld.portals[-areacluster];
+			if (portal->frontcluster != clusternum && portal->backcluster != clusternum) continue;
+		} //end if
+		else if (areacluster != clusternum) continue;
+		clusterareanum = AAS_ClusterAreaNum(clusternum, i);
+		if (clusterareanum >= aasworld.clusters[clusternum].numreachabilityareas) continue;
+		goalareas[clusterareanum] = i;
+	} //end for
+} //end of the function AAS_ClusterGoalAreas
+//===========================================================================
+// calculates the routing tables for the given travel flags and writes
+// them to file, this is done by bspc and takes a while
+//
+// Parameter:			filename		: file to write
+//						numtables		: number of travel flag combinations
+//						travelflags		: travel flags for every table
+// Returns:				qtrue if the tables were written
+// Changes Globals:		-
+//===========================================================================
+int AAS_WriteRouteTable(char *filename, int numtables, int *travelflags)
+{
+	int i, j, k, size, pad, *goalareas;
+	unsigned short int zero[2];
+	aas_routingcache_t *cache;
+	aas_cluster_t *cluster;
+	fileHandle_t fp;
+	routetableheader_t header;
+
+	if (numtables > MAX_ROUTETABLES) numtables = MAX_ROUTETABLES;
+	//
+	botimport.FS_FOpenFile(filename, &fp, FS_WRITE);
+	if (!fp)
+	{
+		AAS_Error("Unable to open file: %s\n", filename);
+		return qfalse;
+	} //end if
+	AAS_RouteTableHeader(&header);
+	header.numtables = numtables;
+	for (i = 0; i < numtables; i++) header.travelflags[i] = travelflags[i];
+	botimport.FS_Write(&header, sizeof(routetableheader_t), fp);
+	//
+	goalareas = (int *) GetClearedMemory(aasworld.numareas * sizeof(int));
+	zero[0] = zero[1] = 0;
+	size = 0;
+	for (i = 0; i < numtables; i++)
+	{
+		botimport.Print(PRT_MESSAGE, "routing table for travel flags 0x%x\n", travelflags[i]);
+		//travel times within the clusters
+		for (j = 1; j < aasworld.numclusters; j++)
+		{
+			cluster = &aasworld.clusters[j];
+			AAS_ClusterGoalAreas(j, goalareas);
+			for (k = 0; k < cluster->numreachabilityareas; k++)
+			{
+				cache = AAS_GetAreaRoutingCache(j, goalareas[k], travelflags[i]);
+				botimport.FS_Write(cache->traveltimes, cluster->numreachabilityareas * sizeof(unsigned short int), fp);
+			} //end for
+		} //end for
+		//travel times to the portals
+		for (j = 0; j < aasworld.numareas; j++)
+		{
+			//areas outside any cluster can't be routed to
+			if (!aasworld.areasettings[j].cluster)
+			{
+				for (k = 0; k < aasworld.numportals; k++) botimport.FS_Write(zero, sizeof(unsigned short int), fp);
+				continue;
+			} //end if
+			k = aasworld.areasettings[j].cluster;
+			if (k < 0) k = aasworld.portals[-k].frontcluster;
+			cache = AAS_GetPortalRoutingCache(k, j, travelflags[i]);
+			botimport.FS_Write(cache->traveltimes, aasworld.numportals * sizeof(unsigned short int), fp);
+		} //end for
+		//reachabilities within the clusters, the caches are still around
+		for (j = 1; j < aasworld.numclusters; j++)
+		{
+			cluster = &aasworld.clusters[j];
+			AAS_ClusterGoalAreas(j, goalareas);
+			for (k = 0; k < cluster->numreachabilityareas; k++)
+			{
+				cache = AAS_GetAreaRoutingCache(j, goalareas[k], travelflags[i]);
+				botimport.FS_Write(cache->reachabilities, cluster->numreachabilityareas, fp);
+			} //end for
+		} //end for
+		size = AAS_RouteTableSize();
+		pad = ((size + 3) & ~3) - size;
+		if (pad) botimport.FS_Write(zero, pad, fp);
+		//don't keep all the cache around for the next table
+		AAS_FreeAllClusterAreaCache();
+		AAS_FreeAllPortalCache();
+		AAS_InitClusterAreaCache();
+		AAS_InitPortalCache();
+	} //end for
+	FreeMemory(goalareas);
+	botimport.FS_FCloseFile(fp);
+	botimport.Print(PRT_MESSAGE, "routing tables written to %s\n", filename);
+	botimport.Print(PRT_MESSAGE, "written %d bytes of routing tables\n", (int) sizeof(routetableheader_t) + numtables * ((size + 3) & ~3));
+	return qtrue;
+} //end of the function AAS_WriteRouteTable
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_FreeRouteTable(void)
+{
+	if (aasworld.routetables) FreeMemory(aasworld.routetables);
+	aasworld.routetables = NULL;
+	if (aasworld.routetabledata) FreeMemory(aasworld.routetabledata);
+	aasworld.routetabledata = NULL;
+	aasworld.numroutetables = 0;
+} //end of the function AAS_FreeRouteTable
+//===========================================================================
+// reads the routing tables bspc wrote for the map, after this no
+// routing cache has to be calculated for the travel flags in the tables
+//
+// Parameter:			-
+// Returns:				qtrue if routing tables were loaded
+// Changes Globals:		-
+//===========================================================================
+int AAS_ReadRouteTable(void)
+{
+	int i, j, length, size, numreachabilityareas;
+	fileHandle_t fp;
+	char filename[MAX_QPATH];
+	routetableheader_t header, routetableheader;
+	aas_routetable_t *table;
+	byte *ptr, *data;
+
+	AAS_FreeRouteTable();
+	//
+	Com_sprintf(filename, MAX_QPATH, "maps/%s.rtb", aasworld.mapname);
+	length = botimport.FS_FOpenFile( filename, &fp, FS_READ );
+	if (!fp)
+	{
+		return qfalse;
+	} //end if
+	botimport.FS_Read(&routetableheader, sizeof(routetableheader_t), fp );
+	AAS_RouteTableHeader(&header);
+	if (routetableheader.ident != RTID)
+	{
+		AAS_Error("%s is not a routing table\n", filename);
+		botimport.FS_FCloseFile(fp);
+		return qfalse;
+	} //end if
+	//the routing tables are only valid for the exact AAS file they were calculated for
+	if (routetableheader.version != RTVERSION ||
+		routetableheader.numareas != header.numareas ||
+		routetableheader.numclusters != header.numclusters ||
+		routetableheader.numportals != header.numportals ||
+		routetableheader.areacrc != header.areacrc ||
+		routetableheader.clustercrc != header.clustercrc ||
+		routetableheader.reachabilitycrc != header.reachabilitycrc ||
+		routetableheader.numtables < 0 || routetableheader.numtables > MAX_ROUTETABLES)
+	{
+		botimport.Print(PRT_WARNING, "%s is out of date, ignored\n", filename);
+		botimport.FS_FCloseFile(fp);
+		return qfalse;
+	} //end if
+	size = (AAS_RouteTableSize() + 3) & ~3;
+	if (length != sizeof(routetableheader_t) + routetableheader.numtables * size)
+	{
+		botimport.Print(PRT_WARNING, "%s has the wrong size, ignored\n", filename);
+		botimport.FS_FCloseFile(fp);
+		return qfalse;
+	} //end if
+	//read all the tables in one go
+	data = (byte *) GetMemory(routetableheader.numtables * size);
+	botimport.FS_Read(data, routetableheader.numtables * size, fp);
+	botimport.FS_FCloseFile(fp);
+	//
+	ptr = (byte *) GetClearedMemory(routetableheader.numtables * (sizeof(aas_routetable_t) +
+								aasworld.numclusters * (sizeof(unsigned short int *) + sizeof(unsigned char *))) +
+								aasworld.numportals * sizeof(unsigned char));
+	aasworld.routetables = (aas_routetable_t *) ptr;
+	ptr += routetableheader.numtables * sizeof(aas_routetable_t);
+	aasworld.routetabledata = data;
+	aasworld.numroutetables = routetableheader.numtables;
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		table = &aasworld.routetables[i];
+		table->travelflags = routetableheader.travelflags[i];
+		table->clustertraveltimes = (unsigned short int **) ptr;
+		ptr += aasworld.numclusters * sizeof(unsigned short int *);
+		table->clusterreachabilities = (unsigned char **) ptr;
+		ptr += aasworld.numclusters * sizeof(unsigned char *);
+	} //end for
+	//the portal cache never stores reachabilities
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		aasworld.routetables[i].portalreachabilities = ptr;
+	} //end for
+	//point into the table data
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		table = &aasworld.routetables[i];
+		ptr = data + i * size;
+		for (j = 1; j < aasworld.numclusters; j++)
+		{
+			numreachabilityareas = aasworld.clusters[j].numreachabilityareas;
+			table->clustertraveltimes[j] = (unsigned short int *) ptr;
+			ptr += numreachabilityareas * numreachabilityareas * sizeof(unsigned short int);
+		} //end for
+		table->portaltraveltimes = (unsigned short int *) ptr;
+		ptr += aasworld.numareas * aasworld.numportals * sizeof(unsigned short int);
+		for (j = 1; j < aasworld.numclusters; j++)
+		{
+			numreachabilityareas = aasworld.clusters[j].numreachabilityareas;
+			table->clusterreachabilities[j] = ptr;
+			ptr += numreachabilityareas * numreachabilityareas;
+		} //end for
+	} //end for
+	botimport.Print(PRT_MESSAGE, "loaded %s\n", filename);
+	return qtrue;
+} //end of the function AAS_ReadRouteTable
+//===========================================================================
+// the routing tables no longer hold when areas are enabled or disabled
+//
+// Parameter:			clusternum		: cluster with changed areas, 0 for the portals only
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_InvalidateRouteTable(int clusternum)
+{
+	int i;
+
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		if (clusternum) aasworld.routetables[i].clustertraveltimes[clusternum] = NULL;
+		aasworld.routetables[i].portaltraveltimes = NULL;
+	} //end for
+} //end of the function AAS_InvalidateRouteTable
+//===========================================================================
+// returns the travel times and reachabilities towards the goal area for
+// all the reachability areas in the cluster
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_AreaRoutingTimes(int clusternum, int areanum, int travelflags,
+							unsigned short int **traveltimes, unsigned char **reachabilities)
+{
+	int i, clusterareanum, numreachabilityareas;
+	aas_routetable_t *table;
+	aas_routingcache_t *cache;
+
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		table = &aasworld.routetables[i];
+		if (table->travelflags != travelflags) continue;
+		if (!table->clustertraveltimes[clusternum]) break;
+		numreachabilityareas = aasworld.clusters[clusternum].numreachabilityareas;
+		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
+		if (clusterareanum >= numreachabilityareas) break;
+		*traveltimes = table->clustertraveltimes[clusternum] + clusterareanum * numreachabilityareas;
+		*reachabilities = table->clusterreachabilities[clusternum] + clusterareanum * numreachabilityareas;
+		AAS_RoutingCount(&routetablelookups, AAS_RoutingShared());
+		return;
+	} //end for
+	cache = AAS_GetAreaRoutingCache(clusternum, areanum, travelflags);
+	*traveltimes = cache->traveltimes;
+	*reachabilities = cache->reachabilities;
+} //end of the function AAS_AreaRoutingTimes
+//===========================================================================
+// returns the travel times towards the goal area for all the portals
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void AAS_PortalRoutingTimes(int clusternum, int areanum, int travelflags,
+							unsigned short int **traveltimes, unsigned char **reachabilities)
+{
+	int i;
+	aas_routetable_t *table;
+	aas_routingcache_t *cache;
+
+	for (i = 0; i < aasworld.numroutetables; i++)
+	{
+		table = &aasworld.routetables[i];
+		if (table->travelflags != travelflags) continue;
+		if (!table->portaltraveltimes) break;
+		*traveltimes = table->portaltraveltimes + areanum * aasworld.numportals;
+		*reachabilities = table->portalreachabilities;
+		AAS_RoutingCount(&routetablelookups, AAS_RoutingShared());
+		return;
+	} //end for
+	cache = AAS_GetPortalRoutingCache(clusternum, areanum, travelflags);
+	*traveltimes = cache->traveltimes;
+	*reachabilities = cache->reachabilities;
+} //end of the function AAS_PortalRoutingTimes
+//===========================================================================
 //
 // Parameter:			-
 // Returns:				-
@@ -1585,10 +2204,10 @@ aas_routingcache_t *AAS_GetPortalRoutingCache(int clusternum, int areanum, int t
 int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int travelflags, int *traveltime, int *reachnum)
 {
 	int clusternum, goalclusternum, portalnum, i, clusterareanum, bestreachnum;
-	unsigned short int t, besttime;
+	unsigned short int t, besttime, *areatraveltimes, *portaltraveltimes;
+	unsigned char *areareachabilities, *portalreachabilities;
 	aas_portal_t *portal;
 	aas_cluster_t *cluster;
-	aas_routingcache_t *areacache, *portalcache;
 	aas_reachability_t *reach;
 
 	if (!aasworld.initialized) return qfalse;
@@ -1616,8 +2235,11 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		} //end if
 		return qfalse;
 	} //end if
-	// make sure the routing cache doesn't grow to large
-	while(AvailableMemory() < 1 * 1024 * 1024) {
+	// make sure the routing cache doesn't grow to large, the budget is checked
+	// before any cache is used so a single query can still go over it, and
+	// not at all while other threads may be reading the caches, only the
+	// caches that can be evicted count against the budget
+	while(!AAS_RoutingShared() && (routingcachesize - routingcachepinnedsize > max_routingcachesize || AvailableMemory() < 1 * 1024 * 1024)) {
 		if (!AAS_FreeOldestCache()) break;
 	}
 	//
@@ -1663,7 +2285,7 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	if (clusternum > 0 && goalclusternum > 0 && clusternum == goalclusternum)
 	{
 		//
-		areacache = AAS_GetAreaRoutingCache(clusternum, goalareanum, travelflags);
+		AAS_AreaRoutingTimes(clusternum, goalareanum, travelflags, &areatraveltimes, &areareachabilities);
 		//the number of the area in the cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//the cluster the area is in
@@ -1671,16 +2293,16 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		//if the area is NOT a reachability area
 		if (clusterareanum >= cluster->numreachabilityareas) return 0;
 		//if it is possible to travel to the goal area through this cluster
-		if (areacache->traveltimes[clusterareanum] != 0)
+		if (areatraveltimes[clusterareanum] != 0)
 		{
 			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
+							areareachabilities[clusterareanum];
 			if (!origin) {
-				*traveltime = areacache->traveltimes[clusterareanum];
+				*traveltime = areatraveltimes[clusterareanum];
 				return qtrue;
 			}
 			reach = &aasworld.reachability[*reachnum];
-			*traveltime = areacache->traveltimes[clusterareanum] +
+			*traveltime = areatraveltimes[clusterareanum] +
 							AAS_AreaTravelTime(areanum, origin, reach->start);
 			//
 			return qtrue;
@@ -1697,13 +2319,13 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		goalclusternum = portal->frontcluster;
 	} //end if
 	//get the portal routing cache
-	portalcache = AAS_GetPortalRoutingCache(goalclusternum, goalareanum, travelflags);
+	AAS_PortalRoutingTimes(goalclusternum, goalareanum, travelflags, &portaltraveltimes, &portalreachabilities);
 	//if the area is a cluster portal, read directly from the portal cache
 	if (clusternum < 0)
 	{
-		*traveltime = portalcache->traveltimes[-clusternum];
+		*traveltime = portaltraveltimes[-clusternum];
 		*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-						portalcache->reachabilities[-clusternum];
+						portalreachabilities[-clusternum];
 		return qtrue;
 	} //end if
 	//
@@ -1716,20 +2338,20 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 	{
 		portalnum = aasworld.portalindex[cluster->firstportal + i];
 		//if the goal area isn't reachable from the portal
-		if (!portalcache->traveltimes[portalnum]) continue;
+		if (!portaltraveltimes[portalnum]) continue;
 		//
 		portal = &aasworld.portals[portalnum];
 		//get the cache of the portal area
-		areacache = AAS_GetAreaRoutingCache(clusternum, portal->areanum, travelflags);
+		AAS_AreaRoutingTimes(clusternum, portal->areanum, travelflags, &areatraveltimes, &areareachabilities);
 		//current area inside the current cluster
 		clusterareanum = AAS_ClusterAreaNum(clusternum, areanum);
 		//if the area is NOT a reachability area
 		if (clusterareanum >= cluster->numreachabilityareas) continue;
 		//if the portal is NOT reachable from this area
-		if (!areacache->traveltimes[clusterareanum]) continue;
+		if (!areatraveltimes[clusterareanum]) continue;
 		//total travel time is the travel time the portal area is from
 		//the goal area plus the travel time towards the portal area
-		t = portalcache->traveltimes[portalnum] + areacache->traveltimes[clusterareanum];
+		t = portaltraveltimes[portalnum] + areatraveltimes[clusterareanum];
 		//FIXME: add the exact travel time through the actual portal area
 		//NOTE: for now we just add the largest travel time through the portal area
 		//		because we can't directly calculate the exact travel time
@@ -1740,7 +2362,7 @@ int AAS_AreaRouteToGoalArea(int areanum, vec3_t origin, int goalareanum, int tra
 		if (origin)
 		{
 			*reachnum = aasworld.areasettings[areanum].firstreachablearea +
-							areacache->reachabilities[clusterareanum];
+							areareachabilities[clusterareanum];
 			reach = aasworld.reachability + *reachnum;
 			t += AAS_AreaTravelTime(areanum, origin, reach->start);
 		} //end if
@@ -39,8 +39,18 @@ unsigned short int AAS_AreaTravelTime(int areanum, vec3_t start, vec3_t end);
 //
 void AAS_CreateAllRoutingCache(void);
 void AAS_WriteRouteCache(void);
-//
+//calculate the routing tables for the given travel flags and write them to file
+int AAS_WriteRouteTable(char *filename, int numtables, int *travelflags);
+//read the routing tables for the map
+int AAS_ReadRouteTable(void);
+//free the routing tables
+void AAS_FreeRouteTable(void);
+//stop using the routing tables for the cluster and the portals
+void AAS_InvalidateRouteTable(int clusternum);
+//print the routing cache statistics
 void AAS_RoutingInfo(void);
+//print the routing cache statistics and memory use per cluster
+void AAS_DumpRoutingCache(void);
 #endif //AASINTERN
 
 //returns the travel flag for the given travel type
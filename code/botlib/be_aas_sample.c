@@ -54,6 +54,8 @@ extern botlib_import_t botimport;
 
 #define TRACEPLANE_EPSILON			0.125
 
+#define MAX_BBOXAREAS				1024	//areas AAS_BBoxAreas gathers before it stops
+
 typedef struct aas_tracestack_s
 {
 	vec3_t start;		//start point of the piece of line to trace
@@ -1221,6 +1223,62 @@ typedef struct
 } aas_linkstack_t;
 
 aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
+{
+	return AAS_AASLinkEntityMargin(absmins, absmaxs, entnum, NULL);
+} //end of the function AAS_AASLinkEntity
+//===========================================================================
+// same as AAS_BoxOnPlaneSide2 but also lowers the margin to how far the
+// box can move before it would end up on other sides of the plane
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AAS_BoxOnPlaneSideMargin(vec3_t absmins, vec3_t absmaxs, aas_plane_t *p, float *margin)
+{
+	int i, sides;
+	float dist1, dist2;
+	vec3_t corners[2];
+
+	for (i = 0; i < 3; i++)
+	{
+		if (p->normal[i] < 0)
+		{
+			corners[0][i] = absmins[i];
+			corners[1][i] = absmaxs[i];
+		} //end if
+		else
+		{
+			corners[1][i] = absmins[i];
+			corners[0][i] = absmaxs[i];
+		} //end else
+	} //end for
+	dist1 = DotProduct(p->normal, corners[0]) - p->dist;
+	dist2 = DotProduct(p->normal, corners[1]) - p->dist;
+	sides = 0;
+	if (dist1 >= 0) sides = 1;
+	if (dist2 < 0) sides |= 2;
+	//the sides stay the same as long as both corners stay where they are
+	if (sides & 1)
+	{
+		if (dist1 < *margin) *margin = dist1;
+	} //end if
+	else if (-dist1 < *margin) *margin = -dist1;
+	if (sides & 2)
+	{
+		if (-dist2 < *margin) *margin = -dist2;
+	} //end if
+	else if (dist2 < *margin) *margin = dist2;
+
+	return sides;
+} //end of the function AAS_BoxOnPlaneSideMargin
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+aas_link_t *AAS_AASLinkEntityMargin(vec3_t absmins, vec3_t absmaxs, int entnum, float *margin)
 {
 	int side, nodenum;
 	aas_linkstack_t linkstack[128];
@@ -1236,6 +1294,8 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 	} //end if
 
 	areas = NULL;
+	//nothing limits the movement yet
+	if (margin) *margin = 99999;
 	//
 	lstack_p = linkstack;
 	//we start with the whole line on the stack
@@ -1264,7 +1324,11 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 			if (link) continue;
 			//
 			link = AAS_AllocAASLink();
-			if (!link) return areas;
+			if (!link)
+			{
+				if (margin) *margin = 0;
+				return areas;
+			} //end if
 			link->entnum = entnum;
 			link->areanum = -nodenum;
 			//put the link into the double linked area list of the entity
@@ -1288,7 +1352,8 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		//the current node plane
 		plane = &aasworld.planes[aasnode->planenum];
 		//get the side(s) the box is situated relative to the plane
-		side = AAS_BoxOnPlaneSide2(absmins, absmaxs, plane);
+		if (margin) side = AAS_BoxOnPlaneSideMargin(absmins, absmaxs, plane, margin);
+		else side = AAS_BoxOnPlaneSide2(absmins, absmaxs, plane);
 		//if on the front side of the node
 		if (side & 1)
 		{
@@ -1298,6 +1363,7 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		if (lstack_p >= &linkstack[127])
 		{
 			botimport.Print(PRT_ERROR, "AAS_LinkEntity: stack overflow\n");
+			if (margin) *margin = 0;
 			break;
 		} //end if
 		//if on the back side of the node
@@ -1309,11 +1375,12 @@ aas_link_t *AAS_AASLinkEntity(vec3_t absmins, vec3_t absmaxs, int entnum)
 		if (lstack_p >= &linkstack[127])
 		{
 			botimport.Print(PRT_ERROR, "AAS_LinkEntity: stack overflow\n");
+			if (margin) *margin = 0;
 			break;
 		} //end if
 	} //end while
 	return areas;
-} //end of the function AAS_AASLinkEntity
+} //end of the function AAS_AASLinkEntityMargin
 //===========================================================================
 //
 // Parameter:				-
@@ -1339,19 +1406,54 @@ aas_link_t *AAS_LinkEntityClientBBox(vec3_t absmins, vec3_t absmaxs, int entnum,
 //===========================================================================
 int AAS_BBoxAreas(vec3_t absmins, vec3_t absmaxs, int *areas, int maxareas)
 {
-	aas_link_t *linkedareas, *link;
-	int num;
+	int nodenum, side, numfound, i, num;
+	int nodestack[128], *stack_p;
+	int found[MAX_BBOXAREAS];
+	aas_node_t *aasnode;
 
-	linkedareas = AAS_AASLinkEntity(absmins, absmaxs, -1);
-	num = 0;
-	for (link = linkedareas; link; link = link->next_area)
+	if (!aasworld.loaded)
+	{
+		botimport.Print(PRT_ERROR, "AAS_BBoxAreas: aas not loaded\n");
+		return 0;
+	} //end if
+	//walk the tree like AAS_AASLinkEntity without linking anything,
+	//so the areas can be looked up by several threads at once
+	numfound = 0;
+	stack_p = nodestack;
+	//start with node 1 because node zero is a dummy used for solid leafs
+	*stack_p++ = 1;
+	while (stack_p > nodestack && numfound < MAX_BBOXAREAS)
 	{
-		areas[num] = link->areanum;
-		num++;
-		if (num >= maxareas)
+		nodenum = *--stack_p;
+		//if it is an area
+		if (nodenum < 0)
+		{
+			//several node children can point to the same area
+			for (i = 0; i < numfound; i++)
+			{
+				if (found[i] == -nodenum) break;
+			} //end for
+			if (i >= numfound) found[numfound++] = -nodenum;
+			continue;
+		} //end if
+		//if solid leaf
+		if (!nodenum) continue;
+		aasnode = &aasworld.nodes[nodenum];
+		side = AAS_BoxOnPlaneSide2(absmins, absmaxs, &aasworld.planes[aasnode->planenum]);
+		if (stack_p + 2 > &nodestack[127])
+		{
+			botimport.Print(PRT_ERROR, "AAS_BBoxAreas: stack overflow\n");
 			break;
+		} //end if
+		if (side & 1) *stack_p++ = aasnode->children[0];
+		if (side & 2) *stack_p++ = aasnode->children[1];
+	} //end while
+	//the areas used to come from the entity link list, latest area first
+	num = 0;
+	for (i = numfound - 1; i >= 0 && num < maxareas; i--)
+	{
+		areas[num++] = found[i];
 	} //end for
-	AAS_UnlinkFromAreas(linkedareas);
 	return num;
 } //end of the function AAS_BBoxAreas
 //===========================================================================
@@ -295,6 +295,28 @@ int Export_BotLibUpdateEntity(int ent, bot_entitystate_t *state)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+int Export_BotLibUpdateEntities(int numentities, int *entnums, bot_entitystate_t *states)
+{
+	int i, errnum;
+
+	if (!BotLibSetup("BotUpdateEntities")) return BLERR_LIBRARYNOTSETUP;
+
+	for (i = 0; i < numentities; i++)
+	{
+		if (!ValidEntityNumber(entnums[i], "BotUpdateEntities")) return BLERR_INVALIDENTITYNUMBER;
+		errnum = AAS_UpdateEntity(entnums[i], &states[i]);
+		if (errnum != BLERR_NOERROR) return errnum;
+	} //end for
+	//the entities that were left out are gone
+	AAS_UnlinkInvalidEntities();
+	return BLERR_NOERROR;
+} //end of the function Export_BotLibUpdateEntities
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 void AAS_TestMovementPrediction(int entnum, vec3_t origin, vec3_t dir);
 void ElevatorBottomCenter(aas_reachability_t *reach, vec3_t bottomcenter);
 int BotGetReachabilityToGoal(vec3_t origin, int areanum,
@@ -875,6 +897,7 @@ botlib_export_t *GetBotLibAPI(int apiVersion, botlib_import_t *import) {
 	be_botlib_export.BotLibStartFrame = Export_BotLibStartFrame;
 	be_botlib_export.BotLibLoadMap = Export_BotLibLoadMap;
 	be_botlib_export.BotLibUpdateEntity = Export_BotLibUpdateEntity;
+	be_botlib_export.BotLibUpdateEntities = Export_BotLibUpdateEntities;
 	be_botlib_export.Test = BotExportTest;
 
 	return &be_botlib_export;
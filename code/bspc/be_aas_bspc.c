@@ -40,6 +40,7 @@ extern	qboolean capsule_collision;
 
 botlib_import_t botimport;
 clipHandle_t worldmodel;
+int bot_developer;
 
 void Error (char *error, ...);
 
@@ -94,6 +95,42 @@ void AAS_ClearShownDebugLines(void)
 // Returns:					-
 // Changes Globals:		-
 //===========================================================================
+float AAS_Time(void)
+{
+	return 0;
+} //end of the function AAS_Time
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+int AvailableMemory(void)
+{
+	return 0x7fffffff;
+} //end of the function AvailableMemory
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_ProjectPointOntoVector( vec3_t point, vec3_t vStart, vec3_t vEnd, vec3_t vProj )
+{
+	vec3_t pVec, vec;
+
+	VectorSubtract( point, vStart, pVec );
+	VectorSubtract( vEnd, vStart, vec );
+	VectorNormalize( vec );
+	// project onto the directional vector for this segment
+	VectorMA( vStart, DotProduct( pVec, vec ), vec, vProj );
+} //end of the function AAS_ProjectPointOntoVector
+//===========================================================================
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
 char *BotImport_BSPEntityData(void)
 {
 	return CM_EntityString();
@@ -236,6 +273,84 @@ void Com_Memcpy (void* dest, const void* src, const size_t count) {
 	memcpy(dest, src, count);
 }
 //===========================================================================
+// the botlib only needs plain files in bspc
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+#define MAX_BOTIMPORT_FILES		4
+
+FILE *botimportfiles[MAX_BOTIMPORT_FILES];
+
+int BotImport_FS_FOpenFile(const char *qpath, fileHandle_t *file, fsMode_t mode)
+{
+	int i, length;
+	FILE *fp;
+
+	*file = 0;
+	for (i = 1; i < MAX_BOTIMPORT_FILES; i++)
+	{
+		if (!botimportfiles[i]) break;
+	} //end for
+	if (i >= MAX_BOTIMPORT_FILES) return -1;
+	fp = fopen(qpath, mode == FS_READ ? "rb" : "wb");
+	if (!fp) return -1;
+	botimportfiles[i] = fp;
+	*file = i;
+	if (mode != FS_READ) return 0;
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	return length;
+} //end of the function BotImport_FS_FOpenFile
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotImport_FS_Read(void *buffer, int len, fileHandle_t f)
+{
+	return fread(buffer, 1, len, botimportfiles[f]);
+} //end of the function BotImport_FS_Read
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+int BotImport_FS_Write(const void *buffer, int len, fileHandle_t f)
+{
+	return fwrite(buffer, 1, len, botimportfiles[f]);
+} //end of the function BotImport_FS_Write
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void BotImport_FS_FCloseFile(fileHandle_t f)
+{
+	fclose(botimportfiles[f]);
+	botimportfiles[f] = NULL;
+} //end of the function BotImport_FS_FCloseFile
+//===========================================================================
+//
+// Parameter:			-
+// Returns:				-
+// Changes Globals:		-
+//===========================================================================
+void Com_sprintf(char *dest, int size, const char *fmt, ...)
+{
+	va_list argptr;
+
+	va_start(argptr, fmt);
+	vsnprintf(dest, size, fmt, argptr);
+	dest[size - 1] = '\0';
+	va_end(argptr);
+} //end of the function Com_sprintf
+//===========================================================================
 //
 // Parameter:				-
 // Returns:					-
@@ -250,6 +365,10 @@ void AAS_InitBotImport(void)
 	botimport.PointContents = BotImport_PointContents;
 	botimport.Print = BotImport_Print;
 	botimport.BSPModelMinsMaxsOrigin = BotImport_BSPModelMinsMaxsOrigin;
+	botimport.FS_FOpenFile = BotImport_FS_FOpenFile;
+	botimport.FS_Read = BotImport_FS_Read;
+	botimport.FS_Write = BotImport_FS_Write;
+	botimport.FS_FCloseFile = BotImport_FS_FCloseFile;
 } //end of the function AAS_InitBotImport
 //===========================================================================
 //
@@ -290,3 +409,23 @@ void AAS_CalcReachAndClusters(struct quakefile_s *qf)
 	//calculate clusters
 	AAS_InitClustering();
 } //end of the function AAS_CalcReachAndClusters
+//===========================================================================
+// calculates the routing tables the bots load with the AAS file
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_CalcRouteTables(char *filename)
+{
+	int travelflags[2];
+
+	AAS_InitBotImport();
+	//the routing the way the game sets it up
+	AAS_InitRouting();
+	//the bots use the default travel flags, with rocket jumping when they have a rocket launcher
+	travelflags[0] = TFL_DEFAULT;
+	travelflags[1] = TFL_DEFAULT | TFL_ROCKETJUMP;
+	AAS_WriteRouteTable(filename, 2, travelflags);
+	AAS_FreeRoutingCaches();
+} //end of the function AAS_CalcRouteTables
@@ -500,6 +500,7 @@ quakefile_t *GetArgumentFiles(int argc, char *argv[], int *i, char *ext)
 #define COMP_CLUSTER		4
 #define COMP_AASOPTIMIZE	5
 #define COMP_AASINFO		6
+#define COMP_ROUTE			7
 
 int main (int argc, char **argv)
 {
@@ -718,6 +719,12 @@ int main (int argc, char **argv)
 			comp = COMP_AASOPTIMIZE;
 			qfiles = GetArgumentFiles(argc, argv, &i, "aas");
 		} //end else if
+		else if (!stricmp(argv[i], "-route"))
+		{
+			if (i + 1 >= argc) {i = 0; break;}
+			comp = COMP_ROUTE;
+			qfiles = GetArgumentFiles(argc, argv, &i, "aas");
+		} //end else if
 #endif //ME
 		else
 		{
@@ -905,6 +912,31 @@ int main (int argc, char **argv)
 				} //end for
 				break;
 			} //end case
+			case COMP_ROUTE:
+			{
+				if (!qfiles) Log_Print("no files found\n");
+				for (qf = qfiles; qf; qf = qf->next)
+				{
+					AASOuputFile(qf, outputpath, filename);
+					//the routing tables go next to the aas file
+					StripExtension(filename);
+					strcat(filename, ".rtb");
+					//
+					Log_Print("routing tables: %s to %s\n", qf->origname, filename);
+					if (qf->type != QFILETYPE_AAS) Warning("%s is probably not a AAS file\n", qf->origname);
+					//
+					AAS_InitBotImport();
+					//
+					if (!AAS_LoadAASFile(qf->filename, qf->offset, qf->length))
+					{
+						Error("error loading aas file %s\n", qf->filename);
+					} //end if
+					AAS_CalcRouteTables(filename);
+					//deallocate memory
+					AAS_FreeMaxAAS();
+				} //end for
+				break;
+			} //end case
 			case COMP_AASINFO:
 			{
 				if (!qfiles) Log_Print("no files found\n");
@@ -950,6 +982,7 @@ int main (int argc, char **argv)
 			"   cluster  <filter.aas>                = compute clusters\n"
 			"   aasopt   <filter.aas>                = optimize aas file\n"
 			"   aasinfo  <filter.aas>                = show AAS file info\n"
+			"   route    <filter.aas>                = calculate routing tables\n"
 			"   output   <output path>               = set output path\n"
 			"   threads  <X>                         = set number of threads to X\n"
 			"   cfg      <filename>                  = use this cfg file\n"
@@ -1168,6 +1168,17 @@ unsigned short CRC_Value(unsigned short crcvalue)
 {
 	return crcvalue ^ CRC_XOR_VALUE;
 }
+
+unsigned short CRC_ProcessString(unsigned char *data, int length)
+{
+	unsigned short crcvalue;
+	int i;
+
+	CRC_Init(&crcvalue);
+	for (i = 0; i < length; i++)
+		CRC_ProcessByte(&crcvalue, data[i]);
+	return CRC_Value(crcvalue);
+}
 //=============================================================================
 
 /*
@@ -132,6 +132,7 @@ char *copystring(char *s);
 void CRC_Init(unsigned short *crcvalue);
 void CRC_ProcessByte(unsigned short *crcvalue, byte data);
 unsigned short CRC_Value(unsigned short crcvalue);
+unsigned short CRC_ProcessString(unsigned char *data, int length);
 
 void	CreatePath (char *path);
 void	QCopyFile (char *from, char *to);
@@ -2213,6 +2213,9 @@ void CL_InitRef( void ) {
 	ri.CM_DrawDebugSurface = CM_DrawDebugSurface;
 	ri.FS_ReadFile = FS_ReadFile;
 	ri.FS_FreeFile = FS_FreeFile;
+	ri.FS_ReadFileAsync = (int (*)( const char *, int, fsLoadCallback_t, void * ))FS_ReadFileAsync;
+	ri.FS_FinishAsyncLoads = FS_FinishAsyncLoads;
+	ri.FS_FreeAsyncFile = FS_FreeAsyncFile;
 	ri.FS_WriteFile = FS_WriteFile;
 	ri.FS_FreeFileList = FS_FreeFileList;
 	ri.FS_ListFiles = FS_ListFiles;
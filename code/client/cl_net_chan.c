@@ -147,7 +147,7 @@ void CL_Netchan_Transmit( netchan_t *chan, msg_t* msg ) {
 	Netchan_Transmit( chan, msg->cursize, msg->data );
 }
 
-extern 	int oldsize;
+extern 	THREAD_LOCAL int oldsize;
 int newsize = 0;
 
 /*
@@ -73,6 +73,7 @@ int bot_interbreedmatchcount;
 vmCvar_t bot_thinktime;
 vmCvar_t bot_memorydump;
 vmCvar_t bot_saveroutingcache;
+vmCvar_t bot_routingcachedump;
 vmCvar_t bot_pause;
 vmCvar_t bot_report;
 vmCvar_t bot_testsolid;
@@ -1376,8 +1377,12 @@ BotAIStartFrame
 */
 int BotAIStartFrame(int time) {
 	int i;
+	int thinking[MAX_CLIENTS], numthinking;
 	gentity_t	*ent;
-	bot_entitystate_t state;
+	bot_entitystate_t *state;
+	static bot_entitystate_t states[MAX_GENTITIES];
+	static int entnums[MAX_GENTITIES];
+	int numentities;
 	int elapsed_time, thinktime;
 	static int local_time;
 	static int botlib_residual;
@@ -1393,6 +1398,7 @@ int BotAIStartFrame(int time) {
 	trap_Cvar_Update(&bot_thinktime);
 	trap_Cvar_Update(&bot_memorydump);
 	trap_Cvar_Update(&bot_saveroutingcache);
+	trap_Cvar_Update(&bot_routingcachedump);
 	trap_Cvar_Update(&bot_pause);
 	trap_Cvar_Update(&bot_report);
 
@@ -1429,6 +1435,10 @@ int BotAIStartFrame(int time) {
 		trap_BotLibVarSet("saveroutingcache", "1");
 		trap_Cvar_Set("bot_saveroutingcache", "0");
 	}
+	if (bot_routingcachedump.integer) {
+		trap_BotLibVarSet("routingcachedump", "1");
+		trap_Cvar_Set("bot_routingcachedump", "0");
+	}
 	//check if bot interbreeding is activated
 	BotInterbreeding();
 	//cap the bot think time
@@ -1458,68 +1468,66 @@ int BotAIStartFrame(int time) {
 		if (!trap_AAS_Initialized()) return qfalse;
 
 		//update entities in the botlib
+		numentities = 0;
 		for (i = 0; i < MAX_GENTITIES; i++) {
 			ent = &g_entities[i];
 			if (!ent->inuse) {
-				trap_BotLibUpdateEntity(i, NULL);
 				continue;
 			}
 			if (!ent->r.linked) {
-				trap_BotLibUpdateEntity(i, NULL);
 				continue;
 			}
 			if (ent->r.svFlags & SVF_NOCLIENT) {
-				trap_BotLibUpdateEntity(i, NULL);
 				continue;
 			}
 			// do not update missiles
 			if (ent->s.eType == ET_MISSILE && ent->s.weapon != WP_GRAPPLING_HOOK) {
-				trap_BotLibUpdateEntity(i, NULL);
 				continue;
 			}
 			// do not update event only entities
 			if (ent->s.eType > ET_EVENTS) {
-				trap_BotLibUpdateEntity(i, NULL);
 				continue;
 			}
 #ifdef MISSIONPACK
 			// never link prox mine triggers
 			if (ent->r.contents == CONTENTS_TRIGGER) {
 				if (ent->touch == ProximityMine_Trigger) {
-					trap_BotLibUpdateEntity(i, NULL);
 					continue;
 				}
 			}
 #endif
 			//
-			memset(&state, 0, sizeof(bot_entitystate_t));
+			state = &states[numentities];
+			memset(state, 0, sizeof(bot_entitystate_t));
 			//
-			VectorCopy(ent->r.currentOrigin, state.origin);
+			VectorCopy(ent->r.currentOrigin, state->origin);
 			if (i < MAX_CLIENTS) {
-				VectorCopy(ent->s.apos.trBase, state.angles);
+				VectorCopy(ent->s.apos.trBase, state->angles);
 			} else {
-				VectorCopy(ent->r.currentAngles, state.angles);
+				VectorCopy(ent->r.currentAngles, state->angles);
 			}
-			VectorCopy(ent->s.origin2, state.old_origin);
-			VectorCopy(ent->r.mins, state.mins);
-			VectorCopy(ent->r.maxs, state.maxs);
-			state.type = ent->s.eType;
-			state.flags = ent->s.eFlags;
-			if (ent->r.bmodel) state.solid = SOLID_BSP;
-			else state.solid = SOLID_BBOX;
-			state.groundent = ent->s.groundEntityNum;
-			state.modelindex = ent->s.modelindex;
-			state.modelindex2 = ent->s.modelindex2;
-			state.frame = ent->s.frame;
-			state.event = ent->s.event;
-			state.eventParm = ent->s.eventParm;
-			state.powerups = ent->s.powerups;
-			state.legsAnim = ent->s.legsAnim;
-			state.torsoAnim = ent->s.torsoAnim;
-			state.weapon = ent->s.weapon;
+			VectorCopy(ent->s.origin2, state->old_origin);
+			VectorCopy(ent->r.mins, state->mins);
+			VectorCopy(ent->r.maxs, state->maxs);
+			state->type = ent->s.eType;
+			state->flags = ent->s.eFlags;
+			if (ent->r.bmodel) state->solid = SOLID_BSP;
+			else state->solid = SOLID_BBOX;
+			state->groundent = ent->s.groundEntityNum;
+			state->modelindex = ent->s.modelindex;
+			state->modelindex2 = ent->s.modelindex2;
+			state->frame = ent->s.frame;
+			state->event = ent->s.event;
+			state->eventParm = ent->s.eventParm;
+			state->powerups = ent->s.powerups;
+			state->legsAnim = ent->s.legsAnim;
+			state->torsoAnim = ent->s.torsoAnim;
+			state->weapon = ent->s.weapon;
 			//
-			trap_BotLibUpdateEntity(i, &state);
+			entnums[numentities++] = i;
 		}
+		//the entities left out are unlinked
+		trap_BotLibUpdateEntities(numentities, entnums, states);
 
 		BotAIRegularUpdate();
 	}
@@ -1527,6 +1535,7 @@ int BotAIStartFrame(int time) {
 	floattime = trap_AAS_Time();
 
 	// execute scheduled bot AI
+	numthinking = 0;
 	for( i = 0; i < MAX_CLIENTS; i++ ) {
 		if( !botstates[i] || !botstates[i]->inuse ) {
 			continue;
@@ -1540,10 +1549,17 @@ int BotAIStartFrame(int time) {
 			if (!trap_AAS_Initialized()) return qfalse;
 
 			if (g_entities[i].client->pers.connected == CON_CONNECTED) {
-				BotAI(i, (float) thinktime / 1000);
+				thinking[numthinking++] = i;
 			}
 		}
 	}
+	//the engine may think the bots on several threads, the user
+	//commands below are still sent one by one in client order
+	if (numthinking < 2 || !trap_BotParallelThink(thinking, numthinking, thinktime)) {
+		for (i = 0; i < numthinking; i++) {
+			BotAI(thinking[i], (float) thinktime / 1000);
+		}
+	}
 
 
 	// execute bot user commands every frame
@@ -1562,6 +1578,17 @@ int BotAIStartFrame(int time) {
 	return qtrue;
 }
 
+/*
+==================
+BotAIThink
+
+Called by the engine for each bot of trap_BotParallelThink
+==================
+*/
+int BotAIThink(int client, int thinktime) {
+	return BotAI(client, (float) thinktime / 1000);
+}
+
 /*
 ==============
 BotInitLibrary
@@ -1613,6 +1640,9 @@ int BotInitLibrary(void) {
 	//
 	trap_Cvar_VariableStringBuffer("bot_saveroutingcache", buf, sizeof(buf));
 	if (strlen(buf)) trap_BotLibVarSet("saveroutingcache", buf);
+	//routing cache budget in kilobytes
+	trap_Cvar_VariableStringBuffer("bot_maxroutingcache", buf, sizeof(buf));
+	if (strlen(buf)) trap_BotLibVarSet("max_routingcache", buf);
 	//reload instead of cache bot character files
 	trap_Cvar_VariableStringBuffer("bot_reloadcharacters", buf, sizeof(buf));
 	if (!strlen(buf)) strcpy(buf, "0");
@@ -1645,6 +1675,7 @@ int BotAISetup( int restart ) {
 	trap_Cvar_Register(&bot_thinktime, "bot_thinktime", "100", CVAR_CHEAT);
 	trap_Cvar_Register(&bot_memorydump, "bot_memorydump", "0", CVAR_CHEAT);
 	trap_Cvar_Register(&bot_saveroutingcache, "bot_saveroutingcache", "0", CVAR_CHEAT);
+	trap_Cvar_Register(&bot_routingcachedump, "bot_routingcachedump", "0", CVAR_CHEAT);
 	trap_Cvar_Register(&bot_pause, "bot_pause", "0", CVAR_CHEAT);
 	trap_Cvar_Register(&bot_report, "bot_report", "0", CVAR_CHEAT);
 	trap_Cvar_Register(&bot_testsolid, "bot_testsolid", "0", CVAR_CHEAT);
@@ -29,7 +29,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *
  *****************************************************************************/
 
-#define	BOTLIB_API_VERSION		2
+#define	BOTLIB_API_VERSION		3
 
 struct aas_clientmove_s;
 struct aas_entityinfo_s;
@@ -202,6 +202,12 @@ typedef struct botlib_import_s
 	//
 	int			(*DebugPolygonCreate)(int color, int numPoints, vec3_t *points);
 	void		(*DebugPolygonDelete)(int id);
+	//true while other threads may query the routing at the same time
+	int			(*RoutingShared)(void);
+	//serializes the routing cache updates while the routing is shared
+	void		(*RoutingLock)(int lock);
+	//atomically adds to the value and returns the new value
+	int			(*AtomicAdd)(volatile int *value, int add);
 } botlib_import_t;
 
 typedef struct aas_export_s
@@ -425,6 +431,9 @@ typedef struct botlib_export_s
 	int (*BotLibLoadMap)(const char *mapname);
 	//entity updates
 	int (*BotLibUpdateEntity)(int ent, bot_entitystate_t *state);
+	//updates the listed entities and unlinks all the others that were not
+	//updated since the start of the frame
+	int (*BotLibUpdateEntities)(int numentities, int *entnums, bot_entitystate_t *states);
 	//just for testing
 	int (*Test)(int parm0, char *parm1, vec3_t parm2, vec3_t parm3);
 } botlib_export_t;
@@ -232,6 +232,8 @@ int vmMain( int command, int arg0, int arg1, int arg2, int arg3, int arg4, int a
 		return ConsoleCommand();
 	case BOTAI_START_FRAME:
 		return BotAIStartFrame( arg0 );
+	case BOTAI_THINK:
+		return BotAIThink( arg0, arg1 );
 	}
 
 	return -1;
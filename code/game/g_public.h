@@ -229,6 +229,12 @@ typedef enum {
 	// 1.32
 	G_FS_SEEK,
 
+	G_TRACEBATCH,	// ( trace_t *results, const traceRay_t *rays, int numRays, const vec3_t mins, const vec3_t maxs, int passEntityNum, int contentmask );
+
+	G_BOT_PARALLEL_THINK,	// ( const int *clients, int numClients, int thinktime );
+	// calls BOTAI_THINK for each of the clients on the job threads
+	// returns qfalse if the bots should think one by one instead
+
 	BOTLIB_SETUP = 200,				// ( void );
 	BOTLIB_SHUTDOWN,				// ( void );
 	BOTLIB_LIBVAR_SET,
@@ -242,6 +248,7 @@ typedef enum {
 	BOTLIB_GET_SNAPSHOT_ENTITY,		// ( int client, int ent );
 	BOTLIB_GET_CONSOLE_MESSAGE,		// ( int client, char *message, int size );
 	BOTLIB_USER_COMMAND,			// ( int client, usercmd_t *ucmd );
+	BOTLIB_UPDATENTITIES,			// ( int numEntities, int *entnums, bot_entitystate_t *states );
 
 	BOTLIB_AAS_ENABLE_ROUTING_AREA = 300,
 	BOTLIB_AAS_BBOX_AREAS,
@@ -424,6 +431,9 @@ typedef enum {
 	// The game can issue trap_argc() / trap_argv() commands to get the command
 	// and parameters.  Return qfalse if the game doesn't recognize it as a command.
 
-	BOTAI_START_FRAME				// ( int time );
+	BOTAI_START_FRAME,				// ( int time );
+
+	BOTAI_THINK						// ( int client, int thinktime );
+	// only called from inside G_BOT_PARALLEL_THINK, possibly from another thread
 } gameExport_t;
 
@@ -46,6 +46,8 @@ equ trap_SnapVector			-43
 equ trap_TraceCapsule		-44
 equ trap_EntityContactCapsule	-45
 equ trap_FS_Seek -46
+equ trap_TraceBatch -47
+equ trap_BotParallelThink -48
 
 equ	memset					-101
 equ	memcpy					-102
@@ -74,6 +76,7 @@ equ trap_BotLibTest						-209
 equ trap_BotGetSnapshotEntity			-210
 equ trap_BotGetServerCommand		-211
 equ trap_BotUserCommand					-212
+equ trap_BotLibUpdateEntities			-213
 
 
 
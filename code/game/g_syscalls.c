@@ -154,6 +154,10 @@ void trap_TraceCapsule( trace_t *results, const vec3_t start, const vec3_t mins,
 	syscall( G_TRACECAPSULE, results, start, mins, maxs, end, passEntityNum, contentmask );
 }
 
+void trap_TraceBatch( trace_t *results, const traceRay_t *rays, int numRays, const vec3_t mins, const vec3_t maxs, int passEntityNum, int contentmask ) {
+	syscall( G_TRACEBATCH, results, rays, numRays, mins, maxs, passEntityNum, contentmask );
+}
+
 int trap_PointContents( const vec3_t point, int passEntityNum ) {
 	return syscall( G_POINT_CONTENTS, point, passEntityNum );
 }
@@ -261,6 +265,10 @@ int trap_BotLibUpdateEntity(int ent, void /* struct bot_updateentity_s */ *bue)
 	return syscall( BOTLIB_UPDATENTITY, ent, bue );
 }
 
+int trap_BotLibUpdateEntities(int numEntities, int *entnums, void /* struct bot_updateentity_s */ *bues) {
+	return syscall( BOTLIB_UPDATENTITIES, numEntities, entnums, bues );
+}
+
 int trap_BotLibTest(int parm0, char *parm1, vec3_t parm2, vec3_t parm3) {
 	return syscall( BOTLIB_TEST, parm0, parm1, parm2, parm3 );
 }
@@ -277,6 +285,10 @@ void trap_BotUserCommand(int clientNum, usercmd_t *ucmd) {
 	syscall( BOTLIB_USER_COMMAND, clientNum, ucmd );
 }
 
+int trap_BotParallelThink( const int *clients, int numClients, int thinktime ) {
+	return syscall( G_BOT_PARALLEL_THINK, clients, numClients, thinktime );
+}
+
 void trap_AAS_EntityInfo(int entnum, void /* struct aas_entityinfo_s */ *info) {
 	syscall( BOTLIB_AAS_ENTITY_INFO, entnum, info );
 }
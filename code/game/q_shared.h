@@ -1037,6 +1037,14 @@ typedef struct {
 	int			entityNum;	// entity the contacted sirface is a part of
 } trace_t;
 
+// one of a group of traces that share a box size and content mask
+typedef struct {
+	vec3_t		start;
+	vec3_t		end;
+} traceRay_t;
+
+#define	MAX_TRACE_BATCH		1024	// rays beyond this are ignored
+
 // trace->entityNum can also be 0 to (MAX_GENTITIES-1)
 // or ENTITYNUM_NONE, ENTITYNUM_WORLD
 
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // cmodel.c -- model loading
 
 #include "cm_local.h"
+#include "cm_patch.h"
 
 #ifdef BSPC
 
@@ -42,11 +43,18 @@ void SetPlaneSignbits (cplane_t *out) {
 #endif //BSPC
 
 // to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
-#define	BOX_BRUSHES		1
-#define	BOX_SIDES		6
+// some extra indexes along with those needed by the map, one
+// box for each thread that can trace
+#ifdef BSPC
+#define	MAX_BOX_HULLS	1
+#else
+#define	MAX_BOX_HULLS	( 1 + MAX_JOB_THREADS )
+#endif
+
+#define	BOX_BRUSHES		( 1 * MAX_BOX_HULLS )
+#define	BOX_SIDES		( 6 * MAX_BOX_HULLS )
 #define	BOX_LEAFS		2
-#define	BOX_PLANES		12
+#define	BOX_PLANES		( 12 * MAX_BOX_HULLS )
 
 #define	LL(x) x=LittleLong(x)
 
@@ -62,15 +70,25 @@ byte		*cmod_base;
 cvar_t		*cm_noAreas;
 cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
+cvar_t		*cm_patchCache;
 #endif
 
-cmodel_t	box_model;
-cplane_t	*box_planes;
-cbrush_t	*box_brush;
+typedef struct {
+	cmodel_t	model;
+	cplane_t	*planes;
+	cbrush_t	*brush;
+} boxHull_t;
+
+static boxHull_t	cm_boxHulls[MAX_BOX_HULLS];
+static volatile int	cm_numBoxHulls;
+#ifndef BSPC
+static THREAD_LOCAL boxHull_t	*cm_boxHull;	// the hull of the calling thread
+#endif
 
 
 
 void	CM_InitBoxHull (void);
+static boxHull_t	*CM_BoxHull( void );
 void	CM_FloodAreaConnections (void);
 
 
@@ -223,6 +241,37 @@ void CM_BoundBrush( cbrush_t *b ) {
 	b->bounds[1][2] = b->sides[5].plane->dist;
 }
 
+/*
+=================
+CM_SetBrushPlaneGroups
+
+Copies the side planes into the layout CM_TraceThroughBrush
+tests four at a time
+=================
+*/
+void CM_SetBrushPlaneGroups( cbrush_t *b ) {
+	int			i, j;
+	float		*group;
+	cplane_t	*plane;
+
+	for ( i = 0 ; i < b->numsides ; i += 4 ) {
+		group = b->planeGroups + ( i >> 2 ) * BRUSH_PLANE_GROUP;
+		for ( j = 0 ; j < 4 ; j++ ) {
+			if ( i + j < b->numsides ) {
+				plane = b->sides[i+j].plane;
+				group[j] = plane->normal[0];
+				group[4+j] = plane->normal[1];
+				group[8+j] = plane->normal[2];
+				group[12+j] = plane->dist;
+			} else {
+				// everything is behind a padding side
+				group[j] = group[4+j] = group[8+j] = 0;
+				group[12+j] = 1e30f;
+			}
+		}
+	}
+}
+
 
 /*
 =================
@@ -234,6 +283,8 @@ void CMod_LoadBrushes( lump_t *l ) {
 	dbrush_t	*in;
 	cbrush_t	*out;
 	int			i, count;
+	int			numGroups;
+	float		*groups;
 
 	in = (void *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in)) {
@@ -259,6 +310,17 @@ void CMod_LoadBrushes( lump_t *l ) {
 		CM_BoundBrush( out );
 	}
 
+	// the side planes again, four at a time
+	numGroups = 0;
+	for ( i = 0, out = cm.brushes ; i < count ; i++, out++ ) {
+		numGroups += ( out->numsides + 3 ) >> 2;
+	}
+	groups = Hunk_Alloc( numGroups * BRUSH_PLANE_GROUP * sizeof( float ), h_high );
+	for ( i = 0, out = cm.brushes ; i < count ; i++, out++ ) {
+		out->planeGroups = groups;
+		CM_SetBrushPlaneGroups( out );
+		groups += ( ( out->numsides + 3 ) >> 2 ) * BRUSH_PLANE_GROUP;
+	}
 }
 
 /*
@@ -475,13 +537,239 @@ void CMod_LoadVisibility( lump_t *l ) {
 //==================================================================
 
 
+#ifndef BSPC
+/*
+===============================================================================
+
+PATCH COLLISION CACHE
+
+Generating the patch collision is a good part of loading a curvy map, so
+the result is saved under cache/ and read straight back onto the hunk in
+one block the next time the same bsp is loaded.  The planes and facets are
+used where they land.  Anything that doesn't match exactly, the checksum
+included, means the patches get generated and the cache rewritten.
+
+===============================================================================
+*/
+
+#define	PATCH_CACHE_IDENT		(('L'<<24)+('O'<<16)+('C'<<8)+'P')		// little-endian "PCOL"
+#define	PATCH_CACHE_VERSION		1
+
+typedef struct {
+	int			ident;
+	int			version;
+	unsigned	checksum;			// of the whole bsp
+	int			numSurfaces;
+	int			numPatches;
+	int			planeSize;			// sizeof( patchPlane_t )
+	int			facetSize;			// sizeof( facet_t )
+	int			dataSize;			// bytes of records after the header
+} patchCacheHeader_t;
+
+typedef struct {
+	int			surfaceNum;
+	vec3_t		bounds[2];
+	int			numPlanes;
+	int			numFacets;
+	// followed by the planes, then the facets
+} patchCacheRecord_t;
+
+/*
+=================
+CM_PatchCacheName
+=================
+*/
+static void CM_PatchCacheName( const char *name, char *path, int size ) {
+	char	base[MAX_QPATH];
+
+	COM_StripExtension( COM_SkipPath( (char *)name ), base );
+	Com_sprintf( path, size, "cache/%s.pcol", base );
+}
+
+/*
+=================
+CM_CheckPatchCache
+
+Makes sure every record fits in the data and that the facets only
+index their own planes, the traces don't check either
+=================
+*/
+static qboolean CM_CheckPatchCache( const byte *data, int dataSize ) {
+	const patchCacheRecord_t	*record;
+	const facet_t				*facet;
+	int							offset, size;
+	int							i, j, k;
+
+	offset = 0;
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+
+		if ( dataSize - offset < (int)sizeof( *record ) ) {
+			return qfalse;
+		}
+		record = (const patchCacheRecord_t *)( data + offset );
+		if ( record->surfaceNum != i || record->numPlanes < 0 || record->numPlanes > MAX_PATCH_PLANES
+			|| record->numFacets < 0 || record->numFacets > MAX_PATCH_PLANES ) {
+			return qfalse;
+		}
+		size = sizeof( *record ) + record->numPlanes * sizeof( patchPlane_t ) + record->numFacets * sizeof( facet_t );
+		if ( dataSize - offset < size ) {
+			return qfalse;
+		}
+		offset += size;
+
+		facet = (const facet_t *)( (const patchPlane_t *)( record + 1 ) + record->numPlanes );
+		for ( j = 0 ; j < record->numFacets ; j++, facet++ ) {
+			if ( facet->surfacePlane < 0 || facet->surfacePlane >= record->numPlanes
+				|| facet->numBorders < 0 || facet->numBorders > 4+6+16 ) {
+				return qfalse;
+			}
+			for ( k = 0 ; k < facet->numBorders ; k++ ) {
+				if ( facet->borderPlanes[k] < 0 || facet->borderPlanes[k] >= record->numPlanes ) {
+					return qfalse;
+				}
+			}
+		}
+	}
+
+	return offset == dataSize;
+}
+
+/*
+=================
+CM_LoadPatchCache
+
+Returns qfalse if the cache can't be used, nothing is left on the
+hunk in that case.  The file is read and checked in temp memory first
+=================
+*/
+static qboolean CM_LoadPatchCache( const char *name, unsigned checksum, int numPatches ) {
+	char				path[MAX_QPATH];
+	fileHandle_t		f;
+	int					length;
+	patchCacheHeader_t	header;
+	patchCacheRecord_t	*record;
+	patchCollide_t		*pc;
+	byte				*temp, *data;
+	int					offset;
+	int					i;
+
+	CM_PatchCacheName( name, path, sizeof( path ) );
+	length = FS_SV_FOpenFileRead( path, &f );
+	if ( !f ) {
+		return qfalse;
+	}
+
+	if ( length < (int)sizeof( header ) || FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| header.ident != PATCH_CACHE_IDENT || header.version != PATCH_CACHE_VERSION
+		|| header.checksum != checksum || header.numSurfaces != cm.numSurfaces
+		|| header.numPatches != numPatches || header.planeSize != sizeof( patchPlane_t )
+		|| header.facetSize != sizeof( facet_t ) || header.dataSize != length - (int)sizeof( header ) ) {
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+
+	temp = Hunk_AllocateTempMemory( header.dataSize );
+	if ( FS_Read( temp, header.dataSize, f ) != header.dataSize || !CM_CheckPatchCache( temp, header.dataSize ) ) {
+		Hunk_FreeTempMemory( temp );
+		FS_FCloseFile( f );
+		return qfalse;
+	}
+	FS_FCloseFile( f );
+
+	data = Hunk_Alloc( header.dataSize, h_high );
+	Com_Memcpy( data, temp, header.dataSize );
+	Hunk_FreeTempMemory( temp );
+
+	// hook each patch up to its planes and facets where they are
+	offset = 0;
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+
+		record = (patchCacheRecord_t *)( data + offset );
+		offset += sizeof( *record ) + record->numPlanes * sizeof( patchPlane_t ) + record->numFacets * sizeof( facet_t );
+
+		pc = Hunk_Alloc( sizeof( *pc ), h_high );
+		VectorCopy( record->bounds[0], pc->bounds[0] );
+		VectorCopy( record->bounds[1], pc->bounds[1] );
+		pc->numPlanes = record->numPlanes;
+		pc->planes = (patchPlane_t *)( record + 1 );
+		pc->numFacets = record->numFacets;
+		pc->facets = (facet_t *)( pc->planes + pc->numPlanes );
+
+		cm.surfaces[i]->pc = pc;
+	}
+
+	return qtrue;
+}
+
+/*
+=================
+CM_WritePatchCache
+=================
+*/
+static void CM_WritePatchCache( const char *name, unsigned checksum, int numPatches ) {
+	char				path[MAX_QPATH];
+	fileHandle_t		f;
+	patchCacheHeader_t	header;
+	patchCacheRecord_t	record;
+	patchCollide_t		*pc;
+	int					i;
+
+	header.ident = PATCH_CACHE_IDENT;
+	header.version = PATCH_CACHE_VERSION;
+	header.checksum = checksum;
+	header.numSurfaces = cm.numSurfaces;
+	header.numPatches = numPatches;
+	header.planeSize = sizeof( patchPlane_t );
+	header.facetSize = sizeof( facet_t );
+	header.dataSize = 0;
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( cm.surfaces[i] ) {
+			pc = cm.surfaces[i]->pc;
+			header.dataSize += sizeof( record ) + pc->numPlanes * sizeof( patchPlane_t ) + pc->numFacets * sizeof( facet_t );
+		}
+	}
+
+	CM_PatchCacheName( name, path, sizeof( path ) );
+	f = FS_SV_FOpenFileWrite( path );
+	if ( !f ) {
+		Com_DPrintf( "Couldn't write %s\n", path );
+		return;
+	}
+
+	FS_Write( &header, sizeof( header ), f );
+	for ( i = 0 ; i < cm.numSurfaces ; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+		Com_Memset( &record, 0, sizeof( record ) );
+		record.surfaceNum = i;
+		VectorCopy( pc->bounds[0], record.bounds[0] );
+		VectorCopy( pc->bounds[1], record.bounds[1] );
+		record.numPlanes = pc->numPlanes;
+		record.numFacets = pc->numFacets;
+		FS_Write( &record, sizeof( record ), f );
+		FS_Write( pc->planes, pc->numPlanes * sizeof( patchPlane_t ), f );
+		FS_Write( pc->facets, pc->numFacets * sizeof( facet_t ), f );
+	}
+
+	FS_FCloseFile( f );
+}
+#endif
+
 /*
 =================
 CMod_LoadPatches
 =================
 */
 #define	MAX_PATCH_VERTS		1024
-void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
+void CMod_LoadPatches( lump_t *surfs, lump_t *verts, const char *name, unsigned checksum ) {
 	drawVert_t	*dv, *dv_p;
 	dsurface_t	*in;
 	int			count;
@@ -491,6 +779,7 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 	vec3_t		points[MAX_PATCH_VERTS];
 	int			width, height;
 	int			shaderNum;
+	int			numPatches;
 
 	in = (void *)(cmod_base + surfs->fileofs);
 	if (surfs->filelen % sizeof(*in))
@@ -504,14 +793,34 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 
 	// scan through all the surfaces, but only load patches,
 	// not planar faces
-	for ( i = 0 ; i < count ; i++, in++ ) {
-		if ( LittleLong( in->surfaceType ) != MST_PATCH ) {
+	numPatches = 0;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( LittleLong( in[i].surfaceType ) != MST_PATCH ) {
 			continue;		// ignore other surfaces
 		}
 		// FIXME: check for non-colliding patches
 
 		cm.surfaces[ i ] = patch = Hunk_Alloc( sizeof( *patch ), h_high );
 
+		shaderNum = LittleLong( in[i].shaderNum );
+		patch->contents = cm.shaders[shaderNum].contentFlags;
+		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
+		numPatches++;
+	}
+
+#ifndef BSPC
+	if ( numPatches && cm_patchCache->integer && CM_LoadPatchCache( name, checksum, numPatches ) ) {
+		Com_DPrintf( "%i patches from the collision cache\n", numPatches );
+		return;
+	}
+#endif
+
+	for ( i = 0 ; i < count ; i++, in++ ) {
+		patch = cm.surfaces[ i ];
+		if ( !patch ) {
+			continue;
+		}
+
 		// load the full drawverts onto the stack
 		width = LittleLong( in->patchWidth );
 		height = LittleLong( in->patchHeight );
@@ -527,13 +836,15 @@ void CMod_LoadPatches( lump_t *surfs, lump_t *verts ) {
 			points[j][2] = LittleFloat( dv_p->xyz[2] );
 		}
 
-		shaderNum = LittleLong( in->shaderNum );
-		patch->contents = cm.shaders[shaderNum].contentFlags;
-		patch->surfaceFlags = cm.shaders[shaderNum].surfaceFlags;
-
 		// create the internal facet structure
 		patch->pc = CM_GeneratePatchCollide( width, height, points );
 	}
+
+#ifndef BSPC
+	if ( numPatches && cm_patchCache->integer ) {
+		CM_WritePatchCache( name, checksum, numPatches );
+	}
+#endif
 }
 
 //==================================================================
@@ -581,6 +892,7 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	cm_noAreas = Cvar_Get ("cm_noAreas", "0", CVAR_CHEAT);
 	cm_noCurves = Cvar_Get ("cm_noCurves", "0", CVAR_CHEAT);
 	cm_playerCurveClip = Cvar_Get ("cm_playerCurveClip", "1", CVAR_ARCHIVE|CVAR_CHEAT );
+	cm_patchCache = Cvar_Get ("cm_patchCache", "1", CVAR_ARCHIVE );
 #endif
 	Com_DPrintf( "CM_LoadMap( %s, %i )\n", name, clientload );
 
@@ -606,7 +918,8 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	// load the file
 	//
 #ifndef BSPC
-	length = FS_ReadFile( name, (void **)&buf );
+	// only read from, so a stored bsp can stay in the pk3
+	length = FS_ReadFileDirect( name, (void **)&buf );
 #else
 	length = LoadQuakeFile((quakefile_t *) name, (void **)&buf);
 #endif
@@ -642,7 +955,7 @@ void CM_LoadMap( const char *name, qboolean clientload, int *checksum ) {
 	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
 	CMod_LoadVisibility( &header.lumps[LUMP_VISIBILITY] );
-	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS] );
+	CMod_LoadPatches( &header.lumps[LUMP_SURFACES], &header.lumps[LUMP_DRAWVERTS], name, last_checksum );
 
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile (buf);
@@ -680,7 +993,7 @@ cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle ) {
 		return &cm.cmodels[handle];
 	}
 	if ( handle == BOX_MODEL_HANDLE ) {
-		return &box_model;
+		return &CM_BoxHull()->model;
 	}
 	if ( handle < MAX_SUBMODELS ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i < %i < %i", 
@@ -744,46 +1057,78 @@ can just be stored out and get a proper clipping hull structure.
 void CM_InitBoxHull (void)
 {
 	int			i;
+	int			h;
 	int			side;
 	cplane_t	*p;
 	cbrushside_t	*s;
+	boxHull_t	*hull;
 
-	box_planes = &cm.planes[cm.numPlanes];
+	for ( h = 0 ; h < MAX_BOX_HULLS ; h++ ) {
+		hull = &cm_boxHulls[h];
+		Com_Memset( &hull->model, 0, sizeof( hull->model ) );
 
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
+		hull->planes = &cm.planes[cm.numPlanes + h * 12];
 
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+		hull->brush = &cm.brushes[cm.numBrushes + h];
+		hull->brush->numsides = 6;
+		hull->brush->sides = cm.brushsides + cm.numBrushSides + h * 6;
+		hull->brush->contents = CONTENTS_BODY;
+		hull->brush->planeGroups = Hunk_Alloc( 2 * BRUSH_PLANE_GROUP * sizeof( float ), h_high );
 
-	for (i=0 ; i<6 ; i++)
-	{
-		side = i&1;
+		hull->model.leaf.numLeafBrushes = 1;
+		hull->model.leaf.firstLeafBrush = cm.numLeafBrushes + h;
+		cm.leafbrushes[cm.numLeafBrushes + h] = cm.numBrushes + h;
 
-		// brush sides
-		s = &cm.brushsides[cm.numBrushSides+i];
-		s->plane = 	cm.planes + (cm.numPlanes+i*2+side);
-		s->surfaceFlags = 0;
+		for (i=0 ; i<6 ; i++)
+		{
+			side = i&1;
+
+			// brush sides
+			s = &hull->brush->sides[i];
+			s->plane = 	hull->planes + (i*2+side);
+			s->surfaceFlags = 0;
+
+			// planes
+			p = &hull->planes[i*2];
+			p->type = i>>1;
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = 1;
+
+			p = &hull->planes[i*2+1];
+			p->type = 3 + (i>>1);
+			p->signbits = 0;
+			VectorClear (p->normal);
+			p->normal[i>>1] = -1;
+
+			SetPlaneSignbits( p );
+		}
+	}
+}
 
-		// planes
-		p = &box_planes[i*2];
-		p->type = i>>1;
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = 1;
+/*
+===================
+CM_BoxHull
 
-		p = &box_planes[i*2+1];
-		p->type = 3 + (i>>1);
-		p->signbits = 0;
-		VectorClear (p->normal);
-		p->normal[i>>1] = -1;
+Each thread gets a box of its own the first time it needs one, so
+temporary box models don't get overwritten by traces on other threads.
+===================
+*/
+static boxHull_t *CM_BoxHull( void ) {
+#ifdef BSPC
+	return &cm_boxHulls[0];
+#else
+	int		h;
 
-		SetPlaneSignbits( p );
-	}	
+	if ( !cm_boxHull ) {
+		h = Sys_AtomicAdd( &cm_numBoxHulls, 1 ) - 1;
+		if ( h >= MAX_BOX_HULLS ) {
+			Sys_Error( "CM_BoxHull: more than %i threads tracing", MAX_BOX_HULLS );
+		}
+		cm_boxHull = &cm_boxHulls[h];
+	}
+	return cm_boxHull;
+#endif
 }
 
 /*
@@ -796,9 +1141,14 @@ Capsules are handled differently though.
 ===================
 */
 clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	boxHull_t	*hull;
+	cplane_t	*box_planes;
+
+	hull = CM_BoxHull();
+	box_planes = hull->planes;
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, hull->model.mins );
+	VectorCopy( maxs, hull->model.maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
@@ -817,8 +1167,9 @@ clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule
 	box_planes[10].dist = mins[2];
 	box_planes[11].dist = -mins[2];
 
-	VectorCopy( mins, box_brush->bounds[0] );
-	VectorCopy( maxs, box_brush->bounds[1] );
+	VectorCopy( mins, hull->brush->bounds[0] );
+	VectorCopy( maxs, hull->brush->bounds[1] );
+	CM_SetBrushPlaneGroups( hull->brush );
 
 	return BOX_MODEL_HANDLE;
 }
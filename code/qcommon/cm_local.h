@@ -56,12 +56,18 @@ typedef struct {
 	int			shaderNum;
 } cbrushside_t;
 
+// the side planes of a brush are also kept four at a time as
+// normal[0][4], normal[1][4], normal[2][4], dist[4], padded out
+// with sides nothing can be in front of
+#define	BRUSH_PLANE_GROUP	16
+
 typedef struct {
 	int			shaderNum;		// the shader that determined the contents
 	int			contents;
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
+	float		*planeGroups;	// ( numsides + 3 ) / 4 groups of BRUSH_PLANE_GROUP
 	int			checkcount;		// to avoid repeated testings
 } cbrush_t;
 
@@ -125,7 +131,7 @@ typedef struct {
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
+	volatile int	checkcount;				// incremented on each trace
 } clipMap_t;
 
 
@@ -133,12 +139,27 @@ typedef struct {
 // and to avoid various numeric issues
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
+// brush sides are tested four at a time where the vector unit does the
+// same single precision math as the scalar code, so results don't change
+#if defined(__SSE_MATH__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 1 )
+#define	CM_SSE_TRACE	1
+#endif
+
 extern	clipMap_t	cm;
+
+// every trace and leaf gathering takes its own stamp, so traces running on
+// other threads can share the brushes, they only repeat a test at worst
+#ifdef BSPC
+#define	CM_CheckCount()		( ++cm.checkcount )
+#else
+#define	CM_CheckCount()		Sys_AtomicAdd( &cm.checkcount, 1 )
+#endif
 extern	int			c_pointcontents;
 extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
+extern	cvar_t		*cm_patchCache;
 
 // cm_test.c
 
@@ -164,6 +185,7 @@ typedef struct {
 	qboolean	isPoint;	// optimized case
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
+	int			checkcount;	// stamp of this trace on the brushes and patches
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -173,6 +195,7 @@ typedef struct leafList_s {
 	int		*list;
 	vec3_t	bounds[2];
 	int		lastLeaf;		// for overflows where each leaf can't be stored individually
+	int		checkcount;		// stamp of this gathering for CM_StoreBrushes
 	void	(*storeLeafs)( struct leafList_s *ll, int nodenum );
 } leafList_t;
 
@@ -184,6 +207,8 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum );
 
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum );
 
+void CM_SetBrushPlaneGroups( cbrush_t *brush );
+
 cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle );
 
 // cm_patch.c
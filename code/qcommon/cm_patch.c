@@ -423,6 +423,111 @@ static	facet_t			facets[MAX_PATCH_PLANES]; //maybe MAX_FACETS ??
 #define	NORMAL_EPSILON	0.0001
 #define	DIST_EPSILON	0.02
 
+// planes are also hashed by the cell of normal space their normal is in, so
+// a lookup only has to look at planes with a normal close enough to match
+#define	PLANE_HASH_SIZE		1024		// power of two
+#define	PLANE_HASH_SCALE	16			// cells per unit of each normal component
+#define	PLANE_HASH_RADIUS	0.125		// look through every plane past this
+
+static	int				planeHashHeads[PLANE_HASH_SIZE];
+static	int				planeHashNext[MAX_PATCH_PLANES];
+static	int				planeHashCells[MAX_PATCH_PLANES][3];
+static	int				planeHashMarks[MAX_PATCH_PLANES];
+static	int				planeHashMark;
+
+/*
+==================
+CM_PlaneHashForCell
+==================
+*/
+static int CM_PlaneHashForCell( int x, int y, int z ) {
+	return ( x * 73856093 ^ y * 19349663 ^ z * 83492791 ) & ( PLANE_HASH_SIZE - 1 );
+}
+
+/*
+==================
+CM_ClearPlaneHash
+==================
+*/
+static void CM_ClearPlaneHash( void ) {
+	int		i;
+
+	for ( i = 0 ; i < PLANE_HASH_SIZE ; i++ ) {
+		planeHashHeads[i] = -1;
+	}
+}
+
+/*
+==================
+CM_AddPlane
+
+Appends a plane and hashes it
+==================
+*/
+static int CM_AddPlane( float plane[4] ) {
+	int		*cell;
+	int		hash;
+
+	if ( numPlanes == MAX_PATCH_PLANES ) {
+		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
+	}
+
+	Vector4Copy( plane, planes[numPlanes].plane );
+	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
+
+	cell = planeHashCells[numPlanes];
+	cell[0] = (int)floor( plane[0] * PLANE_HASH_SCALE );
+	cell[1] = (int)floor( plane[1] * PLANE_HASH_SCALE );
+	cell[2] = (int)floor( plane[2] * PLANE_HASH_SCALE );
+	hash = CM_PlaneHashForCell( cell[0], cell[1], cell[2] );
+	planeHashNext[numPlanes] = planeHashHeads[hash];
+	planeHashHeads[hash] = numPlanes;
+	planeHashMarks[numPlanes] = 0;
+
+	numPlanes++;
+
+	return numPlanes-1;
+}
+
+/*
+==================
+CM_GatherPlanes
+
+Adds every plane with each normal component within radius of normal's
+to the list, skipping planes already marked with planeHashMark
+==================
+*/
+static int CM_GatherPlanes( const float *normal, float radius, int *list, int count ) {
+	int		mins[3], maxs[3];
+	int		x, y, z;
+	int		i, *cell;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		mins[i] = (int)floor( ( normal[i] - radius ) * PLANE_HASH_SCALE );
+		maxs[i] = (int)floor( ( normal[i] + radius ) * PLANE_HASH_SCALE );
+	}
+
+	for ( x = mins[0] ; x <= maxs[0] ; x++ ) {
+		for ( y = mins[1] ; y <= maxs[1] ; y++ ) {
+			for ( z = mins[2] ; z <= maxs[2] ; z++ ) {
+				for ( i = planeHashHeads[ CM_PlaneHashForCell( x, y, z ) ] ; i != -1 ; i = planeHashNext[i] ) {
+					cell = planeHashCells[i];
+					if ( cell[0] != x || cell[1] != y || cell[2] != z ) {
+						continue;	// another cell in the same bucket
+					}
+					if ( planeHashMarks[i] == planeHashMark ) {
+						continue;
+					}
+					planeHashMarks[i] = planeHashMark;
+					list[count++] = i;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
 /*
 ==================
 CM_PlaneEqual
@@ -488,26 +593,93 @@ CM_FindPlane2
 ==================
 */
 int CM_FindPlane2(float plane[4], int *flipped) {
-	int i;
-
-	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if (CM_PlaneEqual(&planes[i], plane, flipped)) return i;
+	int		i, count, best;
+	int		list[MAX_PATCH_PLANES];
+	vec3_t	invnormal;
+
+	// see if the points are close enough to an existing plane,
+	// the first one in the list wins just as if they were all checked
+	planeHashMark++;
+	VectorNegate( plane, invnormal );
+	count = CM_GatherPlanes( plane, NORMAL_EPSILON * 2, list, 0 );
+	count = CM_GatherPlanes( invnormal, NORMAL_EPSILON * 2, list, count );
+
+	best = -1;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( ( best == -1 || list[i] < best ) && CM_PlaneEqual( &planes[ list[i] ], plane, flipped ) ) {
+			best = list[i];
+		}
+	}
+	if ( best != -1 ) {
+		CM_PlaneEqual( &planes[best], plane, flipped );
+		return best;
 	}
 
 	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
-		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
+	*flipped = qfalse;
+
+	return CM_AddPlane( plane );
+}
+
+/*
+==================
+CM_PlaneFitsPoints
+==================
+*/
+static qboolean CM_PlaneFitsPoints( const patchPlane_t *p, float *plane, float *p1, float *p2, float *p3 ) {
+	float	d;
+
+	if ( DotProduct( plane, p->plane ) < 0 ) {
+		return qfalse;	// allow backwards planes?
 	}
 
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
+	d = DotProduct( p1, p->plane ) - p->plane[3];
+	if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
+		return qfalse;
+	}
 
-	numPlanes++;
+	d = DotProduct( p2, p->plane ) - p->plane[3];
+	if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
+		return qfalse;
+	}
 
-	*flipped = qfalse;
+	d = DotProduct( p3, p->plane ) - p->plane[3];
+	if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
+		return qfalse;
+	}
 
-	return numPlanes-1;
+	return qtrue;
+}
+
+/*
+==================
+CM_PlaneSearchRadius
+
+How far the normal of a plane that passes within PLANE_TRI_EPSILON of all
+three points can be from the triangle's own normal, per component.  A
+plane like that tilts by at most twice the epsilon over the triangle's
+narrowest extent, the smallest singular value of its two edges.
+==================
+*/
+static float CM_PlaneSearchRadius( float *p1, float *p2, float *p3 ) {
+	vec3_t	u, v;
+	float	uu, uv, vv, det, trace, smallest, tilt;
+
+	VectorSubtract( p2, p1, u );
+	VectorSubtract( p3, p1, v );
+	uu = DotProduct( u, u );
+	uv = DotProduct( u, v );
+	vv = DotProduct( v, v );
+	det = uu * vv - uv * uv;
+	trace = uu + vv;
+	if ( det <= 0 ) {
+		return -1;
+	}
+	smallest = 2 * det / ( trace + sqrt( trace * trace - 4 * det ) );
+
+	// a little extra for rounding
+	tilt = 2 * ( PLANE_TRI_EPSILON + 0.01f ) * 1.4142136f / sqrt( smallest );
+	return tilt * ( 1 + tilt ) + 0.001f;
 }
 
 /*
@@ -517,49 +689,41 @@ CM_FindPlane
 */
 static int CM_FindPlane( float *p1, float *p2, float *p3 ) {
 	float	plane[4];
-	int		i;
-	float	d;
+	int		i, count, best;
+	float	radius;
+	int		list[MAX_PATCH_PLANES];
 
 	if ( !CM_PlaneFromPoints( plane, p1, p2, p3 ) ) {
 		return -1;
 	}
 
-	// see if the points are close enough to an existing plane
-	for ( i = 0 ; i < numPlanes ; i++ ) {
-		if ( DotProduct( plane, planes[i].plane ) < 0 ) {
-			continue;	// allow backwards planes?
+	// see if the points are close enough to an existing plane,
+	// the first one in the list wins just as if they were all checked
+	radius = CM_PlaneSearchRadius( p1, p2, p3 );
+	if ( radius >= 0 && radius < PLANE_HASH_RADIUS ) {
+		planeHashMark++;
+		count = CM_GatherPlanes( plane, radius, list, 0 );
+
+		best = -1;
+		for ( i = 0 ; i < count ; i++ ) {
+			if ( ( best == -1 || list[i] < best ) && CM_PlaneFitsPoints( &planes[ list[i] ], plane, p1, p2, p3 ) ) {
+				best = list[i];
+			}
 		}
-
-		d = DotProduct( p1, planes[i].plane ) - planes[i].plane[3];
-		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
-			continue;
+		if ( best != -1 ) {
+			return best;
 		}
-
-		d = DotProduct( p2, planes[i].plane ) - planes[i].plane[3];
-		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
-			continue;
-		}
-
-		d = DotProduct( p3, planes[i].plane ) - planes[i].plane[3];
-		if ( d < -PLANE_TRI_EPSILON || d > PLANE_TRI_EPSILON ) {
-			continue;
+	} else {
+		// a sliver, all sorts of planes could pass close to it
+		for ( i = 0 ; i < numPlanes ; i++ ) {
+			if ( CM_PlaneFitsPoints( &planes[i], plane, p1, p2, p3 ) ) {
+				return i;
+			}
 		}
-
-		// found it
-		return i;
 	}
 
 	// add a new plane
-	if ( numPlanes == MAX_PATCH_PLANES ) {
-		Com_Error( ERR_DROP, "MAX_PATCH_PLANES" );
-	}
-
-	Vector4Copy( plane, planes[numPlanes].plane );
-	planes[numPlanes].signbits = CM_SignbitsForNormal( plane );
-
-	numPlanes++;
-
-	return numPlanes-1;
+	return CM_AddPlane( plane );
 }
 
 /*
@@ -987,6 +1151,7 @@ static void CM_PatchCollideFromGrid( cGrid_t *grid, patchCollide_t *pf ) {
 
 	numPlanes = 0;
 	numFacets = 0;
+	CM_ClearPlaneHash();
 
 	// find the planes for each triangle of the grid
 	for ( i = 0 ; i < grid->width - 1 ; i++ ) {
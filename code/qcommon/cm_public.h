@@ -45,6 +45,10 @@ void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 						  vec3_t mins, vec3_t maxs,
 						  clipHandle_t model, int brushmask,
 						  const vec3_t origin, const vec3_t angles, int capsule );
+// same results as a CM_BoxTrace per ray
+void		CM_BoxTraceBatch( trace_t *results, const traceRay_t *rays, int numRays,
+						  vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, int brushmask, int capsule );
 
 byte		*CM_ClusterPVS (int cluster);
 
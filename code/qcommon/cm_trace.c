@@ -20,6 +20,11 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 #include "cm_local.h"
+#include "cm_patch.h"
+
+#if CM_SSE_TRACE
+#include <xmmintrin.h>
+#endif
 
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
@@ -250,10 +255,10 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if (b->checkcount == tw->checkcount) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		b->checkcount = tw->checkcount;
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
@@ -276,10 +281,10 @@ void CM_TestInLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( patch->checkcount == tw->checkcount ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			patch->checkcount = tw->checkcount;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -428,13 +433,12 @@ void CM_PositionTest( traceWork_t *tw ) {
 	ll.storeLeafs = CM_StoreLeafs;
 	ll.lastLeaf = 0;
 	ll.overflowed = qfalse;
-
-	cm.checkcount++;
+	ll.checkcount = CM_CheckCount();
 
 	CM_BoxLeafnums_r( &ll, 0 );
 
 
-	cm.checkcount++;
+	tw->checkcount = CM_CheckCount();
 
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
@@ -475,6 +479,79 @@ void CM_TraceThroughPatch( traceWork_t *tw, cPatch_t *patch ) {
 	}
 }
 
+#if CM_SSE_TRACE
+
+#define	MAX_SSE_BRUSH_SIDES		128
+
+/*
+================
+CM_BrushSideDistances
+
+The box sweep's start and end distances to every side of the brush, four
+sides at a time.  Every lane does the same operations in the same order
+as the scalar code, so the distances are bit identical.  Returns qtrue if
+the sweep is completely in front of some side, which means it can't touch
+the brush no matter what the other sides say.
+================
+*/
+static qboolean CM_BrushSideDistances( traceWork_t *tw, cbrush_t *brush, float *d1s, float *d2s ) {
+	__m128		sx, sy, sz, ex, ey, ez;
+	__m128		lox, loy, loz, hix, hiy, hiz;
+	__m128		nx, ny, nz, dist, ox, oy, oz, d1, d2;
+	__m128		zero, eps, reject;
+	const float	*group;
+	int			i;
+
+	sx = _mm_set1_ps( tw->start[0] );
+	sy = _mm_set1_ps( tw->start[1] );
+	sz = _mm_set1_ps( tw->start[2] );
+	ex = _mm_set1_ps( tw->end[0] );
+	ey = _mm_set1_ps( tw->end[1] );
+	ez = _mm_set1_ps( tw->end[2] );
+	lox = _mm_set1_ps( tw->size[0][0] );
+	loy = _mm_set1_ps( tw->size[0][1] );
+	loz = _mm_set1_ps( tw->size[0][2] );
+	hix = _mm_set1_ps( tw->size[1][0] );
+	hiy = _mm_set1_ps( tw->size[1][1] );
+	hiz = _mm_set1_ps( tw->size[1][2] );
+	zero = _mm_setzero_ps();
+	eps = _mm_set1_ps( SURFACE_CLIP_EPSILON );
+	reject = zero;
+
+	for ( i = 0, group = brush->planeGroups ; i < brush->numsides ; i += 4, group += BRUSH_PLANE_GROUP ) {
+		nx = _mm_loadu_ps( group );
+		ny = _mm_loadu_ps( group + 4 );
+		nz = _mm_loadu_ps( group + 8 );
+		dist = _mm_loadu_ps( group + 12 );
+
+		// tw->offsets[ plane->signbits ], the maxs where the normal is negative
+		ox = _mm_cmplt_ps( nx, zero );
+		ox = _mm_or_ps( _mm_and_ps( ox, hix ), _mm_andnot_ps( ox, lox ) );
+		oy = _mm_cmplt_ps( ny, zero );
+		oy = _mm_or_ps( _mm_and_ps( oy, hiy ), _mm_andnot_ps( oy, loy ) );
+		oz = _mm_cmplt_ps( nz, zero );
+		oz = _mm_or_ps( _mm_and_ps( oz, hiz ), _mm_andnot_ps( oz, loz ) );
+
+		dist = _mm_sub_ps( dist, _mm_add_ps( _mm_add_ps( _mm_mul_ps( ox, nx ),
+			_mm_mul_ps( oy, ny ) ), _mm_mul_ps( oz, nz ) ) );
+		d1 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( sx, nx ),
+			_mm_mul_ps( sy, ny ) ), _mm_mul_ps( sz, nz ) ), dist );
+		d2 = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( ex, nx ),
+			_mm_mul_ps( ey, ny ) ), _mm_mul_ps( ez, nz ) ), dist );
+
+		// d1 > 0 && ( d2 >= SURFACE_CLIP_EPSILON || d2 >= d1 )
+		reject = _mm_or_ps( reject, _mm_and_ps( _mm_cmpgt_ps( d1, zero ),
+			_mm_or_ps( _mm_cmpge_ps( d2, eps ), _mm_cmpge_ps( d2, d1 ) ) ) );
+
+		_mm_storeu_ps( d1s + i, d1 );
+		_mm_storeu_ps( d2s + i, d2 );
+	}
+
+	return _mm_movemask_ps( reject ) != 0;
+}
+
+#endif
+
 /*
 ================
 CM_TraceThroughBrush
@@ -492,6 +569,10 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 	float		t;
 	vec3_t		startp;
 	vec3_t		endp;
+	qboolean	haveDistances;
+#if CM_SSE_TRACE
+	float		d1s[MAX_SSE_BRUSH_SIDES + 3], d2s[MAX_SSE_BRUSH_SIDES + 3];
+#endif
 
 	enterFrac = -1.0;
 	leaveFrac = 1.0;
@@ -576,6 +657,16 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			}
 		}
 	} else {
+		haveDistances = qfalse;
+#if CM_SSE_TRACE
+		if ( brush->numsides <= MAX_SSE_BRUSH_SIDES ) {
+			if ( CM_BrushSideDistances( tw, brush, d1s, d2s ) ) {
+				return;		// completely in front of some face
+			}
+			haveDistances = qtrue;
+		}
+#endif
+
 		//
 		// compare the trace against all planes of the brush
 		// find the latest time the trace crosses a plane towards the interior
@@ -585,11 +676,19 @@ void CM_TraceThroughBrush( traceWork_t *tw, cbrush_t *brush ) {
 			side = brush->sides + i;
 			plane = side->plane;
 
-			// adjust the plane distance apropriately for mins/maxs
-			dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
+#if CM_SSE_TRACE
+			if ( haveDistances ) {
+				d1 = d1s[i];
+				d2 = d2s[i];
+			} else
+#endif
+			{
+				// adjust the plane distance apropriately for mins/maxs
+				dist = plane->dist - DotProduct( tw->offsets[ plane->signbits ], plane->normal );
 
-			d1 = DotProduct( tw->start, plane->normal ) - dist;
-			d2 = DotProduct( tw->end, plane->normal ) - dist;
+				d1 = DotProduct( tw->start, plane->normal ) - dist;
+				d2 = DotProduct( tw->end, plane->normal ) - dist;
+			}
 
 			if (d2 > 0) {
 				getout = qtrue;	// endpoint is not in solid
@@ -674,10 +773,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
 		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( b->checkcount == tw->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		b->checkcount = tw->checkcount;
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -700,10 +799,10 @@ void CM_TraceThroughLeaf( traceWork_t *tw, cLeaf_t *leaf ) {
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( patch->checkcount == tw->checkcount ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			patch->checkcount = tw->checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -1155,12 +1254,11 @@ void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, vec3_t mi
 
 	cmod = CM_ClipHandleToModel( model );
 
-	cm.checkcount++;		// for multi-check avoidance
-
 	c_traces++;				// for statistics, may be zeroed
 
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof(tw) );
+	tw.checkcount = CM_CheckCount();	// for multi-check avoidance
 	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
 
@@ -1469,3 +1567,189 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 
 	*results = trace;
 }
+
+/*
+==================
+CM_BoxTraceBatch
+
+Traces a group of rays that share a box size, content mask and model.
+
+The brushes and patches near the whole group are gathered with a single
+BSP walk, and any ray whose swept box doesn't come near one of them gets
+the untouched result directly.  The rest go through CM_Trace one at a
+time, so every result is the same as a CM_BoxTrace of that ray.
+==================
+*/
+#define	MAX_BATCH_LEAFS			1024
+#define	MAX_BATCH_CANDIDATES	1024
+#define	BATCH_BOUNDS_EPSILON	1.0f
+
+void CM_BoxTraceBatch( trace_t *results, const traceRay_t *rays, int numRays, vec3_t mins, vec3_t maxs,
+						  clipHandle_t model, int brushmask, int capsule ) {
+	int			leafs[MAX_BATCH_LEAFS];
+	float		candMins[3][MAX_BATCH_CANDIDATES + 3];
+	float		candMaxs[3][MAX_BATCH_CANDIDATES + 3];
+	int			numLeafs, numCandidates;
+	int			lastLeaf;
+	vec3_t		rayMins, rayMaxs;
+	vec3_t		groupMins, groupMaxs;
+	cLeaf_t		*leaf;
+	cbrush_t	*b;
+	cPatch_t	*patch;
+	float		*bounds[2];
+	int			i, j, k;
+	int			checkcount;
+	qboolean	touch;
+#if CM_SSE_TRACE
+	__m128		rx0, ry0, rz0, rx1, ry1, rz1, hit;
+#endif
+
+	if ( numRays <= 0 ) {
+		return;
+	}
+
+	if ( model || numRays == 1 || !cm.numNodes ) {
+		for ( i = 0 ; i < numRays ; i++ ) {
+			CM_BoxTrace( &results[i], rays[i].start, rays[i].end, mins, maxs, model, brushmask, capsule );
+		}
+		return;
+	}
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	// bounds of the whole group
+	ClearBounds( groupMins, groupMaxs );
+	for ( i = 0 ; i < numRays ; i++ ) {
+		AddPointToBounds( rays[i].start, groupMins, groupMaxs );
+		AddPointToBounds( rays[i].end, groupMins, groupMaxs );
+	}
+	for ( i = 0 ; i < 3 ; i++ ) {
+		groupMins[i] += mins[i] - BATCH_BOUNDS_EPSILON;
+		groupMaxs[i] += maxs[i] + BATCH_BOUNDS_EPSILON;
+	}
+
+	numLeafs = CM_BoxLeafnums( groupMins, groupMaxs, leafs, MAX_BATCH_LEAFS, &lastLeaf );
+	if ( numLeafs >= MAX_BATCH_LEAFS ) {
+		numCandidates = -1;
+	} else {
+		numCandidates = 0;
+	}
+
+	// gather everything in those leafs that a trace could stop on
+	checkcount = CM_CheckCount();
+	for ( i = 0 ; i < numLeafs && numCandidates >= 0 ; i++ ) {
+		leaf = &cm.leafs[ leafs[i] ];
+
+		for ( k = 0 ; k < leaf->numLeafBrushes + leaf->numLeafSurfaces ; k++ ) {
+			if ( k < leaf->numLeafBrushes ) {
+				b = &cm.brushes[ cm.leafbrushes[ leaf->firstLeafBrush + k ] ];
+				if ( b->checkcount == checkcount || !( b->contents & brushmask ) ) {
+					continue;
+				}
+				b->checkcount = checkcount;
+				bounds[0] = b->bounds[0];
+				bounds[1] = b->bounds[1];
+			} else {
+				patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k - leaf->numLeafBrushes ] ];
+				if ( !patch || patch->checkcount == checkcount || !( patch->contents & brushmask ) ) {
+					continue;
+				}
+				patch->checkcount = checkcount;
+				bounds[0] = patch->pc->bounds[0];
+				bounds[1] = patch->pc->bounds[1];
+			}
+
+			if ( bounds[0][0] > groupMaxs[0] || bounds[0][1] > groupMaxs[1] || bounds[0][2] > groupMaxs[2]
+				|| bounds[1][0] < groupMins[0] || bounds[1][1] < groupMins[1] || bounds[1][2] < groupMins[2] ) {
+				continue;
+			}
+
+			if ( numCandidates == MAX_BATCH_CANDIDATES ) {
+				numCandidates = -1;
+				break;
+			}
+			for ( j = 0 ; j < 3 ; j++ ) {
+				candMins[j][numCandidates] = bounds[0][j];
+				candMaxs[j][numCandidates] = bounds[1][j];
+			}
+			numCandidates++;
+		}
+	}
+
+	if ( numCandidates < 0 ) {
+		// too much around to be worth sorting out
+		for ( i = 0 ; i < numRays ; i++ ) {
+			CM_BoxTrace( &results[i], rays[i].start, rays[i].end, mins, maxs, model, brushmask, capsule );
+		}
+		return;
+	}
+
+	// pad out to a multiple of four with boxes that touch nothing
+	for ( k = numCandidates ; k & 3 ; k++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			candMins[j][k] = 1e30f;
+			candMaxs[j][k] = -1e30f;
+		}
+	}
+
+	for ( i = 0 ; i < numRays ; i++ ) {
+		for ( j = 0 ; j < 3 ; j++ ) {
+			if ( rays[i].start[j] < rays[i].end[j] ) {
+				rayMins[j] = rays[i].start[j];
+				rayMaxs[j] = rays[i].end[j];
+			} else {
+				rayMins[j] = rays[i].end[j];
+				rayMaxs[j] = rays[i].start[j];
+			}
+			rayMins[j] += mins[j] - BATCH_BOUNDS_EPSILON;
+			rayMaxs[j] += maxs[j] + BATCH_BOUNDS_EPSILON;
+		}
+
+		touch = qfalse;
+#if CM_SSE_TRACE
+		rx0 = _mm_set1_ps( rayMins[0] );
+		ry0 = _mm_set1_ps( rayMins[1] );
+		rz0 = _mm_set1_ps( rayMins[2] );
+		rx1 = _mm_set1_ps( rayMaxs[0] );
+		ry1 = _mm_set1_ps( rayMaxs[1] );
+		rz1 = _mm_set1_ps( rayMaxs[2] );
+		for ( k = 0 ; k < numCandidates ; k += 4 ) {
+			hit = _mm_and_ps( _mm_cmple_ps( _mm_loadu_ps( &candMins[0][k] ), rx1 ),
+				_mm_cmpge_ps( _mm_loadu_ps( &candMaxs[0][k] ), rx0 ) );
+			hit = _mm_and_ps( hit, _mm_and_ps( _mm_cmple_ps( _mm_loadu_ps( &candMins[1][k] ), ry1 ),
+				_mm_cmpge_ps( _mm_loadu_ps( &candMaxs[1][k] ), ry0 ) ) );
+			hit = _mm_and_ps( hit, _mm_and_ps( _mm_cmple_ps( _mm_loadu_ps( &candMins[2][k] ), rz1 ),
+				_mm_cmpge_ps( _mm_loadu_ps( &candMaxs[2][k] ), rz0 ) ) );
+			if ( _mm_movemask_ps( hit ) ) {
+				touch = qtrue;
+				break;
+			}
+		}
+#else
+		for ( k = 0 ; k < numCandidates ; k++ ) {
+			if ( candMins[0][k] <= rayMaxs[0] && candMaxs[0][k] >= rayMins[0]
+				&& candMins[1][k] <= rayMaxs[1] && candMaxs[1][k] >= rayMins[1]
+				&& candMins[2][k] <= rayMaxs[2] && candMaxs[2][k] >= rayMins[2] ) {
+				touch = qtrue;
+				break;
+			}
+		}
+#endif
+
+		if ( touch ) {
+			CM_BoxTrace( &results[i], rays[i].start, rays[i].end, mins, maxs, model, brushmask, capsule );
+			continue;
+		}
+
+		// nothing near it, so it goes the entire distance
+		c_traces++;
+		Com_Memset( &results[i], 0, sizeof( results[i] ) );
+		results[i].fraction = 1;
+		VectorCopy( rays[i].end, results[i].endpos );
+	}
+}
@@ -248,6 +248,7 @@ void Cmd_Exec_f( void ) {
 
 	Q_strncpyz( filename, Cmd_Argv(1), sizeof( filename ) );
 	COM_DefaultExtension( filename, sizeof( filename ), ".cfg" ); 
+	FS_ClearDirMisses();
 	len = FS_ReadFile( filename, (void **)&f);
 	if (!f) {
 		Com_Printf ("couldn't exec %s\n",Cmd_Argv(1));
@@ -121,6 +121,25 @@ void Com_EndRedirect (void)
 	rd_flush = NULL;
 }
 
+/*
+=============
+Com_HoldPrints
+
+While held, the prints of the calling thread are kept back and only
+printed when it stops holding them
+=============
+*/
+static THREAD_LOCAL qboolean	com_holdPrints;
+static THREAD_LOCAL char		com_heldPrints[MAXPRINTMSG];
+
+void Com_HoldPrints( qboolean hold ) {
+	com_holdPrints = hold;
+	if ( !hold && com_heldPrints[0] ) {
+		Com_Printf( "%s", com_heldPrints );
+		com_heldPrints[0] = 0;
+	}
+}
+
 /*
 =============
 Com_Printf
@@ -140,6 +159,11 @@ void QDECL Com_Printf( const char *fmt, ... ) {
 	Q_vsnprintf (msg, sizeof(msg), fmt, argptr);
 	va_end (argptr);
 
+	if ( com_holdPrints ) {
+		Q_strcat( com_heldPrints, sizeof( com_heldPrints ), msg );
+		return;
+	}
+
 	if ( rd_buffer ) {
 		if ((strlen (msg) + strlen(rd_buffer)) > (rd_buffersize - 1)) {
 			rd_flush(rd_buffer);
@@ -212,6 +236,32 @@ void QDECL Com_DPrintf( const char *fmt, ...) {
 	Com_Printf ("%s", msg);
 }
 
+/*
+=============
+Com_CatchErrors
+
+frame is a jmp_buf to longjmp to on the next Com_Error from the calling
+thread, or NULL to go back to aborting the frame
+=============
+*/
+static THREAD_LOCAL jmp_buf	*com_catchFrame;
+static THREAD_LOCAL int		com_caughtCode;
+static THREAD_LOCAL char	com_caughtMessage[MAXPRINTMSG];
+
+void Com_CatchErrors( void *frame ) {
+	com_catchFrame = (jmp_buf *)frame;
+}
+
+/*
+=============
+Com_CaughtError
+=============
+*/
+const char *Com_CaughtError( int *code ) {
+	*code = com_caughtCode;
+	return com_caughtMessage;
+}
+
 /*
 =============
 Com_Error
@@ -241,6 +291,16 @@ void QDECL Com_Error( int code, const char *fmt, ... ) {
 	}
 #endif
 
+	// a job that catches its own errors is handed the error to raise
+	// again on the main thread
+	if ( com_catchFrame ) {
+		com_caughtCode = code;
+		va_start (argptr,fmt);
+		Q_vsnprintf (com_caughtMessage, sizeof(com_caughtMessage), fmt, argptr);
+		va_end (argptr);
+		longjmp (*com_catchFrame, -1);
+	}
+
 	// when we are running automated scripts, make sure we
 	// know if anything failed
 	if ( com_buildScript && com_buildScript->integer ) {
@@ -795,6 +855,180 @@ size_t Z_AvailableMemory( void ) {
 	return Z_AvailableZoneMemory( mainzone );
 }
 
+/*
+==============================================================================
+
+						ZONE SLABS
+
+Allocations of up to SLAB_MAX_SIZE bytes come out of fixed size chunks
+carved from SLAB_PAGE_SIZE pages.  A page is an ordinary zone block of the
+tag its chunks were asked for, so Z_FreeTags and the per tag counts in
+Com_Meminfo_f keep working on whole pages, and the endless small strings
+and structs no longer fragment the zone or lengthen the rover's walk.
+
+A chunk header ends with its id just where a memblock_t ends with its id,
+which is how Z_Free tells the two apart.  ZONE_DEBUG builds label every
+allocation, so they go straight to the zone.
+==============================================================================
+*/
+
+#ifndef ZONE_DEBUG
+#define	ZONE_SLABS
+#endif
+
+#ifdef ZONE_SLABS
+
+#define	SLABID			0x1d4a12
+#define	SLABFREEID		0x1d4a13
+#define	SLAB_PAGE_SIZE	4096
+#define	SLAB_MAX_SIZE	256
+#define	SLAB_GRANULARITY	16
+#define	SLAB_CLASSES	( SLAB_MAX_SIZE / SLAB_GRANULARITY )
+
+typedef struct {
+	int		pageOffset;		// back to the start of the slabpage_t
+	int		id;				// should be SLABID, or SLABFREEID
+} slabchunk_t;
+
+typedef struct slabpage_s {
+	struct slabpage_s	*prev, *next;	// pages of this tag and class with free chunks
+	slabchunk_t	*free;					// the link is kept in the chunk's data
+	int			numFree;
+	int			numChunks;
+	int			stride;
+	int			tag;
+	int			sizeClass;
+} slabpage_t;
+
+#define	SLAB_HEADER_SIZE	( ( sizeof( slabpage_t ) + 15 ) & ~15 )
+
+static	slabpage_t	*zone_slabs[TAG_STATIC][SLAB_CLASSES];
+static	size_t		zone_slabBytes[TAG_STATIC];		// chunk bytes handed out, for Com_Meminfo_f
+static	size_t		zone_slabChunks[TAG_STATIC];
+
+/*
+========================
+Z_NewSlabPage
+========================
+*/
+static slabpage_t *Z_NewSlabPage( int tag, int sizeClass ) {
+	slabpage_t	*page;
+	slabchunk_t	*chunk;
+	int			i;
+
+	page = Z_TagMalloc( SLAB_PAGE_SIZE, tag );
+	page->tag = tag;
+	page->sizeClass = sizeClass;
+	page->stride = sizeof( slabchunk_t ) + ( sizeClass + 1 ) * SLAB_GRANULARITY;
+	page->numChunks = ( SLAB_PAGE_SIZE - SLAB_HEADER_SIZE ) / page->stride;
+	page->numFree = page->numChunks;
+
+	page->free = NULL;
+	for ( i = page->numChunks - 1 ; i >= 0 ; i-- ) {
+		chunk = (slabchunk_t *)( (byte *)page + SLAB_HEADER_SIZE + i * page->stride );
+		chunk->pageOffset = (byte *)chunk - (byte *)page;
+		chunk->id = SLABFREEID;
+		*(slabchunk_t **)( chunk + 1 ) = page->free;
+		page->free = chunk;
+	}
+
+	page->prev = NULL;
+	page->next = zone_slabs[tag][sizeClass];
+	if ( page->next ) {
+		page->next->prev = page;
+	}
+	zone_slabs[tag][sizeClass] = page;
+
+	return page;
+}
+
+/*
+========================
+Z_SlabMalloc
+========================
+*/
+static void *Z_SlabMalloc( size_t size, int tag ) {
+	slabpage_t	*page;
+	slabchunk_t	*chunk;
+	int			sizeClass;
+
+	sizeClass = size ? (int)( ( size - 1 ) / SLAB_GRANULARITY ) : 0;
+
+	page = zone_slabs[tag][sizeClass];
+	if ( !page ) {
+		page = Z_NewSlabPage( tag, sizeClass );
+	}
+
+	chunk = page->free;
+	page->free = *(slabchunk_t **)( chunk + 1 );
+	page->numFree--;
+	if ( !page->numFree ) {
+		// full pages drop out of the list until a chunk comes back
+		zone_slabs[tag][sizeClass] = page->next;
+		if ( page->next ) {
+			page->next->prev = NULL;
+		}
+		page->next = NULL;
+	}
+
+	chunk->id = SLABID;
+	zone_slabBytes[tag] += page->stride;
+	zone_slabChunks[tag]++;
+
+	return (void *)( chunk + 1 );
+}
+
+/*
+========================
+Z_SlabFree
+========================
+*/
+static void Z_SlabFree( slabchunk_t *chunk ) {
+	slabpage_t	*page;
+	slabpage_t	**list;
+
+	page = (slabpage_t *)( (byte *)chunk - chunk->pageOffset );
+	list = &zone_slabs[page->tag][page->sizeClass];
+
+	zone_slabBytes[page->tag] -= page->stride;
+	zone_slabChunks[page->tag]--;
+
+	// set the chunk to something that should cause problems
+	// if it is referenced...
+	Com_Memset( chunk + 1, 0xaa, page->stride - sizeof( *chunk ) );
+
+	chunk->id = SLABFREEID;
+	*(slabchunk_t **)( chunk + 1 ) = page->free;
+	page->free = chunk;
+	page->numFree++;
+
+	if ( page->numFree == 1 ) {
+		// the page was full
+		page->prev = NULL;
+		page->next = *list;
+		if ( page->next ) {
+			page->next->prev = page;
+		}
+		*list = page;
+		return;
+	}
+
+	// empty pages go back to the zone, except the last one of a class
+	if ( page->numFree == page->numChunks && ( page->prev || page->next ) ) {
+		if ( page->prev ) {
+			page->prev->next = page->next;
+		} else {
+			*list = page->next;
+		}
+		if ( page->next ) {
+			page->next->prev = page->prev;
+		}
+		Z_Free( page );
+	}
+}
+
+#endif	// ZONE_SLABS
+
 /*
 ========================
 Z_Free
@@ -808,6 +1042,16 @@ void Z_Free( void *ptr ) {
 		Com_Error( ERR_DROP, "Z_Free: NULL pointer" );
 	}
 
+#ifdef ZONE_SLABS
+	if ( ((int *)ptr)[-1] == SLABID ) {
+		Z_SlabFree( (slabchunk_t *)ptr - 1 );
+		return;
+	}
+	if ( ((int *)ptr)[-1] == SLABFREEID ) {
+		Com_Error( ERR_FATAL, "Z_Free: freed a freed pointer" );
+	}
+#endif
+
 	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 	if (block->id != ZONEID) {
 		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
@@ -881,6 +1125,16 @@ void Z_FreeTags( int tag ) {
 	else {
 		zone = mainzone;
 	}
+
+#ifdef ZONE_SLABS
+	// the pages themselves are freed with the rest of the tag
+	if ( tag > TAG_FREE && tag < TAG_STATIC ) {
+		Com_Memset( zone_slabs[tag], 0, sizeof( zone_slabs[tag] ) );
+		zone_slabBytes[tag] = 0;
+		zone_slabChunks[tag] = 0;
+	}
+#endif
+
 	count = 0;
 	// use the rover as our pointer, because
 	// Z_Free automatically adjusts it
@@ -914,6 +1168,12 @@ void *Z_TagMalloc( size_t size, int tag ) {
 		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use a 0 tag" );
 	}
 
+#ifdef ZONE_SLABS
+	if ( size <= SLAB_MAX_SIZE && tag < TAG_STATIC ) {
+		return Z_SlabMalloc( size, tag );
+	}
+#endif
+
 	if ( tag == TAG_SMALL ) {
 		zone = smallzone;
 	}
@@ -1224,6 +1484,235 @@ static	size_t		s_zoneTotal;
 static	size_t		s_smallZoneTotal;
 
 
+/*
+==============================================================================
+
+						FRAME ARENAS
+
+Every thread that asks for frame memory gets an arena of its own, so
+Hunk_FrameAlloc never takes a lock and works on the job threads as well as
+the main thread.  Allocations are a bump of the arena's pointer, can be
+dropped back to a Hunk_FrameMark, and all go away when Com_Frame starts
+the next frame, so nothing is ever freed one by one.  Requests that don't
+fit the arena come from the C heap until the end of the frame, and the
+high water marks in Hunk_Log show when com_frameArenaKB needs raising.
+
+Arenas are only reset between frames, so the only threads that may use
+them are the main thread and the job threads, which are idle then.
+==============================================================================
+*/
+
+#define	MAX_FRAME_ARENAS	( 1 + MAX_JOB_THREADS + 4 )
+
+typedef struct frameOverflow_s {
+	struct frameOverflow_s	*next;
+	int						size;
+} frameOverflow_t;
+
+typedef struct {
+	byte			*base;			// NULL for threads that came after the arenas were handed out
+	int				size;
+	int				used;
+	frameOverflow_t	*overflow;		// newest first
+	int				overflowBytes;
+
+	int				highwater;		// most used in any one frame, overflow included
+	int				overflowFrames;	// frames that didn't fit
+	qboolean		overflowed;		// this frame
+} frameArena_t;
+
+static	frameArena_t	hunk_frameArenas[MAX_FRAME_ARENAS];
+static	volatile int	hunk_numFrameArenas;
+static	THREAD_LOCAL frameArena_t	*hunk_threadArena;
+
+static	cvar_t			*com_frameArenaKB;
+
+/*
+=================
+Hunk_InitFrameArenas
+
+Gives the main thread and each job thread an arena
+=================
+*/
+void Hunk_InitFrameArenas( void ) {
+	int		i, count, size;
+	byte	*base;
+
+	com_frameArenaKB = Cvar_Get( "com_frameArenaKB", "256", CVAR_LATCH | CVAR_ARCHIVE );
+
+	size = com_frameArenaKB->integer;
+	if ( size < 16 ) {
+		size = 16;
+	}
+	size = size * 1024;
+
+	count = 1 + Com_JobThreads();
+	base = calloc( count, size );
+	if ( !base ) {
+		Com_Error( ERR_FATAL, "Frame arenas failed to allocate %i kb", count * size / 1024 );
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		hunk_frameArenas[i].base = base + i * size;
+		hunk_frameArenas[i].size = size;
+	}
+
+	// the main thread always has the first one
+	hunk_threadArena = &hunk_frameArenas[0];
+	if ( !hunk_numFrameArenas ) {
+		hunk_numFrameArenas = 1;
+	}
+}
+
+/*
+=================
+Hunk_ThreadFrameArena
+=================
+*/
+static frameArena_t *Hunk_ThreadFrameArena( void ) {
+	int		index;
+
+	if ( !hunk_threadArena ) {
+		index = Sys_AtomicAdd( &hunk_numFrameArenas, 1 ) - 1;
+		if ( index >= MAX_FRAME_ARENAS ) {
+			Sys_Error( "Hunk_FrameAlloc: more than %i threads", MAX_FRAME_ARENAS );
+		}
+		hunk_threadArena = &hunk_frameArenas[index];
+	}
+	return hunk_threadArena;
+}
+
+/*
+=================
+Hunk_FrameAlloc
+
+Returns 16 byte aligned memory that is not cleared and
+is only valid until the next frame
+=================
+*/
+void *Hunk_FrameAlloc( int size ) {
+	frameArena_t	*arena;
+	frameOverflow_t	*overflow;
+	int				total;
+
+	arena = Hunk_ThreadFrameArena();
+
+	size = ( size + 15 ) & ~15;
+
+	if ( arena->used + size <= arena->size ) {
+		arena->used += size;
+		total = arena->used + arena->overflowBytes;
+		if ( total > arena->highwater ) {
+			arena->highwater = total;
+		}
+		return arena->base + arena->used - size;
+	}
+
+	// keep going from the heap until the next frame
+	overflow = malloc( 16 + size );
+	if ( !overflow ) {
+		Sys_Error( "Hunk_FrameAlloc: failed on %i bytes", size );
+	}
+	overflow->next = arena->overflow;
+	overflow->size = size;
+	arena->overflow = overflow;
+	arena->overflowBytes += size;
+	arena->overflowed = qtrue;
+
+	total = arena->used + arena->overflowBytes;
+	if ( total > arena->highwater ) {
+		arena->highwater = total;
+	}
+	return (byte *)overflow + 16;
+}
+
+/*
+=================
+Hunk_FrameMark
+=================
+*/
+frameMark_t Hunk_FrameMark( void ) {
+	frameArena_t	*arena;
+	frameMark_t		mark;
+
+	arena = Hunk_ThreadFrameArena();
+	mark.used = arena->used;
+	mark.overflow = arena->overflow;
+
+	return mark;
+}
+
+/*
+=================
+Hunk_FrameRelease
+
+Frees everything the calling thread took since the mark
+=================
+*/
+void Hunk_FrameRelease( frameMark_t mark ) {
+	frameArena_t	*arena;
+	frameOverflow_t	*overflow;
+
+	arena = Hunk_ThreadFrameArena();
+
+	while ( arena->overflow && arena->overflow != mark.overflow ) {
+		overflow = arena->overflow;
+		arena->overflow = overflow->next;
+		arena->overflowBytes -= overflow->size;
+		free( overflow );
+	}
+
+	if ( mark.used < arena->used ) {
+		arena->used = mark.used;
+	}
+}
+
+/*
+=================
+Hunk_ClearFrameArenas
+
+Called by Com_Frame before anything can use the new frame's memory
+=================
+*/
+void Hunk_ClearFrameArenas( void ) {
+	frameArena_t	*arena;
+	frameOverflow_t	*overflow;
+	int				i, count;
+
+	count = Sys_AtomicAdd( &hunk_numFrameArenas, 0 );
+	for ( i = 0, arena = hunk_frameArenas ; i < count && i < MAX_FRAME_ARENAS ; i++, arena++ ) {
+		while ( arena->overflow ) {
+			overflow = arena->overflow;
+			arena->overflow = overflow->next;
+			free( overflow );
+		}
+		if ( arena->overflowed ) {
+			arena->overflowFrames++;
+			arena->overflowed = qfalse;
+		}
+		arena->overflowBytes = 0;
+		arena->used = 0;
+	}
+}
+
+/*
+=================
+Hunk_LogFrameArenas
+=================
+*/
+static void Hunk_LogFrameArenas( void ) {
+	frameArena_t	*arena;
+	char			buf[4096];
+	int				i, count;
+
+	count = Sys_AtomicAdd( &hunk_numFrameArenas, 0 );
+	for ( i = 0, arena = hunk_frameArenas ; i < count && i < MAX_FRAME_ARENAS ; i++, arena++ ) {
+		Com_sprintf( buf, sizeof( buf ), "frame arena %2d: %8d highwater of %8d, %d frames overflowed\r\n",
+			i, arena->highwater, arena->size, arena->overflowFrames );
+		FS_Write( buf, (int) strlen( buf ), logfile );
+	}
+}
+
 /*
 =================
 Com_Meminfo_f
@@ -1234,7 +1723,10 @@ void Com_Meminfo_f( void ) {
 	size_t		zoneBytes, zoneBlocks;
 	size_t		smallZoneBytes, smallZoneBlocks;
 	size_t		botlibBytes, rendererBytes;
+	size_t		slabBytes, slabChunks;
 	size_t		unused;
+	int			i;
+	int			arenaHighwater, arenaCount;
 
 	zoneBytes = 0;
 	botlibBytes = 0;
@@ -1309,11 +1801,29 @@ void Com_Meminfo_f( void ) {
 	}
 	Com_Printf( "%8i unused highwater\n", unused );
 	Com_Printf( "\n" );
+	arenaHighwater = 0;
+	arenaCount = Sys_AtomicAdd( &hunk_numFrameArenas, 0 );
+	for ( i = 0 ; i < arenaCount && i < MAX_FRAME_ARENAS ; i++ ) {
+		if ( hunk_frameArenas[i].highwater > arenaHighwater ) {
+			arenaHighwater = hunk_frameArenas[i].highwater;
+		}
+	}
+	Com_Printf( "%8i frame arena highwater in %i threads\n", arenaHighwater, arenaCount );
+	Com_Printf( "\n" );
 	Com_Printf( "%8i bytes in %i zone blocks\n", zoneBytes, zoneBlocks	);
 	Com_Printf( "        %8i bytes in dynamic botlib\n", botlibBytes );
 	Com_Printf( "        %8i bytes in dynamic renderer\n", rendererBytes );
 	Com_Printf( "        %8i bytes in dynamic other\n", zoneBytes - ( botlibBytes + rendererBytes ) );
 	Com_Printf( "        %8i bytes in small Zone memory\n", smallZoneBytes );
+
+	slabBytes = slabChunks = 0;
+#ifdef ZONE_SLABS
+	for ( i = 0 ; i < TAG_STATIC ; i++ ) {
+		slabBytes += zone_slabBytes[i];
+		slabChunks += zone_slabChunks[i];
+	}
+#endif
+	Com_Printf( "        %8i bytes of both in %i slab chunks\n", slabBytes, slabChunks );
 }
 
 /*
@@ -1430,6 +1940,7 @@ void Hunk_Log( void) {
 	FS_Write(buf, (int) strlen(buf), logfile);
 	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
 	FS_Write(buf, (int) strlen(buf), logfile);
+	Hunk_LogFrameArenas();
 }
 
 /*
@@ -2471,6 +2982,8 @@ void Com_Init( char *commandLine ) {
 	com_version = Cvar_Get ("version", s, CVAR_ROM | CVAR_SERVERINFO );
 
 	Sys_Init();
+	Com_InitJobs();
+	Hunk_InitFrameArenas();
 	Netchan_Init( Com_Milliseconds() & 0xffff );	// pick a port value that should be nice and random
 	VM_Init();
 	SV_Init();
@@ -2673,6 +3186,9 @@ void Com_Frame( void ) {
 	// old net chan encryption key
 	key = 0x87243987;
 
+	// last frame's scratch memory is gone
+	Hunk_ClearFrameArenas();
+
 	// write config file if anything changed
 	Com_WriteConfiguration(); 
 
@@ -2703,9 +3219,17 @@ void Com_Frame( void ) {
 			lastTime = com_frameTime;		// possible on first frame
 		}
 		msec = com_frameTime - lastTime;
+		if ( msec < minMsec && com_dedicated->integer ) {
+			// block in the network layer until a packet shows up or
+			// the rest of the slice runs out instead of spinning
+			NET_Sleep( minMsec - msec );
+		}
 	} while ( msec < minMsec );
 	Cbuf_Execute ();
 
+	// call back file loads that finished since the last frame
+	FS_RunAsyncLoads();
+
 	lastTime = com_frameTime;
 
 	// mess with msec if needed
@@ -2721,6 +3245,9 @@ void Com_Frame( void ) {
 
 	SV_Frame( msec );
 
+	// replies to packets handled outside of a server frame
+	NET_FlushPackets();
+
 	// if "dedicated" has been modified, start up
 	// or shut down the client system.
 	// Do this after the server may have started,
@@ -2818,6 +3345,8 @@ Com_Shutdown
 =================
 */
 void Com_Shutdown (void) {
+	Com_ShutdownJobs();
+
 	if (logfile) {
 		FS_FCloseFile (logfile);
 		logfile = 0;
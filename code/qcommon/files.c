@@ -222,31 +222,42 @@ or configs will never get loaded from disk!
 
 #define MAX_ZPATH			256
 #define	MAX_SEARCH_PATHS	4096
-#define MAX_FILEHASH_SIZE	1024
+#define	ZIP_LOCAL_HEADER_SIZE	30
+#define	ZIP_METHOD_DEFLATED		8
+
+struct pack_s;
 
 typedef struct fileInPack_s {
 	char					*name;		// name of the file
+	struct pack_s			*pack;		// pak the file is in
 	unsigned long			pos;		// file info position in zip
-	struct	fileInPack_s*	next;		// next file in the hash
+	unsigned long			offset;		// local header position in zip
+	int						method;		// 0 = stored, else deflated
+	int						compressedSize;
+	int						size;
+	struct	fileInPack_s*	nextName;	// next name in the global index hash
+	struct	fileInPack_s*	nextCopy;	// same name in a pak later in the search path
 } fileInPack_t;
 
-typedef struct {
+typedef struct pack_s {
 	char			pakFilename[MAX_OSPATH];	// c:\quake3\baseq3\pak0.pk3
 	char			pakBasename[MAX_OSPATH];	// pak0
 	char			pakGamename[MAX_OSPATH];	// baseq3
 	unzFile			handle;						// handle to zip file
+	byte			*mapping;					// whole zip file mapped read-only, or NULL
+	int				mappingSize;
 	int				checksum;					// regular checksum
 	int				pure_checksum;				// checksum for pure
 	int				numfiles;					// number of files in pk3
 	int				referenced;					// referenced file flags
-	int				hashSize;					// hash table size (power of 2)
-	fileInPack_t*	*hashTable;					// hash table
 	fileInPack_t*	buildBuffer;				// buffer with the filenames etc.
+	int				searchOrder;				// position in fs_searchpaths
 } pack_t;
 
 typedef struct {
 	char		path[MAX_OSPATH];		// c:\quake3
 	char		gamedir[MAX_OSPATH];	// baseq3
+	int			searchOrder;			// position in fs_searchpaths
 } directory_t;
 
 typedef struct searchpath_s {
@@ -266,6 +277,7 @@ static	cvar_t		*fs_cdpath;
 static	cvar_t		*fs_copyfiles;
 static	cvar_t		*fs_gamedirvar;
 static	cvar_t		*fs_restrict;
+static	cvar_t		*fs_mapPaks;
 static	searchpath_t	*fs_searchpaths;
 static	int			fs_readCount;			// total bytes read
 static	int			fs_loadCount;			// total files read
@@ -293,6 +305,8 @@ typedef struct {
 	int			zipFilePos;
 	qboolean	zipFile;
 	qboolean	streamed;
+	fileInPack_t	*mappedFile;	// only ever set on handles opened by FS_ReadFile
+	const byte	*mappedData;
 	char		name[MAX_ZPATH];
 } fileHandleData_t;
 
@@ -564,6 +578,7 @@ static void FS_CopyFile( char *fromOSPath, char *toOSPath ) {
 	if ( !f ) {
 		return;
 	}
+	FS_ClearDirMisses();
 	if (fwrite( buf, 1, len, f ) != len)
 		Com_Error( ERR_FATAL, "Short write in FS_Copyfiles()\n" );
 	fclose( f );
@@ -662,6 +677,7 @@ fileHandle_t FS_SV_FOpenFileWrite( const char *filename ) {
 
 	Com_DPrintf( "writing to: %s\n", ospath );
 	fsh[f].handleFiles.file.o = fopen( ospath, "wb" );
+	FS_ClearDirMisses();
 
 	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
 
@@ -806,6 +822,7 @@ void FS_SV_Rename( const char *from, const char *to ) {
 		FS_CopyFile ( from_ospath, to_ospath );
 		FS_Remove ( from_ospath );
 	}
+	FS_ClearDirMisses();
 }
 
 
@@ -839,6 +856,7 @@ void FS_Rename( const char *from, const char *to ) {
 		FS_CopyFile ( from_ospath, to_ospath );
 		FS_Remove ( from_ospath );
 	}
+	FS_ClearDirMisses();
 }
 
 /*
@@ -859,6 +877,11 @@ void FS_FCloseFile( fileHandle_t f ) {
 	if (fsh[f].streamed) {
 		Sys_EndStreamedFile(f);
 	}
+	if (fsh[f].mappedFile) {
+		// nothing was opened in the zip
+		Com_Memset( &fsh[f], 0, sizeof( fsh[f] ) );
+		return;
+	}
 	if (fsh[f].zipFile == qtrue) {
 		unzCloseCurrentFile( fsh[f].handleFiles.file.z );
 		if ( fsh[f].handleFiles.unique ) {
@@ -907,6 +930,7 @@ fileHandle_t FS_FOpenFileWrite( const char *filename ) {
 	// when running with +set logfile 1 +set developer 1
 	//Com_DPrintf( "writing to: %s\n", ospath );
 	fsh[f].handleFiles.file.o = fopen( ospath, "wb" );
+	FS_ClearDirMisses();
 
 	Q_strncpyz( fsh[f].name, filename, sizeof( fsh[f].name ) );
 
@@ -951,6 +975,7 @@ fileHandle_t FS_FOpenFileAppend( const char *filename ) {
 	}
 
 	fsh[f].handleFiles.file.o = fopen( ospath, "ab" );
+	FS_ClearDirMisses();
 	fsh[f].handleSync = qfalse;
 	if (!fsh[f].handleFiles.file.o) {
 		f = 0;
@@ -1010,6 +1035,424 @@ char *FS_ShiftedStrStr(const char *string, const char *substring, int shift) {
 	return strstr(string, buf);
 }
 
+/*
+=================================================================================
+
+FILE LOOKUP INDEX
+
+Every file of every pak in the search path is hashed once, by name, when
+the search path is built.  Copies of a name are chained in search order,
+so a lookup only has to weigh them against the directories that come
+before each copy.  Names a directory didn't have are remembered until
+the filesystem writes a file, a map is loaded or a script is exec'd.  A
+file copied into a directory by hand in between stays invisible to
+everything else until then, or until fs_restart.
+
+=================================================================================
+*/
+
+#define	MAX_INDEX_SIZE		0x100000
+#define	MAX_DIR_MISSES		4096
+#define	DIR_MISS_HASH_SIZE	1024
+
+typedef struct dirMiss_s {
+	directory_t			*dir;
+	char				*name;
+	struct dirMiss_s	*next;
+} dirMiss_t;
+
+static fileInPack_t	**fs_index;
+static int			fs_indexSize;			// power of 2
+static directory_t	**fs_indexDirs;			// all directories, in search order
+static int			fs_numIndexDirs;
+
+static dirMiss_t	*fs_dirMisses[DIR_MISS_HASH_SIZE];
+static int			fs_numDirMisses;
+
+/*
+=================
+FS_ClearDirMisses
+
+Called whenever the filesystem may have created a file, and before the
+lookups that an admin may have just put a file in place for
+=================
+*/
+void FS_ClearDirMisses( void ) {
+	dirMiss_t	*miss, *next;
+	int			i;
+
+	if ( !fs_numDirMisses ) {
+		return;
+	}
+
+	for ( i = 0 ; i < DIR_MISS_HASH_SIZE ; i++ ) {
+		for ( miss = fs_dirMisses[i] ; miss ; miss = next ) {
+			next = miss->next;
+			Z_Free( miss );
+		}
+		fs_dirMisses[i] = NULL;
+	}
+	fs_numDirMisses = 0;
+}
+
+/*
+=================
+FS_OpenDirFile
+
+fopen of a file in a directory, unless it is already known not to be there
+=================
+*/
+static FILE *FS_OpenDirFile( directory_t *dir, const char *filename, char **netpath ) {
+	dirMiss_t	*miss;
+	FILE		*f;
+	long		hash;
+	int			len;
+
+	hash = FS_HashFileName( filename, DIR_MISS_HASH_SIZE );
+	for ( miss = fs_dirMisses[hash] ; miss ; miss = miss->next ) {
+		// exact compare, the directory may well be case sensitive
+		if ( miss->dir == dir && !strcmp( miss->name, filename ) ) {
+			return NULL;
+		}
+	}
+
+	*netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
+	f = fopen( *netpath, "rb" );
+	if ( f ) {
+		return f;
+	}
+
+	if ( fs_numDirMisses >= MAX_DIR_MISSES ) {
+		FS_ClearDirMisses();
+	}
+
+	len = (int) strlen( filename ) + 1;
+	miss = Z_Malloc( sizeof( *miss ) + len );
+	miss->dir = dir;
+	miss->name = (char *)( miss + 1 );
+	Com_Memcpy( miss->name, filename, len );
+	miss->next = fs_dirMisses[hash];
+	fs_dirMisses[hash] = miss;
+	fs_numDirMisses++;
+
+	return NULL;
+}
+
+/*
+=================
+FS_FreeFileIndex
+=================
+*/
+static void FS_FreeFileIndex( void ) {
+	if ( fs_index ) {
+		Z_Free( fs_index );
+		fs_index = NULL;
+	}
+	if ( fs_indexDirs ) {
+		Z_Free( fs_indexDirs );
+		fs_indexDirs = NULL;
+	}
+	fs_indexSize = 0;
+	fs_numIndexDirs = 0;
+
+	FS_ClearDirMisses();
+}
+
+/*
+=================
+FS_BuildFileIndex
+
+Has to run again whenever fs_searchpaths changes
+=================
+*/
+static void FS_BuildFileIndex( void ) {
+	searchpath_t	*search;
+	pack_t			*pak;
+	fileInPack_t	*pakFile, *name, *last;
+	int				numFiles, numDirs, order, i;
+	long			hash;
+
+	FS_FreeFileIndex();
+
+	numFiles = 0;
+	numDirs = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		if ( search->pack ) {
+			numFiles += search->pack->numfiles;
+		} else if ( search->dir ) {
+			numDirs++;
+		}
+	}
+
+	for ( fs_indexSize = 1 ; fs_indexSize < numFiles && fs_indexSize < MAX_INDEX_SIZE ; fs_indexSize <<= 1 ) {
+	}
+	fs_index = Z_Malloc( fs_indexSize * sizeof( *fs_index ) );
+	fs_indexDirs = Z_Malloc( ( numDirs + 1 ) * sizeof( *fs_indexDirs ) );
+
+	order = 0;
+	for ( search = fs_searchpaths ; search ; search = search->next, order++ ) {
+		if ( search->dir ) {
+			search->dir->searchOrder = order;
+			fs_indexDirs[fs_numIndexDirs++] = search->dir;
+			continue;
+		}
+
+		pak = search->pack;
+		if ( !pak ) {
+			continue;
+		}
+		pak->searchOrder = order;
+
+		// backwards, so a name repeated within one zip resolves the way
+		// the pak's own hash chains did
+		for ( i = pak->numfiles - 1 ; i >= 0 ; i-- ) {
+			pakFile = &pak->buildBuffer[i];
+			pakFile->nextName = NULL;
+			pakFile->nextCopy = NULL;
+			if ( !pakFile->name ) {
+				continue;		// the central directory was cut short
+			}
+
+			hash = FS_HashFileName( pakFile->name, fs_indexSize );
+			for ( name = fs_index[hash] ; name ; name = name->nextName ) {
+				if ( !FS_FilenameCompare( name->name, pakFile->name ) ) {
+					break;
+				}
+			}
+
+			if ( !name ) {
+				pakFile->nextName = fs_index[hash];
+				fs_index[hash] = pakFile;
+				continue;
+			}
+
+			for ( last = name ; last->nextCopy ; last = last->nextCopy ) {
+			}
+			last->nextCopy = pakFile;
+		}
+	}
+}
+
+/*
+=================
+FS_IndexedFile
+
+The first copy of a file in any pak, or NULL
+=================
+*/
+static fileInPack_t *FS_IndexedFile( const char *filename ) {
+	fileInPack_t	*pakFile;
+
+	pakFile = fs_index[FS_HashFileName( filename, fs_indexSize )];
+	for ( ; pakFile ; pakFile = pakFile->nextName ) {
+		// case and separator insensitive comparisons
+		if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
+			return pakFile;
+		}
+	}
+	return NULL;
+}
+
+//============================================================================
+
+/*
+=================
+FS_MappedPakData
+
+Returns where the data of a file starts inside the mapped pak,
+or NULL if the local header doesn't check out.
+=================
+*/
+static const byte *FS_MappedPakData( pack_t *pak, fileInPack_t *pakFile ) {
+	const byte	*header;
+	int			start;
+
+	if ( pakFile->method && pakFile->method != ZIP_METHOD_DEFLATED ) {
+		return NULL;
+	}
+	if ( !pakFile->method && pakFile->compressedSize != pakFile->size ) {
+		return NULL;
+	}
+	if ( pakFile->offset + ZIP_LOCAL_HEADER_SIZE > (unsigned long)pak->mappingSize ) {
+		return NULL;
+	}
+	header = pak->mapping + pakFile->offset;
+	if ( header[0] != 'P' || header[1] != 'K' || header[2] != 3 || header[3] != 4 ) {
+		return NULL;
+	}
+
+	// the local name and extra field can differ from the central directory's
+	start = pakFile->offset + ZIP_LOCAL_HEADER_SIZE
+		+ ( header[26] | ( header[27] << 8 ) ) + ( header[28] | ( header[29] << 8 ) );
+	if ( pakFile->compressedSize < 0 || start > pak->mappingSize - pakFile->compressedSize ) {
+		return NULL;
+	}
+
+	return pak->mapping + start;
+}
+
+/*
+===========
+FS_FOpenPakFileRead
+===========
+*/
+static int FS_FOpenPakFileRead( fileInPack_t *pakFile, const char *filename, fileHandle_t file, qboolean uniqueFILE, qboolean allowMapped ) {
+	pack_t			*pak;
+	unz_s			*zfi;
+	FILE			*temp;
+	const byte		*data;
+	int				l;
+
+	pak = pakFile->pack;
+
+	// mark the pak as having been referenced and mark specifics on cgame and ui
+	// shaders, txt, arena files  by themselves do not count as a reference as 
+	// these are loaded from all pk3s 
+	// from every pk3 file.. 
+	l = (int) strlen( filename );
+	if ( !(pak->referenced & FS_GENERAL_REF)) {
+		if ( Q_stricmp(filename + l - 7, ".shader") != 0 &&
+			Q_stricmp(filename + l - 4, ".txt") != 0 &&
+			Q_stricmp(filename + l - 4, ".cfg") != 0 &&
+			Q_stricmp(filename + l - 7, ".config") != 0 &&
+			strstr(filename, "levelshots") == NULL &&
+			Q_stricmp(filename + l - 4, ".bot") != 0 &&
+			Q_stricmp(filename + l - 6, ".arena") != 0 &&
+			Q_stricmp(filename + l - 5, ".menu") != 0) {
+			pak->referenced |= FS_GENERAL_REF;
+		}
+	}
+
+	// qagame.qvm	- 13
+	// dTZT`X!di`
+	if (!(pak->referenced & FS_QAGAME_REF) && FS_ShiftedStrStr(filename, "dTZT`X!di`", 13)) {
+		pak->referenced |= FS_QAGAME_REF;
+	}
+	// cgame.qvm	- 7
+	// \`Zf^'jof
+	if (!(pak->referenced & FS_CGAME_REF) && FS_ShiftedStrStr(filename , "\\`Zf^'jof", 7)) {
+		pak->referenced |= FS_CGAME_REF;
+	}
+	// ui.qvm		- 5
+	// pd)lqh
+	if (!(pak->referenced & FS_UI_REF) && FS_ShiftedStrStr(filename , "pd)lqh", 5)) {
+		pak->referenced |= FS_UI_REF;
+	}
+
+	if ( allowMapped && !uniqueFILE && pak->mapping ) {
+		data = FS_MappedPakData( pak, pakFile );
+		if ( data ) {
+			// the zip handle only marks the slot as used
+			fsh[file].handleFiles.file.z = pak->handle;
+			fsh[file].mappedFile = pakFile;
+			fsh[file].mappedData = data;
+			Q_strncpyz( fsh[file].name, filename, sizeof( fsh[file].name ) );
+			fsh[file].zipFile = qtrue;
+
+			if ( fs_debug->integer ) {
+				Com_Printf( "FS_FOpenFileRead: %s (mapped from '%s')\n",
+					filename, pak->pakFilename );
+			}
+			return pakFile->size;
+		}
+	}
+
+	if ( uniqueFILE ) {
+		// open a new file on the pakfile
+		fsh[file].handleFiles.file.z = unzReOpen (pak->pakFilename, pak->handle);
+		if (fsh[file].handleFiles.file.z == NULL) {
+			Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->pakFilename);
+		}
+	} else {
+		fsh[file].handleFiles.file.z = pak->handle;
+	}
+	Q_strncpyz( fsh[file].name, filename, sizeof( fsh[file].name ) );
+	fsh[file].zipFile = qtrue;
+	zfi = (unz_s *)fsh[file].handleFiles.file.z;
+	// in case the file was new
+	temp = zfi->file;
+	// set the file position in the zip file (also sets the current file info)
+	unzSetCurrentFileInfoPosition(pak->handle, pakFile->pos);
+	// copy the file info into the unzip structure
+	Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
+	// we copy this back into the structure
+	zfi->file = temp;
+	// open the file in the zip
+	unzOpenCurrentFile( fsh[file].handleFiles.file.z );
+	fsh[file].zipFilePos = pakFile->pos;
+
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n", 
+			filename, pak->pakFilename );
+	}
+	return zfi->cur_file_info.uncompressed_size;
+}
+
+/*
+===========
+FS_FOpenDirFileRead
+
+Returns -1 if the directory doesn't have the file or isn't allowed to give it
+===========
+*/
+static int FS_FOpenDirFileRead( directory_t *dir, const char *filename, fileHandle_t file ) {
+	char			*netpath;
+	int				l;
+	char demoExt[16];
+
+	Com_sprintf (demoExt, sizeof(demoExt), ".dm_%d",PROTOCOL_VERSION );
+
+	// if we are running restricted, the only files we
+	// will allow to come from the directory are .cfg files
+	l = (int) strlen( filename );
+  // FIXME TTimo I'm not sure about the fs_numServerPaks test
+  // if you are using FS_ReadFile to find out if a file exists,
+  //   this test can make the search fail although the file is in the directory
+  // I had the problem on https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=8
+  // turned out I used FS_FileExists instead
+	if ( fs_restrict->integer || fs_numServerPaks ) {
+
+		if ( Q_stricmp( filename + l - 4, ".cfg" )		// for config files
+			&& Q_stricmp( filename + l - 5, ".menu" )	// menu files
+			&& Q_stricmp( filename + l - 5, ".game" )	// menu files
+			&& Q_stricmp( filename + l - strlen(demoExt), demoExt )	// menu files
+			&& Q_stricmp( filename + l - 4, ".dat" ) ) {	// for journal files
+			return -1;
+		}
+	}
+
+	fsh[file].handleFiles.file.o = FS_OpenDirFile( dir, filename, &netpath );
+	if ( !fsh[file].handleFiles.file.o ) {
+		return -1;
+	}
+
+	if ( Q_stricmp( filename + l - 4, ".cfg" )		// for config files
+		&& Q_stricmp( filename + l - 5, ".menu" )	// menu files
+		&& Q_stricmp( filename + l - 5, ".game" )	// menu files
+		&& Q_stricmp( filename + l - strlen(demoExt), demoExt )	// menu files
+		&& Q_stricmp( filename + l - 4, ".dat" ) ) {	// for journal files
+		fs_fakeChkSum = random();
+	}
+
+	Q_strncpyz( fsh[file].name, filename, sizeof( fsh[file].name ) );
+	fsh[file].zipFile = qfalse;
+	if ( fs_debug->integer ) {
+		Com_Printf( "FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
+			dir->path, dir->gamedir );
+	}
+
+	// if we are getting it from the cdpath, optionally copy it
+	//  to the basepath
+	if ( fs_copyfiles->integer && !Q_stricmp( dir->path, fs_cdpath->string ) ) {
+		char	*copypath;
+
+		copypath = FS_BuildOSPath( fs_basepath->string, dir->gamedir, filename );
+		FS_CopyFile( netpath, copypath );
+	}
+
+	return FS_filelength (file);
+}
+
 /*
 ===========
 FS_FOpenFileRead
@@ -1018,23 +1461,19 @@ Finds the file in the search path.
 Returns filesize and an open FILE pointer.
 Used for streaming data out of either a
 separate file or a ZIP file.
+
+With allowMapped, a file found in a mapped pak gets a handle that
+only FS_ReadMappedFile can read.
 ===========
 */
 extern qboolean		com_fullyInitialized;
 
-int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
-	searchpath_t	*search;
-	char			*netpath;
-	pack_t			*pak;
+static int FS_FOpenFileReadMapped( const char *filename, fileHandle_t *file, qboolean uniqueFILE, qboolean allowMapped ) {
 	fileInPack_t	*pakFile;
 	directory_t		*dir;
-	long			hash;
-	unz_s			*zfi;
+	char			*netpath;
 	FILE			*temp;
-	int				l;
-	char demoExt[16];
-
-	hash = 0;
+	int				i, len;
 
 	if ( !fs_searchpaths ) {
 		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
@@ -1042,32 +1481,12 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 
 	if ( file == NULL ) {
 		// just wants to see if file is there
-		for ( search = fs_searchpaths ; search ; search = search->next ) {
-			//
-			if ( search->pack ) {
-				hash = FS_HashFileName(filename, search->pack->hashSize);
-			}
-			// is the element a pak file?
-			if ( search->pack && search->pack->hashTable[hash] ) {
-				// look through all the pak file elements
-				pak = search->pack;
-				pakFile = pak->hashTable[hash];
-				do {
-					// case and separator insensitive comparisons
-					if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-						// found it!
-						return qtrue;
-					}
-					pakFile = pakFile->next;
-				} while(pakFile != NULL);
-			} else if ( search->dir ) {
-				dir = search->dir;
-			
-				netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
-				temp = fopen (netpath, "rb");
-				if ( !temp ) {
-					continue;
-				}
+		if ( FS_IndexedFile( filename ) ) {
+			return qtrue;
+		}
+		for ( i = 0 ; i < fs_numIndexDirs ; i++ ) {
+			temp = FS_OpenDirFile( fs_indexDirs[i], filename, &netpath );
+			if ( temp ) {
 				fclose(temp);
 				return qtrue;
 			}
@@ -1079,7 +1498,6 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
 	}
 
-	Com_sprintf (demoExt, sizeof(demoExt), ".dm_%d",PROTOCOL_VERSION );
 	// qpaths are not supposed to have a leading slash
 	if ( filename[0] == '/' || filename[0] == '\\' ) {
 		filename++;
@@ -1101,154 +1519,35 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 	}
 
 	//
-	// search through the path, one element at a time
+	// go through the copies in paks in search order, giving each
+	// directory that comes before a copy its chance first
 	//
 
 	*file = FS_HandleForFile();
 	fsh[*file].handleFiles.unique = uniqueFILE;
 
-	for ( search = fs_searchpaths ; search ; search = search->next ) {
-		//
-		if ( search->pack ) {
-			hash = FS_HashFileName(filename, search->pack->hashSize);
-		}
-		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
-			// disregard if it doesn't match one of the allowed pure pak files
-			if ( !FS_PakIsPure(search->pack) ) {
-				continue;
-			}
-
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					// found it!
-
-					// mark the pak as having been referenced and mark specifics on cgame and ui
-					// shaders, txt, arena files  by themselves do not count as a reference as 
-					// these are loaded from all pk3s 
-					// from every pk3 file.. 
-					l = (int) strlen( filename );
-					if ( !(pak->referenced & FS_GENERAL_REF)) {
-						if ( Q_stricmp(filename + l - 7, ".shader") != 0 &&
-							Q_stricmp(filename + l - 4, ".txt") != 0 &&
-							Q_stricmp(filename + l - 4, ".cfg") != 0 &&
-							Q_stricmp(filename + l - 7, ".config") != 0 &&
-							strstr(filename, "levelshots") == NULL &&
-							Q_stricmp(filename + l - 4, ".bot") != 0 &&
-							Q_stricmp(filename + l - 6, ".arena") != 0 &&
-							Q_stricmp(filename + l - 5, ".menu") != 0) {
-							pak->referenced |= FS_GENERAL_REF;
-						}
-					}
-
-					// qagame.qvm	- 13
-					// dTZT`X!di`
-					if (!(pak->referenced & FS_QAGAME_REF) && FS_ShiftedStrStr(filename, "dTZT`X!di`", 13)) {
-						pak->referenced |= FS_QAGAME_REF;
-					}
-					// cgame.qvm	- 7
-					// \`Zf^'jof
-					if (!(pak->referenced & FS_CGAME_REF) && FS_ShiftedStrStr(filename , "\\`Zf^'jof", 7)) {
-						pak->referenced |= FS_CGAME_REF;
-					}
-					// ui.qvm		- 5
-					// pd)lqh
-					if (!(pak->referenced & FS_UI_REF) && FS_ShiftedStrStr(filename , "pd)lqh", 5)) {
-						pak->referenced |= FS_UI_REF;
-					}
-
-					if ( uniqueFILE ) {
-						// open a new file on the pakfile
-						fsh[*file].handleFiles.file.z = unzReOpen (pak->pakFilename, pak->handle);
-						if (fsh[*file].handleFiles.file.z == NULL) {
-							Com_Error (ERR_FATAL, "Couldn't reopen %s", pak->pakFilename);
-						}
-					} else {
-						fsh[*file].handleFiles.file.z = pak->handle;
-					}
-					Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-					fsh[*file].zipFile = qtrue;
-					zfi = (unz_s *)fsh[*file].handleFiles.file.z;
-					// in case the file was new
-					temp = zfi->file;
-					// set the file position in the zip file (also sets the current file info)
-					unzSetCurrentFileInfoPosition(pak->handle, pakFile->pos);
-					// copy the file info into the unzip structure
-					Com_Memcpy( zfi, pak->handle, sizeof(unz_s) );
-					// we copy this back into the structure
-					zfi->file = temp;
-					// open the file in the zip
-					unzOpenCurrentFile( fsh[*file].handleFiles.file.z );
-					fsh[*file].zipFilePos = pakFile->pos;
-
-					if ( fs_debug->integer ) {
-						Com_Printf( "FS_FOpenFileRead: %s (found in '%s')\n", 
-							filename, pak->pakFilename );
-					}
-					return zfi->cur_file_info.uncompressed_size;
-				}
-				pakFile = pakFile->next;
-			} while(pakFile != NULL);
-		} else if ( search->dir ) {
-			// check a file in the directory tree
-
-			// if we are running restricted, the only files we
-			// will allow to come from the directory are .cfg files
-			l = (int) strlen( filename );
-      // FIXME TTimo I'm not sure about the fs_numServerPaks test
-      // if you are using FS_ReadFile to find out if a file exists,
-      //   this test can make the search fail although the file is in the directory
-      // I had the problem on https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=8
-      // turned out I used FS_FileExists instead
-			if ( fs_restrict->integer || fs_numServerPaks ) {
-
-				if ( Q_stricmp( filename + l - 4, ".cfg" )		// for config files
-					&& Q_stricmp( filename + l - 5, ".menu" )	// menu files
-					&& Q_stricmp( filename + l - 5, ".game" )	// menu files
-					&& Q_stricmp( filename + l - strlen(demoExt), demoExt )	// menu files
-					&& Q_stricmp( filename + l - 4, ".dat" ) ) {	// for journal files
-					continue;
-				}
-			}
-
-			dir = search->dir;
-			
-			netpath = FS_BuildOSPath( dir->path, dir->gamedir, filename );
-			fsh[*file].handleFiles.file.o = fopen (netpath, "rb");
-			if ( !fsh[*file].handleFiles.file.o ) {
-				continue;
-			}
-
-			if ( Q_stricmp( filename + l - 4, ".cfg" )		// for config files
-				&& Q_stricmp( filename + l - 5, ".menu" )	// menu files
-				&& Q_stricmp( filename + l - 5, ".game" )	// menu files
-				&& Q_stricmp( filename + l - strlen(demoExt), demoExt )	// menu files
-				&& Q_stricmp( filename + l - 4, ".dat" ) ) {	// for journal files
-				fs_fakeChkSum = random();
-			}
-      
-			Q_strncpyz( fsh[*file].name, filename, sizeof( fsh[*file].name ) );
-			fsh[*file].zipFile = qfalse;
-			if ( fs_debug->integer ) {
-				Com_Printf( "FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
-					dir->path, dir->gamedir );
+	pakFile = FS_IndexedFile( filename );
+	i = 0;
+	while ( 1 ) {
+		for ( ; i < fs_numIndexDirs ; i++ ) {
+			dir = fs_indexDirs[i];
+			if ( pakFile && dir->searchOrder > pakFile->pack->searchOrder ) {
+				break;
 			}
-
-			// if we are getting it from the cdpath, optionally copy it
-			//  to the basepath
-			if ( fs_copyfiles->integer && !Q_stricmp( dir->path, fs_cdpath->string ) ) {
-				char	*copypath;
-
-				copypath = FS_BuildOSPath( fs_basepath->string, dir->gamedir, filename );
-				FS_CopyFile( netpath, copypath );
+			len = FS_FOpenDirFileRead( dir, filename, *file );
+			if ( len >= 0 ) {
+				return len;
 			}
+		}
+		if ( !pakFile ) {
+			break;
+		}
 
-			return FS_filelength (*file);
-		}		
+		// disregard if it doesn't match one of the allowed pure pak files
+		if ( FS_PakIsPure( pakFile->pack ) ) {
+			return FS_FOpenPakFileRead( pakFile, filename, *file, uniqueFILE, allowMapped );
+		}
+		pakFile = pakFile->nextCopy;
 	}
 	
 	Com_DPrintf ("Can't find %s\n", filename);
@@ -1261,6 +1560,10 @@ int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueF
 	return -1;
 }
 
+int FS_FOpenFileRead( const char *filename, fileHandle_t *file, qboolean uniqueFILE ) {
+	return FS_FOpenFileReadMapped( filename, file, uniqueFILE, qfalse );
+}
+
 
 /*
 =================
@@ -1466,309 +1769,951 @@ CONVENIENCE FUNCTIONS FOR ENTIRE FILES
 */
 
 int	FS_FileIsInPAK(const char *filename, int *pChecksum ) {
-	searchpath_t	*search;
-	pack_t			*pak;
 	fileInPack_t	*pakFile;
-	long			hash = 0;
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
-	}
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	if ( !filename ) {
+		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
+	}
+
+	// qpaths are not supposed to have a leading slash
+	if ( filename[0] == '/' || filename[0] == '\\' ) {
+		filename++;
+	}
+
+	// make absolutely sure that it can't back up the path.
+	// The searchpaths do guarantee that something will always
+	// be prepended, so we don't need to worry about "c:" or "//limbo" 
+	if ( strstr( filename, ".." ) || strstr( filename, "::" ) ) {
+		return -1;
+	}
+
+	// the first copy in a pure pak
+	for ( pakFile = FS_IndexedFile( filename ) ; pakFile ; pakFile = pakFile->nextCopy ) {
+		if ( FS_PakIsPure( pakFile->pack ) ) {
+			if (pChecksum) {
+				*pChecksum = pakFile->pack->pure_checksum;
+			}
+			return 1;
+		}
+	}
+	return -1;
+}
+
+/*
+============
+FS_ReadMappedFile
+
+Copies a stored file out of the mapped pak, or inflates a deflated
+one straight into buffer.
+============
+*/
+static void FS_ReadMappedFile( fileHandle_t f, byte *buffer ) {
+	fileInPack_t	*pakFile;
+
+	pakFile = fsh[f].mappedFile;
+	fs_readCount += pakFile->size;
+
+	if ( !pakFile->method ) {
+		Com_Memcpy( buffer, fsh[f].mappedData, pakFile->size );
+		return;
+	}
+
+	if ( unzInflateBuffer( fsh[f].mappedData, pakFile->compressedSize, buffer, pakFile->size ) != UNZ_OK ) {
+		Com_Error( ERR_DROP, "FS_ReadFile: %s is corrupt", fsh[f].name );
+	}
+}
+
+/*
+============
+FS_ReadFile
+
+Filename are relative to the quake search path
+a null buffer will just return the file length without loading
+============
+*/
+int FS_ReadFile( const char *qpath, void **buffer ) {
+	fileHandle_t	h;
+	byte*			buf;
+	qboolean		isConfig;
+	int				len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	if ( !qpath || !qpath[0] ) {
+		Com_Error( ERR_FATAL, "FS_ReadFile with empty name\n" );
+	}
+
+	buf = NULL;	// quiet compiler warning
+
+	// if this is a .cfg file and we are playing back a journal, read
+	// it from the journal file
+	if ( strstr( qpath, ".cfg" ) ) {
+		isConfig = qtrue;
+		if ( com_journal && com_journal->integer == 2 ) {
+			int		r;
+
+			Com_DPrintf( "Loading %s from journal file.\n", qpath );
+			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
+			if ( r != sizeof( len ) ) {
+				if (buffer != NULL) *buffer = NULL;
+				return -1;
+			}
+			// if the file didn't exist when the journal was created
+			if (!len) {
+				if (buffer == NULL) {
+					return 1;			// hack for old journal files
+				}
+				*buffer = NULL;
+				return -1;
+			}
+			if (buffer == NULL) {
+				return len;
+			}
+
+			buf = Hunk_AllocateTempMemory(len+1);
+			*buffer = buf;
+
+			r = FS_Read( buf, len, com_journalDataFile );
+			if ( r != len ) {
+				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
+			}
+
+			fs_loadCount++;
+			fs_loadStack++;
+
+			// guarantee that it will have a trailing 0 for string operations
+			buf[len] = 0;
+
+			return len;
+		}
+	} else {
+		isConfig = qfalse;
+	}
+
+	// look for it in the filesystem or pack files
+	len = FS_FOpenFileReadMapped( qpath, &h, qfalse, qtrue );
+	if ( h == 0 ) {
+		if ( buffer ) {
+			*buffer = NULL;
+		}
+		// if we are journalling and it is a config file, write a zero to the journal file
+		if ( isConfig && com_journal && com_journal->integer == 1 ) {
+			Com_DPrintf( "Writing zero for %s to journal file.\n", qpath );
+			len = 0;
+			FS_Write( &len, sizeof( len ), com_journalDataFile );
+			FS_Flush( com_journalDataFile );
+		}
+		return -1;
+	}
+	
+	if ( !buffer ) {
+		if ( isConfig && com_journal && com_journal->integer == 1 ) {
+			Com_DPrintf( "Writing len for %s to journal file.\n", qpath );
+			FS_Write( &len, sizeof( len ), com_journalDataFile );
+			FS_Flush( com_journalDataFile );
+		}
+		FS_FCloseFile( h);
+		return len;
+	}
+
+	fs_loadCount++;
+	fs_loadStack++;
+
+	buf = Hunk_AllocateTempMemory(len+1);
+	*buffer = buf;
+
+	if ( fsh[h].mappedFile ) {
+		FS_ReadMappedFile( h, buf );
+	} else {
+		FS_Read (buf, len, h);
+	}
+
+	// guarantee that it will have a trailing 0 for string operations
+	buf[len] = 0;
+	FS_FCloseFile( h );
+
+	// if we are journalling and it is a config file, write it to the journal file
+	if ( isConfig && com_journal && com_journal->integer == 1 ) {
+		Com_DPrintf( "Writing %s to journal file.\n", qpath );
+		FS_Write( &len, sizeof( len ), com_journalDataFile );
+		FS_Write( buf, len, com_journalDataFile );
+		FS_Flush( com_journalDataFile );
+	}
+	return len;
+}
+
+/*
+============
+FS_ReadFileDirect
+
+Stored files in a mapped pak are handed out in place, everything
+else is read as FS_ReadFile does.  Stored files don't have to start on
+a four byte boundary in the pk3, those are read as well so the callers
+can still cast the buffer to ints.
+============
+*/
+int FS_ReadFileDirect( const char *qpath, void **buffer ) {
+	fileHandle_t	h;
+	int				len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	// configs may have to come from the journal
+	if ( !buffer || !qpath || strstr( qpath, ".cfg" ) ) {
+		return FS_ReadFile( qpath, buffer );
+	}
+
+	len = FS_FOpenFileReadMapped( qpath, &h, qfalse, qtrue );
+	if ( h == 0 ) {
+		*buffer = NULL;
+		return -1;
+	}
+
+	if ( !fsh[h].mappedFile || fsh[h].mappedFile->method || ( (size_t)fsh[h].mappedData & 3 ) ) {
+		FS_FCloseFile( h );
+		return FS_ReadFile( qpath, buffer );
+	}
+
+	*buffer = (void *)fsh[h].mappedData;
+	FS_FCloseFile( h );
+
+	fs_loadCount++;
+	fs_loadStack++;
+	fs_readCount += len;
+
+	return len;
+}
+
+/*
+=============
+FS_PointerInMappedPak
+=============
+*/
+static qboolean FS_PointerInMappedPak( const void *buffer ) {
+	searchpath_t	*search;
+	pack_t			*pak;
+
+	for ( search = fs_searchpaths ; search ; search = search->next ) {
+		pak = search->pack;
+		if ( pak && pak->mapping && (const byte *)buffer >= pak->mapping
+			&& (const byte *)buffer < pak->mapping + pak->mappingSize ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
+/*
+=============
+FS_FreeFile
+=============
+*/
+void FS_FreeFile( void *buffer ) {
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+	if ( !buffer ) {
+		Com_Error( ERR_FATAL, "FS_FreeFile( NULL )" );
+	}
+	fs_loadStack--;
+
+	// handed out by FS_ReadFileDirect, nothing to free
+	if ( !FS_PointerInMappedPak( buffer ) ) {
+		Hunk_FreeTempMemory( buffer );
+	}
+
+	// if all of our temp files are free, clear all of our space
+	if ( fs_loadStack == 0 ) {
+		Hunk_ClearTempMemory();
+	}
+}
+
+/*
+============
+FS_WriteFile
+
+Filename are reletive to the quake search path
+============
+*/
+void FS_WriteFile( const char *qpath, const void *buffer, int size ) {
+	fileHandle_t f;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	if ( !qpath || !buffer ) {
+		Com_Error( ERR_FATAL, "FS_WriteFile: NULL parameter" );
+	}
+
+	f = FS_FOpenFileWrite( qpath );
+	if ( !f ) {
+		Com_Printf( "Failed to open %s\n", qpath );
+		return;
+	}
+
+	FS_Write( buffer, size, f );
+
+	FS_FCloseFile( f );
+}
+
+
+
+/*
+==========================================================================
+
+ASYNCHRONOUS LOADING
+
+FS_ReadFileAsync finds the file on the main thread, exactly as FS_ReadFile
+would, so reference marking and the pure rules don't change.  The I/O
+threads then only copy or inflate out of a mapped pak, or read a file that
+was already opened for them; they never touch the search path, the zone
+or the hunk.  Each thread holds at most one load, handed to it by the
+main thread, which keeps the bytes in flight bounded and lets queued
+loads be started strictly by priority.
+
+==========================================================================
+*/
+
+#define	MAX_LOAD_THREADS	4
+
+typedef struct asyncLoad_s {
+	char				qpath[MAX_QPATH];
+	fsLoadCallback_t	callback;
+	void				*data;
+	int					length;
+
+	// exactly one of these is the source
+	const fileInPack_t	*mappedFile;
+	const byte			*mappedData;
+	FILE				*file;
+
+	byte				*buffer;		// C heap, NULL if the read failed
+	volatile int		finished;
+
+	struct asyncLoad_s	*next;
+} asyncLoad_t;
+
+typedef struct {
+	void				*wake;
+	asyncLoad_t			*load;			// only written while the thread is idle
+	volatile int		busy;
+} loadThread_t;
+
+static	cvar_t			*fs_loadThreads;
+static	loadThread_t	fs_loaders[MAX_LOAD_THREADS];
+static	int				fs_numLoaders = -1;		// -1 until the first load
+static	void			*fs_loadsDone;			// posted once per finished load
+static	asyncLoad_t		*fs_queuedLoads[FS_LOAD_PRIORITIES];
+static	asyncLoad_t		*fs_startedLoads;		// on a thread or finished
+
+/*
+============
+FS_ReadAsyncLoad
+
+Fills in load->buffer, on whichever thread the load was given to.
+============
+*/
+static void FS_ReadAsyncLoad( asyncLoad_t *load ) {
+	byte	*buf;
+	int		ok;
+
+	buf = malloc( load->length + 1 );
+
+	if ( load->file ) {
+		ok = buf && fread( buf, 1, load->length, load->file ) == (size_t)load->length;
+		fclose( load->file );
+		load->file = NULL;
+	} else if ( !load->mappedFile->method ) {
+		if ( buf ) {
+			Com_Memcpy( buf, load->mappedData, load->length );
+		}
+		ok = buf != NULL;
+	} else {
+		ok = buf && unzInflateBuffer( load->mappedData, load->mappedFile->compressedSize,
+			buf, load->length ) == UNZ_OK;
+	}
+
+	if ( !ok ) {
+		free( buf );
+		load->buffer = NULL;
+		return;
+	}
+
+	// guarantee that it will have a trailing 0 for string operations
+	buf[load->length] = 0;
+	load->buffer = buf;
+}
+
+/*
+============
+FS_LoadThread
+============
+*/
+static void FS_LoadThread( void *data ) {
+	loadThread_t	*thread;
+	asyncLoad_t		*load;
+
+	thread = data;
+	while ( 1 ) {
+		Sys_SemaphoreWait( thread->wake );
+
+		load = thread->load;
+		FS_ReadAsyncLoad( load );
+
+		Sys_AtomicAdd( &load->finished, 1 );
+		Sys_AtomicAdd( &thread->busy, -1 );
+		Sys_SemaphorePost( fs_loadsDone, 1 );
+	}
+}
+
+/*
+============
+FS_StartLoadThreads
+
+Threads are only started the first time something is loaded
+asynchronously, so a dedicated server never has them.
+============
+*/
+static void FS_StartLoadThreads( void ) {
+	int		i, count;
+
+	fs_numLoaders = 0;
+
+	count = fs_loadThreads->integer;
+	if ( count > MAX_LOAD_THREADS ) {
+		count = MAX_LOAD_THREADS;
+	}
+	if ( count <= 0 ) {
+		return;
+	}
+
+	fs_loadsDone = Sys_CreateSemaphore( 0 );
+	if ( !fs_loadsDone ) {
+		return;
+	}
+
+	for ( i = 0 ; i < count ; i++ ) {
+		fs_loaders[i].wake = Sys_CreateSemaphore( 0 );
+		if ( !fs_loaders[i].wake ) {
+			break;
+		}
+		if ( !Sys_CreateThread( FS_LoadThread, &fs_loaders[i] ) ) {
+			Sys_DestroySemaphore( fs_loaders[i].wake );
+			break;
+		}
+		fs_numLoaders++;
+	}
+
+	Com_DPrintf( "%i file loading threads\n", fs_numLoaders );
+}
+
+/*
+============
+FS_StartQueuedLoads
+
+Gives the most important queued loads to idle threads.
+============
+*/
+static void FS_StartQueuedLoads( void ) {
+	loadThread_t	*thread;
+	asyncLoad_t		*load;
+	int				i, priority;
+
+	priority = FS_LOAD_PRIORITIES - 1;
+	for ( i = 0 ; i < fs_numLoaders ; i++ ) {
+		thread = &fs_loaders[i];
+		if ( Sys_AtomicAdd( &thread->busy, 0 ) ) {
+			continue;
+		}
+
+		while ( priority >= 0 && !fs_queuedLoads[priority] ) {
+			priority--;
+		}
+		if ( priority < 0 ) {
+			return;
+		}
+
+		load = fs_queuedLoads[priority];
+		fs_queuedLoads[priority] = load->next;
+		load->next = fs_startedLoads;
+		fs_startedLoads = load;
+
+		thread->load = load;
+		Sys_AtomicAdd( &thread->busy, 1 );
+		Sys_SemaphorePost( thread->wake, 1 );
+	}
+}
+
+/*
+============
+FS_ReadFileAsync
+
+Never calls back itself, even when the file was read right here, so
+callers don't have to be re-entrant.  The callbacks all come from
+FS_RunAsyncLoads or FS_FinishAsyncLoads.
+============
+*/
+int FS_ReadFileAsync( const char *qpath, fsLoadPriority_t priority, fsLoadCallback_t callback, void *data ) {
+	fileHandle_t	h;
+	asyncLoad_t		*load, **tail;
+	void			*buf;
+	int				len;
+
+	if ( !fs_searchpaths ) {
+		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	}
+
+	if ( !qpath || !qpath[0] || !callback ) {
+		Com_Error( ERR_FATAL, "FS_ReadFileAsync: NULL parameter" );
+	}
+
+	if ( priority < 0 || priority >= FS_LOAD_PRIORITIES ) {
+		priority = FS_LOAD_NORMAL;
+	}
+
+	if ( fs_numLoaders < 0 ) {
+		FS_StartLoadThreads();
+	}
+
+	load = Z_Malloc( sizeof( *load ) );
+	Q_strncpyz( load->qpath, qpath, sizeof( load->qpath ) );
+	load->callback = callback;
+	load->data = data;
+
+	// configs may have to come from the journal
+	if ( strstr( qpath, ".cfg" ) ) {
+		len = FS_ReadFile( qpath, &buf );
+		if ( !buf ) {
+			Z_Free( load );
+			return len;
+		}
+		load->length = len;
+		load->buffer = malloc( len + 1 );
+		if ( load->buffer ) {
+			Com_Memcpy( load->buffer, buf, len + 1 );
+		}
+		FS_FreeFile( buf );
+		load->finished = 1;
+		load->next = fs_startedLoads;
+		fs_startedLoads = load;
+		return len;
+	}
+
+	len = FS_FOpenFileReadMapped( qpath, &h, qfalse, qtrue );
+	if ( h == 0 ) {
+		Z_Free( load );
+		return -1;
+	}
+	load->length = len;
+
+	fs_loadCount++;
+	fs_readCount += len;
+
+	if ( fsh[h].mappedFile ) {
+		load->mappedFile = fsh[h].mappedFile;
+		load->mappedData = fsh[h].mappedData;
+		FS_FCloseFile( h );
+	} else if ( !fsh[h].zipFile && !fsh[h].streamed ) {
+		// the thread reads and closes it
+		load->file = fsh[h].handleFiles.file.o;
+		Com_Memset( &fsh[h], 0, sizeof( fsh[h] ) );
+	} else {
+		// an unmapped pak can only be read through the shared unzip handle
+		load->buffer = malloc( len + 1 );
+		if ( load->buffer ) {
+			FS_Read( load->buffer, len, h );
+			load->buffer[len] = 0;
+		}
+		FS_FCloseFile( h );
+		load->finished = 1;
+		load->next = fs_startedLoads;
+		fs_startedLoads = load;
+		return len;
+	}
+
+	if ( !fs_numLoaders ) {
+		FS_ReadAsyncLoad( load );
+		load->finished = 1;
+		load->next = fs_startedLoads;
+		fs_startedLoads = load;
+		return len;
+	}
+
+	for ( tail = &fs_queuedLoads[priority] ; *tail ; tail = &(*tail)->next ) {
+	}
+	*tail = load;
+
+	FS_StartQueuedLoads();
+
+	return len;
+}
+
+/*
+============
+FS_RunAsyncLoads
+
+Callbacks may submit further loads.
+============
+*/
+void FS_RunAsyncLoads( void ) {
+	asyncLoad_t		*load, **prev;
+
+	FS_StartQueuedLoads();
+
+	prev = &fs_startedLoads;
+	while ( ( load = *prev ) != NULL ) {
+		if ( !Sys_AtomicAdd( &load->finished, 0 ) ) {
+			prev = &load->next;
+			continue;
+		}
+
+		*prev = load->next;
 
-	if ( !filename ) {
-		Com_Error( ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n" );
-	}
+		if ( load->buffer ) {
+			load->callback( load->qpath, load->buffer, load->length, load->data );
+		} else {
+			Com_Printf( S_COLOR_YELLOW "WARNING: couldn't read %s\n", load->qpath );
+			load->callback( load->qpath, NULL, -1, load->data );
+		}
+		Z_Free( load );
 
-	// qpaths are not supposed to have a leading slash
-	if ( filename[0] == '/' || filename[0] == '\\' ) {
-		filename++;
+		// the callback may have changed the list
+		prev = &fs_startedLoads;
 	}
 
-	// make absolutely sure that it can't back up the path.
-	// The searchpaths do guarantee that something will always
-	// be prepended, so we don't need to worry about "c:" or "//limbo" 
-	if ( strstr( filename, ".." ) || strstr( filename, "::" ) ) {
-		return -1;
-	}
+	FS_StartQueuedLoads();
+}
 
-	//
-	// search through the path, one element at a time
-	//
+/*
+============
+FS_FinishAsyncLoads
+============
+*/
+void FS_FinishAsyncLoads( void ) {
+	int		i;
 
-	for ( search = fs_searchpaths ; search ; search = search->next ) {
-		//
-		if (search->pack) {
-			hash = FS_HashFileName(filename, search->pack->hashSize);
-		}
-		// is the element a pak file?
-		if ( search->pack && search->pack->hashTable[hash] ) {
-			// disregard if it doesn't match one of the allowed pure pak files
-			if ( !FS_PakIsPure(search->pack) ) {
-				continue;
+	while ( 1 ) {
+		FS_RunAsyncLoads();
+		if ( !fs_startedLoads ) {
+			for ( i = 0 ; i < FS_LOAD_PRIORITIES ; i++ ) {
+				if ( fs_queuedLoads[i] ) {
+					break;
+				}
 			}
+			if ( i == FS_LOAD_PRIORITIES ) {
+				return;
+			}
+		}
 
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do {
-				// case and separator insensitive comparisons
-				if ( !FS_FilenameCompare( pakFile->name, filename ) ) {
-					if (pChecksum) {
-						*pChecksum = pak->pure_checksum;
-					}
-					return 1;
-				}
-				pakFile = pakFile->next;
-			} while(pakFile != NULL);
+		// finished loads post once each, so a stale post only
+		// costs an extra pass
+		if ( fs_numLoaders > 0 ) {
+			Sys_SemaphoreWait( fs_loadsDone );
 		}
 	}
-	return -1;
 }
 
 /*
 ============
-FS_ReadFile
-
-Filename are relative to the quake search path
-a null buffer will just return the file length without loading
+FS_FreeAsyncFile
 ============
 */
-int FS_ReadFile( const char *qpath, void **buffer ) {
-	fileHandle_t	h;
-	byte*			buf;
-	qboolean		isConfig;
-	int				len;
+void FS_FreeAsyncFile( void *buffer ) {
+	free( buffer );
+}
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
-	}
 
-	if ( !qpath || !qpath[0] ) {
-		Com_Error( ERR_FATAL, "FS_ReadFile with empty name\n" );
-	}
+/*
+==========================================================================
 
-	buf = NULL;	// quiet compiler warning
+ZIP FILE LOADING
 
-	// if this is a .cfg file and we are playing back a journal, read
-	// it from the journal file
-	if ( strstr( qpath, ".cfg" ) ) {
-		isConfig = qtrue;
-		if ( com_journal && com_journal->integer == 2 ) {
-			int		r;
+==========================================================================
+*/
 
-			Com_DPrintf( "Loading %s from journal file.\n", qpath );
-			r = FS_Read( &len, sizeof( len ), com_journalDataFile );
-			if ( r != sizeof( len ) ) {
-				if (buffer != NULL) *buffer = NULL;
-				return -1;
-			}
-			// if the file didn't exist when the journal was created
-			if (!len) {
-				if (buffer == NULL) {
-					return 1;			// hack for old journal files
-				}
-				*buffer = NULL;
-				return -1;
-			}
-			if (buffer == NULL) {
-				return len;
-			}
+/*
+The central directory of every pak in a game directory is parsed on the
+job threads before any pack_t is built.  The scan touches nothing but
+its own zipScan_t, malloc and the file itself, the zone and the unzip
+handles are left to FS_LoadZipFile on the main thread.
+*/
 
-			buf = Hunk_AllocateTempMemory(len+1);
-			*buffer = buf;
+#define	ZIP_END_HEADER_SIZE		22
+#define	ZIP_CENTRAL_HEADER_SIZE	46
+#define	ZIP_MAX_COMMENT			0xffff
 
-			r = FS_Read( buf, len, com_journalDataFile );
-			if ( r != len ) {
-				Com_Error( ERR_FATAL, "Read from journalDataFile failed" );
-			}
+typedef struct {
+	unsigned long	pos;			// file info position, as unzip counts it
+	unsigned long	offset;			// local header position in zip
+	unsigned long	crc;
+	int				method;
+	int				compressedSize;
+	int				size;
+	int				name;			// offset in names
+} zipScanEntry_t;
 
-			fs_loadCount++;
-			fs_loadStack++;
+typedef struct {
+	char			zipfile[MAX_OSPATH];
+	const char		*basename;
+
+	// filled in by FS_ScanZipFile
+	qboolean		valid;
+	int				numEntries;
+	zipScanEntry_t	*entries;
+	char			*names;
+	int				namesLength;
+	int				checksum;
+	int				pure_checksum;
+	byte			*mapping;
+	int				mappingSize;
+} zipScan_t;
+
+#define	ZIP_SHORT(p)	( (p)[0] | ( (p)[1] << 8 ) )
+#define	ZIP_LONG(p)		( (unsigned long)( (p)[0] | ( (p)[1] << 8 ) | ( (p)[2] << 16 ) ) | ( (unsigned long)(p)[3] << 24 ) )
 
-			// guarantee that it will have a trailing 0 for string operations
-			buf[len] = 0;
+/*
+=================
+FS_ReadZipRange
 
-			return len;
-		}
-	} else {
-		isConfig = qfalse;
+From the mapping if there is one, otherwise into a malloc'd buffer
+that the caller frees
+=================
+*/
+static const byte *FS_ReadZipRange( zipScan_t *scan, FILE *f, unsigned long pos, int length, byte **allocated ) {
+	byte	*buf;
+
+	*allocated = NULL;
+	if ( scan->mapping ) {
+		return scan->mapping + pos;
 	}
 
-	// look for it in the filesystem or pack files
-	len = FS_FOpenFileRead( qpath, &h, qfalse );
-	if ( h == 0 ) {
-		if ( buffer ) {
-			*buffer = NULL;
-		}
-		// if we are journalling and it is a config file, write a zero to the journal file
-		if ( isConfig && com_journal && com_journal->integer == 1 ) {
-			Com_DPrintf( "Writing zero for %s to journal file.\n", qpath );
-			len = 0;
-			FS_Write( &len, sizeof( len ), com_journalDataFile );
-			FS_Flush( com_journalDataFile );
-		}
-		return -1;
+	buf = malloc( length + 1 );
+	if ( !buf ) {
+		return NULL;
 	}
-	
-	if ( !buffer ) {
-		if ( isConfig && com_journal && com_journal->integer == 1 ) {
-			Com_DPrintf( "Writing len for %s to journal file.\n", qpath );
-			FS_Write( &len, sizeof( len ), com_journalDataFile );
-			FS_Flush( com_journalDataFile );
-		}
-		FS_FCloseFile( h);
-		return len;
+	if ( fseek( f, pos, SEEK_SET ) || fread( buf, 1, length, f ) != (size_t)length ) {
+		free( buf );
+		return NULL;
 	}
 
-	fs_loadCount++;
-	fs_loadStack++;
+	*allocated = buf;
+	return buf;
+}
 
-	buf = Hunk_AllocateTempMemory(len+1);
-	*buffer = buf;
+/*
+=================
+FS_ParseZipDirectory
 
-	FS_Read (buf, len, h);
+Reads the end of central directory record and the central directory
+the way unzip does, checking the same things
+=================
+*/
+static qboolean FS_ParseZipDirectory( zipScan_t *scan, FILE *f, unsigned long fileSize ) {
+	const byte		*tail, *dir, *p;
+	byte			*tailBuf, *dirBuf;
+	unsigned long	tailPos, endPos, dirSize, dirOffset, byteBefore;
+	int				tailSize, numEntries, nameLength, i, l;
+	int				*headerLongs, numHeaderLongs;
+	zipScanEntry_t	*entry;
+
+	if ( fileSize < ZIP_END_HEADER_SIZE ) {
+		return qfalse;
+	}
 
-	// guarantee that it will have a trailing 0 for string operations
-	buf[len] = 0;
-	FS_FCloseFile( h );
+	// the end record is somewhere in the last 64k, behind the zip comment
+	tailSize = fileSize < ZIP_MAX_COMMENT ? (int)fileSize : ZIP_MAX_COMMENT;
+	tailPos = fileSize - tailSize;
+	tail = FS_ReadZipRange( scan, f, tailPos, tailSize, &tailBuf );
+	if ( !tail ) {
+		return qfalse;
+	}
+	for ( i = tailSize - ZIP_END_HEADER_SIZE ; i >= 0 ; i-- ) {
+		if ( tail[i] == 'P' && tail[i+1] == 'K' && tail[i+2] == 5 && tail[i+3] == 6 ) {
+			break;
+		}
+	}
+	if ( i < 0 ) {
+		free( tailBuf );
+		return qfalse;
+	}
 
-	// if we are journalling and it is a config file, write it to the journal file
-	if ( isConfig && com_journal && com_journal->integer == 1 ) {
-		Com_DPrintf( "Writing %s to journal file.\n", qpath );
-		FS_Write( &len, sizeof( len ), com_journalDataFile );
-		FS_Write( buf, len, com_journalDataFile );
-		FS_Flush( com_journalDataFile );
+	p = tail + i;
+	endPos = tailPos + i;
+	numEntries = ZIP_SHORT( p + 10 );
+	dirSize = ZIP_LONG( p + 12 );
+	dirOffset = ZIP_LONG( p + 16 );
+	if ( ZIP_SHORT( p + 4 ) || ZIP_SHORT( p + 6 ) || ZIP_SHORT( p + 8 ) != numEntries
+		|| endPos < dirOffset + dirSize || dirOffset + dirSize < dirOffset ) {
+		free( tailBuf );
+		return qfalse;
 	}
-	return len;
-}
+	free( tailBuf );
 
-/*
-=============
-FS_FreeFile
-=============
-*/
-void FS_FreeFile( void *buffer ) {
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
+	byteBefore = endPos - ( dirOffset + dirSize );
+	dir = FS_ReadZipRange( scan, f, dirOffset + byteBefore, dirSize, &dirBuf );
+	if ( !dir ) {
+		return qfalse;
 	}
-	if ( !buffer ) {
-		Com_Error( ERR_FATAL, "FS_FreeFile( NULL )" );
+
+	// names can't be longer than the directory itself
+	scan->entries = malloc( ( numEntries + 1 ) * sizeof( *scan->entries ) );
+	scan->names = malloc( dirSize + numEntries + 1 );
+	headerLongs = malloc( ( numEntries + 1 ) * sizeof( *headerLongs ) );
+	if ( !scan->entries || !scan->names || !headerLongs ) {
+		free( headerLongs );
+		free( dirBuf );
+		return qfalse;
 	}
-	fs_loadStack--;
 
-	Hunk_FreeTempMemory( buffer );
+	numHeaderLongs = 0;
+	p = dir;
+	for ( i = 0 ; i < numEntries ; i++ ) {
+		if ( p + ZIP_CENTRAL_HEADER_SIZE > dir + dirSize
+			|| p[0] != 'P' || p[1] != 'K' || p[2] != 1 || p[3] != 2 ) {
+			break;		// unzip stops at the first bad entry too
+		}
+		l = ZIP_CENTRAL_HEADER_SIZE + ZIP_SHORT( p + 28 ) + ZIP_SHORT( p + 30 ) + ZIP_SHORT( p + 32 );
+		if ( p + l > dir + dirSize ) {
+			break;
+		}
 
-	// if all of our temp files are free, clear all of our space
-	if ( fs_loadStack == 0 ) {
-		Hunk_ClearTempMemory();
+		entry = &scan->entries[i];
+		entry->pos = dirOffset + ( p - dir );
+		entry->offset = ZIP_LONG( p + 42 ) + byteBefore;
+		entry->crc = ZIP_LONG( p + 16 );
+		entry->method = ZIP_SHORT( p + 10 );
+		entry->compressedSize = ZIP_LONG( p + 20 );
+		entry->size = ZIP_LONG( p + 24 );
+
+		nameLength = ZIP_SHORT( p + 28 );
+		if ( nameLength > MAX_ZPATH - 1 ) {
+			nameLength = MAX_ZPATH - 1;
+		}
+		entry->name = scan->namesLength;
+		Com_Memcpy( scan->names + scan->namesLength, p + ZIP_CENTRAL_HEADER_SIZE, nameLength );
+		scan->names[scan->namesLength + nameLength] = 0;
+		Q_strlwr( scan->names + scan->namesLength );
+		scan->namesLength += (int) strlen( scan->names + scan->namesLength ) + 1;
+
+		if ( entry->size > 0 ) {
+			headerLongs[numHeaderLongs++] = LittleLong( entry->crc );
+		}
+
+		p += l;
 	}
+	scan->numEntries = i;
+	free( dirBuf );
+
+	scan->checksum = Com_BlockChecksum( headerLongs, 4 * numHeaderLongs );
+	scan->pure_checksum = Com_BlockChecksumKey( headerLongs, 4 * numHeaderLongs, LittleLong(fs_checksumFeed) );
+	scan->checksum = LittleLong( scan->checksum );
+	scan->pure_checksum = LittleLong( scan->pure_checksum );
+	free( headerLongs );
+
+	return qtrue;
 }
 
 /*
-============
-FS_WriteFile
+=================
+FS_ScanZipFile
 
-Filename are reletive to the quake search path
-============
+Safe to run on any thread
+=================
 */
-void FS_WriteFile( const char *qpath, const void *buffer, int size ) {
-	fileHandle_t f;
+static void FS_ScanZipFile( int index, void *data ) {
+	zipScan_t		*scan;
+	FILE			*f;
+	unsigned long	fileSize;
 
-	if ( !fs_searchpaths ) {
-		Com_Error( ERR_FATAL, "Filesystem call made without initialization\n" );
-	}
+	scan = (zipScan_t *)data + index;
+	f = NULL;
 
-	if ( !qpath || !buffer ) {
-		Com_Error( ERR_FATAL, "FS_WriteFile: NULL parameter" );
+	if ( fs_mapPaks->integer ) {
+		scan->mapping = Sys_MapFile( scan->zipfile, &scan->mappingSize );
 	}
-
-	f = FS_FOpenFileWrite( qpath );
-	if ( !f ) {
-		Com_Printf( "Failed to open %s\n", qpath );
-		return;
+	if ( scan->mapping ) {
+		fileSize = scan->mappingSize;
+	} else {
+		f = fopen( scan->zipfile, "rb" );
+		if ( !f ) {
+			return;
+		}
+		fseek( f, 0, SEEK_END );
+		fileSize = ftell( f );
 	}
 
-	FS_Write( buffer, size, f );
+	scan->valid = FS_ParseZipDirectory( scan, f, fileSize );
 
-	FS_FCloseFile( f );
+	if ( f ) {
+		fclose( f );
+	}
 }
 
-
-
 /*
-==========================================================================
-
-ZIP FILE LOADING
-
-==========================================================================
+=================
+FS_FreeZipScan
+=================
 */
+static void FS_FreeZipScan( zipScan_t *scan ) {
+	free( scan->entries );
+	free( scan->names );
+	scan->entries = NULL;
+	scan->names = NULL;
+
+	if ( scan->mapping ) {
+		Sys_UnmapFile( scan->mapping, scan->mappingSize );
+		scan->mapping = NULL;
+	}
+}
 
 /*
 =================
 FS_LoadZipFile
 
 Creates a new pak_t in the search chain for the contents
-of a zip file.
+of a scanned zip file.
 =================
 */
-static pack_t *FS_LoadZipFile( char *zipfile, const char *basename )
+static pack_t *FS_LoadZipFile( zipScan_t *scan )
 {
 	fileInPack_t	*buildBuffer;
 	pack_t			*pack;
 	unzFile			uf;
-	int				err;
-	unz_global_info gi;
-	char			filename_inzip[MAX_ZPATH];
-	unz_file_info	file_info;
-	int				i, len;
-	long			hash;
-	int				fs_numHeaderLongs;
-	int				*fs_headerLongs;
+	zipScanEntry_t	*entry;
+	int				i;
 	char			*namePtr;
 
-	fs_numHeaderLongs = 0;
-
-	uf = unzOpen(zipfile);
-	err = unzGetGlobalInfo (uf,&gi);
-
-	if (err != UNZ_OK)
+	if ( !scan->valid ) {
+		FS_FreeZipScan( scan );
 		return NULL;
+	}
 
-	fs_packFiles += gi.number_entry;
-
-	len = 0;
-	unzGoToFirstFile(uf);
-	for (i = 0; i < gi.number_entry; i++)
-	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
-		}
-		len += (int) strlen(filename_inzip) + 1;
-		unzGoToNextFile(uf);
+	uf = unzOpen( scan->zipfile );
+	if ( !uf ) {
+		FS_FreeZipScan( scan );
+		return NULL;
 	}
 
-	buildBuffer = Z_Malloc( (gi.number_entry * sizeof( fileInPack_t )) + len );
-	namePtr = ((char *) buildBuffer) + gi.number_entry * sizeof( fileInPack_t );
-	fs_headerLongs = Z_Malloc( gi.number_entry * sizeof(int) );
+	fs_packFiles += scan->numEntries;
 
-	// get the hash table size from the number of files in the zip
-	// because lots of custom pk3 files have less than 32 or 64 files
-	for (i = 1; i <= MAX_FILEHASH_SIZE; i <<= 1) {
-		if (i > gi.number_entry) {
-			break;
-		}
-	}
+	buildBuffer = Z_Malloc( (scan->numEntries * sizeof( fileInPack_t )) + scan->namesLength );
+	namePtr = ((char *) buildBuffer) + scan->numEntries * sizeof( fileInPack_t );
+	Com_Memcpy( namePtr, scan->names, scan->namesLength );
 
-	pack = Z_Malloc( sizeof( pack_t ) + i * sizeof(fileInPack_t *) );
-	pack->hashSize = i;
-	pack->hashTable = (fileInPack_t **) (((char *) pack) + sizeof( pack_t ));
-	for(i = 0; i < pack->hashSize; i++) {
-		pack->hashTable[i] = NULL;
-	}
+	// the files are hashed by FS_BuildFileIndex once the search path is complete
+	pack = Z_Malloc( sizeof( pack_t ) );
 
-	Q_strncpyz( pack->pakFilename, zipfile, sizeof( pack->pakFilename ) );
-	Q_strncpyz( pack->pakBasename, basename, sizeof( pack->pakBasename ) );
+	Q_strncpyz( pack->pakFilename, scan->zipfile, sizeof( pack->pakFilename ) );
+	Q_strncpyz( pack->pakBasename, scan->basename, sizeof( pack->pakBasename ) );
 
 	// strip .pk3 if needed
 	if ( strlen( pack->pakBasename ) > 4 && !Q_stricmp( pack->pakBasename + strlen( pack->pakBasename ) - 4, ".pk3" ) ) {
@@ -1776,39 +2721,32 @@ static pack_t *FS_LoadZipFile( char *zipfile, const char *basename )
 	}
 
 	pack->handle = uf;
-	pack->numfiles = gi.number_entry;
-	unzGoToFirstFile(uf);
+	pack->numfiles = scan->numEntries;
 
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0; i < scan->numEntries; i++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		if (err != UNZ_OK) {
-			break;
-		}
-		if (file_info.uncompressed_size > 0) {
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
-		}
-		Q_strlwr( filename_inzip );
-		hash = FS_HashFileName(filename_inzip, pack->hashSize);
-		buildBuffer[i].name = namePtr;
-		strcpy( buildBuffer[i].name, filename_inzip );
-		namePtr += strlen(filename_inzip) + 1;
+		entry = &scan->entries[i];
+		buildBuffer[i].name = namePtr + entry->name;
+		buildBuffer[i].pack = pack;
 		// store the file position in the zip
-		unzGetCurrentFileInfoPosition(uf, &buildBuffer[i].pos);
-		//
-		buildBuffer[i].next = pack->hashTable[hash];
-		pack->hashTable[hash] = &buildBuffer[i];
-		unzGoToNextFile(uf);
+		buildBuffer[i].pos = entry->pos;
+		// and what a mapped read needs to find the data
+		buildBuffer[i].offset = entry->offset;
+		buildBuffer[i].method = entry->method;
+		buildBuffer[i].compressedSize = entry->compressedSize;
+		buildBuffer[i].size = entry->size;
 	}
 
-	pack->checksum = Com_BlockChecksum( fs_headerLongs, 4 * fs_numHeaderLongs );
-	pack->pure_checksum = Com_BlockChecksumKey( fs_headerLongs, 4 * fs_numHeaderLongs, LittleLong(fs_checksumFeed) );
-	pack->checksum = LittleLong( pack->checksum );
-	pack->pure_checksum = LittleLong( pack->pure_checksum );
+	pack->checksum = scan->checksum;
+	pack->pure_checksum = scan->pure_checksum;
+	pack->buildBuffer = buildBuffer;
 
-	Z_Free(fs_headerLongs);
+	// the pack owns the mapping from here on
+	pack->mapping = scan->mapping;
+	pack->mappingSize = scan->mappingSize;
+	scan->mapping = NULL;
+	FS_FreeZipScan( scan );
 
-	pack->buildBuffer = buildBuffer;
 	return pack;
 }
 
@@ -2513,6 +3451,7 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 	int				numfiles;
 	char			**pakfiles;
 	char			*sorted[MAX_PAKFILES];
+	zipScan_t		*scans;
 
 	// this fixes the case where fs_basepath is the same as fs_cdpath
 	// which happens on full installs
@@ -2556,9 +3495,16 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 
 	qsort( sorted, numfiles, sizeof(size_t), paksort );
 
+	// read all the central directories at once
+	scans = Z_Malloc( ( numfiles + 1 ) * sizeof( *scans ) );
+	for ( i = 0 ; i < numfiles ; i++ ) {
+		Q_strncpyz( scans[i].zipfile, FS_BuildOSPath( path, dir, sorted[i] ), sizeof( scans[i].zipfile ) );
+		scans[i].basename = sorted[i];
+	}
+	Com_ParallelFor( numfiles, FS_ScanZipFile, scans );
+
 	for ( i = 0 ; i < numfiles ; i++ ) {
-		pakfile = FS_BuildOSPath( path, dir, sorted[i] );
-		if ( ( pak = FS_LoadZipFile( pakfile, sorted[i] ) ) == 0 )
+		if ( ( pak = FS_LoadZipFile( &scans[i] ) ) == 0 )
 			continue;
 		// store the game name for downloading
 		strcpy(pak->pakGamename, dir);
@@ -2570,6 +3516,7 @@ static void FS_AddGameDirectory( const char *path, const char *dir ) {
 	}
 
 	// done
+	Z_Free( scans );
 	Sys_FreeFileList( pakfiles );
 
 // @pjb: if we're prioritizing loose files, we want to add the directory at the end
@@ -2719,6 +3666,9 @@ void FS_Shutdown( qboolean closemfp ) {
 	searchpath_t	*p, *next;
 	int	i;
 
+	// loads may still be reading from the mapped paks
+	FS_FinishAsyncLoads();
+
 	for(i = 0; i < MAX_FILE_HANDLES; i++) {
 		if (fsh[i].fileSize) {
 			FS_FCloseFile(i);
@@ -2730,6 +3680,9 @@ void FS_Shutdown( qboolean closemfp ) {
 		next = p->next;
 
 		if ( p->pack ) {
+			if ( p->pack->mapping ) {
+				Sys_UnmapFile( p->pack->mapping, p->pack->mappingSize );
+			}
 			unzClose(p->pack->handle);
 			Z_Free( p->pack->buildBuffer );
 			Z_Free( p->pack );
@@ -2740,6 +3693,8 @@ void FS_Shutdown( qboolean closemfp ) {
 		Z_Free( p );
 	}
 
+	FS_FreeFileIndex();
+
 	// any FS_ calls will now be an error until reinitialized
 	fs_searchpaths = NULL;
 
@@ -2811,6 +3766,9 @@ static void FS_Startup( const char *gameName ) {
 	Com_Printf( "----- FS_Startup -----\n" );
 
 	fs_debug = Cvar_Get( "fs_debug", "0", 0 );
+	// a 32 bit address space can't take every pk3 mapped whole
+	fs_mapPaks = Cvar_Get( "fs_mapPaks", sizeof( void * ) > 4 ? "1" : "0", CVAR_INIT );
+	fs_loadThreads = Cvar_Get( "fs_loadThreads", "2", CVAR_ARCHIVE );
 	fs_copyfiles = Cvar_Get( "fs_copyfiles", "0", CVAR_INIT );
 	fs_cdpath = Cvar_Get ("fs_cdpath", Sys_DefaultCDPath(), CVAR_INIT );
 	fs_basepath = Cvar_Get ("fs_basepath", Sys_DefaultInstallPath(), CVAR_INIT );
@@ -2908,6 +3866,8 @@ static void FS_Startup( const char *gameName ) {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=506
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
+
+	FS_BuildFileIndex();
 	
 	// print the current search paths
 	FS_Path_f();
@@ -3433,6 +4393,7 @@ restart if necessary
 =================
 */
 qboolean FS_ConditionalRestart( int checksumFeed ) {
+	FS_ClearDirMisses();
 	if( fs_gamedirvar->modified || checksumFeed != fs_checksumFeed ) {
 		FS_Restart( checksumFeed );
 		return qtrue;
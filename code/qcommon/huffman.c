@@ -29,25 +29,67 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 static int			bloc = 0;
 
+// the offset versions don't touch bloc, so snapshots can be
+// encoded on several threads against the shared message tree
 void	Huff_putBit( int bit, byte *fout, int *offset) {
-	bloc = *offset;
-	if ((bloc&7) == 0) {
-		fout[(bloc>>3)] = 0;
+	int		b;
+
+	b = *offset;
+	if ((b&7) == 0) {
+		fout[(b>>3)] = 0;
 	}
-	fout[(bloc>>3)] |= bit << (bloc&7);
-	bloc++;
-	*offset = bloc;
+	fout[(b>>3)] |= bit << (b&7);
+	*offset = b + 1;
 }
 
 int		Huff_getBit( byte *fin, int *offset) {
 	int t;
-	bloc = *offset;
-	t = (fin[(bloc>>3)] >> (bloc&7)) & 0x1;
-	bloc++;
-	*offset = bloc;
+	int b;
+
+	b = *offset;
+	t = (fin[(b>>3)] >> (b&7)) & 0x1;
+	*offset = b + 1;
 	return t;
 }
 
+// writes the low count bits of bits, first bit lowest, leaving the
+// buffer exactly as count calls to Huff_putBit would
+void	Huff_putBits( huffBits_t bits, int count, byte *fout, int *offset ) {
+	int		b;
+	int		room;
+
+	b = *offset;
+	if ( count <= 0 ) {
+		return;
+	}
+
+	if ( b & 7 ) {
+		fout[(b>>3)] |= (byte)( bits << (b&7) );
+		room = 8 - (b&7);
+		if ( count <= room ) {
+			*offset = b + count;
+			return;
+		}
+		bits >>= room;
+		count -= room;
+		b += room;
+	}
+
+	// whole bytes, and a last partial one with its high bits cleared
+	while ( count > 0 ) {
+		fout[(b>>3)] = (byte)bits;
+		bits >>= 8;
+		if ( count >= 8 ) {
+			b += 8;
+			count -= 8;
+		} else {
+			b += count;
+			count = 0;
+		}
+	}
+	*offset = b;
+}
+
 /* Add a bit to the output file (buffered) */
 static void add_bit (char bit, byte *fout) {
 	if ((bloc&7) == 0) {
@@ -315,10 +357,95 @@ void Huff_transmit (huff_t *huff, int ch, byte *fout) {
 	}
 }
 
+/* Send the prefix code for this node at *offset */
+static void offsetSend(node_t *node, node_t *child, byte *fout, int *offset) {
+	if (node->parent) {
+		offsetSend(node->parent, node, fout, offset);
+	}
+	if (child) {
+		Huff_putBit( node->right == child, fout, offset );
+	}
+}
+
 void Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset) {
-	bloc = *offset;
-	send(huff->loc[ch], NULL, fout);
-	*offset = bloc;
+	offsetSend(huff->loc[ch], NULL, fout, offset);
+}
+
+/*
+Flattens a tree that won't be updated again into a code per symbol and
+a lookup on the next HUFF_LOOKUP_BITS bits of input, so sending and
+receiving don't have to walk the tree one bit at a time.
+*/
+void Huff_BuildTable( huff_t *huff, huffTable_t *table ) {
+	int			i, ch, length;
+	unsigned	code;
+	node_t		*node;
+
+	Com_Memset( table, 0, sizeof( *table ) );
+	table->tree = huff->tree;
+
+	for ( ch = 0; ch < HMAX; ch++ ) {
+		code = 0;
+		length = 0;
+		// the root's bit goes out first, so it ends up lowest
+		for ( node = huff->loc[ch]; node && node->parent; node = node->parent ) {
+			code = ( code << 1 ) | ( node->parent->right == node );
+			length++;
+		}
+		if ( !huff->loc[ch] || length > 32 ) {
+			continue;
+		}
+		table->code[ch] = code;
+		table->length[ch] = length;
+	}
+
+	for ( i = 0; i < HUFF_LOOKUP_SIZE; i++ ) {
+		node = huff->tree;
+		for ( length = 0; length < HUFF_LOOKUP_BITS && node && node->symbol == INTERNAL_NODE; length++ ) {
+			if ( ( i >> length ) & 1 ) {
+				node = node->right;
+			} else {
+				node = node->left;
+			}
+		}
+		table->lookup[i].node = node;
+		table->lookup[i].bits = length;
+	}
+}
+
+/* Get a symbol, HUFF_LOOKUP_BITS at a time */
+void Huff_tableReceive( const huffTable_t *table, int *ch, byte *fin, int *offset, int size ) {
+	int			b;
+	unsigned	window;
+	node_t		*node;
+
+	b = *offset;
+
+	// the lookup reads up to three bytes, which may be past the end
+	// of a short message but must stay inside the buffer
+	if ( ( b >> 3 ) + 2 >= size || !table->tree ) {
+		Huff_offsetReceive( table->tree, ch, fin, offset );
+		return;
+	}
+
+	window = ( fin[(b>>3)] | ( fin[(b>>3)+1] << 8 ) | ( fin[(b>>3)+2] << 16 ) ) >> (b&7);
+	node = table->lookup[ window & ( HUFF_LOOKUP_SIZE - 1 ) ].node;
+	b += table->lookup[ window & ( HUFF_LOOKUP_SIZE - 1 ) ].bits;
+
+	// codes longer than the lookup finish the walk a bit at a time
+	while ( node && node->symbol == INTERNAL_NODE ) {
+		if ( Huff_getBit( fin, &b ) ) {
+			node = node->right;
+		} else {
+			node = node->left;
+		}
+	}
+	if ( !node ) {
+		*ch = 0;
+		return;
+	}
+	*ch = node->symbol;
+	*offset = b;
 }
 
 void Huff_Decompress(msg_t *mbuf, int offset) {
@@ -373,7 +500,7 @@ void Huff_Decompress(msg_t *mbuf, int offset) {
 	Com_Memcpy(mbuf->data + offset, seq, cch);
 }
 
-extern 	int oldsize;
+extern 	THREAD_LOCAL int oldsize;
 
 void Huff_Compress(msg_t *mbuf, int offset) {
 	int			i, ch, size;
@@ -0,0 +1,215 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// jobs.c -- a small pool of worker threads for embarrassingly parallel work
+
+#include "../game/q_shared.h"
+#include "qcommon.h"
+
+/*
+=============================================================================
+
+The main thread hands out one batch at a time through Com_ParallelFor and
+works on it along with the pool, so a batch never waits on a sleeping
+thread to make progress.  Indices are claimed with an atomic counter, so
+it doesn't matter how uneven the jobs are.
+
+With com_jobThreads 0 every batch runs in order on the calling thread.
+
+=============================================================================
+*/
+
+typedef struct {
+	int				numThreads;
+	void			*wake;			// posted once per thread that should join a batch
+	void			*done;			// posted by each thread when it is out of work
+	volatile int	quit;
+
+	qboolean		active;			// a batch is running, nested batches run serially
+	jobFunc_t		func;
+	void			*data;
+	int				count;
+	volatile int	next;			// next index to claim
+} jobPool_t;
+
+static jobPool_t	jobs;
+
+static cvar_t	*com_jobThreads;
+
+/*
+=================
+Com_RunJobs
+
+Claims and runs indices until the batch is exhausted
+=================
+*/
+static void Com_RunJobs( void ) {
+	int		index;
+
+	while ( 1 ) {
+		index = Sys_AtomicAdd( &jobs.next, 1 ) - 1;
+		if ( index >= jobs.count ) {
+			break;
+		}
+		jobs.func( index, jobs.data );
+	}
+}
+
+/*
+=================
+Com_JobThread
+=================
+*/
+static void Com_JobThread( void *data ) {
+	while ( 1 ) {
+		Sys_SemaphoreWait( jobs.wake );
+		if ( jobs.quit ) {
+			break;
+		}
+		Com_RunJobs();
+		Sys_SemaphorePost( jobs.done, 1 );
+	}
+	Sys_SemaphorePost( jobs.done, 1 );
+}
+
+/*
+=================
+Com_ParallelFor
+=================
+*/
+void Com_ParallelFor( int count, jobFunc_t func, void *data ) {
+	int		i;
+	int		helpers;
+
+	if ( count <= 0 ) {
+		return;
+	}
+
+	if ( !jobs.numThreads || jobs.active || count == 1 ) {
+		for ( i = 0 ; i < count ; i++ ) {
+			func( i, data );
+		}
+		return;
+	}
+
+	helpers = jobs.numThreads;
+	if ( helpers > count - 1 ) {
+		helpers = count - 1;
+	}
+
+	jobs.active = qtrue;
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	jobs.next = 0;
+
+	// posting the semaphore publishes the batch to the threads
+	Sys_SemaphorePost( jobs.wake, helpers );
+
+	Com_RunJobs();
+
+	for ( i = 0 ; i < helpers ; i++ ) {
+		Sys_SemaphoreWait( jobs.done );
+	}
+
+	jobs.active = qfalse;
+}
+
+/*
+=================
+Com_JobThreads
+
+Returns the number of threads helping the caller
+=================
+*/
+int Com_JobThreads( void ) {
+	return jobs.numThreads;
+}
+
+/*
+=================
+Com_InitJobs
+=================
+*/
+void Com_InitJobs( void ) {
+	int		count;
+
+	count = Sys_ProcessorCount() - 1;
+	if ( count > MAX_JOB_THREADS ) {
+		count = MAX_JOB_THREADS;
+	}
+	com_jobThreads = Cvar_Get( "com_jobThreads", va( "%i", count ), CVAR_ARCHIVE | CVAR_LATCH );
+
+	count = com_jobThreads->integer;
+	if ( count < 0 ) {
+		count = 0;
+	} else if ( count > MAX_JOB_THREADS ) {
+		count = MAX_JOB_THREADS;
+	}
+	if ( !count ) {
+		return;
+	}
+
+	jobs.wake = Sys_CreateSemaphore( 0 );
+	jobs.done = Sys_CreateSemaphore( 0 );
+	if ( !jobs.wake || !jobs.done ) {
+		Com_Printf( "WARNING: couldn't create job semaphores\n" );
+		Com_ShutdownJobs();
+		return;
+	}
+
+	jobs.quit = qfalse;
+	for ( jobs.numThreads = 0 ; jobs.numThreads < count ; jobs.numThreads++ ) {
+		if ( !Sys_CreateThread( Com_JobThread, NULL ) ) {
+			Com_Printf( "WARNING: couldn't create job thread %i\n", jobs.numThreads );
+			break;
+		}
+	}
+
+	Com_Printf( "%i job threads\n", jobs.numThreads );
+}
+
+/*
+=================
+Com_ShutdownJobs
+=================
+*/
+void Com_ShutdownJobs( void ) {
+	int		i;
+
+	if ( jobs.numThreads ) {
+		jobs.quit = qtrue;
+		Sys_SemaphorePost( jobs.wake, jobs.numThreads );
+		for ( i = 0 ; i < jobs.numThreads ; i++ ) {
+			Sys_SemaphoreWait( jobs.done );
+		}
+		jobs.numThreads = 0;
+	}
+
+	if ( jobs.wake ) {
+		Sys_DestroySemaphore( jobs.wake );
+		jobs.wake = NULL;
+	}
+	if ( jobs.done ) {
+		Sys_DestroySemaphore( jobs.done );
+		jobs.done = NULL;
+	}
+}
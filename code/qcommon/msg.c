@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qcommon.h"
 
 static huffman_t		msgHuff;
+static huffTable_t		msgHuffTable;	// msgHuff flattened, it doesn't change after init
 
 static qboolean			msgInit = qfalse;
 
@@ -37,7 +38,8 @@ Handles byte ordering and avoids alignment errors
 ==============================================================================
 */
 
-int oldsize = 0;
+// per thread, the snapshot jobs write messages in parallel
+THREAD_LOCAL int oldsize = 0;
 
 void MSG_initHuffman();
 
@@ -101,11 +103,14 @@ bit functions
 =============================================================================
 */
 
-int	overflows;
+THREAD_LOCAL int	overflows;
 
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	int	i;
+	int			sym;
+	huffBits_t	acc;
+	int			accBits;
 //	FILE*	fp;
 
 	oldsize += bits;
@@ -160,27 +165,69 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 	} else {
 //		fp = fopen("c:\\netchan.bin", "a");
 		value &= (0xffffffff>>(32-bits));
+		// gather the raw bits and the codes, and write them out in one go
+		acc = 0;
+		accBits = 0;
 		if (bits&7) {
 			int nbits;
 			nbits = bits&7;
-			for(i=0;i<nbits;i++) {
-				Huff_putBit((value&1), msg->data, &msg->bit);
-				value = (value>>1);
-			}
+			acc = value & ( ( 1 << nbits ) - 1 );
+			accBits = nbits;
+			value = (value>>nbits);
 			bits = bits - nbits;
 		}
 		if (bits) {
 			for(i=0;i<bits;i+=8) {
 //				fwrite(bp, 1, 1, fp);
-				Huff_offsetTransmit (&msgHuff.compressor, (value&0xff), msg->data, &msg->bit);
+				sym = value & 0xff;
+				if ( accBits + msgHuffTable.length[sym] > 64 || !msgHuffTable.length[sym] ) {
+					Huff_putBits( acc, accBits, msg->data, &msg->bit );
+					acc = 0;
+					accBits = 0;
+					if ( !msgHuffTable.length[sym] ) {
+						Huff_offsetTransmit (&msgHuff.compressor, sym, msg->data, &msg->bit);
+						value = (value>>8);
+						continue;
+					}
+				}
+				acc |= (huffBits_t)msgHuffTable.code[sym] << accBits;
+				accBits += msgHuffTable.length[sym];
 				value = (value>>8);
 			}
 		}
+		Huff_putBits( acc, accBits, msg->data, &msg->bit );
 		msg->cursize = (msg->bit>>3)+1;
 //		fclose(fp);
 	}
 }
 
+// appends bits that were already written to another message from bit 0,
+// the output doesn't depend on alignment so they can be copied as is
+void MSG_WriteEncodedBits( msg_t *msg, const byte *data, int bits ) {
+	huffBits_t	chunk;
+	int			i, j, n;
+
+	// this isn't an exact overflow check, but close enough
+	if ( ( ( msg->bit + bits ) >> 3 ) + 4 > msg->maxsize ) {
+		msg->overflowed = qtrue;
+		return;
+	}
+
+	for ( i = 0 ; i < bits ; i += 56 ) {
+		n = bits - i;
+		if ( n > 56 ) {
+			n = 56;
+		}
+		chunk = 0;
+		for ( j = ( n + 7 ) >> 3 ; j > 0 ; j-- ) {
+			chunk = ( chunk << 8 ) | data[ ( i >> 3 ) + j - 1 ];
+		}
+		chunk &= ( (huffBits_t)1 << n ) - 1;
+		Huff_putBits( chunk, n, msg->data, &msg->bit );
+	}
+	msg->cursize = (msg->bit>>3)+1;
+}
+
 int MSG_ReadBits( msg_t *msg, int bits ) {
 	int			value;
 	int			get;
@@ -227,7 +274,7 @@ int MSG_ReadBits( msg_t *msg, int bits ) {
 		if (bits) {
 //			fp = fopen("c:\\netchan.bin", "a");
 			for(i=0;i<bits;i+=8) {
-				Huff_offsetReceive (msgHuff.decompressor.tree, &get, msg->data, &msg->bit);
+				Huff_tableReceive (&msgHuffTable, &get, msg->data, &msg->bit, msg->maxsize);
 //				fwrite(&get, 1, 1, fp);
 				value |= (get<<(i+nbits));
 			}
@@ -1717,6 +1764,8 @@ void MSG_initHuffman() {
 			Huff_addRef(&msgHuff.decompressor,	(byte)i);			// Do update
 		}
 	}
+	// both trees were built the same way, so one table serves both
+	Huff_BuildTable(&msgHuff.compressor, &msgHuffTable);
 }
 
 /*
@@ -57,6 +57,7 @@ to the new value before sending out any replies.
 cvar_t		*showpackets;
 cvar_t		*showdrop;
 cvar_t		*qport;
+cvar_t		*net_batchSend;
 
 static char *netsrcString[2] = {
 	"client",
@@ -74,6 +75,7 @@ void Netchan_Init( int port ) {
 	showpackets = Cvar_Get ("showpackets", "0", CVAR_TEMP );
 	showdrop = Cvar_Get ("showdrop", "0", CVAR_TEMP );
 	qport = Cvar_Get ("net_qport", va("%i", port), CVAR_INIT );
+	net_batchSend = Cvar_Get ("net_batchSend", "1", 0 );
 }
 
 /*
@@ -613,6 +615,68 @@ void NET_SendLoopPacket (netsrc_t sock, int length, const void *data, netadr_t t
 	loop->msgs[i].datalen = length;
 }
 
+/*
+=============================================================================
+
+OUTBOUND PACKET QUEUE
+
+With net_batchSend, server packets are held here through the frame and
+handed to the system all at once by NET_FlushPackets, at the end of
+SV_Frame and of every Com_Frame.  Client packets still go straight out.
+
+=============================================================================
+*/
+
+#define	MAX_QUEUED_PACKETS		256
+#define	QUEUED_PACKET_BYTES		0x40000
+
+static sysPacket_t	net_queuedPackets[MAX_QUEUED_PACKETS];
+static int			net_numQueuedPackets;
+static byte			net_queuedData[QUEUED_PACKET_BYTES];
+static int			net_queuedBytes;
+
+/*
+==================
+NET_FlushPackets
+==================
+*/
+void NET_FlushPackets( void ) {
+	if ( !net_numQueuedPackets ) {
+		return;
+	}
+
+	Sys_SendPackets( net_queuedPackets, net_numQueuedPackets );
+
+	net_numQueuedPackets = 0;
+	net_queuedBytes = 0;
+}
+
+/*
+==================
+NET_QueueSendPacket
+==================
+*/
+static void NET_QueueSendPacket( int length, const void *data, netadr_t to ) {
+	sysPacket_t	*packet;
+
+	if ( length > QUEUED_PACKET_BYTES ) {
+		NET_FlushPackets();
+		Sys_SendPacket( length, data, to );
+		return;
+	}
+
+	if ( net_numQueuedPackets == MAX_QUEUED_PACKETS || net_queuedBytes + length > QUEUED_PACKET_BYTES ) {
+		NET_FlushPackets();
+	}
+
+	packet = &net_queuedPackets[net_numQueuedPackets++];
+	packet->to = to;
+	packet->length = length;
+	packet->data = net_queuedData + net_queuedBytes;
+	Com_Memcpy( net_queuedData + net_queuedBytes, data, length );
+	net_queuedBytes += length;
+}
+
 //=============================================================================
 
 
@@ -634,6 +698,13 @@ void NET_SendPacket( netsrc_t sock, int length, const void *data, netadr_t to )
 		return;
 	}
 
+	if ( sock == NS_SERVER && net_batchSend && net_batchSend->integer ) {
+		NET_QueueSendPacket( length, data, to );
+		return;
+	}
+
+	// keep the order if batching was just turned off
+	NET_FlushPackets();
 	Sys_SendPacket( length, data, to );
 }
 
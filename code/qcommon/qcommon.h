@@ -60,6 +60,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits( msg_t *msg, int value, int bits );
+void MSG_WriteEncodedBits( msg_t *msg, const byte *data, int bits );
 
 void MSG_WriteChar (msg_t *sb, int c);
 void MSG_WriteByte (msg_t *sb, int c);
@@ -154,6 +155,7 @@ void		NET_Restart( void );
 void		NET_Config( qboolean enableNetworking );
 
 void		NET_SendPacket (netsrc_t sock, int length, const void *data, netadr_t to);
+void		NET_FlushPackets( void );
 void		QDECL NET_OutOfBandPrint( netsrc_t net_socket, netadr_t adr, const char *format, ...);
 void		QDECL NET_OutOfBandData( netsrc_t sock, netadr_t adr, byte *format, int len );
 
@@ -321,9 +323,12 @@ vm_t	*VM_Restart( vm_t *vm );
 int		QDECL VM_Call( vm_t *vm, int callNum, ... );
 
 void	VM_Debug( int level );
+qboolean	VM_IsNative( vm_t *vm );
 
 void	*VM_ArgPtr( size_t intValue );
 void	*VM_ExplicitArgPtr( vm_t *vm, size_t intValue );
+void	VM_CheckBlock( vm_t *vm, size_t intValue, int size, const char *name );
+// Com_Errors if size bytes at a pointer argument leave the vm data segment
 
 /*
 ==============================================================
@@ -525,6 +530,10 @@ qboolean	FS_ConditionalRestart( int checksumFeed );
 void	FS_Restart( int checksumFeed );
 // shutdown and restart the filesystem so changes to fs_gamedir can take effect
 
+void	FS_ClearDirMisses( void );
+// forgets which files the directories were found not to have, so files
+// copied in while running are seen by the next lookup
+
 char	**FS_ListFiles( const char *directory, const char *extension, int *numfiles );
 // directory should not have either a leading or trailing /
 // if extension is "/", only subdirectories will be returned
@@ -573,6 +582,36 @@ int		FS_ReadFile( const char *qpath, void **buffer );
 // the buffer should be considered read-only, because it may be cached
 // for other uses.
 
+int		FS_ReadFileDirect( const char *qpath, void **buffer );
+// like FS_ReadFile, but a file stored uncompressed in a mapped pk3 comes
+// back as a pointer straight into the pk3.  That buffer is strictly
+// read-only and has no trailing 0.  Free it with FS_FreeFile as usual.
+
+typedef enum {
+	FS_LOAD_LOW,
+	FS_LOAD_NORMAL,
+	FS_LOAD_HIGH,
+
+	FS_LOAD_PRIORITIES
+} fsLoadPriority_t;
+
+typedef void (*fsLoadCallback_t)( const char *qpath, void *buffer, int length, void *data );
+
+int		FS_ReadFileAsync( const char *qpath, fsLoadPriority_t priority, fsLoadCallback_t callback, void *data );
+// finds the file now and reads it on the I/O threads.  Returns the length,
+// or -1 without ever calling back if the file isn't present.  The callback
+// runs on the main thread from FS_RunAsyncLoads or FS_FinishAsyncLoads and
+// owns the buffer, which has a trailing 0 and is freed with
+// FS_FreeAsyncFile.  A read error calls back with a NULL buffer and -1.
+
+void	FS_RunAsyncLoads( void );
+// starts queued loads and calls back finished ones, once a frame
+
+void	FS_FinishAsyncLoads( void );
+// blocks until every submitted load has called back
+
+void	FS_FreeAsyncFile( void *buffer );
+
 void	FS_ForceFlush( fileHandle_t f );
 // forces flush on files we're writing to.
 
@@ -804,6 +843,19 @@ size_t	Hunk_MemoryRemaining( void );
 void Hunk_Log( void);
 void Hunk_Trash( void );
 
+// per thread scratch memory that is thrown away at the start of each
+// frame, for the main thread and the job threads
+typedef struct {
+	int		used;
+	void	*overflow;
+} frameMark_t;
+
+void Hunk_InitFrameArenas( void );
+void Hunk_ClearFrameArenas( void );
+void *Hunk_FrameAlloc( int size );		// NOT 0 filled memory
+frameMark_t Hunk_FrameMark( void );
+void Hunk_FrameRelease( frameMark_t mark );	// frees this thread's allocations since the mark
+
 void Com_TouchMemory( void );
 
 // commandLine should not include the executable name (argv[0])
@@ -811,6 +863,45 @@ void Com_Init( char *commandLine );
 void Com_Frame( void );
 void Com_Shutdown( void );
 
+/*
+==============================================================
+
+JOB THREADS
+
+==============================================================
+*/
+
+#define	MAX_JOB_THREADS		16
+
+typedef void (*jobFunc_t)( int index, void *data );
+
+void		Com_InitJobs( void );
+void		Com_ShutdownJobs( void );
+int			Com_JobThreads( void );
+
+void		Com_ParallelFor( int count, jobFunc_t func, void *data );
+// calls func( i, data ) for every i in [0, count), spread over the job
+// threads and the caller, and returns when all of them have finished.
+// jobs must only write to their own slot of data and must not print,
+// error or call into the filesystem, cvars or the zone allocator.
+// Hunk_FrameAlloc is safe to use from jobs.
+
+void		Com_CatchErrors( void *frame );
+// while a jmp_buf is set for the calling thread, Com_Error longjmps to it
+// instead of aborting the frame, for jobs that can run into errors.
+// Com_CaughtError returns the message and code of the last caught error.
+const char	*Com_CaughtError( int *code );
+
+void		Com_HoldPrints( qboolean hold );
+// keeps the prints of the calling thread back until it stops holding
+// them, for code that may print while other threads are running.
+
+#ifdef _MSC_VER
+#define	THREAD_LOCAL	__declspec( thread )
+#else
+#define	THREAD_LOCAL	__thread
+#endif
+
 
 /*
 ==============================================================
@@ -985,6 +1076,15 @@ void	Sys_SetErrorText( const char *text );
 
 void	Sys_SendPacket( int length, const void *data, netadr_t to );
 
+typedef struct {
+	netadr_t	to;
+	int			length;
+	const void	*data;
+} sysPacket_t;
+
+// sends all of them, in order, with as few system calls as the platform allows
+void	Sys_SendPackets( const sysPacket_t *packets, int count );
+
 qboolean	Sys_StringToAdr( const char *s, netadr_t *a );
 //Does NOT parse port numbers, only base addresses.
 
@@ -1011,12 +1111,24 @@ char	*Sys_DefaultHomePath(void);
 char **Sys_ListFiles( const char *directory, const char *extension, char *filter, int *numfiles, qboolean wantsubs );
 void	Sys_FreeFileList( char **list );
 
+// read-only view of a whole file, NULL if it can't be mapped
+void	*Sys_MapFile( const char *ospath, int *length );
+void	Sys_UnmapFile( void *data, int length );
+
 void	Sys_BeginProfiling( void );
 void	Sys_EndProfiling( void );
 
 qboolean Sys_LowPhysicalMemory();
 unsigned int Sys_ProcessorCount();
 
+// threads for the job system, they are never joined
+qboolean	Sys_CreateThread( void (*function)( void *data ), void *data );
+void		*Sys_CreateSemaphore( int initialCount );
+void		Sys_DestroySemaphore( void *sem );
+void		Sys_SemaphoreWait( void *sem );
+void		Sys_SemaphorePost( void *sem, int count );
+int			Sys_AtomicAdd( volatile int *value, int add );	// returns the new value
+
 int Sys_MonkeyShouldBeSpanked( void );
 
 /* This is based on the Adaptive Huffman algorithm described in Sayood's Data
@@ -1055,6 +1167,29 @@ typedef struct {
 	huff_t		decompressor;
 } huffman_t;
 
+// a tree that is no longer updated can be flattened into tables,
+// codes are stored in transmit order with the first bit lowest
+#define	HUFF_LOOKUP_BITS	11
+#define	HUFF_LOOKUP_SIZE	( 1 << HUFF_LOOKUP_BITS )
+
+#ifdef _MSC_VER
+typedef unsigned __int64	huffBits_t;
+#else
+typedef unsigned long long	huffBits_t;
+#endif
+
+typedef struct {
+	node_t		*node;		// leaf, or where to carry on down the tree
+	int			bits;		// bits of the lookup consumed to get to node
+} huffLookup_t;
+
+typedef struct {
+	node_t		*tree;
+	unsigned	code[HMAX];
+	int			length[HMAX];	// 0 if the symbol isn't in the tree
+	huffLookup_t	lookup[HUFF_LOOKUP_SIZE];
+} huffTable_t;
+
 void	Huff_Compress(msg_t *buf, int offset);
 void	Huff_Decompress(msg_t *buf, int offset);
 void	Huff_Init(huffman_t *huff);
@@ -1065,6 +1200,9 @@ void	Huff_offsetReceive (node_t *node, int *ch, byte *fin, int *offset);
 void	Huff_offsetTransmit (huff_t *huff, int ch, byte *fout, int *offset);
 void	Huff_putBit( int bit, byte *fout, int *offset);
 int		Huff_getBit( byte *fout, int *offset);
+void	Huff_putBits( huffBits_t bits, int count, byte *fout, int *offset );
+void	Huff_BuildTable( huff_t *huff, huffTable_t *table );
+void	Huff_tableReceive( const huffTable_t *table, int *ch, byte *fin, int *offset, int size );
 
 extern huffman_t clientHuffTables;
 
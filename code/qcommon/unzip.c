@@ -2082,6 +2082,53 @@ extern int unzReadCurrentFile  (unzFile file, void *buf, unsigned len)
 }
 
 
+/*
+  inflate state for unzInflateBuffer comes from the C heap rather than the
+  zone, so the function can be called from other threads
+*/
+static voidp unzHeapAlloc (voidp opaque, unsigned items, unsigned size)
+{
+	return malloc(items * size);
+}
+
+static void unzHeapFree (voidp opaque, voidp ptr)
+{
+	free(ptr);
+}
+
+/*
+  Inflate a whole file that is already in memory.
+  src is the raw deflated data of the file, without any header.
+  return UNZ_OK if exactly destLen bytes came out
+*/
+extern int unzInflateBuffer (const void* src, unsigned srcLen, void* dest, unsigned destLen)
+{
+	z_stream stream;
+	int err;
+
+	Com_Memset(&stream, 0, sizeof(stream));
+	stream.zalloc = (alloc_func)unzHeapAlloc;
+	stream.zfree = (free_func)unzHeapFree;
+	err=inflateInit2(&stream, -MAX_WBITS);
+	if (err!=Z_OK)
+		return UNZ_INTERNALERROR;
+
+	stream.next_in = (unsigned char*)src;
+	stream.avail_in = (uInt)srcLen;
+	stream.next_out = (unsigned char*)dest;
+	stream.avail_out = (uInt)destLen;
+
+	err=inflate(&stream, Z_SYNC_FLUSH);
+	inflateEnd(&stream);
+
+	if (err!=Z_OK && err!=Z_STREAM_END)
+		return err;
+	if (stream.total_out!=destLen)
+		return UNZ_BADZIPFILE;
+	return UNZ_OK;
+}
+
+
 /*
   Give the current position in uncompressed data
 */
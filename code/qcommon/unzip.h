@@ -308,6 +308,14 @@ extern int unzReadCurrentFile (unzFile file, void* buf, unsigned len);
     (UNZ_ERRNO for IO error, or zLib error for uncompress error)
 */
 
+extern int unzInflateBuffer (const void* src, unsigned srcLen, void* dest, unsigned destLen);
+
+/*
+  Inflate a whole file that is already in memory, src being its raw
+  deflated data.  Needs no open zip file.
+  return UNZ_OK if exactly destLen unsigned chars came out
+*/
+
 extern long unztell(unzFile file);
 
 /*
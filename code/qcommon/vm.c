@@ -33,8 +33,6 @@ and one exported function: Perform
 
 */
 
-#define VM_ONLY_LOAD_DLLS 1
-
 #include "vm_local.h"
 
 
@@ -66,9 +64,10 @@ VM_Init
 ==============
 */
 void VM_Init( void ) {
-	Cvar_Get( "vm_cgame", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
-	Cvar_Get( "vm_game", "2", CVAR_ARCHIVE );	// !@# SHIP WITH SET TO 2
-	Cvar_Get( "vm_ui", "2", CVAR_ARCHIVE );		// !@# SHIP WITH SET TO 2
+	// native modules first, falling back to compiled qvms
+	Cvar_Get( "vm_cgame", "0", CVAR_ARCHIVE );
+	Cvar_Get( "vm_game", "0", CVAR_ARCHIVE );
+	Cvar_Get( "vm_ui", "0", CVAR_ARCHIVE );
 
 	Cmd_AddCommand ("vmprofile", VM_VmProfile_f );
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f );
@@ -323,13 +322,18 @@ Dlls will call this directly
 
   For speed, we just grab 15 arguments, and don't worry about exactly
    how many the syscall actually needs; the extra is thrown away.
+
+  The System V x86-64 ABI has the same problem as PowerPC: variadic
+   arguments travel in registers, so the address of the first one says
+   nothing about where the rest are. Win64 spills them to the home area
+   contiguously, which is why the original code works there.
  
 ============
 */
 int QDECL VM_DllSyscall( size_t arg, ... ) {
-#if ((defined __linux__) && (defined __powerpc__))
+#if ((defined __linux__) && (defined __powerpc__)) || ((defined __x86_64__) && !(defined _WIN32))
   // rcg010206 - see commentary above
-  int args[16];
+  size_t args[16];
   int i;
   va_list ap;
   
@@ -337,7 +341,7 @@ int QDECL VM_DllSyscall( size_t arg, ... ) {
   
   va_start(ap, arg);
   for (i = 1; i < sizeof (args) / sizeof (args[i]); i++)
-    args[i] = va_arg(ap, int);
+    args[i] = va_arg(ap, size_t);
   va_end(ap);
   
   return currentVM->systemCall( args );
@@ -437,12 +441,10 @@ it will attempt to load as a system dll
 vm_t *VM_Create( const char *module, int (*systemCalls)(size_t *), 
 				vmInterpret_t interpret ) {
 	vm_t		*vm;
-#if !VM_ONLY_LOAD_DLLS
 	vmHeader_t	*header;
 	int			length;
 	int			dataLength;
 	char		filename[MAX_QPATH];
-#endif
 	int			i, remaining;
 
 	if ( !module || !module[0] || !systemCalls ) {
@@ -475,17 +477,6 @@ vm_t *VM_Create( const char *module, int (*systemCalls)(size_t *),
 	Q_strncpyz( vm->name, module, sizeof( vm->name ) );
 	vm->systemCall = systemCalls;
 
-// @pjb: Force loading of DLLs until we get an X64 build of the QVM compiler and VM.
-#if VM_ONLY_LOAD_DLLS
-	Com_Printf( "Loading dll file %s.\n", vm->name );
-	vm->dllHandle = Sys_LoadDll( module, vm->fqpath , &vm->entryPoint, VM_DllSyscall );
-	if ( vm->dllHandle ) {
-		return vm;
-	}
-    
-	Com_Printf( "Failed.\n" );
-	return NULL;
-#else
 	// never allow dll loading with a demo
 	if ( interpret == VMI_NATIVE ) {
 		if ( Cvar_VariableValue( "fs_restrict" ) ) {
@@ -505,6 +496,12 @@ vm_t *VM_Create( const char *module, int (*systemCalls)(size_t *),
 		interpret = VMI_COMPILED;
 	}
 
+#ifndef VM_HAS_COMPILER
+	if ( interpret == VMI_COMPILED ) {
+		interpret = VMI_BYTECODE;
+	}
+#endif
+
 	// load the image
 	Com_sprintf( filename, sizeof(filename), "vm/%s.qvm", vm->name );
 	Com_Printf( "Loading vm file %s.\n", filename );
@@ -553,6 +550,11 @@ vm_t *VM_Create( const char *module, int (*systemCalls)(size_t *),
 	vm->instructionPointersLength = header->instructionCount * 4;
 	vm->instructionPointers = Hunk_Alloc( vm->instructionPointersLength, h_high );
 
+	// the stack is implicitly at the end of the image, the compiler
+	// bakes stackBottom into the generated code
+	vm->programStack = vm->dataMask + 1;
+	vm->stackBottom = vm->programStack - STACK_SIZE;
+
 	// copy or compile the instructions
 	vm->codeLength = header->codeLength;
 
@@ -570,14 +572,9 @@ vm_t *VM_Create( const char *module, int (*systemCalls)(size_t *),
 	// load the map file
 	VM_LoadSymbols( vm );
 
-	// the stack is implicitly at the end of the image
-	vm->programStack = vm->dataMask + 1;
-	vm->stackBottom = vm->programStack - STACK_SIZE;
-
 	Com_Printf("%s loaded in %d bytes on the hunk\n", module, remaining - Hunk_MemoryRemaining());
 
 	return vm;
-#endif
 }
 
 /*
@@ -587,6 +584,9 @@ VM_Free
 */
 void VM_Free( vm_t *vm ) {
 
+	if ( vm->destroy ) {
+		vm->destroy( vm );
+	}
 	if ( vm->dllHandle ) {
 		Sys_UnloadDll( vm->dllHandle );
 		Com_Memset( vm, 0, sizeof( *vm ) );
@@ -611,6 +611,9 @@ void VM_Free( vm_t *vm ) {
 void VM_Clear(void) {
 	int i;
 	for (i=0;i<MAX_VM; i++) {
+		if ( vmTable[i].destroy ) {
+			vmTable[i].destroy( &vmTable[i] );
+		}
 		if ( vmTable[i].dllHandle ) {
 			Sys_UnloadDll( vmTable[i].dllHandle );
 		}
@@ -620,6 +623,18 @@ void VM_Clear(void) {
 	lastVM = NULL;
 }
 
+/*
+==============
+VM_IsNative
+
+Native modules can be called from more than one thread, as long as
+the module itself keeps them apart
+==============
+*/
+qboolean VM_IsNative( vm_t *vm ) {
+	return vm && vm->dllHandle;
+}
+
 void *VM_ArgPtr( size_t intValue ) {
 	if ( !intValue ) {
 		return NULL;
@@ -636,6 +651,26 @@ void *VM_ArgPtr( size_t intValue ) {
 	}
 }
 
+/*
+============
+VM_CheckBlock
+
+Makes sure the size bytes a pointer argument of a system call points at
+stay inside the data segment of a bytecode vm, native modules are trusted
+============
+*/
+void VM_CheckBlock( vm_t *vm, size_t intValue, int size, const char *name ) {
+	size_t	offset;
+
+	if ( !vm || vm->entryPoint || !intValue || size <= 0 ) {
+		return;
+	}
+	offset = intValue & vm->dataMask;
+	if ( offset + size > (size_t)vm->dataMask + 1 ) {
+		Com_Error( ERR_DROP, "%s: %i bytes outside the vm data segment", name, size );
+	}
+}
+
 void *VM_ExplicitArgPtr( vm_t *vm, size_t intValue ) {
 	if ( !intValue ) {
 		return NULL;
@@ -655,6 +690,37 @@ void *VM_ExplicitArgPtr( vm_t *vm, size_t intValue ) {
 }
 
 
+/*
+============
+VM_SystemCall
+
+Bytecode leaves its syscall arguments on the vm stack as 32 bit ints,
+but the handlers index them as size_t, so they get widened on 64 bit
+============
+*/
+int VM_SystemCall( vm_t *vm, int *args ) {
+	size_t	wide[MAX_VMSYSCALL_ARGS];
+	int		i, count;
+
+	if ( sizeof( size_t ) == sizeof( int ) ) {
+		return vm->systemCall( (size_t *)args );
+	}
+
+	// a call made right at the top of the stack has fewer slots above it
+	count = (int)( ( vm->dataBase + vm->dataMask + 1 - (byte *)args ) / sizeof( int ) );
+	if ( count > MAX_VMSYSCALL_ARGS ) {
+		count = MAX_VMSYSCALL_ARGS;
+	}
+	for ( i = 0 ; i < count ; i++ ) {
+		wide[i] = args[i];
+	}
+	for ( ; i < MAX_VMSYSCALL_ARGS ; i++ ) {
+		wide[i] = 0;
+	}
+
+	return vm->systemCall( wide );
+}
+
 /*
 ==============
 VM_Call
@@ -686,6 +752,7 @@ int	QDECL VM_Call( vm_t *vm, int callnum, ... ) {
 	int		r = 0;
 	int i;
 	int args[16];
+	int vmArgs[MAX_VMMAIN_ARGS];
 	va_list ap;
 
 
@@ -715,17 +782,22 @@ int	QDECL VM_Call( vm_t *vm, int callnum, ... ) {
                             args[8],  args[9], args[10], args[11],
                             args[12], args[13], args[14], args[15]);
 
-#if !VM_ONLY_LOAD_DLLS
-	} else if ( vm->compiled ) {
-		r = VM_CallCompiled( vm, &callnum );
 	} else {
-		r = VM_CallInterpreted( vm, &callnum );
+		// the bytecode reads its arguments from one contiguous block,
+		// which &callnum can't be relied on to be
+		vmArgs[0] = callnum;
+		va_start(ap, callnum);
+		for (i = 1; i < MAX_VMMAIN_ARGS; i++) {
+			vmArgs[i] = va_arg(ap, int);
+		}
+		va_end(ap);
+
+		if ( vm->compiled ) {
+			r = VM_CallCompiled( vm, vmArgs );
+		} else {
+			r = VM_CallInterpreted( vm, vmArgs );
+		}
 	}
-#else
-    } else {
-        Sys_Error( "Invalid DLL function call" );
-    }
-#endif
 
 	if ( oldVM != NULL ) // bk001220 - assert(currentVM!=NULL) for oldVM==NULL
 	  currentVM = oldVM;
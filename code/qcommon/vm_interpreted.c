@@ -147,39 +147,103 @@ void VM_StackTrace( vm_t *vm, int programCounter, int programStack ) {
 }
 
 
+/*
+==============================================================================
+
+The bytecode is decoded once at load time into one fixed size cell per
+instruction, so operands never have to be reassembled and branch targets
+are plain instruction numbers.
+
+Common sequences are fused into superinstructions that live in the cell
+of their first instruction. The cells they cover keep their own decoded
+instruction, so a branch into the middle of a sequence still works and
+no branch analysis is needed to decide what can be fused.
+
+With gcc the handler address of every cell is filled in after decoding
+and the interpreter jumps straight from one handler to the next,
+everything else dispatches through a switch on the opcode.
+
+==============================================================================
+*/
+
+#if defined __GNUC__ && !defined DEBUG_VM
+#define	VM_THREADED_DISPATCH
+#endif
+
+// superinstructions, numbered after the real opcodes
+typedef enum {
+	IOP_LOCAL_LOAD4 = OP_CVFI + 1,	// LOCAL, LOAD4
+	IOP_CONST_LOAD4,				// CONST, LOAD4
+	IOP_CONST_ADD,					// CONST, ADD
+	IOP_CONST_ADD_LOAD4,			// CONST, ADD, LOAD4
+	IOP_CONST_SUB,					// CONST, SUB
+	IOP_CONST_MUL,					// CONST, MULI or MULU
+	IOP_CONST_BAND,					// CONST, BAND
+	IOP_CONST_BOR,					// CONST, BOR
+	IOP_CONST_LSH,					// CONST, LSH
+	IOP_CONST_RSHI,					// CONST, RSHI
+	IOP_CONST_RSHU,					// CONST, RSHU
+	IOP_CONST_ARG,					// CONST, ARG
+	IOP_CONST_CALL,					// CONST, CALL to bytecode
+	IOP_CONST_SYSCALL,				// CONST, CALL to the engine
+	IOP_CONST_JUMP,					// CONST, JUMP
+	IOP_CONST_EQ,					// CONST, EQ and so on
+	IOP_CONST_NE,
+	IOP_CONST_LTI,
+	IOP_CONST_LEI,
+	IOP_CONST_GTI,
+	IOP_CONST_GEI,
+	IOP_CONST_LTU,
+	IOP_CONST_LEU,
+	IOP_CONST_GTU,
+	IOP_CONST_GEU,
+
+	IOP_NUM_OPS
+} vmFusedOp_t;
+
+typedef struct {
+#ifdef VM_THREADED_DISPATCH
+	const void	*handler;
+#endif
+	int			op;
+	int			value;		// operand, branch target or folded constant
+	int			value2;		// branch target or arg offset of a superinstruction
+} vmInstruction_t;
+
 /*
 ====================
 VM_PrepareInterpreter
 ====================
 */
 void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
-	int		op;
-	int		pc;
-	byte	*code;
-	int		instruction;
-	int		*codeBase;
+	int				op;
+	int				pc;
+	byte			*code;
+	int				instruction;
+	int				count;
+	vmInstruction_t	*codeBase;
+	vmInstruction_t	*in;
 
-	vm->codeBase = Hunk_Alloc( vm->codeLength*4, h_high );			// we're now int aligned
-//	memcpy( vm->codeBase, (byte *)header + header->codeOffset, vm->codeLength );
+	count = header->instructionCount;
+	vm->codeBase = Hunk_Alloc( count * sizeof( vmInstruction_t ), h_high );
 
-	// we don't need to translate the instructions, but we still need
-	// to find each instructions starting point for jumps
 	pc = 0;
-	instruction = 0;
 	code = (byte *)header + header->codeOffset;
-	codeBase = (int *)vm->codeBase;
+	codeBase = (vmInstruction_t *)vm->codeBase;
 
-	while ( instruction < header->instructionCount ) {
-		vm->instructionPointers[ instruction ] = pc;
-		instruction++;
+	for ( instruction = 0 ; instruction < count ; instruction++ ) {
+		vm->instructionPointers[ instruction ] = instruction;
+		in = &codeBase[ instruction ];
 
-		op = code[ pc ];
-		codeBase[pc] = op;
-		if ( pc > header->codeLength ) {
-			Com_Error( ERR_FATAL, "VM_PrepareInterpreter: pc > header->codeLength" );
+		if ( pc >= header->codeLength ) {
+			Com_Error( ERR_DROP, "VM_PrepareInterpreter: pc > header->codeLength" );
 		}
-
+		op = code[ pc ];
 		pc++;
+		if ( op > OP_CVFI ) {
+			Com_Error( ERR_DROP, "VM_PrepareInterpreter: bad opcode %i at offset %i", op, pc - 1 );
+		}
+		in->op = op;
 
 		// these are the only opcodes that aren't a single byte
 		switch ( op ) {
@@ -204,32 +268,100 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		case OP_GTF:
 		case OP_GEF:
 		case OP_BLOCK_COPY:
-			codeBase[pc+0] = loadWord(&code[pc]);
+			if ( pc + 4 > header->codeLength ) {
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: operand past end of code" );
+			}
+			in->value = loadWord(&code[pc]);
 			pc += 4;
 			break;
 		case OP_ARG:
-			codeBase[pc+0] = code[pc];
+			if ( pc + 1 > header->codeLength ) {
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: operand past end of code" );
+			}
+			in->value = code[pc];
 			pc += 1;
 			break;
 		default:
 			break;
 		}
 
+		// branches are checked here so the interpreter doesn't have to
+		if ( op >= OP_EQ && op <= OP_GEF ) {
+			if ( in->value < 0 || in->value >= count ) {
+				Com_Error( ERR_DROP, "VM_PrepareInterpreter: branch target %i out of range", in->value );
+			}
+		}
 	}
-	pc = 0;
-	instruction = 0;
-	code = (byte *)header + header->codeOffset;
-	codeBase = (int *)vm->codeBase;
 
-	while ( instruction < header->instructionCount ) {
-		op = code[ pc ];
-		instruction++;
-		pc++;
-		switch ( op ) {
-		case OP_ENTER:
-		case OP_CONST:
-		case OP_LOCAL:
-		case OP_LEAVE:
+	// fuse superinstructions, the following cells are only looked at
+	// before they are rewritten themselves
+	for ( instruction = 0 ; instruction < count - 1 ; instruction++ ) {
+		in = &codeBase[ instruction ];
+
+		if ( in->op == OP_LOCAL ) {
+			if ( in[1].op == OP_LOAD4 ) {
+				in->op = IOP_LOCAL_LOAD4;
+			}
+			continue;
+		}
+		if ( in->op != OP_CONST ) {
+			continue;
+		}
+
+		switch ( in[1].op ) {
+		case OP_LOAD4:
+			in->op = IOP_CONST_LOAD4;
+			in->value &= vm->dataMask;
+			break;
+		case OP_ADD:
+			if ( instruction < count - 2 && in[2].op == OP_LOAD4 ) {
+				in->op = IOP_CONST_ADD_LOAD4;
+			} else {
+				in->op = IOP_CONST_ADD;
+			}
+			break;
+		case OP_SUB:
+			in->op = IOP_CONST_SUB;
+			break;
+		case OP_MULI:
+		case OP_MULU:
+			in->op = IOP_CONST_MUL;
+			break;
+		case OP_BAND:
+			in->op = IOP_CONST_BAND;
+			break;
+		case OP_BOR:
+			in->op = IOP_CONST_BOR;
+			break;
+		case OP_LSH:
+			in->op = IOP_CONST_LSH;
+			in->value &= 31;
+			break;
+		case OP_RSHI:
+			in->op = IOP_CONST_RSHI;
+			in->value &= 31;
+			break;
+		case OP_RSHU:
+			in->op = IOP_CONST_RSHU;
+			in->value &= 31;
+			break;
+		case OP_ARG:
+			in->op = IOP_CONST_ARG;
+			in->value2 = in[1].value;
+			break;
+		case OP_CALL:
+			// out of range calls are left to the checked OP_CALL
+			if ( in->value < 0 ) {
+				in->op = IOP_CONST_SYSCALL;
+			} else if ( in->value < count ) {
+				in->op = IOP_CONST_CALL;
+			}
+			break;
+		case OP_JUMP:
+			if ( in->value >= 0 && in->value < count ) {
+				in->op = IOP_CONST_JUMP;
+			}
+			break;
 		case OP_EQ:
 		case OP_NE:
 		case OP_LTI:
@@ -240,45 +372,18 @@ void VM_PrepareInterpreter( vm_t *vm, vmHeader_t *header ) {
 		case OP_LEU:
 		case OP_GTU:
 		case OP_GEU:
-		case OP_EQF:
-		case OP_NEF:
-		case OP_LTF:
-		case OP_LEF:
-		case OP_GTF:
-		case OP_GEF:
-		case OP_BLOCK_COPY:
-			switch(op) {
-				case OP_EQ:
-				case OP_NE:
-				case OP_LTI:
-				case OP_LEI:
-				case OP_GTI:
-				case OP_GEI:
-				case OP_LTU:
-				case OP_LEU:
-				case OP_GTU:
-				case OP_GEU:
-				case OP_EQF:
-				case OP_NEF:
-				case OP_LTF:
-				case OP_LEF:
-				case OP_GTF:
-				case OP_GEF:
-				codeBase[pc] = vm->instructionPointers[codeBase[pc]];
-				break;
-			default:
-				break;
-			}
-			pc += 4;
-			break;
-		case OP_ARG:
-			pc += 1;
+			in->op = IOP_CONST_EQ + ( in[1].op - OP_EQ );
+			in->value2 = in[1].value;
 			break;
 		default:
 			break;
 		}
-
 	}
+
+#ifdef VM_THREADED_DISPATCH
+	// fill in the handler addresses
+	VM_CallInterpreted( vm, NULL );
+#endif
 }
 
 /*
@@ -302,27 +407,90 @@ sp		return address
 An interpreted function will immediately execute
 an OP_ENTER instruction, which will subtract space for
 locals from sp
+
+The return address is the number of the instruction to resume at.
 ==============
 */
-#define	MAX_STACK	256
-#define	STACK_MASK	(MAX_STACK-1)
 //#define	DEBUG_VM
 
-#define	DEBUGSTR va("%s%i", VM_Indent(vm), opStack-stack )
+#define	DEBUGSTR va("%s%i", VM_Indent(vm), opStackOfs >> 2 )
+
+// the operand stack offset is a byte, so it wraps inside the stack
+// no matter what the bytecode does, just like in the compilers
+#define	OPSTACK_SIZE	256
+
+#define	TOP			(*(int *)&opStack[ opStackOfs ])
+#define	NEXT_TOP	(*(int *)&opStack[ (byte)( opStackOfs - 4 ) ])
+#define	TOPF		(*(float *)&opStack[ opStackOfs ])
+#define	NEXT_TOPF	(*(float *)&opStack[ (byte)( opStackOfs - 4 ) ])
+
+#ifdef VM_THREADED_DISPATCH
+#define	VM_OP(x)	do_##x:
+#define	DISPATCH()	goto *ip->handler
+#else
+#define	VM_OP(x)	case x:
+#define	DISPATCH()	goto nextInstruction
+#endif
+
+#define	NEXT(n)		{ ip += (n); DISPATCH(); }
 
 int	VM_CallInterpreted( vm_t *vm, int *args ) {
-	int		stack[MAX_STACK];
-	int		*opStack;
-	int		programCounter;
-	int		programStack;
-	int		stackOnEntry;
-	byte	*image;
-	int		*codeImage;
-	int		v1;
-	int		dataMask;
+	int				stack[OPSTACK_SIZE/4];
+	byte			*opStack;
+	byte			opStackOfs;
+	vmInstruction_t	*ip;
+	vmInstruction_t	*codeImage;
+	int				instructionCount;
+	int				programStack;
+	int				stackOnEntry;
+	byte			*image;
+	int				dataMask;
+	int				stackMask;
+	int				r0, r1;
 #ifdef DEBUG_VM
 	vmSymbol_t	*profileSymbol;
 #endif
+#ifdef VM_THREADED_DISPATCH
+	static const void *dispatchTable[IOP_NUM_OPS] = {
+		&&do_OP_UNDEF, &&do_OP_IGNORE, &&do_OP_BREAK, &&do_OP_ENTER,
+		&&do_OP_LEAVE, &&do_OP_CALL, &&do_OP_PUSH, &&do_OP_POP,
+		&&do_OP_CONST, &&do_OP_LOCAL, &&do_OP_JUMP,
+		&&do_OP_EQ, &&do_OP_NE, &&do_OP_LTI, &&do_OP_LEI, &&do_OP_GTI, &&do_OP_GEI,
+		&&do_OP_LTU, &&do_OP_LEU, &&do_OP_GTU, &&do_OP_GEU,
+		&&do_OP_EQF, &&do_OP_NEF, &&do_OP_LTF, &&do_OP_LEF, &&do_OP_GTF, &&do_OP_GEF,
+		&&do_OP_LOAD1, &&do_OP_LOAD2, &&do_OP_LOAD4,
+		&&do_OP_STORE1, &&do_OP_STORE2, &&do_OP_STORE4,
+		&&do_OP_ARG, &&do_OP_BLOCK_COPY, &&do_OP_SEX8, &&do_OP_SEX16,
+		&&do_OP_NEGI, &&do_OP_ADD, &&do_OP_SUB, &&do_OP_DIVI, &&do_OP_DIVU,
+		&&do_OP_MODI, &&do_OP_MODU, &&do_OP_MULI, &&do_OP_MULU,
+		&&do_OP_BAND, &&do_OP_BOR, &&do_OP_BXOR, &&do_OP_BCOM,
+		&&do_OP_LSH, &&do_OP_RSHI, &&do_OP_RSHU,
+		&&do_OP_NEGF, &&do_OP_ADDF, &&do_OP_SUBF, &&do_OP_DIVF, &&do_OP_MULF,
+		&&do_OP_CVIF, &&do_OP_CVFI,
+
+		&&do_IOP_LOCAL_LOAD4, &&do_IOP_CONST_LOAD4,
+		&&do_IOP_CONST_ADD, &&do_IOP_CONST_ADD_LOAD4, &&do_IOP_CONST_SUB, &&do_IOP_CONST_MUL,
+		&&do_IOP_CONST_BAND, &&do_IOP_CONST_BOR,
+		&&do_IOP_CONST_LSH, &&do_IOP_CONST_RSHI, &&do_IOP_CONST_RSHU,
+		&&do_IOP_CONST_ARG, &&do_IOP_CONST_CALL, &&do_IOP_CONST_SYSCALL, &&do_IOP_CONST_JUMP,
+		&&do_IOP_CONST_EQ, &&do_IOP_CONST_NE,
+		&&do_IOP_CONST_LTI, &&do_IOP_CONST_LEI, &&do_IOP_CONST_GTI, &&do_IOP_CONST_GEI,
+		&&do_IOP_CONST_LTU, &&do_IOP_CONST_LEU, &&do_IOP_CONST_GTU, &&do_IOP_CONST_GEU
+	};
+#endif
+
+	codeImage = (vmInstruction_t *)vm->codeBase;
+	instructionCount = vm->instructionPointersLength >> 2;
+
+#ifdef VM_THREADED_DISPATCH
+	if ( !args ) {
+		// called from VM_PrepareInterpreter, the labels are only visible in here
+		for ( ip = codeImage ; ip < codeImage + instructionCount ; ip++ ) {
+			ip->handler = dispatchTable[ ip->op ];
+		}
+		return 0;
+	}
+#endif
 
 	// interpret the code
 	vm->currentlyInterpreting = qtrue;
@@ -338,14 +506,14 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	// set up the stack frame 
 
 	image = vm->dataBase;
-	codeImage = (int *)vm->codeBase;
 	dataMask = vm->dataMask;
-	
-	// leave a free spot at start of stack so
-	// that as long as opStack is valid, opStack-1 will
-	// not corrupt anything
-	opStack = stack;
-	programCounter = 0;
+	stackMask = dataMask & ~3;
+
+	// the offset is a byte, so it wraps around inside the 256 byte
+	// op stack and even a bad program can't reach outside of it
+	opStack = (byte *)stack;
+	opStackOfs = 0;
+	ip = codeImage;
 
 	programStack -= 48;
 
@@ -370,521 +538,455 @@ int	VM_CallInterpreted( vm_t *vm, int *args ) {
 	// main interpreter loop, will exit when a LEAVE instruction
 	// grabs the -1 program counter
 
-#define r2 codeImage[programCounter]
-
-	while ( 1 ) {
-		int		opcode,	r0, r1;
-//		unsigned int	r2;
-
+#ifdef VM_THREADED_DISPATCH
+	DISPATCH();
+#else
 nextInstruction:
-		r0 = ((int *)opStack)[0];
-		r1 = ((int *)opStack)[-1];
-nextInstruction2:
-		opcode = codeImage[ programCounter++ ];
 #ifdef DEBUG_VM
-		if ( (unsigned)programCounter > vm->codeLength ) {
-			Com_Error( ERR_DROP, "VM pc out of range" );
-		}
-
-		if ( opStack < stack ) {
-			Com_Error( ERR_DROP, "VM opStack underflow" );
-		}
-		if ( opStack >= stack+MAX_STACK ) {
-			Com_Error( ERR_DROP, "VM opStack overflow" );
-		}
-
-		if ( programStack <= vm->stackBottom ) {
-			Com_Error( ERR_DROP, "VM stack overflow" );
-		}
+	if ( programStack <= vm->stackBottom ) {
+		Com_Error( ERR_DROP, "VM stack overflow" );
+	}
 
-		if ( programStack & 3 ) {
-			Com_Error( ERR_DROP, "VM program stack misaligned" );
-		}
+	if ( programStack & 3 ) {
+		Com_Error( ERR_DROP, "VM program stack misaligned" );
+	}
 
-		if ( vm_debugLevel > 1 ) {
-			Com_Printf( "%s %s\n", DEBUGSTR, opnames[opcode] );
-		}
-		profileSymbol->profileCount++;
+	if ( vm_debugLevel > 1 ) {
+		Com_Printf( "%s %s\n", DEBUGSTR, ip->op <= OP_CVFI ? opnames[ip->op] : "superinstruction" );
+	}
+	profileSymbol->profileCount++;
 #endif
 
-		switch ( opcode ) {
-#ifdef DEBUG_VM
-		default:
-			Com_Error( ERR_DROP, "Bad VM instruction" );  // this should be scanned on load!
+	switch ( ip->op ) {
+	default:
+		Com_Error( ERR_DROP, "Bad VM instruction" );
 #endif
-		case OP_BREAK:
-			vm->breakCount++;
-			goto nextInstruction2;
-		case OP_CONST:
-			opStack++;
-			r1 = r0;
-			r0 = *opStack = r2;
-			
-			programCounter += 4;
-			goto nextInstruction2;
-		case OP_LOCAL:
-			opStack++;
-			r1 = r0;
-			r0 = *opStack = r2+programStack;
 
-			programCounter += 4;
-			goto nextInstruction2;
-
-		case OP_LOAD4:
-#ifdef DEBUG_VM
-			if ( *opStack & 3 ) {
-				Com_Error( ERR_DROP, "OP_LOAD4 misaligned" );
+	VM_OP( OP_UNDEF )
+	VM_OP( OP_IGNORE )
+		NEXT( 1 );
+	VM_OP( OP_BREAK )
+		vm->breakCount++;
+		NEXT( 1 );
+
+	VM_OP( OP_CONST )
+		opStackOfs += 4;
+		TOP = ip->value;
+		NEXT( 1 );
+	VM_OP( OP_LOCAL )
+		opStackOfs += 4;
+		TOP = ip->value + programStack;
+		NEXT( 1 );
+
+	VM_OP( OP_LOAD4 )
+		TOP = *(int *)&image[ TOP & dataMask ];
+		NEXT( 1 );
+	VM_OP( OP_LOAD2 )
+		TOP = *(unsigned short *)&image[ TOP & dataMask ];
+		NEXT( 1 );
+	VM_OP( OP_LOAD1 )
+		TOP = image[ TOP & dataMask ];
+		NEXT( 1 );
+
+	VM_OP( OP_STORE4 )
+		*(int *)&image[ NEXT_TOP & ( dataMask & ~3 ) ] = TOP;
+		opStackOfs -= 8;
+		NEXT( 1 );
+	VM_OP( OP_STORE2 )
+		*(short *)&image[ NEXT_TOP & ( dataMask & ~1 ) ] = TOP;
+		opStackOfs -= 8;
+		NEXT( 1 );
+	VM_OP( OP_STORE1 )
+		image[ NEXT_TOP & dataMask ] = TOP;
+		opStackOfs -= 8;
+		NEXT( 1 );
+
+	VM_OP( OP_ARG )
+		// single byte offset from programStack
+		*(int *)&image[ ( ip->value + programStack ) & stackMask ] = TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+
+	VM_OP( OP_BLOCK_COPY )
+		{
+			int		*src, *dest;
+			int		i, count, srci, desti;
+
+			count = ip->value;
+			// MrE: copy range check
+			srci = TOP & dataMask;
+			desti = NEXT_TOP & dataMask;
+			count = ((srci + count) & dataMask) - srci;
+			count = ((desti + count) & dataMask) - desti;
+
+			if ( ( srci | desti | count ) & 3 ) {
+				Com_Error( ERR_DROP, "OP_BLOCK_COPY not dword aligned" );
 			}
-#endif
-			r0 = *opStack = *(int *)&image[ r0&dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD2:
-			r0 = *opStack = *(unsigned short *)&image[ r0&dataMask ];
-			goto nextInstruction2;
-		case OP_LOAD1:
-			r0 = *opStack = image[ r0&dataMask ];
-			goto nextInstruction2;
-
-		case OP_STORE4:
-			*(int *)&image[ r1&(dataMask & ~3) ] = r0;
-			opStack -= 2;
-			goto nextInstruction;
-		case OP_STORE2:
-			*(short *)&image[ r1&(dataMask & ~1) ] = r0;
-			opStack -= 2;
-			goto nextInstruction;
-		case OP_STORE1:
-			image[ r1&dataMask ] = r0;
-			opStack -= 2;
-			goto nextInstruction;
-
-		case OP_ARG:
-			// single byte offset from programStack
-			*(int *)&image[ codeImage[programCounter] + programStack ] = r0;
-			opStack--;
-			programCounter += 1;
-			goto nextInstruction;
-
-		case OP_BLOCK_COPY:
-			{
-				int		*src, *dest;
-				int		i, count, srci, desti;
-
-				count = r2;
-				// MrE: copy range check
-				srci = r0 & dataMask;
-				desti = r1 & dataMask;
-				count = ((srci + count) & dataMask) - srci;
-				count = ((desti + count) & dataMask) - desti;
-
-				src = (int *)&image[ r0&dataMask ];
-				dest = (int *)&image[ r1&dataMask ];
-				if ( ( (int)src | (int)dest | count ) & 3 ) {
-					Com_Error( ERR_DROP, "OP_BLOCK_COPY not dword aligned" );
-				}
-				count >>= 2;
-				for ( i = count-1 ; i>= 0 ; i-- ) {
-					dest[i] = src[i];
-				}
-				programCounter += 4;
-				opStack -= 2;
+			src = (int *)&image[ srci ];
+			dest = (int *)&image[ desti ];
+			count >>= 2;
+			for ( i = count-1 ; i>= 0 ; i-- ) {
+				dest[i] = src[i];
 			}
-			goto nextInstruction;
-
-		case OP_CALL:
-			// save current program counter
-			*(int *)&image[ programStack ] = programCounter;
-			
-			// jump to the location on the stack
-			programCounter = r0;
-			opStack--;
-			if ( programCounter < 0 ) {
-				// system call
-				int		r;
-				int		temp;
+			opStackOfs -= 8;
+		}
+		NEXT( 1 );
+
+	VM_OP( OP_CALL )
+		r0 = TOP;
+		opStackOfs -= 4;
+		if ( r0 < 0 ) {
+			ip++;
+			goto systemCall;
+		}
+		if ( r0 >= instructionCount ) {
+			Com_Error( ERR_DROP, "VM %s: call target out of range", vm->name );
+		}
+		// save the instruction to return to
+		*(int *)&image[ programStack & stackMask ] = ip - codeImage + 1;
+		ip = codeImage + r0;
+		DISPATCH();
+
+systemCall:
+		{
+			int		temp;
 #ifdef DEBUG_VM
-				int		stomped;
+			int		stomped;
 
-				if ( vm_debugLevel ) {
-					Com_Printf( "%s---> systemcall(%i)\n", DEBUGSTR, -1 - programCounter );
-				}
+			if ( vm_debugLevel ) {
+				Com_Printf( "%s---> systemcall(%i)\n", DEBUGSTR, -1 - r0 );
+			}
 #endif
-				// save the stack to allow recursive VM entry
-				temp = vm->callLevel;
-				vm->programStack = programStack - 4;
+			// save the stack to allow recursive VM entry
+			temp = vm->callLevel;
+			vm->programStack = programStack - 4;
 #ifdef DEBUG_VM
-				stomped = *(int *)&image[ programStack + 4 ];
+			stomped = *(int *)&image[ ( programStack + 4 ) & stackMask ];
 #endif
-				*(int *)&image[ programStack + 4 ] = -1 - programCounter;
+			*(int *)&image[ ( programStack + 4 ) & stackMask ] = -1 - r0;
 
-//VM_LogSyscalls( (int *)&image[ programStack + 4 ] );
-                // @pjb: TODO: probably want to check this
-				r = vm->systemCall( (size_t *)&image[ programStack + 4 ] );
+//VM_LogSyscalls( (int *)&image[ ( programStack + 4 ) & stackMask ] );
+			r0 = VM_SystemCall( vm, (int *)&image[ ( programStack + 4 ) & stackMask ] );
 
 #ifdef DEBUG_VM
-				// this is just our stack frame pointer, only needed
-				// for debugging
-				*(int *)&image[ programStack + 4 ] = stomped;
+			// this is just our stack frame pointer, only needed
+			// for debugging
+			*(int *)&image[ ( programStack + 4 ) & stackMask ] = stomped;
 #endif
 
-				// save return value
-				opStack++;
-				*opStack = r;
-				programCounter = *(int *)&image[ programStack ];
-				vm->callLevel = temp;
-#ifdef DEBUG_VM
-				if ( vm_debugLevel ) {
-					Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
-				}
-#endif
-			} else {
-				programCounter = vm->instructionPointers[ programCounter ];
-			}
-			goto nextInstruction;
+			// save return value
+			opStackOfs += 4;
+			TOP = r0;
+			vm->callLevel = temp;
+		}
+		DISPATCH();
 
-		// push and pop are only needed for discarded or bad function return values
-		case OP_PUSH:
-			opStack++;
-			goto nextInstruction;
-		case OP_POP:
-			opStack--;
-			goto nextInstruction;
+	// push and pop are only needed for discarded or bad function return values
+	VM_OP( OP_PUSH )
+		opStackOfs += 4;
+		NEXT( 1 );
+	VM_OP( OP_POP )
+		opStackOfs -= 4;
+		NEXT( 1 );
 
-		case OP_ENTER:
+	VM_OP( OP_ENTER )
 #ifdef DEBUG_VM
-			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
+		profileSymbol = VM_ValueToFunctionSymbol( vm, ip - codeImage );
 #endif
-			// get size of stack frame
-			v1 = r2;
-
-			programCounter += 4;
-			programStack -= v1;
+		// get size of stack frame
+		r0 = ip->value;
+		programStack -= r0;
+		if ( programStack <= vm->stackBottom ) {
+			Com_Error( ERR_DROP, "VM %s: stack overflow", vm->name );
+		}
 #ifdef DEBUG_VM
-			// save old stack frame for debugging traces
-			*(int *)&image[programStack+4] = programStack + v1;
-			if ( vm_debugLevel ) {
-				Com_Printf( "%s---> %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter - 5 ) );
-				if ( vm->breakFunction && programCounter - 5 == vm->breakFunction ) {
-					// this is to allow setting breakpoints here in the debugger
-					vm->breakCount++;
-//					vm_debugLevel = 2;
-//					VM_StackTrace( vm, programCounter, programStack );
-				}
-				vm->callLevel++;
+		// save old stack frame for debugging traces
+		*(int *)&image[ ( programStack + 4 ) & stackMask ] = programStack + r0;
+		if ( vm_debugLevel ) {
+			Com_Printf( "%s---> %s\n", DEBUGSTR, VM_ValueToSymbol( vm, ip - codeImage ) );
+			if ( vm->breakFunction && ip - codeImage == vm->breakFunction ) {
+				// this is to allow setting breakpoints here in the debugger
+				vm->breakCount++;
+//				vm_debugLevel = 2;
+//				VM_StackTrace( vm, ip - codeImage, programStack );
 			}
+			vm->callLevel++;
+		}
 #endif
-			goto nextInstruction;
-		case OP_LEAVE:
-			// remove our stack frame
-			v1 = r2;
+		NEXT( 1 );
+	VM_OP( OP_LEAVE )
+		// remove our stack frame
+		programStack += ip->value;
 
-			programStack += v1;
-
-			// grab the saved program counter
-			programCounter = *(int *)&image[ programStack ];
+		// grab the saved program counter
+		r0 = *(int *)&image[ programStack & stackMask ];
 #ifdef DEBUG_VM
-			profileSymbol = VM_ValueToFunctionSymbol( vm, programCounter );
-			if ( vm_debugLevel ) {
-				vm->callLevel--;
-				Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, programCounter ) );
-			}
+		profileSymbol = VM_ValueToFunctionSymbol( vm, r0 );
+		if ( vm_debugLevel ) {
+			vm->callLevel--;
+			Com_Printf( "%s<--- %s\n", DEBUGSTR, VM_ValueToSymbol( vm, r0 ) );
+		}
 #endif
-			// check for leaving the VM
-			if ( programCounter == -1 ) {
-				goto done;
-			}
-			goto nextInstruction;
-
-		/*
-		===================================================================
-		BRANCHES
-		===================================================================
-		*/
-
-		case OP_JUMP:
-			programCounter = r0;
-			programCounter = vm->instructionPointers[ programCounter ];
-			opStack--;
-			goto nextInstruction;
-
-		case OP_EQ:
-			opStack -= 2;
-			if ( r1 == r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_NE:
-			opStack -= 2;
-			if ( r1 != r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_LTI:
-			opStack -= 2;
-			if ( r1 < r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_LEI:
-			opStack -= 2;
-			if ( r1 <= r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_GTI:
-			opStack -= 2;
-			if ( r1 > r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_GEI:
-			opStack -= 2;
-			if ( r1 >= r0 ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_LTU:
-			opStack -= 2;
-			if ( ((unsigned)r1) < ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_LEU:
-			opStack -= 2;
-			if ( ((unsigned)r1) <= ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_GTU:
-			opStack -= 2;
-			if ( ((unsigned)r1) > ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_GEU:
-			opStack -= 2;
-			if ( ((unsigned)r1) >= ((unsigned)r0) ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				goto nextInstruction;
-			}
-
-		case OP_EQF:
-			if ( ((float *)opStack)[-1] == *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-		case OP_NEF:
-			if ( ((float *)opStack)[-1] != *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-		case OP_LTF:
-			if ( ((float *)opStack)[-1] < *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-		case OP_LEF:
-			if ( ((float *)opStack)[-1] <= *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-		case OP_GTF:
-			if ( ((float *)opStack)[-1] > *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-		case OP_GEF:
-			if ( ((float *)opStack)[-1] >= *(float *)opStack ) {
-				programCounter = r2;	//vm->instructionPointers[r2];
-				opStack -= 2;
-				goto nextInstruction;
-			} else {
-				programCounter += 4;
-				opStack -= 2;
-				goto nextInstruction;
-			}
-
-
-		//===================================================================
-
-		case OP_NEGI:
-			*opStack = -r0;
-			goto nextInstruction;
-		case OP_ADD:
-			opStack[-1] = r1 + r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_SUB:
-			opStack[-1] = r1 - r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_DIVI:
-			opStack[-1] = r1 / r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_DIVU:
-			opStack[-1] = ((unsigned)r1) / ((unsigned)r0);
-			opStack--;
-			goto nextInstruction;
-		case OP_MODI:
-			opStack[-1] = r1 % r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_MODU:
-			opStack[-1] = ((unsigned)r1) % (unsigned)r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_MULI:
-			opStack[-1] = r1 * r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_MULU:
-			opStack[-1] = ((unsigned)r1) * ((unsigned)r0);
-			opStack--;
-			goto nextInstruction;
-
-		case OP_BAND:
-			opStack[-1] = ((unsigned)r1) & ((unsigned)r0);
-			opStack--;
-			goto nextInstruction;
-		case OP_BOR:
-			opStack[-1] = ((unsigned)r1) | ((unsigned)r0);
-			opStack--;
-			goto nextInstruction;
-		case OP_BXOR:
-			opStack[-1] = ((unsigned)r1) ^ ((unsigned)r0);
-			opStack--;
-			goto nextInstruction;
-		case OP_BCOM:
-			opStack[-1] = ~ ((unsigned)r0);
-			goto nextInstruction;
-
-		case OP_LSH:
-			opStack[-1] = r1 << r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_RSHI:
-			opStack[-1] = r1 >> r0;
-			opStack--;
-			goto nextInstruction;
-		case OP_RSHU:
-			opStack[-1] = ((unsigned)r1) >> r0;
-			opStack--;
-			goto nextInstruction;
-
-		case OP_NEGF:
-			*(float *)opStack =  -*(float *)opStack;
-			goto nextInstruction;
-		case OP_ADDF:
-			*(float *)(opStack-1) = *(float *)(opStack-1) + *(float *)opStack;
-			opStack--;
-			goto nextInstruction;
-		case OP_SUBF:
-			*(float *)(opStack-1) = *(float *)(opStack-1) - *(float *)opStack;
-			opStack--;
-			goto nextInstruction;
-		case OP_DIVF:
-			*(float *)(opStack-1) = *(float *)(opStack-1) / *(float *)opStack;
-			opStack--;
-			goto nextInstruction;
-		case OP_MULF:
-			*(float *)(opStack-1) = *(float *)(opStack-1) * *(float *)opStack;
-			opStack--;
-			goto nextInstruction;
-
-		case OP_CVIF:
-			*(float *)opStack =  (float)*opStack;
-			goto nextInstruction;
-		case OP_CVFI:
-			*opStack = (int) *(float *)opStack;
-			goto nextInstruction;
-		case OP_SEX8:
-			*opStack = (signed char)*opStack;
-			goto nextInstruction;
-		case OP_SEX16:
-			*opStack = (short)*opStack;
-			goto nextInstruction;
+		// check for leaving the VM
+		if ( r0 == -1 ) {
+			goto done;
 		}
+		if ( (unsigned)r0 >= (unsigned)instructionCount ) {
+			Com_Error( ERR_DROP, "VM %s: return address out of range", vm->name );
+		}
+		ip = codeImage + r0;
+		DISPATCH();
+
+	/*
+	===================================================================
+	BRANCHES
+	===================================================================
+	*/
+
+	VM_OP( OP_JUMP )
+		r0 = TOP;
+		opStackOfs -= 4;
+		if ( (unsigned)r0 >= (unsigned)instructionCount ) {
+			Com_Error( ERR_DROP, "VM %s: jump target out of range", vm->name );
+		}
+		ip = codeImage + r0;
+		DISPATCH();
+
+#define	BRANCH_I(x,cmp)							\
+	VM_OP( x )									\
+		r0 = TOP;								\
+		r1 = NEXT_TOP;							\
+		opStackOfs -= 8;						\
+		if ( cmp ) {							\
+			ip = codeImage + ip->value;			\
+			DISPATCH();							\
+		}										\
+		NEXT( 1 );
+
+	BRANCH_I( OP_EQ, r1 == r0 )
+	BRANCH_I( OP_NE, r1 != r0 )
+	BRANCH_I( OP_LTI, r1 < r0 )
+	BRANCH_I( OP_LEI, r1 <= r0 )
+	BRANCH_I( OP_GTI, r1 > r0 )
+	BRANCH_I( OP_GEI, r1 >= r0 )
+	BRANCH_I( OP_LTU, ((unsigned)r1) < ((unsigned)r0) )
+	BRANCH_I( OP_LEU, ((unsigned)r1) <= ((unsigned)r0) )
+	BRANCH_I( OP_GTU, ((unsigned)r1) > ((unsigned)r0) )
+	BRANCH_I( OP_GEU, ((unsigned)r1) >= ((unsigned)r0) )
+
+#define	BRANCH_F(x,cmp)							\
+	VM_OP( x )									\
+		r0 = ( NEXT_TOPF cmp TOPF );			\
+		opStackOfs -= 8;						\
+		if ( r0 ) {								\
+			ip = codeImage + ip->value;			\
+			DISPATCH();							\
+		}										\
+		NEXT( 1 );
+
+	BRANCH_F( OP_EQF, == )
+	BRANCH_F( OP_NEF, != )
+	BRANCH_F( OP_LTF, < )
+	BRANCH_F( OP_LEF, <= )
+	BRANCH_F( OP_GTF, > )
+	BRANCH_F( OP_GEF, >= )
+
+	//===================================================================
+
+	VM_OP( OP_NEGI )
+		TOP = -TOP;
+		NEXT( 1 );
+	VM_OP( OP_ADD )
+		NEXT_TOP = NEXT_TOP + TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_SUB )
+		NEXT_TOP = NEXT_TOP - TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_DIVI )
+		NEXT_TOP = NEXT_TOP / TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_DIVU )
+		NEXT_TOP = ((unsigned)NEXT_TOP) / ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_MODI )
+		NEXT_TOP = NEXT_TOP % TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_MODU )
+		NEXT_TOP = ((unsigned)NEXT_TOP) % ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_MULI )
+		NEXT_TOP = NEXT_TOP * TOP;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_MULU )
+		NEXT_TOP = ((unsigned)NEXT_TOP) * ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+
+	VM_OP( OP_BAND )
+		NEXT_TOP = ((unsigned)NEXT_TOP) & ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_BOR )
+		NEXT_TOP = ((unsigned)NEXT_TOP) | ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_BXOR )
+		NEXT_TOP = ((unsigned)NEXT_TOP) ^ ((unsigned)TOP);
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_BCOM )
+		TOP = ~ ((unsigned)TOP);
+		NEXT( 1 );
+
+	// shift counts wrap like they do on x86, so every host agrees
+	VM_OP( OP_LSH )
+		NEXT_TOP = NEXT_TOP << ( TOP & 31 );
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_RSHI )
+		NEXT_TOP = NEXT_TOP >> ( TOP & 31 );
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_RSHU )
+		NEXT_TOP = ((unsigned)NEXT_TOP) >> ( TOP & 31 );
+		opStackOfs -= 4;
+		NEXT( 1 );
+
+	VM_OP( OP_NEGF )
+		TOPF = -TOPF;
+		NEXT( 1 );
+	VM_OP( OP_ADDF )
+		NEXT_TOPF = NEXT_TOPF + TOPF;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_SUBF )
+		NEXT_TOPF = NEXT_TOPF - TOPF;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_DIVF )
+		NEXT_TOPF = NEXT_TOPF / TOPF;
+		opStackOfs -= 4;
+		NEXT( 1 );
+	VM_OP( OP_MULF )
+		NEXT_TOPF = NEXT_TOPF * TOPF;
+		opStackOfs -= 4;
+		NEXT( 1 );
+
+	VM_OP( OP_CVIF )
+		TOPF = (float)TOP;
+		NEXT( 1 );
+	VM_OP( OP_CVFI )
+		TOP = (int)TOPF;
+		NEXT( 1 );
+	VM_OP( OP_SEX8 )
+		TOP = (signed char)TOP;
+		NEXT( 1 );
+	VM_OP( OP_SEX16 )
+		TOP = (short)TOP;
+		NEXT( 1 );
+
+	/*
+	===================================================================
+	SUPERINSTRUCTIONS
+	===================================================================
+	*/
+
+	VM_OP( IOP_LOCAL_LOAD4 )
+		opStackOfs += 4;
+		TOP = *(int *)&image[ ( ip->value + programStack ) & dataMask ];
+		NEXT( 2 );
+	VM_OP( IOP_CONST_LOAD4 )
+		opStackOfs += 4;
+		TOP = *(int *)&image[ ip->value ];
+		NEXT( 2 );
+
+	VM_OP( IOP_CONST_ADD )
+		TOP += ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_ADD_LOAD4 )
+		TOP = *(int *)&image[ ( TOP + ip->value ) & dataMask ];
+		NEXT( 3 );
+	VM_OP( IOP_CONST_SUB )
+		TOP -= ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_MUL )
+		TOP = ((unsigned)TOP) * ((unsigned)ip->value);
+		NEXT( 2 );
+	VM_OP( IOP_CONST_BAND )
+		TOP &= ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_BOR )
+		TOP |= ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_LSH )
+		TOP <<= ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_RSHI )
+		TOP >>= ip->value;
+		NEXT( 2 );
+	VM_OP( IOP_CONST_RSHU )
+		TOP = ((unsigned)TOP) >> ip->value;
+		NEXT( 2 );
+
+	VM_OP( IOP_CONST_ARG )
+		*(int *)&image[ ( ip->value2 + programStack ) & stackMask ] = ip->value;
+		NEXT( 2 );
+
+	VM_OP( IOP_CONST_CALL )
+		*(int *)&image[ programStack & stackMask ] = ip - codeImage + 2;
+		ip = codeImage + ip->value;
+		DISPATCH();
+	VM_OP( IOP_CONST_SYSCALL )
+		r0 = ip->value;
+		ip += 2;
+		goto systemCall;
+
+	VM_OP( IOP_CONST_JUMP )
+		ip = codeImage + ip->value;
+		DISPATCH();
+
+#define	BRANCH_CONST(x,cmp)						\
+	VM_OP( x )									\
+		r1 = TOP;								\
+		r0 = ip->value;							\
+		opStackOfs -= 4;						\
+		if ( cmp ) {							\
+			ip = codeImage + ip->value2;		\
+			DISPATCH();							\
+		}										\
+		NEXT( 2 );
+
+	BRANCH_CONST( IOP_CONST_EQ, r1 == r0 )
+	BRANCH_CONST( IOP_CONST_NE, r1 != r0 )
+	BRANCH_CONST( IOP_CONST_LTI, r1 < r0 )
+	BRANCH_CONST( IOP_CONST_LEI, r1 <= r0 )
+	BRANCH_CONST( IOP_CONST_GTI, r1 > r0 )
+	BRANCH_CONST( IOP_CONST_GEI, r1 >= r0 )
+	BRANCH_CONST( IOP_CONST_LTU, ((unsigned)r1) < ((unsigned)r0) )
+	BRANCH_CONST( IOP_CONST_LEU, ((unsigned)r1) <= ((unsigned)r0) )
+	BRANCH_CONST( IOP_CONST_GTU, ((unsigned)r1) > ((unsigned)r0) )
+	BRANCH_CONST( IOP_CONST_GEU, ((unsigned)r1) >= ((unsigned)r0) )
+
+#ifndef VM_THREADED_DISPATCH
 	}
+#endif
 
 done:
 	vm->currentlyInterpreting = qfalse;
 
-	if ( opStack != &stack[1] ) {
-		Com_Error( ERR_DROP, "Interpreter error: opStack = %i", opStack - stack );
+	if ( opStackOfs != 4 ) {
+		Com_Error( ERR_DROP, "Interpreter error: opStack = %i", opStackOfs >> 2 );
 	}
 
 	vm->programStack = stackOnEntry;
 
 	// return the result
-	return *opStack;
+	return stack[1];
 }
@@ -120,6 +120,21 @@ typedef struct vmSymbol_s {
 	char	symName[1];		// variable sized
 } vmSymbol_t;
 
+// the x86-64 compiler can't be used where executable memory isn't allowed
+#if ( defined _M_X64 || defined __x86_64__ ) && !defined WIN8
+#define	VM_X86_64
+#endif
+
+#if defined VM_X86_64 || ( defined _M_IX86 && !defined __GNUC__ )
+#define	VM_HAS_COMPILER
+#endif
+
+// ints VM_Call hands to the bytecode, the call number included
+#define	MAX_VMMAIN_ARGS		10
+
+// syscall arguments are widened to size_t for the handlers
+#define	MAX_VMSYSCALL_ARGS	16
+
 #define	VM_OFFSET_PROGRAM_STACK		0
 #define	VM_OFFSET_SYSTEM_CALL		4
 
@@ -161,6 +176,9 @@ struct vm_s {
 
 // fqpath member added 7/20/02 by T.Ray
 	char		fqpath[MAX_QPATH+1] ;
+
+	// releases whatever the compiler allocated outside the hunk
+	void		(*destroy)( vm_t *self );
 };
 
 
@@ -177,4 +195,5 @@ vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
 void VM_LogSyscalls( int *args );
+int VM_SystemCall( vm_t *vm, int *args );
 
@@ -0,0 +1,1197 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_x86_64.c -- load time compiler and execution environment for x86-64
+
+#include "vm_local.h"
+
+#ifdef VM_X86_64
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*
+
+  rax	scratch
+  rcx	scratch (required for shifts), first helper argument
+  rdx	scratch (required for divisions), second helper argument
+  r8	third helper argument
+  rbx	dataBase
+  rbp	frame pointer of the entry thunk, constant while in generated code
+  r12	opStack base
+  r13	saved rsp while calling out to C
+  r14	opStack byte offset, only ever changed through r14b so it wraps
+		inside the 256 byte window instead of running off the opStack
+  r15	programStack
+
+  All of the vm registers are callee saved in both the Win64 and the
+  System V ABI, so calling out to the engine doesn't disturb them.
+
+  Calls between vm functions use the native call/ret pair, the return
+  address on the vm stack is never looked at.
+
+*/
+
+#define	OPSTACK_SIZE		256
+
+// operand cells on either side of the 256 byte window, so a [r14-4] or
+// [r14+4] access at the wrap point still lands inside the array
+#define	OPSTACK_CELLS		( OPSTACK_SIZE / 4 + 2 )
+
+typedef enum {
+	VM_X64_ERR_JUMP,
+	VM_X64_ERR_CALL,
+	VM_X64_ERR_STACK,
+	VM_X64_ERR_END,
+
+	VM_X64_NUM_ERRORS
+} vmX64Error_t;
+
+// passed to the entry thunk, DO NOT CHANGE without fixing EmitEntry
+typedef struct {
+	byte		*dataBase;			// 0
+	int			*opStack;			// 8
+	int			programStack;		// 16
+	int			opStackOfs;			// 20
+} vmX64Call_t;
+
+static	byte	*buf = NULL;
+static	byte	*jused = NULL;
+static	int		compiledOfs = 0;
+static	byte	*code = NULL;
+static	int		pc = 0;
+
+static	int		instruction, pass;
+static	int		instructionCount;
+
+static	int		syscallOfs;
+static	int		errorOfs[VM_X64_NUM_ERRORS];
+static	int		jumpTableOfs;
+
+static int	Constant4( void ) {
+	int		v;
+
+	v = code[pc] | (code[pc+1]<<8) | (code[pc+2]<<16) | (code[pc+3]<<24);
+	pc += 4;
+	return v;
+}
+
+static int	Constant1( void ) {
+	int		v;
+
+	v = code[pc];
+	pc += 1;
+	return v;
+}
+
+static void Emit1( int v ) {
+	buf[ compiledOfs ] = v;
+	compiledOfs++;
+}
+
+static void Emit4( int v ) {
+	Emit1( v & 255 );
+	Emit1( ( v >> 8 ) & 255 );
+	Emit1( ( v >> 16 ) & 255 );
+	Emit1( ( v >> 24 ) & 255 );
+}
+
+static void Emit8( size_t v ) {
+	Emit4( (int)( v & 0xffffffff ) );
+	Emit4( (int)( v >> 32 ) );
+}
+
+static int Hex( int c ) {
+	if ( c >= 'a' && c <= 'f' ) {
+		return 10 + c - 'a';
+	}
+	if ( c >= 'A' && c <= 'F' ) {
+		return 10 + c - 'A';
+	}
+	if ( c >= '0' && c <= '9' ) {
+		return c - '0';
+	}
+
+	Com_Error( ERR_DROP, "Hex: bad char '%c'", c );
+
+	return 0;
+}
+
+static void EmitString( const char *string ) {
+	int		c1, c2;
+	int		v;
+
+	while ( 1 ) {
+		c1 = string[0];
+		c2 = string[1];
+
+		v = ( Hex( c1 ) << 4 ) | Hex( c2 );
+		Emit1( v );
+
+		if ( !string[2] ) {
+			break;
+		}
+		string += 3;
+	}
+}
+
+/*
+=================
+EmitRel32
+
+Displacement from the end of the 4 byte field to a compiled offset
+=================
+*/
+static void EmitRel32( int target ) {
+	Emit4( target - ( compiledOfs + 4 ) );
+}
+
+/*
+=================
+EmitBranch
+
+Conditional or unconditional transfer to a bytecode instruction.
+Only the second pass knows where forward targets end up, but the
+encoding is always rel32 so the size doesn't change between passes.
+=================
+*/
+static void EmitBranch( vm_t *vm, const char *opcode, int target ) {
+	EmitString( opcode );
+	if ( target < 0 || target >= instructionCount ) {
+		// rejected by VM_ScanBranches, but keep the pass sizes equal
+		EmitRel32( errorOfs[VM_X64_ERR_JUMP] );
+		return;
+	}
+	EmitRel32( vm->instructionPointers[ target ] );
+}
+
+static void EmitPush( void ) {
+	EmitString( "41 80 C6 04" );			// add r14b, 4
+}
+
+static void EmitPop( int count ) {
+	EmitString( "41 80 EE" );				// sub r14b, count * 4
+	Emit1( count * 4 );
+}
+
+/*
+=================
+EmitCallHelper
+
+Calls a C function with up to three 32 bit arguments already loaded
+in ecx, edx and r8d. The stack depth in generated code depends on the
+vm call depth, so it gets realigned here.
+=================
+*/
+static void EmitCallHelper( void *func ) {
+	EmitString( "49 89 E5" );				// mov r13, rsp
+	EmitString( "48 83 E4 F0" );			// and rsp, -16
+	EmitString( "48 83 EC 20" );			// sub rsp, 32 (Win64 home space)
+#ifndef _WIN64
+	EmitString( "89 CF" );					// mov edi, ecx
+	EmitString( "89 D6" );					// mov esi, edx
+	EmitString( "44 89 C2" );				// mov edx, r8d
+#endif
+	EmitString( "48 B8" );					// mov rax, func
+	Emit8( (size_t)func );
+	EmitString( "FF D0" );					// call rax
+	EmitString( "4C 89 EC" );				// mov rsp, r13
+}
+
+/*
+=================
+VM_X64_SystemCall
+
+Called from the syscall stub with the negative call number and the
+current programStack
+=================
+*/
+static int VM_X64_SystemCall( int call, int programStack ) {
+	vm_t	*savedVM;
+	int		*args;
+	int		r;
+
+	savedVM = currentVM;
+
+	// save the stack to allow recursive VM entry
+	currentVM->programStack = programStack - 4;
+	args = (int *)( currentVM->dataBase + ( ( programStack + 4 ) & ( currentVM->dataMask & ~3 ) ) );
+	args[0] = -1 - call;
+//VM_LogSyscalls( args );
+	r = VM_SystemCall( currentVM, args );
+
+	currentVM = savedVM;
+
+	return r;
+}
+
+/*
+=================
+VM_X64_BlockCopy
+
+Same range clamping as the interpreter
+=================
+*/
+static void VM_X64_BlockCopy( int dest, int src, int count ) {
+	int		*s, *d;
+	int		i, srci, desti;
+	int		dataMask;
+
+	dataMask = currentVM->dataMask;
+
+	srci = src & dataMask;
+	desti = dest & dataMask;
+	count = ((srci + count) & dataMask) - srci;
+	count = ((desti + count) & dataMask) - desti;
+
+	if ( ( srci | desti | count ) & 3 ) {
+		Com_Error( ERR_DROP, "OP_BLOCK_COPY not dword aligned" );
+	}
+
+	s = (int *)&currentVM->dataBase[ srci ];
+	d = (int *)&currentVM->dataBase[ desti ];
+	count >>= 2;
+	for ( i = count-1 ; i >= 0 ; i-- ) {
+		d[i] = s[i];
+	}
+}
+
+/*
+=================
+VM_X64_Error
+=================
+*/
+static void VM_X64_Error( int error ) {
+	switch ( error ) {
+	case VM_X64_ERR_JUMP:
+		Com_Error( ERR_DROP, "VM %s: jump target out of range", currentVM->name );
+		break;
+	case VM_X64_ERR_CALL:
+		Com_Error( ERR_DROP, "VM %s: call target out of range", currentVM->name );
+		break;
+	case VM_X64_ERR_STACK:
+		Com_Error( ERR_DROP, "VM %s: stack overflow", currentVM->name );
+		break;
+	default:
+		Com_Error( ERR_DROP, "VM %s: ran off the end of the code", currentVM->name );
+		break;
+	}
+}
+
+/*
+=================
+EmitEntry
+
+void entry( vmX64Call_t *call )
+
+Saves the host registers, loads the vm ones and calls instruction 0.
+On Win64 the prologue is described by the unwind info written in
+VM_Compile, with rbp as the frame register, so the whole block unwinds
+as one function no matter how deep the vm calls are nested.
+=================
+*/
+#define	ENTRY_PROLOGUE_SIZE		17
+
+static void EmitEntry( vm_t *vm ) {
+	EmitString( "55" );						// push rbp
+	EmitString( "53" );						// push rbx
+	EmitString( "41 54" );					// push r12
+	EmitString( "41 55" );					// push r13
+	EmitString( "41 56" );					// push r14
+	EmitString( "41 57" );					// push r15
+	EmitString( "48 83 EC 28" );			// sub rsp, 40
+	EmitString( "48 89 E5" );				// mov rbp, rsp
+
+#ifdef _WIN64
+	EmitString( "48 89 4D 20" );			// mov [rbp+32], rcx
+	EmitString( "48 89 C8" );				// mov rax, rcx
+#else
+	EmitString( "48 89 7D 20" );			// mov [rbp+32], rdi
+	EmitString( "48 89 F8" );				// mov rax, rdi
+#endif
+	EmitString( "48 8B 18" );				// mov rbx, [rax]
+	EmitString( "4C 8B 60 08" );			// mov r12, [rax+8]
+	EmitString( "44 8B 78 10" );			// mov r15d, [rax+16]
+	EmitString( "45 31 F6" );				// xor r14d, r14d
+
+	EmitString( "E8" );						// call instruction 0
+	EmitRel32( vm->instructionPointers[0] );
+
+	EmitString( "48 8B 45 20" );			// mov rax, [rbp+32]
+	EmitString( "44 89 78 10" );			// mov [rax+16], r15d
+	EmitString( "44 89 70 14" );			// mov [rax+20], r14d
+
+	EmitString( "48 8D 65 28" );			// lea rsp, [rbp+40]
+	EmitString( "41 5F" );					// pop r15
+	EmitString( "41 5E" );					// pop r14
+	EmitString( "41 5D" );					// pop r13
+	EmitString( "41 5C" );					// pop r12
+	EmitString( "5B" );						// pop rbx
+	EmitString( "5D" );						// pop rbp
+	EmitString( "C3" );						// ret
+}
+
+/*
+=================
+EmitStubs
+
+Out of line code shared by all instructions: the syscall path and one
+landing pad per runtime error
+=================
+*/
+static void EmitStubs( vm_t *vm ) {
+	int		i;
+
+	// eax = call target, anything that isn't negative failed the range check
+	syscallOfs = compiledOfs;
+	EmitString( "85 C0" );					// test eax, eax
+	EmitString( "0F 89" );					// jns error
+	EmitRel32( errorOfs[VM_X64_ERR_CALL] );
+	EmitString( "89 C1" );					// mov ecx, eax
+	EmitString( "44 89 FA" );				// mov edx, r15d
+	EmitCallHelper( VM_X64_SystemCall );
+	EmitPush();
+	EmitString( "43 89 04 34" );			// mov [r12+r14], eax
+	EmitString( "C3" );						// ret
+
+	for ( i = 0 ; i < VM_X64_NUM_ERRORS ; i++ ) {
+		errorOfs[i] = compiledOfs;
+		EmitString( "B9" );					// mov ecx, error
+		Emit4( i );
+		EmitCallHelper( VM_X64_Error );
+		EmitString( "0F 0B" );				// ud2
+	}
+}
+
+/*
+=================
+VM_OperandSize
+=================
+*/
+static int VM_OperandSize( int op ) {
+	switch ( op ) {
+	case OP_ENTER:
+	case OP_CONST:
+	case OP_LOCAL:
+	case OP_LEAVE:
+	case OP_EQ:
+	case OP_NE:
+	case OP_LTI:
+	case OP_LEI:
+	case OP_GTI:
+	case OP_GEI:
+	case OP_LTU:
+	case OP_LEU:
+	case OP_GTU:
+	case OP_GEU:
+	case OP_EQF:
+	case OP_NEF:
+	case OP_LTF:
+	case OP_LEF:
+	case OP_GTF:
+	case OP_GEF:
+	case OP_BLOCK_COPY:
+		return 4;
+	case OP_ARG:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+=================
+VM_ScanBranches
+
+Validates the bytecode before anything is generated and marks every
+instruction that is the target of a static branch, so the two
+instruction peepholes never swallow one
+=================
+*/
+static void VM_ScanBranches( vm_t *vm, vmHeader_t *header ) {
+	int		op, v;
+
+	pc = 0;
+	for ( instruction = 0 ; instruction < instructionCount ; instruction++ ) {
+		if ( pc >= header->codeLength ) {
+			Com_Error( ERR_DROP, "VM_CompileX64: pc > header->codeLength" );
+		}
+		op = code[pc++];
+		if ( op > OP_CVFI ) {
+			Com_Error( ERR_DROP, "VM_CompileX64: bad opcode %i at offset %i", op, pc-1 );
+		}
+		if ( pc + VM_OperandSize( op ) > header->codeLength ) {
+			Com_Error( ERR_DROP, "VM_CompileX64: operand past end of code" );
+		}
+
+		switch ( op ) {
+		case OP_ENTER:
+			// every frame has room for the return address and the saved
+			// frame, which also keeps runaway recursion bounded by stackBottom
+			v = Constant4();
+			if ( v < 8 ) {
+				Com_Error( ERR_DROP, "VM_CompileX64: bad frame size %i", v );
+			}
+			break;
+		case OP_CONST:
+			v = Constant4();
+			if ( code[pc] == OP_JUMP && v >= 0 && v < instructionCount ) {
+				jused[v] = 1;
+			}
+			break;
+		case OP_EQ:
+		case OP_NE:
+		case OP_LTI:
+		case OP_LEI:
+		case OP_GTI:
+		case OP_GEI:
+		case OP_LTU:
+		case OP_LEU:
+		case OP_GTU:
+		case OP_GEU:
+		case OP_EQF:
+		case OP_NEF:
+		case OP_LTF:
+		case OP_LEF:
+		case OP_GTF:
+		case OP_GEF:
+			v = Constant4();
+			if ( v < 0 || v >= instructionCount ) {
+				Com_Error( ERR_DROP, "VM_CompileX64: branch target %i out of range", v );
+			}
+			jused[v] = 1;
+			break;
+		default:
+			pc += VM_OperandSize( op );
+			break;
+		}
+	}
+}
+
+/*
+=================
+VM_FreeCompiled
+=================
+*/
+static void VM_FreeCompiled( vm_t *vm ) {
+	if ( !vm->codeBase ) {
+		return;
+	}
+#ifdef _WIN64
+	RtlDeleteFunctionTable( (PRUNTIME_FUNCTION)( vm->codeBase + vm->codeLength - sizeof( RUNTIME_FUNCTION ) ) );
+#endif
+#ifdef _WIN32
+	VirtualFree( vm->codeBase, 0, MEM_RELEASE );
+#else
+	munmap( vm->codeBase, vm->codeLength );
+#endif
+	vm->codeBase = NULL;
+}
+
+/*
+=================
+VM_Compile
+=================
+*/
+void VM_Compile( vm_t *vm, vmHeader_t *header ) {
+	int		op;
+	int		maxLength;
+	int		v;
+	int		i;
+	int		start;
+	int		length;
+	byte	*image;
+	void	**jumpTable;
+#ifdef _WIN64
+	byte				*unwind;
+	PRUNTIME_FUNCTION	func;
+	int					unwindOfs;
+	DWORD				oldProtect;
+#endif
+
+	instructionCount = header->instructionCount;
+	code = (byte *)header + header->codeOffset;
+
+	// the work buffers are temp hunk memory, which the next Hunk_Clear
+	// takes back if a Com_Error leaves them behind
+	jused = Hunk_AllocateTempMemory( instructionCount + 2 );
+	Com_Memset( jused, 0, instructionCount + 2 );
+
+	VM_ScanBranches( vm, header );
+
+	// no bytecode instruction expands to more than 64 bytes
+	maxLength = instructionCount * 64 + 1024;
+	buf = Hunk_AllocateTempMemory( maxLength );
+
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+	compiledOfs = 0;
+
+	EmitEntry( vm );
+	EmitStubs( vm );
+
+	// translate all instructions
+	pc = 0;
+	instruction = 0;
+
+	while ( instruction < instructionCount ) {
+		if ( compiledOfs > maxLength - 64 ) {
+			Com_Error( ERR_FATAL, "VM_CompileX64: maxLength exceeded" );
+		}
+
+		start = compiledOfs;
+		vm->instructionPointers[ instruction ] = compiledOfs;
+		instruction++;
+
+		op = code[ pc ];
+		pc++;
+		switch ( op ) {
+		case OP_UNDEF:
+		case OP_IGNORE:
+			break;
+		case OP_BREAK:
+			// the interpreter only counts these
+			break;
+		case OP_ENTER:
+			EmitString( "41 81 EF" );		// sub r15d, frame
+			Emit4( Constant4() );
+			EmitString( "41 81 FF" );		// cmp r15d, stackBottom
+			Emit4( vm->stackBottom );
+			EmitString( "0F 8E" );			// jle error
+			EmitRel32( errorOfs[VM_X64_ERR_STACK] );
+			break;
+		case OP_LEAVE:
+			EmitString( "41 81 C7" );		// add r15d, frame
+			Emit4( Constant4() );
+			EmitString( "C3" );				// ret
+			break;
+
+		case OP_CONST:
+			v = Constant4();
+
+			// fold the constant into the instruction that uses it,
+			// unless something branches straight to that instruction
+			op = ( instruction < instructionCount && !jused[instruction] ) ? code[pc] : OP_UNDEF;
+
+			switch ( op ) {
+			case OP_CALL:
+				if ( v >= 0 && v < instructionCount ) {
+					EmitString( "E8" );				// call instruction
+					EmitRel32( vm->instructionPointers[ v ] );
+				} else if ( v < 0 ) {
+					EmitString( "B8" );				// mov eax, syscall
+					Emit4( v );
+					EmitString( "E8" );				// call syscall stub
+					EmitRel32( syscallOfs );
+				} else {
+					EmitString( "E9" );				// jmp error
+					EmitRel32( errorOfs[VM_X64_ERR_CALL] );
+				}
+				break;
+			case OP_JUMP:
+				EmitBranch( vm, "E9", v );			// jmp instruction
+				break;
+			case OP_LOAD4:
+				EmitPush();
+				EmitString( "8B 83" );				// mov eax, [rbx+const]
+				Emit4( v & vm->dataMask );
+				EmitString( "43 89 04 34" );		// mov [r12+r14], eax
+				break;
+			case OP_LOAD2:
+				EmitPush();
+				EmitString( "0F B7 83" );			// movzx eax, word [rbx+const]
+				Emit4( v & vm->dataMask );
+				EmitString( "43 89 04 34" );		// mov [r12+r14], eax
+				break;
+			case OP_LOAD1:
+				EmitPush();
+				EmitString( "0F B6 83" );			// movzx eax, byte [rbx+const]
+				Emit4( v & vm->dataMask );
+				EmitString( "43 89 04 34" );		// mov [r12+r14], eax
+				break;
+			case OP_ADD:
+				EmitString( "43 81 04 34" );		// add dword [r12+r14], const
+				Emit4( v );
+				break;
+			case OP_SUB:
+				EmitString( "43 81 2C 34" );		// sub dword [r12+r14], const
+				Emit4( v );
+				break;
+			case OP_BAND:
+				EmitString( "43 81 24 34" );		// and dword [r12+r14], const
+				Emit4( v );
+				break;
+			case OP_BOR:
+				EmitString( "43 81 0C 34" );		// or dword [r12+r14], const
+				Emit4( v );
+				break;
+			case OP_BXOR:
+				EmitString( "43 81 34 34" );		// xor dword [r12+r14], const
+				Emit4( v );
+				break;
+			case OP_LSH:
+				EmitString( "43 C1 24 34" );		// shl dword [r12+r14], const
+				Emit1( v & 31 );
+				break;
+			case OP_RSHI:
+				EmitString( "43 C1 3C 34" );		// sar dword [r12+r14], const
+				Emit1( v & 31 );
+				break;
+			case OP_RSHU:
+				EmitString( "43 C1 2C 34" );		// shr dword [r12+r14], const
+				Emit1( v & 31 );
+				break;
+			case OP_MULI:
+			case OP_MULU:
+				EmitString( "43 8B 04 34" );		// mov eax, [r12+r14]
+				EmitString( "69 C0" );				// imul eax, eax, const
+				Emit4( v );
+				EmitString( "43 89 04 34" );		// mov [r12+r14], eax
+				break;
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+				EmitPop( 1 );
+				EmitString( "43 81 7C 34 04" );		// cmp dword [r12+r14+4], const
+				Emit4( v );
+				break;
+			default:
+				EmitPush();
+				EmitString( "43 C7 04 34" );		// mov dword [r12+r14], const
+				Emit4( v );
+				break;
+			}
+
+			if ( op == OP_UNDEF ) {
+				break;
+			}
+
+			// the folded instruction shares this code
+			switch ( op ) {
+			case OP_CALL:
+			case OP_JUMP:
+			case OP_LOAD4:
+			case OP_LOAD2:
+			case OP_LOAD1:
+			case OP_ADD:
+			case OP_SUB:
+			case OP_BAND:
+			case OP_BOR:
+			case OP_BXOR:
+			case OP_LSH:
+			case OP_RSHI:
+			case OP_RSHU:
+			case OP_MULI:
+			case OP_MULU:
+				vm->instructionPointers[ instruction ] = start;
+				instruction++;
+				pc++;
+				break;
+			case OP_EQ:
+			case OP_NE:
+			case OP_LTI:
+			case OP_LEI:
+			case OP_GTI:
+			case OP_GEI:
+			case OP_LTU:
+			case OP_LEU:
+			case OP_GTU:
+			case OP_GEU:
+				vm->instructionPointers[ instruction ] = start;
+				instruction++;
+				pc++;
+				v = Constant4();
+				switch ( op ) {
+				case OP_EQ:		EmitBranch( vm, "0F 84", v ); break;	// je
+				case OP_NE:		EmitBranch( vm, "0F 85", v ); break;	// jne
+				case OP_LTI:	EmitBranch( vm, "0F 8C", v ); break;	// jl
+				case OP_LEI:	EmitBranch( vm, "0F 8E", v ); break;	// jle
+				case OP_GTI:	EmitBranch( vm, "0F 8F", v ); break;	// jg
+				case OP_GEI:	EmitBranch( vm, "0F 8D", v ); break;	// jge
+				case OP_LTU:	EmitBranch( vm, "0F 82", v ); break;	// jb
+				case OP_LEU:	EmitBranch( vm, "0F 86", v ); break;	// jbe
+				case OP_GTU:	EmitBranch( vm, "0F 87", v ); break;	// ja
+				default:		EmitBranch( vm, "0F 83", v ); break;	// jae
+				}
+				break;
+			default:
+				break;
+			}
+			break;
+
+		case OP_LOCAL:
+			v = Constant4();
+			EmitString( "41 8D 87" );		// lea eax, [r15+const]
+			Emit4( v );
+			if ( instruction < instructionCount && !jused[instruction] && code[pc] == OP_LOAD4 ) {
+				EmitString( "25" );			// and eax, dataMask
+				Emit4( vm->dataMask );
+				EmitString( "8B 04 03" );	// mov eax, [rbx+rax]
+				vm->instructionPointers[ instruction ] = start;
+				instruction++;
+				pc++;
+			}
+			EmitPush();
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+
+		case OP_ARG:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "41 8D 8F" );		// lea ecx, [r15+const]
+			Emit4( Constant1() );
+			EmitString( "81 E1" );			// and ecx, dataMask
+			Emit4( vm->dataMask );
+			EmitString( "89 04 0B" );		// mov [rbx+rcx], eax
+			break;
+
+		case OP_CALL:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "3D" );				// cmp eax, instructionCount
+			Emit4( instructionCount );
+			EmitString( "73 0C" );			// jae syscall
+			EmitString( "48 8D 0D" );		// lea rcx, [jumpTable]
+			EmitRel32( jumpTableOfs );
+			EmitString( "FF 14 C1" );		// call [rcx+rax*8]
+			EmitString( "EB 05" );			// jmp done
+			EmitString( "E8" );				// syscall: call syscall stub
+			EmitRel32( syscallOfs );
+			break;							// done:
+
+		case OP_JUMP:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "3D" );				// cmp eax, instructionCount
+			Emit4( instructionCount );
+			EmitString( "0F 83" );			// jae error
+			EmitRel32( errorOfs[VM_X64_ERR_JUMP] );
+			EmitString( "48 8D 0D" );		// lea rcx, [jumpTable]
+			EmitRel32( jumpTableOfs );
+			EmitString( "FF 24 C1" );		// jmp [rcx+rax*8]
+			break;
+
+		// push and pop are only needed for discarded or bad function return values
+		case OP_PUSH:
+			EmitPush();
+			break;
+		case OP_POP:
+			EmitPop( 1 );
+			break;
+
+		case OP_LOAD4:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "25" );				// and eax, dataMask
+			Emit4( vm->dataMask );
+			EmitString( "8B 04 03" );		// mov eax, [rbx+rax]
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+		case OP_LOAD2:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "25" );				// and eax, dataMask
+			Emit4( vm->dataMask );
+			EmitString( "0F B7 04 03" );	// movzx eax, word [rbx+rax]
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+		case OP_LOAD1:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "25" );				// and eax, dataMask
+			Emit4( vm->dataMask );
+			EmitString( "0F B6 04 03" );	// movzx eax, byte [rbx+rax]
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+
+		case OP_STORE4:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "43 8B 4C 34 FC" );	// mov ecx, [r12+r14-4]
+			EmitString( "81 E1" );			// and ecx, dataMask & ~3
+			Emit4( vm->dataMask & ~3 );
+			EmitString( "89 04 0B" );		// mov [rbx+rcx], eax
+			EmitPop( 2 );
+			break;
+		case OP_STORE2:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "43 8B 4C 34 FC" );	// mov ecx, [r12+r14-4]
+			EmitString( "81 E1" );			// and ecx, dataMask & ~1
+			Emit4( vm->dataMask & ~1 );
+			EmitString( "66 89 04 0B" );	// mov [rbx+rcx], ax
+			EmitPop( 2 );
+			break;
+		case OP_STORE1:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitString( "43 8B 4C 34 FC" );	// mov ecx, [r12+r14-4]
+			EmitString( "81 E1" );			// and ecx, dataMask
+			Emit4( vm->dataMask );
+			EmitString( "88 04 0B" );		// mov [rbx+rcx], al
+			EmitPop( 2 );
+			break;
+
+		case OP_BLOCK_COPY:
+			EmitString( "43 8B 4C 34 FC" );	// mov ecx, [r12+r14-4]
+			EmitString( "43 8B 14 34" );	// mov edx, [r12+r14]
+			EmitString( "41 B8" );			// mov r8d, count
+			Emit4( Constant4() );
+			EmitCallHelper( VM_X64_BlockCopy );
+			EmitPop( 2 );
+			break;
+
+		case OP_EQ:
+		case OP_NE:
+		case OP_LTI:
+		case OP_LEI:
+		case OP_GTI:
+		case OP_GEI:
+		case OP_LTU:
+		case OP_LEU:
+		case OP_GTU:
+		case OP_GEU:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "43 8B 0C 34" );	// mov ecx, [r12+r14]
+			EmitPop( 2 );
+			EmitString( "39 C8" );			// cmp eax, ecx
+			v = Constant4();
+			switch ( op ) {
+			case OP_EQ:		EmitBranch( vm, "0F 84", v ); break;	// je
+			case OP_NE:		EmitBranch( vm, "0F 85", v ); break;	// jne
+			case OP_LTI:	EmitBranch( vm, "0F 8C", v ); break;	// jl
+			case OP_LEI:	EmitBranch( vm, "0F 8E", v ); break;	// jle
+			case OP_GTI:	EmitBranch( vm, "0F 8F", v ); break;	// jg
+			case OP_GEI:	EmitBranch( vm, "0F 8D", v ); break;	// jge
+			case OP_LTU:	EmitBranch( vm, "0F 82", v ); break;	// jb
+			case OP_LEU:	EmitBranch( vm, "0F 86", v ); break;	// jbe
+			case OP_GTU:	EmitBranch( vm, "0F 87", v ); break;	// ja
+			default:		EmitBranch( vm, "0F 83", v ); break;	// jae
+			}
+			break;
+
+		// ucomiss flags an unordered result like "less", so the less
+		// than tests swap their operands and everything uses the
+		// "above" conditions, which are false for NaN just like C
+		case OP_EQF:
+		case OP_NEF:
+		case OP_LTF:
+		case OP_LEF:
+		case OP_GTF:
+		case OP_GEF:
+			EmitString( "F3 43 0F 10 44 34 FC" );	// movss xmm0, [r12+r14-4]
+			EmitString( "F3 43 0F 10 0C 34" );		// movss xmm1, [r12+r14]
+			EmitPop( 2 );
+			v = Constant4();
+			switch ( op ) {
+			case OP_EQF:
+				EmitString( "0F 2E C1" );			// ucomiss xmm0, xmm1
+				EmitString( "7A 06" );				// jp skip
+				EmitBranch( vm, "0F 84", v );		// je
+				break;								// skip:
+			case OP_NEF:
+				EmitString( "0F 2E C1" );			// ucomiss xmm0, xmm1
+				EmitBranch( vm, "0F 8A", v );		// jp
+				EmitBranch( vm, "0F 85", v );		// jne
+				break;
+			case OP_LTF:
+				EmitString( "0F 2E C8" );			// ucomiss xmm1, xmm0
+				EmitBranch( vm, "0F 87", v );		// ja
+				break;
+			case OP_LEF:
+				EmitString( "0F 2E C8" );			// ucomiss xmm1, xmm0
+				EmitBranch( vm, "0F 83", v );		// jae
+				break;
+			case OP_GTF:
+				EmitString( "0F 2E C1" );			// ucomiss xmm0, xmm1
+				EmitBranch( vm, "0F 87", v );		// ja
+				break;
+			default:
+				EmitString( "0F 2E C1" );			// ucomiss xmm0, xmm1
+				EmitBranch( vm, "0F 83", v );		// jae
+				break;
+			}
+			break;
+
+		case OP_NEGI:
+			EmitString( "43 F7 1C 34" );	// neg dword [r12+r14]
+			break;
+		case OP_ADD:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 01 04 34" );	// add [r12+r14], eax
+			break;
+		case OP_SUB:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 29 04 34" );	// sub [r12+r14], eax
+			break;
+		case OP_DIVI:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "99" );				// cdq
+			EmitString( "43 F7 3C 34" );	// idiv dword [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+		case OP_DIVU:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "31 D2" );			// xor edx, edx
+			EmitString( "43 F7 34 34" );	// div dword [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+		case OP_MODI:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "99" );				// cdq
+			EmitString( "43 F7 3C 34" );	// idiv dword [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 89 14 34" );	// mov [r12+r14], edx
+			break;
+		case OP_MODU:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "31 D2" );			// xor edx, edx
+			EmitString( "43 F7 34 34" );	// div dword [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 89 14 34" );	// mov [r12+r14], edx
+			break;
+		case OP_MULI:
+		case OP_MULU:
+			EmitString( "43 8B 44 34 FC" );	// mov eax, [r12+r14-4]
+			EmitString( "43 0F AF 04 34" );	// imul eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 89 04 34" );	// mov [r12+r14], eax
+			break;
+
+		case OP_BAND:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 21 04 34" );	// and [r12+r14], eax
+			break;
+		case OP_BOR:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 09 04 34" );	// or [r12+r14], eax
+			break;
+		case OP_BXOR:
+			EmitString( "43 8B 04 34" );	// mov eax, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 31 04 34" );	// xor [r12+r14], eax
+			break;
+		case OP_BCOM:
+			EmitString( "43 F7 14 34" );	// not dword [r12+r14]
+			break;
+
+		case OP_LSH:
+			EmitString( "43 8B 0C 34" );	// mov ecx, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 D3 24 34" );	// shl dword [r12+r14], cl
+			break;
+		case OP_RSHI:
+			EmitString( "43 8B 0C 34" );	// mov ecx, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 D3 3C 34" );	// sar dword [r12+r14], cl
+			break;
+		case OP_RSHU:
+			EmitString( "43 8B 0C 34" );	// mov ecx, [r12+r14]
+			EmitPop( 1 );
+			EmitString( "43 D3 2C 34" );	// shr dword [r12+r14], cl
+			break;
+
+		case OP_NEGF:
+			EmitString( "43 81 34 34 00 00 00 80" );	// xor dword [r12+r14], 0x80000000
+			break;
+		case OP_ADDF:
+		case OP_SUBF:
+		case OP_DIVF:
+		case OP_MULF:
+			EmitString( "F3 43 0F 10 44 34 FC" );	// movss xmm0, [r12+r14-4]
+			switch ( op ) {
+			case OP_ADDF:	EmitString( "F3 43 0F 58 04 34" ); break;	// addss xmm0, [r12+r14]
+			case OP_SUBF:	EmitString( "F3 43 0F 5C 04 34" ); break;	// subss xmm0, [r12+r14]
+			case OP_DIVF:	EmitString( "F3 43 0F 5E 04 34" ); break;	// divss xmm0, [r12+r14]
+			default:		EmitString( "F3 43 0F 59 04 34" ); break;	// mulss xmm0, [r12+r14]
+			}
+			EmitPop( 1 );
+			EmitString( "F3 43 0F 11 04 34" );		// movss [r12+r14], xmm0
+			break;
+
+		case OP_CVIF:
+			EmitString( "F3 43 0F 2A 04 34" );		// cvtsi2ss xmm0, dword [r12+r14]
+			EmitString( "F3 43 0F 11 04 34" );		// movss [r12+r14], xmm0
+			break;
+		case OP_CVFI:
+			EmitString( "F3 43 0F 2C 04 34" );		// cvttss2si eax, dword [r12+r14]
+			EmitString( "43 89 04 34" );			// mov [r12+r14], eax
+			break;
+		case OP_SEX8:
+			EmitString( "43 0F BE 04 34" );			// movsx eax, byte [r12+r14]
+			EmitString( "43 89 04 34" );			// mov [r12+r14], eax
+			break;
+		case OP_SEX16:
+			EmitString( "43 0F BF 04 34" );			// movsx eax, word [r12+r14]
+			EmitString( "43 89 04 34" );			// mov [r12+r14], eax
+			break;
+
+		default:
+			Com_Error( ERR_DROP, "VM_CompileX64: bad opcode %i at offset %i", op, pc );
+		}
+	}
+
+	// falling off the end of the last function
+	EmitString( "E9" );						// jmp error
+	EmitRel32( errorOfs[VM_X64_ERR_END] );
+
+	jumpTableOfs = ( compiledOfs + 7 ) & ~7;
+	}
+
+	// the code is followed by the jump table and, on Win64, the unwind data
+	length = jumpTableOfs + instructionCount * sizeof( void * );
+#ifdef _WIN64
+	unwindOfs = length;
+	length += 20 + sizeof( RUNTIME_FUNCTION );
+#endif
+
+#ifdef _WIN32
+	image = VirtualAlloc( NULL, length, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	if ( !image ) {
+		Com_Error( ERR_FATAL, "VM_CompileX64: VirtualAlloc failed" );
+	}
+#else
+	image = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( image == MAP_FAILED ) {
+		Com_Error( ERR_FATAL, "VM_CompileX64: mmap failed" );
+	}
+#endif
+
+	Com_Memcpy( image, buf, compiledOfs );
+	Com_Memset( image + compiledOfs, 0xCC, jumpTableOfs - compiledOfs );
+
+	jumpTable = (void **)( image + jumpTableOfs );
+	for ( i = 0 ; i < instructionCount ; i++ ) {
+		jumpTable[i] = image + vm->instructionPointers[i];
+	}
+
+#ifdef _WIN64
+	unwind = image + unwindOfs;
+	unwind[0] = 1;							// version 1, no flags
+	unwind[1] = ENTRY_PROLOGUE_SIZE;
+	unwind[2] = 8;							// unwind codes
+	unwind[3] = 5;							// frame register rbp, offset 0
+	unwind[4] = 17;	unwind[5] = 0x03;		// mov rbp, rsp: UWOP_SET_FPREG
+	unwind[6] = 14;	unwind[7] = 0x42;		// sub rsp, 40: UWOP_ALLOC_SMALL
+	unwind[8] = 10;	unwind[9] = 0xF0;		// push r15: UWOP_PUSH_NONVOL
+	unwind[10] = 8;	unwind[11] = 0xE0;		// push r14
+	unwind[12] = 6;	unwind[13] = 0xD0;		// push r13
+	unwind[14] = 4;	unwind[15] = 0xC0;		// push r12
+	unwind[16] = 2;	unwind[17] = 0x30;		// push rbx
+	unwind[18] = 1;	unwind[19] = 0x50;		// push rbp
+
+	func = (PRUNTIME_FUNCTION)( unwind + 20 );
+	func->BeginAddress = 0;
+	func->EndAddress = compiledOfs;
+	func->UnwindData = unwindOfs;
+
+	if ( !VirtualProtect( image, length, PAGE_EXECUTE_READ, &oldProtect ) ) {
+		Com_Error( ERR_FATAL, "VM_CompileX64: VirtualProtect failed" );
+	}
+	FlushInstructionCache( GetCurrentProcess(), image, length );
+	RtlAddFunctionTable( func, 1, (DWORD64)image );
+#else
+	if ( mprotect( image, length, PROT_READ | PROT_EXEC ) ) {
+		Com_Error( ERR_FATAL, "VM_CompileX64: mprotect failed" );
+	}
+#endif
+
+	Hunk_FreeTempMemory( buf );
+	Hunk_FreeTempMemory( jused );
+	buf = NULL;
+	jused = NULL;
+
+	vm->codeBase = image;
+	vm->codeLength = length;
+	vm->destroy = VM_FreeCompiled;
+
+	Com_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
+}
+
+/*
+==============
+VM_CallCompiled
+
+The instruction pointers stay relative to codeBase, the generated code
+goes through its own table of absolute addresses
+==============
+*/
+int	VM_CallCompiled( vm_t *vm, int *args ) {
+	int			stack[OPSTACK_CELLS];
+	vmX64Call_t	call;
+	int			programStack;
+	int			stackOnEntry;
+	byte		*image;
+
+	currentVM = vm;
+
+	// we might be called recursively, so this might not be the very top
+	programStack = vm->programStack;
+	stackOnEntry = programStack;
+
+	// set up the stack frame
+	image = vm->dataBase;
+
+	programStack -= 48;
+
+	*(int *)&image[ programStack + 44] = args[9];
+	*(int *)&image[ programStack + 40] = args[8];
+	*(int *)&image[ programStack + 36] = args[7];
+	*(int *)&image[ programStack + 32] = args[6];
+	*(int *)&image[ programStack + 28] = args[5];
+	*(int *)&image[ programStack + 24] = args[4];
+	*(int *)&image[ programStack + 20] = args[3];
+	*(int *)&image[ programStack + 16] = args[2];
+	*(int *)&image[ programStack + 12] = args[1];
+	*(int *)&image[ programStack + 8 ] = args[0];
+	*(int *)&image[ programStack + 4 ] = 0;	// return stack
+	*(int *)&image[ programStack ] = -1;	// will terminate the loop on return
+
+	// off we go into generated code...
+	call.dataBase = image;
+	call.opStack = &stack[1];
+	call.programStack = programStack;
+	call.opStackOfs = 0;
+
+	((void (*)( vmX64Call_t * ))vm->codeBase)( &call );
+
+	if ( call.opStackOfs != 4 ) {
+		Com_Error( ERR_DROP, "opStack corrupted in compiled code" );
+	}
+	if ( call.programStack != stackOnEntry - 48 ) {
+		Com_Error( ERR_DROP, "programStack corrupted in compiled code" );
+	}
+
+	vm->programStack = stackOnEntry;
+
+	return stack[2];
+}
+
+#endif // VM_X86_64
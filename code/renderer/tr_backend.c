@@ -820,13 +820,22 @@ smp extensions, or asynchronously by another thread.
 */
 void RB_ExecuteRenderCommands( const void *data ) {
 	int		t1, t2;
+	int		i;
 
 	t1 = ri.Milliseconds ();
 
-	if ( !r_smp->integer || data == backEndData[0]->commands.cmds ) {
-		backEnd.smpFrame = 0;
-	} else {
-		backEnd.smpFrame = 1;
+	// only this thread touches the back end counters while it runs,
+	// so they count the last command list when r_speeds prints them
+	Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
+
+	backEnd.smpFrame = 0;
+	if ( r_smp->integer ) {
+		for ( i = 0 ; i < SMP_FRAMES ; i++ ) {
+			if ( backEndData[i] && data == backEndData[i]->commands.cmds ) {
+				backEnd.smpFrame = i;
+				break;
+			}
+		}
 	}
 
 	while ( 1 ) {
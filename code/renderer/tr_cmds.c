@@ -34,9 +34,9 @@ R_PerformanceCounters
 */
 void R_PerformanceCounters( void ) {
 	if ( !r_speeds->integer ) {
-		// clear the counters even if we aren't printing
+		// clear the counters even if we aren't printing, the back end
+		// clears its own at the start of each command list
 		Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
-		Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
 		return;
 	}
 
@@ -72,7 +72,6 @@ void R_PerformanceCounters( void ) {
 	}
 
 	Com_Memset( &tr.pc, 0, sizeof( tr.pc ) );
-	Com_Memset( &backEnd.pc, 0, sizeof( backEnd.pc ) );
 }
 
 
@@ -102,7 +101,7 @@ R_ShutdownCommandBuffers
 void R_ShutdownCommandBuffers( void ) {
 	// kill the rendering thread
 	if ( vdConfig.smpActive ) {
-        RSMP_WakeRenderer( NULL );
+        RSMP_ShutdownRenderThread();
 		vdConfig.smpActive = qfalse;
 	}
 }
@@ -126,26 +125,11 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 	// clear it out, in case this is a sync and not a buffer flip
 	cmdList->used = 0;
 
-	if ( vdConfig.smpActive ) {
-		// if the render thread is not idle, wait for it
-		if ( renderThreadActive ) {
-			c_blockedOnRender++;
-			if ( r_showSmp->integer ) {
-				ri.Printf( PRINT_ALL, "R" );
-			}
-		} else {
-			c_blockedOnMain++;
-			if ( r_showSmp->integer ) {
-				ri.Printf( PRINT_ALL, "." );
-			}
-		}
-
-		// sleep until the renderer has completed
+	// the render thread may still be working on earlier frames, only
+	// wait for it when the counters are going to be printed
+	if ( runPerformanceCounters && vdConfig.smpActive && r_speeds->integer ) {
 		RSMP_FrontEndSleep();
 	}
-
-	// at this point, the back end thread is idle, so it is ok
-	// to look at it's performance counters
 	if ( runPerformanceCounters ) {
 		R_PerformanceCounters();
 	}
@@ -156,7 +140,33 @@ void R_IssueRenderCommands( qboolean runPerformanceCounters ) {
 		if ( !vdConfig.smpActive ) {
 			RB_ExecuteRenderCommands( cmdList->cmds );
 		} else {
-            RSMP_WakeRenderer( cmdList );
+            RSMP_WakeRenderer( cmdList->cmds, tr.smpFrame );
+		}
+	}
+}
+
+/*
+====================
+R_WaitForSmpFrame
+
+Called before the front end starts filling a set of frame buffers
+that may still be queued for the render thread.
+====================
+*/
+void R_WaitForSmpFrame( int frame ) {
+	if ( !vdConfig.smpActive ) {
+		return;
+	}
+
+	if ( RSMP_WaitForFrame( frame ) ) {
+		c_blockedOnRender++;
+		if ( r_showSmp->integer ) {
+			ri.Printf( PRINT_ALL, "R" );
+		}
+	} else if ( RSMP_RendererIdle() ) {
+		c_blockedOnMain++;
+		if ( r_showSmp->integer ) {
+			ri.Printf( PRINT_ALL, "." );
 		}
 	}
 }
@@ -188,27 +198,37 @@ void R_SyncRenderThread( void ) {
 ============
 R_GetCommandBuffer
 
-make sure there is enough command space, waiting on the
-render thread if needed.
+make sure there is enough command space.  The space is claimed
+atomically, so front end threads can add commands to the same
+frame, but each command has to be complete in the space it claims.
 ============
 */
 void *R_GetCommandBuffer( int bytes ) {
 	renderCommandList_t	*cmdList;
+	int		offset;
 
 	cmdList = &backEndData[tr.smpFrame]->commands;
 
+	if ( bytes > MAX_RENDER_COMMANDS - 4 ) {
+		ri.Error( ERR_FATAL, "R_GetCommandBuffer: bad size %i", bytes );
+	}
+
 	// always leave room for the end of list command
-	if ( cmdList->used + bytes + 4 > MAX_RENDER_COMMANDS ) {
-		if ( bytes > MAX_RENDER_COMMANDS - 4 ) {
-			ri.Error( ERR_FATAL, "R_GetCommandBuffer: bad size %i", bytes );
-		}
-		// if we run out of room, just start dropping commands
-		return NULL;
+	if ( vdConfig.smpActive ) {
+		offset = RSMP_ReserveCommands( &cmdList->used, bytes, MAX_RENDER_COMMANDS - 4 );
+	} else if ( cmdList->used + bytes + 4 > MAX_RENDER_COMMANDS ) {
+		offset = -1;
+	} else {
+		offset = cmdList->used;
+		cmdList->used += bytes;
 	}
 
-	cmdList->used += bytes;
+	// if we run out of room, just start dropping commands
+	if ( offset < 0 ) {
+		return NULL;
+	}
 
-	return cmdList->cmds + cmdList->used - bytes;
+	return cmdList->cmds + offset;
 }
 
 
@@ -439,6 +459,9 @@ void RE_EndFrame( int *frontEndMsec, int *backEndMsec ) {
 	if ( backEndMsec ) {
 		*backEndMsec = backEnd.pc.msec;
 	}
-	backEnd.pc.msec = 0;
+	// the render thread may be running the next list already
+	if ( !vdConfig.smpActive ) {
+		backEnd.pc.msec = 0;
+	}
 }
 
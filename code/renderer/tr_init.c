@@ -807,17 +807,15 @@ void R_Init( void ) {
 	if (max_polyverts < MAX_POLYVERTS)
 		max_polyverts = MAX_POLYVERTS;
 
-	ptr = ri.Hunk_Alloc( sizeof( *backEndData[0] ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
-	backEndData[0] = (backEndData_t *) ptr;
-	backEndData[0]->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData[0] ));
-	backEndData[0]->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData[0] ) + sizeof(srfPoly_t) * max_polys);
-	if ( r_smp->integer ) {
-		ptr = ri.Hunk_Alloc( sizeof( *backEndData[1] ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
-		backEndData[1] = (backEndData_t *) ptr;
-		backEndData[1]->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData[1] ));
-		backEndData[1]->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData[1] ) + sizeof(srfPoly_t) * max_polys);
-	} else {
-		backEndData[1] = NULL;
+	for ( i = 0 ; i < SMP_FRAMES ; i++ ) {
+		if ( i > 0 && !r_smp->integer ) {
+			backEndData[i] = NULL;
+			continue;
+		}
+		ptr = ri.Hunk_Alloc( sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys + sizeof(polyVert_t) * max_polyverts, h_low);
+		backEndData[i] = (backEndData_t *) ptr;
+		backEndData[i]->polys = (srfPoly_t *) ((char *) ptr + sizeof( *backEndData[i] ));
+		backEndData[i]->polyVerts = (polyVert_t *) ((char *) ptr + sizeof( *backEndData[i] ) + sizeof(srfPoly_t) * max_polys);
 	}
 	R_ToggleSmpFrame();
 
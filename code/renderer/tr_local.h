@@ -41,9 +41,10 @@ long myftol( float f );
 
 
 // everything that is needed by the backend needs
-// to be double buffered to allow it to run in
-// parallel on a dual cpu machine
-#define	SMP_FRAMES		2
+// to be buffered per frame to allow it to run in
+// parallel, the front end can get SMP_FRAMES - 1
+// frames ahead of the render thread
+#define	SMP_FRAMES		3
 
 // 12 bits
 // see QSORT_SHADERNUM_SHIFT
@@ -938,7 +939,7 @@ typedef struct {
 	int						viewCount;		// incremented every view (twice a scene if portaled)
 											// and every R_MarkFragments call
 
-	int						smpFrame;		// toggles from 0 to 1 every endFrame
+	int						smpFrame;		// cycles through SMP_FRAMES every endFrame
 
 	int						frameSceneNum;	// zeroed at RE_BeginFrame
 
@@ -1323,8 +1324,12 @@ SMP
 
 void* RSMP_RendererSleep( void );
 qboolean RSMP_SpawnRenderThread( void (*function)( void ) );
-void RSMP_WakeRenderer( void *data );
+void RSMP_ShutdownRenderThread( void );
+void RSMP_WakeRenderer( void *data, int frame );
 void RSMP_FrontEndSleep( void );
+qboolean RSMP_WaitForFrame( int frame );
+qboolean RSMP_RendererIdle( void );
+int RSMP_ReserveCommands( int *used, int bytes, int limit );
 
 /*
 ============================================================
@@ -1591,7 +1596,7 @@ typedef struct {
 extern	int		max_polys;
 extern	int		max_polyverts;
 
-extern	backEndData_t	*backEndData[SMP_FRAMES];	// the second one may not be allocated
+extern	backEndData_t	*backEndData[SMP_FRAMES];	// only the first is allocated without r_smp
 
 extern	volatile renderCommandList_t	*renderCommandList;
 
@@ -1604,6 +1609,7 @@ void R_InitCommandBuffers( void );
 void R_ShutdownCommandBuffers( void );
 
 void R_SyncRenderThread( void );
+void R_WaitForSmpFrame( int frame );
 
 void R_AddDrawSurfCmd( drawSurf_t *drawSurfs, int numDrawSurfs );
 
@@ -151,6 +151,11 @@ typedef struct {
 	int		(*FS_FileIsInPAK)( const char *name, int *pCheckSum );
 	int		(*FS_ReadFile)( const char *name, void **buf );
 	void	(*FS_FreeFile)( void *buf );
+	// loads on the I/O threads, calling back from FS_FinishAsyncLoads at the latest
+	int		(*FS_ReadFileAsync)( const char *name, int priority,
+				void (*callback)( const char *name, void *buf, int len, void *data ), void *data );
+	void	(*FS_FinishAsyncLoads)( void );
+	void	(*FS_FreeAsyncFile)( void *buf );
 	char **	(*FS_ListFiles)( const char *name, const char *extension, int *numfilesfound );
 	void	(*FS_FreeFileList)( char **filelist );
 	void	(*FS_WriteFile)( const char *qpath, const void *buffer, int size );
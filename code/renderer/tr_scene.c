@@ -44,9 +44,11 @@ R_ToggleSmpFrame
 */
 void R_ToggleSmpFrame( void ) {
 	if ( r_smp->integer ) {
-		// use the other buffers next frame, because another CPU
-		// may still be rendering into the current ones
-		tr.smpFrame ^= 1;
+		// use the next buffers, the render thread may still be
+		// working on the current ones, and waits only if it
+		// is still on the frame we are about to reuse
+		tr.smpFrame = ( tr.smpFrame + 1 ) % SMP_FRAMES;
+		R_WaitForSmpFrame( tr.smpFrame );
 	} else {
 		tr.smpFrame = 0;
 	}
@@ -2847,6 +2847,12 @@ a single large text block that can be scanned for shader names
 =====================
 */
 #define	MAX_SHADER_FILES	4096
+
+static void ShaderFileLoaded( const char *name, void *buf, int len, void *data )
+{
+	*(char **)data = buf;
+}
+
 static void ScanAndLoadShaderFiles( void )
 {
 	char **shaderFiles;
@@ -2871,15 +2877,32 @@ static void ScanAndLoadShaderFiles( void )
 		numShaders = MAX_SHADER_FILES;
 	}
 
-	// load and parse shader files
+	// load all the shader files at once on the file threads
 	for ( i = 0; i < numShaders; i++ )
 	{
 		char filename[MAX_QPATH];
+		int len;
 
 		Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
 		ri.Printf( PRINT_ALL, "...loading '%s'\n", filename );
-		sum += ri.FS_ReadFile( filename, (void **)&buffers[i] );
+		buffers[i] = NULL;
+		len = ri.FS_ReadFileAsync( filename, FS_LOAD_HIGH, ShaderFileLoaded, &buffers[i] );
+		if ( len > 0 ) {
+			sum += len;
+		}
+	}
+	ri.FS_FinishAsyncLoads();
+
+	for ( i = 0; i < numShaders; i++ )
+	{
 		if ( !buffers[i] ) {
+			char filename[MAX_QPATH];
+
+			Com_sprintf( filename, sizeof( filename ), "scripts/%s", shaderFiles[i] );
+			for ( i = 0; i < numShaders; i++ ) {
+				ri.FS_FreeAsyncFile( buffers[i] );
+			}
+			ri.FS_FreeFileList( shaderFiles );
 			ri.Error( ERR_DROP, "Couldn't load %s", filename );
 		}
 	}
@@ -2887,12 +2910,12 @@ static void ScanAndLoadShaderFiles( void )
 	// build single large buffer
 	s_shaderText = ri.Hunk_Alloc( sum + numShaders*2, h_low );
 
-	// free in reverse order, so the temp files are all dumped
+	// copy them in, last file first
 	for ( i = numShaders - 1; i >= 0 ; i-- ) {
 		strcat( s_shaderText, "\n" );
 		p = &s_shaderText[strlen(s_shaderText)];
 		strcat( s_shaderText, buffers[i] );
-		ri.FS_FreeFile( buffers[i] );
+		ri.FS_FreeAsyncFile( buffers[i] );
 		buffers[i] = p;
 		COM_Compress(p);
 	}
@@ -13,9 +13,44 @@ SMP acceleration
 
 #include <Windows.h>
 
-HANDLE	renderCommandsEvent;
-HANDLE	renderCompletedEvent;
-HANDLE	renderActiveEvent;
+/*
+The front end fills one of SMP_FRAMES sets of backEndData while the render
+thread works through the command lists of earlier frames, so it can run up
+to SMP_FRAMES - 1 frames ahead.  Finished command lists are pushed onto a
+bounded lock-free queue that any thread may submit to, and the render thread
+drains it in order.  Kernel objects are only used to put a thread to sleep
+when there is nothing for it to do.
+
+The render thread keeps the device context for as long as it has queued
+work, and gives it up before it reports itself idle.  The front end only
+takes the context after RSMP_FrontEndSleep, and gives it back before it
+queues anything.
+*/
+
+// must be a power of two and larger than SMP_FRAMES, so a full queue
+// can only happen from extra syncs and is just waited out
+#define	SMP_QUEUE_SIZE		8
+
+typedef struct {
+	volatile LONG	sequence;
+	void			*data;
+	int				frame;
+} smpQueueCell_t;
+
+static smpQueueCell_t	smpQueue[SMP_QUEUE_SIZE];
+static volatile LONG	smpQueueTail;		// next cell to claim, shared by the producers
+static LONG				smpQueueHead;		// next cell to drain, render thread only
+
+static volatile LONG	smpPending;				// lists queued or executing
+static volatile LONG	smpFrameBusy[SMP_FRAMES];	// lists queued or executing per frame
+
+static HANDLE	renderCommandsSemaphore;	// one count per queued list
+static HANDLE	renderCompletedEvent;		// set when a list has finished executing
+static HANDLE	renderExitedEvent;
+
+static int		renderFrame = -1;			// render thread only
+static qboolean	renderContextCurrent;		// render thread only
+static qboolean	frontEndContextCurrent;
 
 #ifndef WIN8
 HANDLE	renderThreadHandle;
@@ -24,13 +59,13 @@ int		renderThreadId;
 extern void Sys_CreateThreadWin8( void (* function)( void* ), void* data );
 #endif
 
-static	void	*smpData;
-
 static void RenderThreadWrapper( void (* function)( void ) ) {
 	function();
 
 	// unbind the context before we die
     GFX_MakeCurrent( qfalse );
+
+	SetEvent( renderExitedEvent );
 }
 
 /*
@@ -39,10 +74,26 @@ GLimp_SpawnRenderThread
 =======================
 */
 qboolean RSMP_SpawnRenderThread( void (*function)( void ) ) {
+	int		i;
+
+	for ( i = 0 ; i < SMP_QUEUE_SIZE ; i++ ) {
+		smpQueue[i].sequence = i;
+		smpQueue[i].data = NULL;
+		smpQueue[i].frame = -1;
+	}
+	smpQueueTail = 0;
+	smpQueueHead = 0;
+	smpPending = 0;
+	for ( i = 0 ; i < SMP_FRAMES ; i++ ) {
+		smpFrameBusy[i] = 0;
+	}
+	renderFrame = -1;
+	renderContextCurrent = qfalse;
+	frontEndContextCurrent = qtrue;
 
-	renderCommandsEvent = CreateEventEx( NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS );
-	renderCompletedEvent = CreateEventEx( NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS );
-	renderActiveEvent = CreateEventEx( NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS );
+	renderCommandsSemaphore = CreateSemaphoreEx( NULL, 0, SMP_QUEUE_SIZE, NULL, 0, SEMAPHORE_ALL_ACCESS );
+	renderCompletedEvent = CreateEventEx( NULL, NULL, 0, EVENT_ALL_ACCESS );
+	renderExitedEvent = CreateEventEx( NULL, NULL, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS );
 
 #ifndef WIN8
 	renderThreadHandle = CreateThread(
@@ -63,47 +114,231 @@ qboolean RSMP_SpawnRenderThread( void (*function)( void ) ) {
 	return qtrue;
 }
 
-void* RSMP_RendererSleep( void ) {
-	void	*data;
+/*
+=======================
+RSMP_QueuePush
 
-    GFX_MakeCurrent( qfalse );
+Bounded multi-producer queue: a producer claims a cell by moving the
+tail past it, then publishes it by advancing the cell's sequence.
+=======================
+*/
+static void RSMP_QueuePush( void *data, int frame ) {
+	smpQueueCell_t	*cell;
+	LONG			pos;
+	LONG			diff;
+
+	while ( 1 ) {
+		pos = smpQueueTail;
+		cell = &smpQueue[ pos & ( SMP_QUEUE_SIZE - 1 ) ];
+		MemoryBarrier();
+		diff = cell->sequence - pos;
+		if ( diff == 0 ) {
+			if ( InterlockedCompareExchange( &smpQueueTail, pos + 1, pos ) == pos ) {
+				break;
+			}
+		} else if ( diff < 0 ) {
+			// full, the render thread hasn't drained this cell yet
+			YieldProcessor();
+		}
+	}
 
-	// after this, the front end can exit GLimp_FrontEndSleep
-	SetEvent( renderCompletedEvent );
+	cell->data = data;
+	cell->frame = frame;
+	MemoryBarrier();
+	cell->sequence = pos + 1;
 
-	ResetEvent( renderActiveEvent );
+	ReleaseSemaphore( renderCommandsSemaphore, 1, NULL );
+}
 
-	WaitForSingleObjectEx( renderCommandsEvent, INFINITE, FALSE );
+/*
+=======================
+RSMP_QueuePop
 
-    GFX_MakeCurrent( qtrue );
+Only called by the render thread after it has taken a semaphore count.
+Another producer may have claimed the head cell but not published it
+yet, which is only ever a few instructions away.
+=======================
+*/
+static void RSMP_QueuePop( void **data, int *frame ) {
+	smpQueueCell_t	*cell;
 
-	ResetEvent( renderCompletedEvent );
-	ResetEvent( renderCommandsEvent );
+	cell = &smpQueue[ smpQueueHead & ( SMP_QUEUE_SIZE - 1 ) ];
+	while ( cell->sequence != smpQueueHead + 1 ) {
+		YieldProcessor();
+	}
+	MemoryBarrier();
 
-	data = smpData;
+	*data = cell->data;
+	*frame = cell->frame;
+	MemoryBarrier();
+	cell->sequence = smpQueueHead + SMP_QUEUE_SIZE;
+	smpQueueHead++;
+}
 
-	// after this, the main thread can exit GLimp_WakeRenderer
-	SetEvent( renderActiveEvent );
+/*
+=======================
+RSMP_RendererSleep
+
+Retires the list the render thread just executed and returns the next
+one, sleeping if the queue is empty.  Returns NULL when the renderer
+is shutting down.
+=======================
+*/
+void* RSMP_RendererSleep( void ) {
+	void		*data;
+	int			frame;
+	qboolean	retired;
+
+	retired = qfalse;
+	if ( renderFrame >= 0 ) {
+		InterlockedDecrement( &smpFrameBusy[renderFrame] );
+		renderFrame = -1;
+		retired = qtrue;
+	}
+
+	if ( WaitForSingleObjectEx( renderCommandsSemaphore, 0, FALSE ) != WAIT_OBJECT_0 ) {
+		// nothing queued, so give up the context before we report
+		// ourselves idle, the front end may want it
+		if ( renderContextCurrent ) {
+			GFX_MakeCurrent( qfalse );
+			renderContextCurrent = qfalse;
+		}
+		if ( retired ) {
+			InterlockedDecrement( &smpPending );
+		}
+		SetEvent( renderCompletedEvent );
+
+		WaitForSingleObjectEx( renderCommandsSemaphore, INFINITE, FALSE );
+	} else {
+		if ( retired ) {
+			InterlockedDecrement( &smpPending );
+		}
+		SetEvent( renderCompletedEvent );
+	}
+
+	RSMP_QueuePop( &data, &frame );
+	renderFrame = frame;
+
+	if ( data && !renderContextCurrent ) {
+		GFX_MakeCurrent( qtrue );
+		renderContextCurrent = qtrue;
+	}
 
 	return data;
 }
 
+/*
+=======================
+RSMP_FrontEndSleep
 
+Waits for the render thread to drain the queue, then makes the context
+current on the calling thread.
+=======================
+*/
 void RSMP_FrontEndSleep( void ) {
-	WaitForSingleObjectEx( renderCompletedEvent, INFINITE, FALSE );
+	while ( smpPending > 0 ) {
+		WaitForSingleObjectEx( renderCompletedEvent, INFINITE, FALSE );
+	}
+	MemoryBarrier();
 
-    GFX_MakeCurrent( qtrue );
+	if ( !frontEndContextCurrent ) {
+		GFX_MakeCurrent( qtrue );
+		frontEndContextCurrent = qtrue;
+	}
 }
 
+/*
+=======================
+RSMP_WaitForFrame
 
-void RSMP_WakeRenderer( void *data ) {
-	smpData = data;
+Returns true if the render thread was still using the buffers of frame.
+=======================
+*/
+qboolean RSMP_WaitForFrame( int frame ) {
+	qboolean	blocked;
 
-    GFX_MakeCurrent( qfalse );
+	blocked = qfalse;
+	while ( smpFrameBusy[frame] > 0 ) {
+		blocked = qtrue;
+		WaitForSingleObjectEx( renderCompletedEvent, INFINITE, FALSE );
+	}
+	MemoryBarrier();
 
-	// after this, the renderer can continue through GLimp_RendererSleep
-	SetEvent( renderCommandsEvent );
+	return blocked;
+}
 
-	WaitForSingleObjectEx( renderActiveEvent, INFINITE, FALSE );
+/*
+=======================
+RSMP_RendererIdle
+=======================
+*/
+qboolean RSMP_RendererIdle( void ) {
+	return smpPending == 0;
 }
 
+/*
+=======================
+RSMP_WakeRenderer
+
+Queues a command list from frame's buffers for the render thread.
+Safe to call from any thread, a NULL list stops the render thread.
+=======================
+*/
+void RSMP_WakeRenderer( void *data, int frame ) {
+	if ( frontEndContextCurrent ) {
+		GFX_MakeCurrent( qfalse );
+		frontEndContextCurrent = qfalse;
+	}
+
+	InterlockedIncrement( &smpPending );
+	if ( frame >= 0 ) {
+		InterlockedIncrement( &smpFrameBusy[frame] );
+	}
+
+	RSMP_QueuePush( data, frame );
+}
+
+/*
+=======================
+RSMP_ShutdownRenderThread
+=======================
+*/
+void RSMP_ShutdownRenderThread( void ) {
+	RSMP_FrontEndSleep();
+
+	RSMP_WakeRenderer( NULL, -1 );
+	WaitForSingleObjectEx( renderExitedEvent, INFINITE, FALSE );
+
+	GFX_MakeCurrent( qtrue );
+	frontEndContextCurrent = qtrue;
+
+	CloseHandle( renderCommandsSemaphore );
+	CloseHandle( renderCompletedEvent );
+	CloseHandle( renderExitedEvent );
+#ifndef WIN8
+	CloseHandle( renderThreadHandle );
+	renderThreadHandle = NULL;
+#endif
+}
+
+/*
+=======================
+RSMP_ReserveCommands
+
+Claims bytes of a command buffer without a lock, so several threads can
+add commands to the same frame.  Returns the offset of the claimed space,
+or -1 if it would not leave room for limit.
+=======================
+*/
+int RSMP_ReserveCommands( int *used, int bytes, int limit ) {
+	LONG	old;
+
+	do {
+		old = *(volatile LONG *)used;
+		if ( old + bytes > limit ) {
+			return -1;
+		}
+	} while ( InterlockedCompareExchange( (volatile LONG *)used, old + bytes, old ) != old );
+
+	return old;
+}
@@ -33,16 +33,25 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define	MAX_ENT_CLUSTERS	16
 
+// every linked entity is chained into the resident list of each
+// cluster it touches, so snapshots can gather entities by cluster
+typedef struct svClusterLink_s {
+	struct svClusterLink_s	*prev, *next;
+	int						entityNum;
+} svClusterLink_t;
+
 typedef struct svEntity_s {
 	struct worldSector_s *worldSector;
 	struct svEntity_s *nextEntityInWorldSector;
+	int			worldNode;			// leaf in the dynamic tree, -1 if not in it
 	
 	entityState_t	baseline;		// for delta compression of initial sighting
-	int			numClusters;		// if -1, use headnode instead
+	int			numClusters;		// if -1, touches too many clusters and is
+									// linked into sv.bigClusterEntities instead
+	int			firstCluster, lastCluster;	// range of clusters touched when numClusters == -1
 	int			clusternums[MAX_ENT_CLUSTERS];
-	int			lastCluster;		// if all the clusters don't fit in clusternums
+	svClusterLink_t	clusterLinks[MAX_ENT_CLUSTERS];	// one per clusternums entry
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -60,13 +69,16 @@ typedef struct {
 	// https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=475
 	// the serverId associated with the current checksumFeed (always <= serverId)
 	int       checksumFeedServerId;	
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	int				nextFrameTime;		// when time > nextFrameTime, process world
 	struct cmodel_s	*models[MAX_MODELS];
 	char			*configstrings[MAX_CONFIGSTRINGS];
 	svEntity_t		svEntities[MAX_GENTITIES];
 
+	int				numClusters;
+	svClusterLink_t	**clusterEntities;	// [numClusters] resident entity lists
+	svClusterLink_t	*bigClusterEntities;	// entities with numClusters == -1
+
 	char			*entityParsePoint;	// used during game VM init
 
 	// the game virtual machine will update these on init and changes
@@ -95,6 +107,7 @@ typedef struct {
 	int				messageSent;		// time the message was transmitted
 	int				messageAcked;		// time the message was acked
 	int				messageSize;		// used to rate drop packets
+	int				generation;			// snapshot pass that copied the entities, 0 if none
 } clientSnapshot_t;
 
 typedef enum {
@@ -156,6 +169,8 @@ typedef struct client_s {
 	int				ping;
 	int				rate;				// bytes / second
 	int				snapshotMsec;		// requests a snapshot every snapshotMsec unless rate choked
+	float			entityPriority[MAX_GENTITIES];	// grows while an entity's updates are held back
+	int				entityDeferred[MAX_GENTITIES];	// svs.time updates were first held back, 0 if current
 	int				pureAuthentic;
 	qboolean  gotCP; // TTimo - additional flag to distinguish between a bad pure checksum, and no cp command at all
 	netchan_t		netchan;
@@ -243,6 +258,10 @@ extern	cvar_t	*sv_pure;
 extern	cvar_t	*sv_floodProtect;
 extern	cvar_t	*sv_lanForceRate;
 extern	cvar_t	*sv_strictAuth;
+extern	cvar_t	*sv_worldTree;
+extern	cvar_t	*sv_traceCache;
+extern	cvar_t	*sv_deltaCache;
+extern	cvar_t	*sv_snapshotBudget;
 
 //===========================================================
 
@@ -338,6 +357,18 @@ int			SV_BotLibShutdown( void );
 int			SV_BotGetSnapshotEntity( int client, int ent );
 int			SV_BotGetConsoleMessage( int client, char *buf, int size );
 
+// how a game system call can overlap others while the bots think in parallel
+typedef enum {
+	BOT_SYSCALL_EXCLUSIVE,		// needs the whole engine
+	BOT_SYSCALL_SHARED			// only reads the world and the routing
+} botSyscall_t;
+
+extern	qboolean	sv_botThinking;		// BotAI calls are running on the job threads
+
+qboolean	SV_BotParallelThink( const int *clients, int numClients, int thinktime );
+botSyscall_t	SV_BotEnterSyscall( botSyscall_t type );
+void		SV_BotLeaveSyscall( botSyscall_t type );
+
 int BotImport_DebugPolygonCreate(int color, int numPoints, vec3_t *points);
 void BotImport_DebugPolygonDelete(int id);
 
@@ -349,6 +380,9 @@ void BotImport_DebugPolygonDelete(int id);
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
 
+void SV_ClearTraceCache( void );
+// forgets every cached trace, called each frame and on every link and unlink
+
 void SV_UnlinkEntity( sharedEntity_t *ent );
 // call before removing an entity, and before trying to move one,
 // so it doesn't clip against itself
@@ -365,6 +399,7 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_WorldStats_f( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -392,6 +427,10 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
 
+void SV_TraceBatch( trace_t *results, const traceRay_t *rays, int numRays, vec3_t mins, vec3_t maxs, int passEntityNum, int contentmask, int capsule );
+// SV_Trace for each of the rays, which all use the same mins/maxs
+
+
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, int capsule );
 // clip to a specific entity
 
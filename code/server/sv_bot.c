@@ -23,6 +23,9 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "server.h"
 #include "../game/botlib.h"
+#include <setjmp.h>
+
+static qboolean SV_BotHoldClientCommand( int client, const char *command );
 
 typedef struct bot_debugpoly_s
 {
@@ -116,6 +119,8 @@ void BotDrawDebugPolygons(void (*drawPoly)(int color, int numPoints, float *poin
 		if (bot_reachability->integer) parm0 |= 2;
 		if (bot_groundonly->integer) parm0 |= 4;
 		botlib_export->BotLibVarSet("bot_highlightarea", bot_highlightarea->string);
+		//the game may have moved things since its last system call
+		SV_ClearTraceCache();
 		botlib_export->Test(parm0, NULL, svs.clients[0].gentity->r.currentOrigin, 
 			svs.clients[0].gentity->r.currentAngles);
 	} //end if
@@ -421,6 +426,9 @@ SV_BotClientCommand
 ==================
 */
 void BotClientCommand( int client, char *command ) {
+	if ( sv_botThinking && SV_BotHoldClientCommand( client, command ) ) {
+		return;
+	}
 	SV_ExecuteClientCommand( &svs.clients[client], command, qtrue );
 }
 
@@ -436,6 +444,296 @@ void SV_BotFrame( int time ) {
 	VM_Call( gvm, BOTAI_START_FRAME, time );
 }
 
+/*
+==============================================================================
+
+PARALLEL BOT THINKING
+
+With bot_parallelthink 1 and a native game module the BotAI calls of a
+frame run on the job threads.  The game code itself isn't reentrant, so it
+only runs while holding the game lock.  System calls that just read the
+world (traces, aas sampling, movement prediction and routing) release the
+game lock while they run.  The botlib looks the routing up without locks
+and only takes the route lock to add to the routing cache.  All other calls
+wait until no reads are in flight, which leaves them the whole engine like
+on a single thread, and everything they call stays exclusive because they
+can reenter the game.  Prints and bot client commands of a read are held
+back until the thread has the game lock again.
+==============================================================================
+*/
+
+#define	BOTTHREAD_GAME		1		// holding the game lock
+#define	BOTTHREAD_READING	2		// holding a reader slot
+#define	BOTTHREAD_ROUTING	4		// holding the route lock
+
+#define	MAX_HELD_BOTCOMMANDS	4
+
+typedef struct {
+	int			locks;				// BOTTHREAD_* held by the thread
+	int			exclusive;			// exclusive calls in progress
+	int			routing;			// nested route locks
+	int			numCommands;		// bot client commands held back during a read
+	int			commandClients[MAX_HELD_BOTCOMMANDS];
+	char		commands[MAX_HELD_BOTCOMMANDS][MAX_STRING_CHARS];
+} botThreadState_t;
+
+typedef struct {
+	const int	*clients;
+	int			thinktime;
+	volatile int	failed;
+	int			*errorCodes;
+	char		**errors;
+} botThinkBatch_t;
+
+qboolean			sv_botThinking;
+static void			*sv_botGameLock;
+static void			*sv_botRouteLock;
+static void			*sv_botReaderSlots;
+static int			sv_botNumReaderSlots;
+static volatile int	sv_botReaders;
+static THREAD_LOCAL botThreadState_t	sv_botThreadState;
+
+/*
+==================
+SV_BotHoldClientCommand
+
+A bot client command from a read runs the game, so it waits
+until the read is done
+==================
+*/
+static qboolean SV_BotHoldClientCommand( int client, const char *command ) {
+	botThreadState_t	*state;
+
+	state = &sv_botThreadState;
+	if ( !( state->locks & BOTTHREAD_READING ) ) {
+		return qfalse;
+	}
+	if ( state->numCommands == MAX_HELD_BOTCOMMANDS ) {
+		Com_DPrintf( "dropped bot client command %s\n", command );
+		return qtrue;
+	}
+	state->commandClients[state->numCommands] = client;
+	Q_strncpyz( state->commands[state->numCommands], command, sizeof( state->commands[0] ) );
+	state->numCommands++;
+	return qtrue;
+}
+
+/*
+==================
+SV_BotEnterSyscall
+
+Returns how the call really runs, to pass on to SV_BotLeaveSyscall
+==================
+*/
+botSyscall_t SV_BotEnterSyscall( botSyscall_t type ) {
+	int		i;
+
+	// an exclusive call can reenter the game, giving the game lock
+	// away in there would let the other threads in halfway
+	if ( sv_botThreadState.exclusive ) {
+		type = BOT_SYSCALL_EXCLUSIVE;
+	}
+
+	if ( type == BOT_SYSCALL_EXCLUSIVE ) {
+		// new reads can't start while we hold the game lock, so
+		// taking every slot once waits out the ones in flight
+		if ( !sv_botThreadState.exclusive++ && Sys_AtomicAdd( &sv_botReaders, 0 ) ) {
+			for ( i = 0 ; i < sv_botNumReaderSlots ; i++ ) {
+				Sys_SemaphoreWait( sv_botReaderSlots );
+			}
+			Sys_SemaphorePost( sv_botReaderSlots, sv_botNumReaderSlots );
+		}
+		return type;
+	}
+
+	Sys_AtomicAdd( &sv_botReaders, 1 );
+	Sys_SemaphoreWait( sv_botReaderSlots );
+	sv_botThreadState.locks = BOTTHREAD_READING;
+	Com_HoldPrints( qtrue );
+	Sys_SemaphorePost( sv_botGameLock, 1 );
+	return type;
+}
+
+/*
+==================
+SV_BotLeaveSyscall
+==================
+*/
+void SV_BotLeaveSyscall( botSyscall_t type ) {
+	botThreadState_t	*state;
+	int					i;
+
+	state = &sv_botThreadState;
+	if ( type == BOT_SYSCALL_EXCLUSIVE ) {
+		state->exclusive--;
+		return;
+	}
+
+	Sys_AtomicAdd( &sv_botReaders, -1 );
+	state->locks = 0;
+	Sys_SemaphorePost( sv_botReaderSlots, 1 );
+
+	Sys_SemaphoreWait( sv_botGameLock );
+	state->locks = BOTTHREAD_GAME;
+	Com_HoldPrints( qfalse );
+
+	if ( state->numCommands ) {
+		type = SV_BotEnterSyscall( BOT_SYSCALL_EXCLUSIVE );
+		for ( i = 0 ; i < state->numCommands ; i++ ) {
+			SV_ExecuteClientCommand( &svs.clients[state->commandClients[i]], state->commands[i], qtrue );
+		}
+		state->numCommands = 0;
+		SV_BotLeaveSyscall( type );
+	}
+}
+
+/*
+==================
+SV_BotRoutingShared
+==================
+*/
+static int SV_BotRoutingShared( void ) {
+	return ( sv_botThreadState.locks & BOTTHREAD_READING ) != 0;
+}
+
+/*
+==================
+SV_BotRoutingLock
+
+The botlib takes it again while updating the routing cache
+==================
+*/
+static void SV_BotRoutingLock( int lock ) {
+	if ( lock ) {
+		if ( !sv_botThreadState.routing++ ) {
+			Sys_SemaphoreWait( sv_botRouteLock );
+			sv_botThreadState.locks |= BOTTHREAD_ROUTING;
+		}
+		return;
+	}
+
+	if ( !--sv_botThreadState.routing ) {
+		sv_botThreadState.locks &= ~BOTTHREAD_ROUTING;
+		Sys_SemaphorePost( sv_botRouteLock, 1 );
+	}
+}
+
+/*
+==================
+SV_BotReleaseLocks
+
+Gives back whatever the calling thread holds, also when an error
+cut a system call short
+==================
+*/
+static void SV_BotReleaseLocks( void ) {
+	int		locks;
+
+	locks = sv_botThreadState.locks;
+	if ( locks & BOTTHREAD_ROUTING ) {
+		Sys_SemaphorePost( sv_botRouteLock, 1 );
+	}
+	if ( locks & BOTTHREAD_READING ) {
+		Sys_AtomicAdd( &sv_botReaders, -1 );
+		Sys_SemaphorePost( sv_botReaderSlots, 1 );
+		Sys_SemaphoreWait( sv_botGameLock );
+	}
+	Com_HoldPrints( qfalse );
+	if ( locks & ( BOTTHREAD_GAME | BOTTHREAD_READING ) ) {
+		Sys_SemaphorePost( sv_botGameLock, 1 );
+	}
+	Com_Memset( &sv_botThreadState, 0, sizeof( sv_botThreadState ) );
+}
+
+/*
+==================
+SV_BotThinkJob
+==================
+*/
+static void SV_BotThinkJob( int index, void *data ) {
+	botThinkBatch_t	*batch;
+	jmp_buf			frame;
+	const char		*message;
+
+	batch = (botThinkBatch_t *)data;
+
+	// once a bot has errored out the frame is lost anyway
+	if ( batch->failed ) {
+		return;
+	}
+
+	Sys_SemaphoreWait( sv_botGameLock );
+	sv_botThreadState.locks = BOTTHREAD_GAME;
+
+	if ( setjmp( frame ) ) {
+		message = Com_CaughtError( &batch->errorCodes[index] );
+		batch->errors[index] = Hunk_FrameAlloc( strlen( message ) + 1 );
+		strcpy( batch->errors[index], message );
+		batch->failed = qtrue;
+	} else {
+		Com_CatchErrors( &frame );
+		VM_Call( gvm, BOTAI_THINK, batch->clients[index], batch->thinktime );
+	}
+
+	Com_CatchErrors( NULL );
+	SV_BotReleaseLocks();
+}
+
+/*
+==================
+SV_BotParallelThink
+
+Runs BotAI for the given clients on the job threads.  Returns qfalse
+without doing anything when the game should think them one by one.
+==================
+*/
+qboolean SV_BotParallelThink( const int *clients, int numClients, int thinktime ) {
+	botThinkBatch_t	batch;
+	int				i;
+
+	if ( sv_botThinking || numClients < 2 || !Com_JobThreads() ) {
+		return qfalse;
+	}
+	if ( !VM_IsNative( gvm ) || !Cvar_VariableIntegerValue( "bot_parallelthink" ) ) {
+		return qfalse;
+	}
+
+	if ( !sv_botGameLock ) {
+		sv_botNumReaderSlots = Com_JobThreads() + 1;
+		sv_botGameLock = Sys_CreateSemaphore( 1 );
+		sv_botRouteLock = Sys_CreateSemaphore( 1 );
+		sv_botReaderSlots = Sys_CreateSemaphore( sv_botNumReaderSlots );
+		if ( !sv_botGameLock || !sv_botRouteLock || !sv_botReaderSlots ) {
+			Com_Printf( "WARNING: couldn't create bot think semaphores\n" );
+			Cvar_Set( "bot_parallelthink", "0" );
+			return qfalse;
+		}
+	}
+
+	batch.clients = clients;
+	batch.thinktime = thinktime;
+	batch.failed = qfalse;
+	batch.errorCodes = Hunk_FrameAlloc( numClients * sizeof( *batch.errorCodes ) );
+	batch.errors = Hunk_FrameAlloc( numClients * sizeof( *batch.errors ) );
+	Com_Memset( batch.errors, 0, numClients * sizeof( *batch.errors ) );
+
+	sv_botThinking = qtrue;
+	Com_ParallelFor( numClients, SV_BotThinkJob, &batch );
+	sv_botThinking = qfalse;
+	SV_ClearTraceCache();
+
+	// raise the error of the lowest client on the main thread
+	if ( batch.failed ) {
+		for ( i = 0 ; i < numClients ; i++ ) {
+			if ( batch.errors[i] ) {
+				Com_Error( batch.errorCodes[i], "%s", batch.errors[i] );
+			}
+		}
+	}
+
+	return qtrue;
+}
+
 /*
 ===============
 SV_BotLibSetup
@@ -451,6 +749,7 @@ int SV_BotLibSetup( void ) {
 		return -1;
 	}
 
+	SV_ClearTraceCache();
 	return botlib_export->BotLibSetup();
 }
 
@@ -490,7 +789,9 @@ void SV_BotInitCvars(void) {
 	Cvar_Get("bot_forcewrite", "0", 0);					//force writing aas file
 	Cvar_Get("bot_aasoptimize", "0", 0);				//no aas file optimisation
 	Cvar_Get("bot_saveroutingcache", "0", 0);			//save routing cache
+	Cvar_Get("bot_maxroutingcache", "4096", 0);			//kilobytes of routing cache
 	Cvar_Get("bot_thinktime", "100", CVAR_CHEAT);		//msec the bots thinks
+	Cvar_Get("bot_parallelthink", "0", 0);				//think the bots on the job threads
 	Cvar_Get("bot_reloadcharacters", "0", 0);			//reload the bot characters each time
 	Cvar_Get("bot_testichat", "0", 0);					//test ichats
 	Cvar_Get("bot_testrchat", "0", 0);					//test rchats
@@ -563,6 +864,11 @@ void SV_BotInitBotLib(void) {
 	botlib_import.DebugPolygonCreate = BotImport_DebugPolygonCreate;
 	botlib_import.DebugPolygonDelete = BotImport_DebugPolygonDelete;
 
+	//parallel routing
+	botlib_import.RoutingShared = SV_BotRoutingShared;
+	botlib_import.RoutingLock = SV_BotRoutingLock;
+	botlib_import.AtomicAdd = Sys_AtomicAdd;
+
 	botlib_export = (botlib_export_t *)GetBotLibAPI( BOTLIB_API_VERSION, &botlib_import );
 	assert(botlib_export); 	// bk001129 - somehow we end up with a zero import.
 }
@@ -300,9 +300,9 @@ static int	FloatAsInt( float f ) {
 
 /*
 ====================
-SV_GameSystemCalls
+SV_GameSystemCall
 
-The module is making a system call
+Carries out a system call of the module
 ====================
 */
 //rcg010207 - see my comments in VM_DllSyscall(), in qcommon/vm.c ...
@@ -315,7 +315,9 @@ The module is making a system call
 #define	VMF(x)	*((float *)(&args[x]))
 #define VMI(x) ((int) args[x])
 
-int SV_GameSystemCalls( size_t *args ) {
+static int SV_GameSystemCall( size_t *args ) {
+	int		count;
+
 	switch( args[0] ) {
 	case G_PRINT:
 		Com_Printf( "%s", VMA(1) );
@@ -391,6 +393,20 @@ int SV_GameSystemCalls( size_t *args ) {
 	case G_TRACECAPSULE:
 		SV_Trace( VMA(1), VMA(2), VMA(3), VMA(4), VMA(5), VMI(6), VMI(7), /*int capsule*/ qtrue );
 		return 0;
+	case G_TRACEBATCH:
+		count = VMI(3);
+		if ( count <= 0 ) {
+			return 0;
+		}
+		if ( count > MAX_TRACE_BATCH ) {
+			count = MAX_TRACE_BATCH;
+		}
+		VM_CheckBlock( gvm, args[1], count * sizeof( trace_t ), "G_TRACEBATCH" );
+		VM_CheckBlock( gvm, args[2], count * sizeof( traceRay_t ), "G_TRACEBATCH" );
+		SV_TraceBatch( VMA(1), VMA(2), count, VMA(4), VMA(5), VMI(6), VMI(7), /*int capsule*/ qfalse );
+		return 0;
+	case G_BOT_PARALLEL_THINK:
+		return SV_BotParallelThink( VMA(1), VMI(2), VMI(3) );
 	case G_POINT_CONTENTS:
 		return SV_PointContents( VMA(1), VMI(2) );
 	case G_SET_BRUSH_MODEL:
@@ -483,6 +499,16 @@ int SV_GameSystemCalls( size_t *args ) {
 		return botlib_export->BotLibLoadMap( VMA(1) );
 	case BOTLIB_UPDATENTITY:
 		return botlib_export->BotLibUpdateEntity( VMI(1), VMA(2) );
+	case BOTLIB_UPDATENTITIES:
+		count = VMI(1);
+		if ( count < 0 ) {
+			count = 0;
+		} else if ( count > MAX_GENTITIES ) {
+			count = MAX_GENTITIES;
+		}
+		VM_CheckBlock( gvm, args[2], count * sizeof( int ), "BOTLIB_UPDATENTITIES" );
+		VM_CheckBlock( gvm, args[3], count * sizeof( bot_entitystate_t ), "BOTLIB_UPDATENTITIES" );
+		return botlib_export->BotLibUpdateEntities( count, VMA(2), VMA(3) );
 	case BOTLIB_TEST:
 		return botlib_export->Test( VMI(1), VMA(2), VMA(3), VMA(4) );
 
@@ -868,6 +894,72 @@ int SV_GameSystemCalls( size_t *args ) {
 	return -1;
 }
 
+/*
+====================
+SV_BotSyscallType
+
+How a call can overlap others while the bots think in parallel
+====================
+*/
+static botSyscall_t SV_BotSyscallType( const size_t *args ) {
+	switch( args[0] ) {
+	case G_TRACE:
+	case G_TRACECAPSULE:
+	case G_TRACEBATCH:
+	case G_POINT_CONTENTS:
+	case G_IN_PVS:
+	case G_IN_PVS_IGNORE_PORTALS:
+	case BOTLIB_AAS_INITIALIZED:
+	case BOTLIB_AAS_TIME:
+	case BOTLIB_AAS_ENTITY_INFO:
+	case BOTLIB_AAS_PRESENCE_TYPE_BOUNDING_BOX:
+	case BOTLIB_AAS_POINT_AREA_NUM:
+	case BOTLIB_AAS_POINT_REACHABILITY_AREA_INDEX:
+	case BOTLIB_AAS_TRACE_AREAS:
+	case BOTLIB_AAS_AREA_INFO:
+	case BOTLIB_AAS_POINT_CONTENTS:
+	case BOTLIB_AAS_AREA_REACHABILITY:
+	case BOTLIB_AAS_BBOX_AREAS:
+	case BOTLIB_AAS_PREDICT_ROUTE:
+	case BOTLIB_AAS_AREA_TRAVEL_TIME_TO_GOAL_AREA:
+	case BOTLIB_AI_CHOOSE_LTG_ITEM:
+	case BOTLIB_AI_CHOOSE_NBG_ITEM:
+	case BOTLIB_AI_MOVE_TO_GOAL:
+		return BOT_SYSCALL_SHARED;
+	case BOTLIB_AAS_PREDICT_CLIENT_MOVEMENT:
+		// visualizing adds debug lines
+		return args[13] ? BOT_SYSCALL_EXCLUSIVE : BOT_SYSCALL_SHARED;
+	default:
+		return BOT_SYSCALL_EXCLUSIVE;
+	}
+}
+
+/*
+====================
+SV_GameSystemCalls
+
+The module is making a system call
+====================
+*/
+int SV_GameSystemCalls( size_t *args ) {
+	botSyscall_t	type;
+	int				r;
+
+	if ( !sv_botThinking ) {
+		// the game may have changed its entities since it last called
+		// in, and may again as soon as this returns
+		SV_ClearTraceCache();
+		r = SV_GameSystemCall( args );
+		SV_ClearTraceCache();
+		return r;
+	}
+
+	type = SV_BotEnterSyscall( SV_BotSyscallType( args ) );
+	r = SV_GameSystemCall( args );
+	SV_BotLeaveSyscall( type );
+	return r;
+}
+
 /*
 ===============
 SV_ShutdownGameProgs
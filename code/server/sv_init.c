@@ -383,6 +383,9 @@ void SV_SpawnServer( char *server, qboolean killBots ) {
 	// clear pak references
 	FS_ClearPakReferences(0);
 
+	// look on disk again for anything that was missing before
+	FS_ClearDirMisses();
+
 	// allocate the snapshot entities on the hunk
 	svs.snapshotEntities = Hunk_Alloc( sizeof(entityState_t)*svs.numSnapshotEntities, h_high );
 	svs.nextSnapshotEntities = 0;
@@ -616,6 +619,10 @@ void SV_Init (void) {
 	sv_mapChecksum = Cvar_Get ("sv_mapChecksum", "", CVAR_ROM);
 	sv_lanForceRate = Cvar_Get ("sv_lanForceRate", "1", CVAR_ARCHIVE );
 	sv_strictAuth = Cvar_Get ("sv_strictAuth", "1", CVAR_ARCHIVE );
+	sv_worldTree = Cvar_Get ("sv_worldTree", "0", 0 );
+	sv_traceCache = Cvar_Get ("sv_traceCache", "0", 0 );
+	sv_deltaCache = Cvar_Get ("sv_deltaCache", "1", 0 );
+	sv_snapshotBudget = Cvar_Get ("sv_snapshotBudget", "1", 0 );
 
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
@@ -654,6 +661,8 @@ void SV_FinalMessage( char *message ) {
 			}
 		}
 	}
+
+	NET_FlushPackets();
 }
 
 
@@ -52,6 +52,10 @@ cvar_t	*sv_pure;
 cvar_t	*sv_floodProtect;
 cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates to 99999 (bug #491)
 cvar_t	*sv_strictAuth;
+cvar_t	*sv_worldTree;			// dynamic AABB tree instead of the sector tree
+cvar_t	*sv_traceCache;			// remember trace results until something moves
+cvar_t	*sv_deltaCache;			// encode each entity delta once for all clients sharing it
+cvar_t	*sv_snapshotBudget;		// hold back low priority entity updates to fit the client's rate
 
 /*
 =============================================================================
@@ -826,6 +830,9 @@ void SV_Frame( int msec ) {
 	// update ping based on the all received frames
 	SV_CalcPings();
 
+	// cached traces only last a frame
+	SV_ClearTraceCache();
+
 	if (com_dedicated->integer) SV_BotFrame( svs.time );
 
 	// run the game simulation in chunks
@@ -834,6 +841,7 @@ void SV_Frame( int msec ) {
 		svs.time += frameMsec;
 
 		// let everything in the world think and move
+		SV_ClearTraceCache();
 		VM_Call( gvm, GAME_RUN_FRAME, svs.time );
 	}
 
@@ -849,6 +857,9 @@ void SV_Frame( int msec ) {
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat();
+
+	// everything for this frame goes out together
+	NET_FlushPackets();
 }
 
 //============================================================================
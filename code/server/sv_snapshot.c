@@ -45,6 +45,150 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Shared entity deltas
+
+Every snapshot built in the same pass copies the same entity states, so
+the delta of an entity from its state in an earlier pass comes out as the
+same bits for every client that is deltaing from that pass, and the delta
+from the baseline is the same for everybody.  The first job that needs one
+encodes it into sv_deltaCacheData, and the rest copy the bits in.  The
+slots only live for one pass.
+
+=============================================================================
+*/
+
+#define	DELTA_CACHE_FRAMES		4					// earlier passes remembered per entity
+#define	DELTA_CACHE_BASELINE	DELTA_CACHE_FRAMES	// slot for the delta from the baseline
+#define	DELTA_CACHE_BYTES		0x40000
+#define	MAX_DELTA_BYTES			1024				// anything bigger is written directly
+
+typedef struct {
+	volatile int	claims;			// the job that takes this from 0 encodes the delta
+	volatile int	ready;			// set once the fields below are filled in
+	int				generation;		// pass the delta is from, -1 for the baseline
+	int				bits;
+	int				offset;			// into sv_deltaCacheData
+} deltaCacheSlot_t;
+
+static deltaCacheSlot_t	sv_deltaSlots[MAX_GENTITIES][DELTA_CACHE_FRAMES+1];
+static int				sv_deltaSlotsUsed[MAX_GENTITIES*(DELTA_CACHE_FRAMES+1)];
+static volatile int		sv_numDeltaSlotsUsed;
+static byte				sv_deltaCacheData[DELTA_CACHE_BYTES];
+static volatile int		sv_deltaCacheBytes;
+static qboolean			sv_deltaCacheActive;
+static int				sv_snapshotGeneration;
+
+/*
+=============
+SV_BeginDeltaCache
+
+Starts a new snapshot pass, on the main thread
+=============
+*/
+static void SV_BeginDeltaCache( int numJobs ) {
+	int					i;
+	deltaCacheSlot_t	*slot;
+
+	for ( i = 0 ; i < sv_numDeltaSlotsUsed ; i++ ) {
+		slot = &sv_deltaSlots[0][0] + sv_deltaSlotsUsed[i];
+		slot->claims = 0;
+		slot->ready = 0;
+	}
+	sv_numDeltaSlotsUsed = 0;
+	sv_deltaCacheBytes = 0;
+
+	sv_snapshotGeneration++;
+
+	// a single snapshot has nobody to share with
+	sv_deltaCacheActive = ( sv_deltaCache->integer && numJobs > 1 );
+}
+
+/*
+=============
+SV_SpliceDelta
+=============
+*/
+static void SV_SpliceDelta( msg_t *msg, const byte *data, int bits, entityState_t *from, entityState_t *to, qboolean force ) {
+	if ( !bits ) {
+		return;
+	}
+
+	// write it out the long way if it could overflow, so the
+	// message ends up the same either way
+	if ( ( ( msg->bit + bits ) >> 3 ) + 1 > msg->maxsize - 4 ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	MSG_WriteEncodedBits( msg, data, bits );
+}
+
+/*
+=============
+SV_WriteSharedDelta
+
+MSG_WriteDeltaEntity for a from state copied in pass fromGeneration,
+or the baseline if it is -1.  Called from the job threads.
+=============
+*/
+static void SV_WriteSharedDelta( msg_t *msg, entityState_t *from, entityState_t *to, qboolean force, int fromGeneration ) {
+	deltaCacheSlot_t	*slot;
+	msg_t				delta;
+	byte				deltaBuf[MAX_DELTA_BYTES];
+	int					bytes, offset;
+
+	if ( !sv_deltaCacheActive || !fromGeneration ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	if ( fromGeneration < 0 ) {
+		slot = &sv_deltaSlots[to->number][DELTA_CACHE_BASELINE];
+	} else {
+		slot = &sv_deltaSlots[to->number][fromGeneration % DELTA_CACHE_FRAMES];
+	}
+
+	if ( Sys_AtomicAdd( &slot->ready, 0 ) ) {
+		if ( slot->generation == fromGeneration ) {
+			SV_SpliceDelta( msg, sv_deltaCacheData + slot->offset, slot->bits, from, to, force );
+		} else {
+			MSG_WriteDeltaEntity( msg, from, to, force );
+		}
+		return;
+	}
+
+	// if another job is encoding it, don't wait around
+	if ( Sys_AtomicAdd( &slot->claims, 1 ) != 1 ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+	sv_deltaSlotsUsed[ Sys_AtomicAdd( &sv_numDeltaSlotsUsed, 1 ) - 1 ] = slot - &sv_deltaSlots[0][0];
+
+	MSG_Init( &delta, deltaBuf, sizeof( deltaBuf ) );
+	delta.allowoverflow = qtrue;
+	MSG_WriteDeltaEntity( &delta, from, to, force );
+	if ( delta.overflowed ) {
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	bytes = ( delta.bit + 7 ) >> 3;
+	offset = Sys_AtomicAdd( &sv_deltaCacheBytes, bytes ) - bytes;
+	if ( offset + bytes <= DELTA_CACHE_BYTES ) {
+		Com_Memcpy( sv_deltaCacheData + offset, deltaBuf, bytes );
+		slot->generation = fromGeneration;
+		slot->bits = delta.bit;
+		slot->offset = offset;
+		// publishes the fields above
+		Sys_AtomicAdd( &slot->ready, 1 );
+	}
+
+	SV_SpliceDelta( msg, deltaBuf, delta.bit, from, to, force );
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -57,12 +201,18 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 	int		oldindex, newindex;
 	int		oldnum, newnum;
 	int		from_num_entities;
+	int		from_generation;
 
 	// generate the delta update
 	if ( !from ) {
 		from_num_entities = 0;
+		from_generation = 0;
 	} else {
 		from_num_entities = from->num_entities;
+		from_generation = from->generation;
+	}
+	if ( to->generation != sv_snapshotGeneration ) {
+		from_generation = 0;
 	}
 
 	newent = NULL;
@@ -88,7 +238,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 			// delta update from old position
 			// because the force parm is qfalse, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity (msg, oldent, newent, qfalse );
+			SV_WriteSharedDelta (msg, oldent, newent, qfalse, from_generation );
 			oldindex++;
 			newindex++;
 			continue;
@@ -96,7 +246,7 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 		if ( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.svEntities[newnum].baseline, newent, qtrue );
+			SV_WriteSharedDelta (msg, &sv.svEntities[newnum].baseline, newent, qtrue, -1 );
 			newindex++;
 			continue;
 		}
@@ -116,42 +266,58 @@ static void SV_EmitPacketEntities( clientSnapshot_t *from, clientSnapshot_t *to,
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_ChooseDeltaFrame
+
+Returns the previous frame to delta compress the new snapshot from, or
+NULL to send it in full.  Called once the entities for every snapshot
+of this server frame have been reserved, so frames whose entities are
+about to be overwritten get rejected.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg ) {
-	clientSnapshot_t	*frame, *oldframe;
-	int					lastframe;
-	int					i;
-	int					snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+static clientSnapshot_t *SV_ChooseDeltaFrame( client_t *client, int *lastframe ) {
+	clientSnapshot_t	*oldframe;
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if ( client->deltaMessage <= 0 || client->state != CS_ACTIVE ) {
 		// client is asking for a retransmit
-		oldframe = NULL;
-		lastframe = 0;
-	} else if ( client->netchan.outgoingSequence - client->deltaMessage 
+		*lastframe = 0;
+		return NULL;
+	}
+	if ( client->netchan.outgoingSequence - client->deltaMessage 
 		>= (PACKET_BACKUP - 3) ) {
 		// client hasn't gotten a good message through in a long time
 		Com_DPrintf ("%s: Delta request from out of date packet.\n", client->name);
-		oldframe = NULL;
-		lastframe = 0;
-	} else {
-		// we have a valid snapshot to delta from
-		oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
-
-		// the snapshot's entities may still have rolled off the buffer, though
-		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
-			Com_DPrintf ("%s: Delta request from out of date entities.\n", client->name);
-			oldframe = NULL;
-			lastframe = 0;
-		}
+		*lastframe = 0;
+		return NULL;
 	}
 
+	// we have a valid snapshot to delta from
+	oldframe = &client->frames[ client->deltaMessage & PACKET_MASK ];
+
+	// the snapshot's entities may still have rolled off the buffer, though
+	if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities ) {
+		Com_DPrintf ("%s: Delta request from out of date entities.\n", client->name);
+		*lastframe = 0;
+		return NULL;
+	}
+
+	*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+==================
+*/
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, clientSnapshot_t *oldframe, int lastframe ) {
+	clientSnapshot_t	*frame;
+	int					i;
+	int					snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
 	MSG_WriteByte (msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -227,13 +393,17 @@ Build a client snapshot structure
 
 #define	MAX_SNAPSHOT_ENTITIES	1024
 typedef struct {
-	int		numSnapshotEntities;
-	int		snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	int			numSnapshotEntities;
+	int			snapshotEntities[MAX_SNAPSHOT_ENTITIES];	
+	byte		added[MAX_GENTITIES/8];		// prevents double adding from portal views
+	const char	*error;						// jobs can't Com_Error, the main thread does
 } snapshotEntityNumbers_t;
 
 /*
 =======================
 SV_QsortEntityNumbers
+
+The added bits already keep duplicates out
 =======================
 */
 static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
@@ -242,10 +412,6 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 	ea = (int *)a;
 	eb = (int *)b;
 
-	if ( *ea == *eb ) {
-		Com_Error( ERR_DROP, "SV_QsortEntityStates: duplicated entity" );
-	}
-
 	if ( *ea < *eb ) {
 		return -1;
 	}
@@ -259,38 +425,88 @@ static int QDECL SV_QsortEntityNumbers( const void *a, const void *b ) {
 SV_AddEntToSnapshot
 ===============
 */
-static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+static void SV_AddEntToSnapshot( sharedEntity_t *gEnt, snapshotEntityNumbers_t *eNums ) {
+	int		num;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
+	num = gEnt->s.number;
+	if ( eNums->added[ num >> 3 ] & ( 1 << ( num & 7 ) ) ) {
 		return;
 	}
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[ num >> 3 ] |= 1 << ( num & 7 );
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES ) {
 		return;
 	}
 
-	eNums->snapshotEntities[ eNums->numSnapshotEntities ] = gEnt->s.number;
+	eNums->snapshotEntities[ eNums->numSnapshotEntities ] = num;
 	eNums->numSnapshotEntities++;
 }
 
+// rebuilt once a frame by SV_MarkSnapshotEntities, read by every client
+static unsigned	sv_sendableEntities[MAX_GENTITIES/32];	// linked and not SVF_NOCLIENT
+static unsigned	sv_broadcastEntities[MAX_GENTITIES/32];	// sendable and SVF_BROADCAST
+
+/*
+===============
+SV_MarkSnapshotEntities
+
+The game can change svFlags without relinking, so the flags every
+client would test are folded into bitmasks once a frame instead
+===============
+*/
+static void SV_MarkSnapshotEntities( void ) {
+	int				e;
+	sharedEntity_t	*ent;
+
+	Com_Memset( sv_sendableEntities, 0, sizeof( sv_sendableEntities ) );
+	Com_Memset( sv_broadcastEntities, 0, sizeof( sv_broadcastEntities ) );
+
+	for ( e = 0 ; e < sv.num_entities ; e++ ) {
+		ent = SV_GentityNum( e );
+		if ( !ent->r.linked ) {
+			continue;
+		}
+
+		if ( ent->s.number != e ) {
+			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
+
+		if ( ent->r.svFlags & SVF_NOCLIENT ) {
+			continue;
+		}
+		sv_sendableEntities[ e >> 5 ] |= 1U << ( e & 31 );
+		if ( ent->r.svFlags & SVF_BROADCAST ) {
+			sv_broadcastEntities[ e >> 5 ] |= 1U << ( e & 31 );
+		}
+	}
+}
+
 /*
 ===============
 SV_AddEntitiesVisibleFromPoint
+
+Rather than testing every entity against the PVS, the entities resident
+in each visible cluster are gathered into a bitmask and only those are
+considered.
+
+Only writes to the frame and eNums, so it can run for several clients at once
 ===============
 */
 static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame, 
 									snapshotEntityNumbers_t *eNums, qboolean portal ) {
-	int		e, i;
+	int		e, i, b, l;
 	sharedEntity_t *ent;
 	svEntity_t	*svEnt;
-	int		l;
+	svClusterLink_t	*link;
 	int		clientarea, clientcluster;
 	int		leafnum;
-	int		c_fullsend;
 	byte	*clientpvs;
-	byte	*bitvector;
+	byte	*row;
+	unsigned	bits;
+	unsigned	candidates[MAX_GENTITIES/32];
 
 	// during an error shutdown message we may need to transmit
 	// the shutdown message after the server has shutdown, so
@@ -308,115 +524,113 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 
 	clientpvs = CM_ClusterPVS (clientcluster);
 
-	c_fullsend = 0;
-
-	for ( e = 0 ; e < sv.num_entities ; e++ ) {
-		ent = SV_GentityNum(e);
-
-		// never send entities that aren't linked in
-		if ( !ent->r.linked ) {
-			continue;
+	// gather everything resident in the visible clusters,
+	// skipping 32 clusters at a time where nothing is visible
+	Com_Memset( candidates, 0, sizeof( candidates ) );
+	for ( i = 0 ; i < sv.numClusters ; i += 32 ) {
+		row = clientpvs + ( i >> 3 );
+		bits = 0;
+		for ( b = 0 ; b < 4 && i + b * 8 < sv.numClusters ; b++ ) {
+			bits |= (unsigned)row[b] << ( b * 8 );
 		}
-
-		if (ent->s.number != e) {
-			Com_DPrintf ("FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
-		}
-
-		// entities can be flagged to explicitly not be sent to the client
-		if ( ent->r.svFlags & SVF_NOCLIENT ) {
-			continue;
+		if ( sv.numClusters - i < 32 ) {
+			bits &= ( 1U << ( sv.numClusters - i ) ) - 1;
 		}
 
-		// entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
-			if ( ent->r.singleClient != frame->ps.clientNum ) {
+		for ( b = i ; bits ; b++, bits >>= 1 ) {
+			if ( !( bits & 1 ) ) {
 				continue;
 			}
-		}
-		// entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
-			if ( ent->r.singleClient == frame->ps.clientNum ) {
-				continue;
+			for ( link = sv.clusterEntities[b] ; link ; link = link->next ) {
+				candidates[ link->entityNum >> 5 ] |= 1U << ( link->entityNum & 31 );
 			}
 		}
-		// entities can be flagged to be sent to a given mask of clients
-		if ( ent->r.svFlags & SVF_CLIENTMASK ) {
-			if (frame->ps.clientNum >= 32)
-				Com_Error( ERR_DROP, "SVF_CLIENTMASK: cientNum > 32\n" );
-			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
-				continue;
-		}
-
-		svEnt = SV_SvEntityForGentity( ent );
-
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter ) {
-			continue;
-		}
-
-		// broadcast entities are always sent
-		if ( ent->r.svFlags & SVF_BROADCAST ) {
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
-			continue;
-		}
+	}
 
-		// ignore if not touching a PV leaf
-		// check area
-		if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
-			// doors can legally straddle two areas, so
-			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
-				continue;		// blocked by a door
+	// entities touching more clusters than we keep track of
+	// are visible if any cluster in their range is
+	for ( link = sv.bigClusterEntities ; link ; link = link->next ) {
+		svEnt = &sv.svEntities[ link->entityNum ];
+		for ( l = svEnt->firstCluster ; l <= svEnt->lastCluster ; l++ ) {
+			if ( clientpvs[l >> 3] & ( 1 << ( l & 7 ) ) ) {
+				candidates[ link->entityNum >> 5 ] |= 1U << ( link->entityNum & 31 );
+				break;
 			}
 		}
+	}
 
-		bitvector = clientpvs;
+	// never send entities that aren't linked in or are flagged not
+	// to be sent, and broadcast entities are always sent
+	for ( i = 0 ; i < MAX_GENTITIES/32 ; i++ ) {
+		candidates[i] = ( candidates[i] & sv_sendableEntities[i] ) | sv_broadcastEntities[i];
+	}
 
-		// check individual leafs
-		if ( !svEnt->numClusters ) {
-			continue;
-		}
-		l = 0;
-		for ( i=0 ; i < svEnt->numClusters ; i++ ) {
-			l = svEnt->clusternums[i];
-			if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-				break;
+	for ( i = 0 ; i < ( sv.num_entities + 31 ) >> 5 ; i++ ) {
+		for ( e = i << 5, bits = candidates[i] ; bits ; e++, bits >>= 1 ) {
+			if ( !( bits & 1 ) ) {
+				continue;
 			}
-		}
+			ent = SV_GentityNum(e);
 
-		// if we haven't found it to be visible,
-		// check overflow clusters that coudln't be stored
-		if ( i == svEnt->numClusters ) {
-			if ( svEnt->lastCluster ) {
-				for ( ; l <= svEnt->lastCluster ; l++ ) {
-					if ( bitvector[l >> 3] & (1 << (l&7) ) ) {
-						break;
-					}
+			// entities can be flagged to be sent to only one client
+			if ( ent->r.svFlags & SVF_SINGLECLIENT ) {
+				if ( ent->r.singleClient != frame->ps.clientNum ) {
+					continue;
+				}
+			}
+			// entities can be flagged to be sent to everyone but one client
+			if ( ent->r.svFlags & SVF_NOTSINGLECLIENT ) {
+				if ( ent->r.singleClient == frame->ps.clientNum ) {
+					continue;
 				}
-				if ( l == svEnt->lastCluster ) {
-					continue;	// not visible
+			}
+			// entities can be flagged to be sent to a given mask of clients
+			if ( ent->r.svFlags & SVF_CLIENTMASK ) {
+				if (frame->ps.clientNum >= 32) {
+					eNums->error = "SVF_CLIENTMASK: cientNum > 32\n";
+					continue;
 				}
-			} else {
+				if (~ent->r.singleClient & (1 << frame->ps.clientNum))
+					continue;
+			}
+
+			svEnt = SV_SvEntityForGentity( ent );
+
+			// don't double add an entity through portals
+			if ( eNums->added[ e >> 3 ] & ( 1 << ( e & 7 ) ) ) {
 				continue;
 			}
-		}
 
-		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+			// broadcast entities are always sent
+			if ( ent->r.svFlags & SVF_BROADCAST ) {
+				SV_AddEntToSnapshot( ent, eNums );
+				continue;
+			}
 
-		// if its a portal entity, add everything visible from its camera position
-		if ( ent->r.svFlags & SVF_PORTAL ) {
-			if ( ent->s.generic1 ) {
-				vec3_t dir;
-				VectorSubtract(ent->s.origin, origin, dir);
-				if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
-					continue;
+			// the cluster lists got us here, but check area
+			if ( !CM_AreasConnected( clientarea, svEnt->areanum ) ) {
+				// doors can legally straddle two areas, so
+				// we may need to check another one
+				if ( !CM_AreasConnected( clientarea, svEnt->areanum2 ) ) {
+					continue;		// blocked by a door
 				}
 			}
-			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
-		}
 
+			// add it
+			SV_AddEntToSnapshot( ent, eNums );
+
+			// if its a portal entity, add everything visible from its camera position
+			if ( ent->r.svFlags & SVF_PORTAL ) {
+				if ( ent->s.generic1 ) {
+					vec3_t dir;
+					VectorSubtract(ent->s.origin, origin, dir);
+					if ( VectorLengthSquared(dir) > (float) ent->s.generic1 * ent->s.generic1 ) {
+						continue;
+					}
+				}
+				SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, qtrue );
+			}
+		}
 	}
 }
 
@@ -425,7 +639,9 @@ static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *fra
 SV_BuildClientSnapshot
 
 Decides which entities are going to be visible to the client, and
-copies off the playerstate and areabits.
+copies off the playerstate and areabits.  The entity states themselves
+are copied by SV_CopySnapshotEntities once SV_ReserveSnapshotEntities
+has made room for them.
 
 This properly handles multiple recursive portals, but the render
 currently doesn't.
@@ -433,26 +649,21 @@ currently doesn't.
 For viewing through other player's eyes, clent can be something other than client->gentity
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client ) {
+static void SV_BuildClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
 	vec3_t						org;
 	clientSnapshot_t			*frame;
-	snapshotEntityNumbers_t		entityNumbers;
 	int							i;
-	sharedEntity_t				*ent;
-	entityState_t				*state;
-	svEntity_t					*svEnt;
 	sharedEntity_t				*clent;
 	int							clientNum;
 	playerState_t				*ps;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	entityNumbers->error = NULL;
+	Com_Memset( entityNumbers->added, 0, sizeof( entityNumbers->added ) );
 	Com_Memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
   // https://zerowing.idsoftware.com/bugzilla/show_bug.cgi?id=62
@@ -471,11 +682,10 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 	// be regenerated from the playerstate
 	clientNum = frame->ps.clientNum;
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES ) {
-		Com_Error( ERR_DROP, "SV_SvEntityForGentity: bad gEnt" );
+		entityNumbers->error = "SV_SvEntityForGentity: bad gEnt";
+		return;
 	}
-	svEnt = &sv.svEntities[ clientNum ];
-
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[ clientNum >> 3 ] |= 1 << ( clientNum & 7 );
 
 	// find the client's viewpoint
 	VectorCopy( ps->origin, org );
@@ -483,34 +693,296 @@ static void SV_BuildClientSnapshot( client_t *client ) {
 
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers, qfalse );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, qfalse );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
-	// to work correctly.  This also catches the error condition
-	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities, 
-		sizeof( entityNumbers.snapshotEntities[0] ), SV_QsortEntityNumbers );
+	// to work correctly.
+	qsort( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities, 
+		sizeof( entityNumbers->snapshotEntities[0] ), SV_QsortEntityNumbers );
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
 	for ( i = 0 ; i < MAX_MAP_AREA_BYTES/4 ; i++ ) {
 		((int *)frame->areabits)[i] = ((int *)frame->areabits)[i] ^ -1;
 	}
+}
 
-	// copy the entity states out
-	frame->num_entities = 0;
+/*
+=============
+SV_ReserveSnapshotEntities
+
+Takes this frame's entities out of the shared ring, on the main thread
+=============
+*/
+static void SV_ReserveSnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers ) {
+	clientSnapshot_t	*frame;
+
+	if ( entityNumbers->error ) {
+		Com_Error( ERR_DROP, "%s", entityNumbers->error );
+	}
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 	frame->first_entity = svs.nextSnapshotEntities;
-	for ( i = 0 ; i < entityNumbers.numSnapshotEntities ; i++ ) {
-		ent = SV_GentityNum(entityNumbers.snapshotEntities[i]);
-		state = &svs.snapshotEntities[svs.nextSnapshotEntities % svs.numSnapshotEntities];
+	frame->num_entities = entityNumbers->numSnapshotEntities;
+	frame->generation = sv_snapshotGeneration;
+
+	svs.nextSnapshotEntities += frame->num_entities;
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
+		Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+	}
+}
+
+/*
+=============================================================================
+
+Entity update scheduling
+
+A client on a low rate used to get every visible entity in every snapshot
+and then have whole snapshots held back by SV_RateMsec.  With
+sv_snapshotBudget, each snapshot's entities are fitted to the bytes the
+client's rate allows per snapshot instead.  Entities that are new to the
+client, or whose events or type changed, always go.  The other changed
+entities are sent in order of a priority that grows with relevance and
+closeness for as long as they are held back.  The ones that don't fit
+keep the state the client already has, which deltas to nothing.
+
+=============================================================================
+*/
+
+#define	HEADER_RATE_BYTES	48		// include our header, IP header, and some overhead
+#define	PLAYERSTATE_RESERVE_BYTES	64		// room left for the playerstate delta
+#define	NEW_ENTITY_BYTES			32		// rough size of a delta from the baseline
+#define	ENTITY_NEAR_DISTANCE		512		// relevance halves at this distance
+#define	MAX_DEFER_MSEC				1000	// updates are never held back longer than this
+
+typedef struct {
+	int				index;				// in the frame
+	entityState_t	*oldstate;			// what the client has
+	float			priority;
+	int				bytes;
+} deferCandidate_t;
+
+/*
+=============
+SV_SnapshotEntityBudget
+
+Bytes the entities of this snapshot can take, or -1 for no limit
+=============
+*/
+static int SV_SnapshotEntityBudget( client_t *client, msg_t *msg, clientSnapshot_t *oldframe ) {
+	int		rate;
+	int		budget;
+
+	if ( !sv_snapshotBudget->integer || !oldframe ) {
+		return -1;
+	}
+
+	// bots aren't sent anything, and local clients aren't held to
+	// their rate, see SV_SendMessageToClient
+	if ( client->netchan.remoteAddress.type == NA_BOT || client->netchan.remoteAddress.type == NA_LOOPBACK
+		|| ( sv_lanForceRate->integer && Sys_IsLANAddress( client->netchan.remoteAddress ) ) ) {
+		return -1;
+	}
+
+	rate = client->rate;
+	if ( sv_maxRate->integer && sv_maxRate->integer < rate ) {
+		rate = sv_maxRate->integer;
+	}
+
+	budget = rate * client->snapshotMsec / 1000 - HEADER_RATE_BYTES - msg->cursize - PLAYERSTATE_RESERVE_BYTES;
+	if ( budget < 0 ) {
+		budget = 0;
+	}
+	return budget;
+}
+
+/*
+=============
+SV_EstimateDeltaBytes
+
+Every entityState_t field is four bytes, and a changed one
+costs about three once it has been through the huffman tree
+=============
+*/
+static int SV_EstimateDeltaBytes( const entityState_t *from, const entityState_t *to ) {
+	const int	*a, *b;
+	int			i, changed;
+
+	a = (const int *)from;
+	b = (const int *)to;
+	changed = 0;
+	for ( i = 0 ; i < (int)( sizeof( entityState_t ) / 4 ) ; i++ ) {
+		if ( a[i] != b[i] ) {
+			changed++;
+		}
+	}
+	if ( !changed ) {
+		return 0;
+	}
+	return 2 + changed * 3;
+}
+
+/*
+=============
+SV_EntityRelevance
+
+The server doesn't know the game's entity types, so other
+clients and moving things count as the interesting ones
+=============
+*/
+static float SV_EntityRelevance( const entityState_t *state, const vec3_t viewOrigin ) {
+	vec3_t	delta;
+	float	relevance;
+
+	if ( state->number < sv_maxclients->integer ) {
+		relevance = 4;
+	} else if ( state->pos.trType != TR_STATIONARY ) {
+		relevance = 2;
+	} else {
+		relevance = 1;
+	}
+
+	VectorSubtract( state->pos.trBase, viewOrigin, delta );
+	return relevance * ENTITY_NEAR_DISTANCE / ( ENTITY_NEAR_DISTANCE + VectorLength( delta ) );
+}
+
+/*
+=======================
+SV_QsortDeferCandidates
+=======================
+*/
+static int QDECL SV_QsortDeferCandidates( const void *a, const void *b ) {
+	const deferCandidate_t	*ca, *cb;
+
+	ca = (const deferCandidate_t *)a;
+	cb = (const deferCandidate_t *)b;
+
+	if ( ca->priority > cb->priority ) {
+		return -1;
+	}
+	if ( ca->priority < cb->priority ) {
+		return 1;
+	}
+	return ca->index - cb->index;
+}
+
+/*
+=============
+SV_CopySnapshotEntities
+
+Copies the entity states out into the room reserved for them, holding
+back the updates that don't fit in budget bytes unless it is -1
+=============
+*/
+static void SV_CopySnapshotEntities( client_t *client, snapshotEntityNumbers_t *entityNumbers, clientSnapshot_t *oldframe, int budget ) {
+	clientSnapshot_t	*frame;
+	sharedEntity_t		*ent;
+	entityState_t		*state, *oldstate;
+	int					i, num, oldindex, bytes;
+	int					numCandidates, numDeferred;
+	deferCandidate_t	*candidates, *c;
+	frameMark_t			mark;
+	vec3_t				org;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+	for ( i = 0 ; i < frame->num_entities ; i++ ) {
+		ent = SV_GentityNum(entityNumbers->snapshotEntities[i]);
+		state = &svs.snapshotEntities[(frame->first_entity+i) % svs.numSnapshotEntities];
 		*state = ent->s;
-		svs.nextSnapshotEntities++;
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE ) {
-			Com_Error(ERR_FATAL, "svs.nextSnapshotEntities wrapped");
+	}
+
+	if ( budget < 0 || !oldframe ) {
+		return;
+	}
+
+	VectorCopy( frame->ps.origin, org );
+	org[2] += frame->ps.viewheight;
+
+	mark = Hunk_FrameMark();
+	candidates = Hunk_FrameAlloc( frame->num_entities * sizeof( *candidates ) );
+
+	// both lists are sorted by entity number
+	numCandidates = 0;
+	oldindex = 0;
+	for ( i = 0 ; i < frame->num_entities ; i++ ) {
+		state = &svs.snapshotEntities[(frame->first_entity+i) % svs.numSnapshotEntities];
+		num = state->number;
+
+		oldstate = NULL;
+		for ( ; oldindex < oldframe->num_entities ; oldindex++ ) {
+			oldstate = &svs.snapshotEntities[(oldframe->first_entity+oldindex) % svs.numSnapshotEntities];
+			if ( oldstate->number >= num ) {
+				break;
+			}
+		}
+		if ( oldindex >= oldframe->num_entities || oldstate->number != num ) {
+			// new to the client, it has to go
+			client->entityPriority[num] = 0;
+			client->entityDeferred[num] = 0;
+			budget -= NEW_ENTITY_BYTES;
+			continue;
+		}
+
+		bytes = SV_EstimateDeltaBytes( oldstate, state );
+		if ( !bytes ) {
+			client->entityPriority[num] = 0;
+			client->entityDeferred[num] = 0;
+			continue;
+		}
+
+		if ( state->event != oldstate->event || state->eType != oldstate->eType
+			|| state->modelindex != oldstate->modelindex || state->modelindex2 != oldstate->modelindex2
+			|| ( client->entityDeferred[num] && svs.time - client->entityDeferred[num] >= MAX_DEFER_MSEC ) ) {
+			client->entityPriority[num] = 0;
+			client->entityDeferred[num] = 0;
+			budget -= bytes;
+			continue;
+		}
+
+		client->entityPriority[num] += SV_EntityRelevance( state, org ) * client->snapshotMsec;
+
+		c = &candidates[numCandidates++];
+		c->index = i;
+		c->oldstate = oldstate;
+		c->priority = client->entityPriority[num];
+		c->bytes = bytes;
+	}
+
+	if ( !numCandidates ) {
+		Hunk_FrameRelease( mark );
+		return;
+	}
+
+	// most important first
+	qsort( candidates, numCandidates, sizeof( candidates[0] ), SV_QsortDeferCandidates );
+
+	numDeferred = 0;
+	for ( i = 0, c = candidates ; i < numCandidates ; i++, c++ ) {
+		state = &svs.snapshotEntities[(frame->first_entity+c->index) % svs.numSnapshotEntities];
+		num = state->number;
+		if ( c->bytes <= budget ) {
+			budget -= c->bytes;
+			client->entityPriority[num] = 0;
+			client->entityDeferred[num] = 0;
+			continue;
+		}
+
+		// the client keeps what it has
+		*state = *c->oldstate;
+		if ( !client->entityDeferred[num] ) {
+			client->entityDeferred[num] = svs.time ? svs.time : 1;
 		}
-		frame->num_entities++;
+		numDeferred++;
+	}
+
+	Hunk_FrameRelease( mark );
+
+	// the held back states weren't copied in this pass, so
+	// deltas to or from this frame can't be shared
+	if ( numDeferred ) {
+		frame->generation = 0;
 	}
 }
 
@@ -523,7 +995,6 @@ Return the number of msec a given size message is supposed
 to take to clear, based on the current rate
 ====================
 */
-#define	HEADER_RATE_BYTES	48		// include our header, IP header, and some overhead
 static int SV_RateMsec( client_t *client, int messageSize ) {
 	int		rate;
 	int		rateMsec;
@@ -599,51 +1070,142 @@ void SV_SendMessageToClient( msg_t *msg, client_t *client ) {
 }
 
 
+/*
+=============================================================================
+
+Snapshots for all the clients that are due one are generated together.
+The visibility pass and the message encoding only write to the client's
+own frame and job, so both run on the job threads; the snapshot entity
+ring is carved up in between and the packets are sent afterwards on the
+main thread.
+
+=============================================================================
+*/
+
+typedef struct {
+	client_t				*client;
+	clientSnapshot_t		*oldframe;		// NULL for a full snapshot
+	int						lastframe;
+	snapshotEntityNumbers_t	entityNumbers;
+	msg_t					msg;
+	byte					msgBuf[MAX_MSGLEN];
+} snapshotJob_t;
+
+static snapshotJob_t	sv_snapshotJobs[MAX_CLIENTS];
+
 /*
 =======================
-SV_SendClientSnapshot
+SV_BuildSnapshotJob
+=======================
+*/
+static void SV_BuildSnapshotJob( int index, void *data ) {
+	snapshotJob_t	*job;
 
-Also called by SV_FinalMessage
+	job = (snapshotJob_t *)data + index;
+	SV_BuildClientSnapshot( job->client, &job->entityNumbers );
+}
 
+/*
+=======================
+SV_WriteSnapshotJob
 =======================
 */
-void SV_SendClientSnapshot( client_t *client ) {
-	byte		msg_buf[MAX_MSGLEN];
-	msg_t		msg;
+static void SV_WriteSnapshotJob( int index, void *data ) {
+	snapshotJob_t	*job;
+	client_t		*client;
 
-	// build the snapshot
-	SV_BuildClientSnapshot( client );
+	job = (snapshotJob_t *)data + index;
+	client = job->client;
 
 	// bots need to have their snapshots build, but
 	// the query them directly without needing to be sent
 	if ( client->gentity && client->gentity->r.svFlags & SVF_BOT ) {
+		SV_CopySnapshotEntities( client, &job->entityNumbers, NULL, -1 );
 		return;
 	}
 
-	MSG_Init (&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = qtrue;
-
 	// NOTE, MRE: all server->client messages now acknowledge
 	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
+	MSG_WriteLong( &job->msg, client->lastClientCommand );
 
 	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
+	SV_UpdateServerCommandsToClient( client, &job->msg );
+
+	// whatever room the rate leaves goes to the entities
+	SV_CopySnapshotEntities( client, &job->entityNumbers, job->oldframe,
+		SV_SnapshotEntityBudget( client, &job->msg, job->oldframe ) );
 
 	// send over all the relevant entityState_t
 	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+	SV_WriteSnapshotToClient( client, &job->msg, job->oldframe, job->lastframe );
+}
+
+/*
+=======================
+SV_SendClientSnapshots
+=======================
+*/
+static void SV_SendClientSnapshots( snapshotJob_t *jobs, int numJobs ) {
+	int				i;
+	snapshotJob_t	*job;
+	client_t		*client;
+
+	if ( !numJobs ) {
+		return;
+	}
 
-	// Add any download data if the client is downloading
-	SV_WriteDownloadToClient( client, &msg );
+	SV_BeginDeltaCache( numJobs );
+
+	if ( sv.state ) {
+		SV_MarkSnapshotEntities();
+	}
+
+	// decide what every client can see
+	Com_ParallelFor( numJobs, SV_BuildSnapshotJob, jobs );
+
+	for ( i = 0, job = jobs ; i < numJobs ; i++, job++ ) {
+		SV_ReserveSnapshotEntities( job->client, &job->entityNumbers );
+	}
 
-	// check for overflow
-	if ( msg.overflowed ) {
-		Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
-		MSG_Clear (&msg);
+	for ( i = 0, job = jobs ; i < numJobs ; i++, job++ ) {
+		MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+		job->msg.allowoverflow = qtrue;
+		job->oldframe = SV_ChooseDeltaFrame( job->client, &job->lastframe );
 	}
 
-	SV_SendMessageToClient( &msg, client );
+	// copy out the entities and delta encode the messages
+	Com_ParallelFor( numJobs, SV_WriteSnapshotJob, jobs );
+
+	for ( i = 0, job = jobs ; i < numJobs ; i++, job++ ) {
+		client = job->client;
+		if ( client->gentity && client->gentity->r.svFlags & SVF_BOT ) {
+			continue;
+		}
+
+		// Add any download data if the client is downloading
+		SV_WriteDownloadToClient( client, &job->msg );
+
+		// check for overflow
+		if ( job->msg.overflowed ) {
+			Com_Printf ("WARNING: msg overflowed for %s\n", client->name);
+			MSG_Clear (&job->msg);
+		}
+
+		SV_SendMessageToClient( &job->msg, client );
+	}
+}
+
+/*
+=======================
+SV_SendClientSnapshot
+
+Also called by SV_FinalMessage
+
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client ) {
+	sv_snapshotJobs[0].client = client;
+	SV_SendClientSnapshots( sv_snapshotJobs, 1 );
 }
 
 
@@ -654,9 +1216,11 @@ SV_SendClientMessages
 */
 void SV_SendClientMessages( void ) {
 	int			i;
+	int			numJobs;
 	client_t	*c;
 
 	// send a message to each connected client
+	numJobs = 0;
 	for (i=0, c = svs.clients ; i < sv_maxclients->integer ; i++, c++) {
 		if (!c->state) {
 			continue;		// not connected
@@ -676,7 +1240,8 @@ void SV_SendClientMessages( void ) {
 		}
 
 		// generate and send a new message
-		SV_SendClientSnapshot( c );
+		sv_snapshotJobs[numJobs++].client = c;
 	}
-}
 
+	SV_SendClientSnapshots( sv_snapshotJobs, numJobs );
+}
@@ -75,6 +75,149 @@ worldSector_t	sv_worldSectors[AREA_NODES];
 int			sv_numworldSectors;
 
 
+/*
+===============================================================================
+
+DYNAMIC AABB TREE
+
+With sv_worldTree 1 the sector tree is replaced by a balanced tree of
+bounding boxes that adapts to wherever the entities actually are, so
+nothing piles up in the upper nodes on large or dense maps.  Leaf boxes
+are padded by WORLD_TREE_MARGIN, which lets most moves be absorbed
+without touching the tree at all.
+
+===============================================================================
+*/
+
+#define	WORLD_TREE_NODES	(MAX_GENTITIES*2)
+#define	WORLD_TREE_MARGIN	16
+#define	WORLD_TREE_STACK	64
+
+typedef struct {
+	vec3_t		mins, maxs;		// padded for leafs
+	int			parent;			// -1 for the root, next free node when free
+	int			children[2];	// -1 for leafs
+	int			height;			// 0 for leafs
+	int			entityNum;		// leafs only
+} worldNode_t;
+
+static worldNode_t	sv_worldNodes[WORLD_TREE_NODES];
+static int			sv_worldRoot;
+static int			sv_worldFreeNodes;
+static int			sv_numWorldNodes;
+static qboolean		sv_worldTreeActive;		// sv_worldTree as latched at SV_ClearWorld
+
+typedef struct {
+	int		links;			// SV_LinkEntity calls that stayed linked
+	int		refits;			// moves that stayed inside the padded leaf box
+	int		reinserts;		// moves that needed the leaf moved in the tree
+	int		queries;		// SV_AreaEntities calls
+	int		nodesVisited;	// tree nodes or sectors looked at
+	int		boxesTested;	// entity bounds checked against a query
+	int		entitiesFound;
+} worldStats_t;
+
+static worldStats_t	sv_worldStats;
+
+
+/*
+===============================================================================
+
+TRACE CACHE
+
+With sv_traceCache 1 the results of SV_Trace and SV_PointContents are
+remembered for as long as nothing they depend on can have changed, since
+the bot movement code often asks the exact same question several times
+within one call.  Keys are compared bit for bit, and every entity link or
+unlink throws the whole cache away.
+
+The game also changes fields the results depend on without relinking:
+r.contents, r.ownerNum, and s.origin and s.angles, which SV_PointContents
+clips against.  It can only do that while its own code runs, so the cache
+is also thrown away on the way into and out of every game system call,
+which covers the game code before and after the call.  The only traces
+that don't come from inside a system call are the bot debug tests, which
+clear it themselves.  A hit is then exactly what the trace would have
+returned.  The cache is left alone while the bots think on the job
+threads, and cleared once they are done.
+
+===============================================================================
+*/
+
+#define	TRACE_CACHE_SIZE	1024	// power of two
+#define	CONTENTS_CACHE_SIZE	256		// power of two
+
+typedef struct {
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+} traceKey_t;
+
+typedef struct {
+	unsigned	generation;
+	traceKey_t	key;
+	trace_t		trace;
+} traceCacheEntry_t;
+
+typedef struct {
+	unsigned	generation;
+	vec3_t		point;
+	int			passEntityNum;
+	int			contents;
+} contentsCacheEntry_t;
+
+typedef struct {
+	int		traces;			// SV_Trace calls with the cache on
+	int		traceHits;
+	int		pointContents;	// SV_PointContents calls with the cache on
+	int		contentsHits;
+	int		invalidations;
+} traceCacheStats_t;
+
+static traceCacheEntry_t	sv_traceEntries[TRACE_CACHE_SIZE];
+static contentsCacheEntry_t	sv_contentsEntries[CONTENTS_CACHE_SIZE];
+static unsigned				sv_traceGeneration = 1;		// entries from older generations are stale
+static traceCacheStats_t	sv_traceCacheStats;
+
+/*
+================
+SV_ClearTraceCache
+
+Called at the start of every frame, whenever an entity is linked or
+unlinked and whenever the game code may have run.  Only bumps the
+generation, the entries are left to age out.
+================
+*/
+void SV_ClearTraceCache( void ) {
+	sv_traceCacheStats.invalidations++;
+
+	if ( ++sv_traceGeneration == 0 ) {
+		// wrapped, so old entries could look current again
+		Com_Memset( sv_traceEntries, 0, sizeof( sv_traceEntries ) );
+		Com_Memset( sv_contentsEntries, 0, sizeof( sv_contentsEntries ) );
+		sv_traceGeneration = 1;
+	}
+}
+
+/*
+================
+SV_HashWords
+================
+*/
+static unsigned SV_HashWords( const int *words, int count ) {
+	unsigned	hash;
+	int			i;
+
+	hash = 2166136261u;
+	for ( i = 0 ; i < count ; i++ ) {
+		hash = ( hash ^ (unsigned)words[i] ) * 16777619u;
+	}
+	return hash ^ ( hash >> 15 );
+}
+
+
 /*
 ===============
 SV_SectorList_f
@@ -85,6 +228,11 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
+	if ( sv_worldTreeActive ) {
+		Com_Printf( "sector tree not in use, see worldstats\n" );
+		return;
+	}
+
 	for ( i = 0 ; i < AREA_NODES ; i++ ) {
 		sec = &sv_worldSectors[i];
 
@@ -147,6 +295,7 @@ SV_ClearWorld
 void SV_ClearWorld( void ) {
 	clipHandle_t	h;
 	vec3_t			mins, maxs;
+	int				i;
 
 	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
 	sv_numworldSectors = 0;
@@ -155,6 +304,478 @@ void SV_ClearWorld( void ) {
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	// the tree just needs its free list threaded, a changed
+	// sv_worldTree only takes effect here so nothing is linked twice
+	sv_worldTreeActive = sv_worldTree->integer != 0;
+	sv_worldRoot = -1;
+	sv_numWorldNodes = 0;
+	for ( i = 0 ; i < WORLD_TREE_NODES ; i++ ) {
+		sv_worldNodes[i].parent = i + 1 < WORLD_TREE_NODES ? i + 1 : -1;
+	}
+	sv_worldFreeNodes = 0;
+	for ( i = 0 ; i < MAX_GENTITIES ; i++ ) {
+		sv.svEntities[i].worldNode = -1;
+	}
+	Com_Memset( &sv_worldStats, 0, sizeof( sv_worldStats ) );
+
+	// nothing from the last level can be trusted
+	SV_ClearTraceCache();
+	Com_Memset( &sv_traceCacheStats, 0, sizeof( sv_traceCacheStats ) );
+
+	// one resident entity list per PVS cluster
+	sv.numClusters = CM_NumClusters();
+	sv.clusterEntities = Hunk_Alloc( sv.numClusters * sizeof( *sv.clusterEntities ), h_high );
+	sv.bigClusterEntities = NULL;
+}
+
+
+/*
+===============
+SV_LinkClusterEntity
+
+Chains the entity into the lists of the clusters it was found to touch
+===============
+*/
+static void SV_LinkClusterEntity( svEntity_t *ent ) {
+	svClusterLink_t	*link, **head;
+	int				i;
+
+	if ( ent->numClusters == -1 ) {
+		link = &ent->clusterLinks[0];
+		link->entityNum = ent - sv.svEntities;
+		link->prev = NULL;
+		link->next = sv.bigClusterEntities;
+		if ( link->next ) {
+			link->next->prev = link;
+		}
+		sv.bigClusterEntities = link;
+		return;
+	}
+
+	for ( i = 0 ; i < ent->numClusters ; i++ ) {
+		head = &sv.clusterEntities[ ent->clusternums[i] ];
+		link = &ent->clusterLinks[i];
+		link->entityNum = ent - sv.svEntities;
+		link->prev = NULL;
+		link->next = *head;
+		if ( link->next ) {
+			link->next->prev = link;
+		}
+		*head = link;
+	}
+}
+
+/*
+===============
+SV_UnlinkClusterEntity
+===============
+*/
+static void SV_UnlinkClusterEntity( svEntity_t *ent ) {
+	svClusterLink_t	*link;
+	int				i, num;
+
+	num = ent->numClusters == -1 ? 1 : ent->numClusters;
+	for ( i = 0 ; i < num ; i++ ) {
+		link = &ent->clusterLinks[i];
+		if ( link->prev ) {
+			link->prev->next = link->next;
+		} else if ( ent->numClusters == -1 ) {
+			sv.bigClusterEntities = link->next;
+		} else {
+			sv.clusterEntities[ ent->clusternums[i] ] = link->next;
+		}
+		if ( link->next ) {
+			link->next->prev = link->prev;
+		}
+	}
+	ent->numClusters = 0;
+}
+
+
+/*
+===============
+SV_AllocWorldNode
+===============
+*/
+static int SV_AllocWorldNode( void ) {
+	int		n;
+
+	n = sv_worldFreeNodes;
+	if ( n == -1 ) {
+		// can't happen, a tree over MAX_GENTITIES leafs never needs more
+		Com_Error( ERR_DROP, "SV_AllocWorldNode: out of nodes" );
+	}
+	sv_worldFreeNodes = sv_worldNodes[n].parent;
+	sv_worldNodes[n].parent = -1;
+	sv_worldNodes[n].children[0] = sv_worldNodes[n].children[1] = -1;
+	sv_worldNodes[n].height = 0;
+	sv_worldNodes[n].entityNum = -1;
+	sv_numWorldNodes++;
+	return n;
+}
+
+/*
+===============
+SV_FreeWorldNode
+===============
+*/
+static void SV_FreeWorldNode( int n ) {
+	sv_worldNodes[n].parent = sv_worldFreeNodes;
+	sv_worldFreeNodes = n;
+	sv_numWorldNodes--;
+}
+
+/*
+===============
+SV_BoxCost
+
+Half the surface area, which is what the insertion heuristic minimizes
+===============
+*/
+static float SV_BoxCost( const vec3_t mins, const vec3_t maxs ) {
+	float	dx, dy, dz;
+
+	dx = maxs[0] - mins[0];
+	dy = maxs[1] - mins[1];
+	dz = maxs[2] - mins[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+/*
+===============
+SV_UnionCost
+===============
+*/
+static float SV_UnionCost( const worldNode_t *a, const worldNode_t *b ) {
+	vec3_t	mins, maxs;
+	int		i;
+
+	for ( i = 0 ; i < 3 ; i++ ) {
+		mins[i] = a->mins[i] < b->mins[i] ? a->mins[i] : b->mins[i];
+		maxs[i] = a->maxs[i] > b->maxs[i] ? a->maxs[i] : b->maxs[i];
+	}
+	return SV_BoxCost( mins, maxs );
+}
+
+/*
+===============
+SV_RefitWorldNode
+
+Recomputes an interior node's box and height from its children
+===============
+*/
+static void SV_RefitWorldNode( int n ) {
+	worldNode_t	*node, *c0, *c1;
+	int			i;
+
+	node = &sv_worldNodes[n];
+	c0 = &sv_worldNodes[ node->children[0] ];
+	c1 = &sv_worldNodes[ node->children[1] ];
+	for ( i = 0 ; i < 3 ; i++ ) {
+		node->mins[i] = c0->mins[i] < c1->mins[i] ? c0->mins[i] : c1->mins[i];
+		node->maxs[i] = c0->maxs[i] > c1->maxs[i] ? c0->maxs[i] : c1->maxs[i];
+	}
+	node->height = 1 + ( c0->height > c1->height ? c0->height : c1->height );
+}
+
+/*
+===============
+SV_RotateWorldNode
+
+Lifts the taller grandchild of a up into a's place if a is out of
+balance, returns the node now at a's position
+===============
+*/
+static int SV_RotateWorldNode( int a ) {
+	worldNode_t	*A, *B, *C, *F, *G;
+	int			b, c, f, g, side, balance;
+
+	A = &sv_worldNodes[a];
+	if ( A->height < 2 ) {
+		return a;
+	}
+
+	b = A->children[0];
+	c = A->children[1];
+	B = &sv_worldNodes[b];
+	C = &sv_worldNodes[c];
+
+	balance = C->height - B->height;
+	if ( balance >= -1 && balance <= 1 ) {
+		return a;
+	}
+
+	// rotate the taller child (c) up, swapping the roles if b is taller
+	if ( balance < 0 ) {
+		int			t;
+		worldNode_t	*T;
+
+		t = b; b = c; c = t;
+		T = B; B = C; C = T;
+		side = 0;
+	} else {
+		side = 1;
+	}
+
+	f = C->children[0];
+	g = C->children[1];
+	F = &sv_worldNodes[f];
+	G = &sv_worldNodes[g];
+
+	// c takes a's place
+	C->children[0] = a;
+	C->parent = A->parent;
+	A->parent = c;
+	if ( C->parent != -1 ) {
+		if ( sv_worldNodes[ C->parent ].children[0] == a ) {
+			sv_worldNodes[ C->parent ].children[0] = c;
+		} else {
+			sv_worldNodes[ C->parent ].children[1] = c;
+		}
+	} else {
+		sv_worldRoot = c;
+	}
+
+	// the taller of c's children stays under c, the other goes to a
+	if ( F->height > G->height ) {
+		C->children[1] = f;
+		A->children[side] = g;
+		G->parent = a;
+	} else {
+		C->children[1] = g;
+		A->children[side] = f;
+		F->parent = a;
+	}
+	SV_RefitWorldNode( a );
+	SV_RefitWorldNode( c );
+
+	return c;
+}
+
+/*
+===============
+SV_RefitWorldAncestors
+===============
+*/
+static void SV_RefitWorldAncestors( int n ) {
+	while ( n != -1 ) {
+		n = SV_RotateWorldNode( n );
+		SV_RefitWorldNode( n );
+		n = sv_worldNodes[n].parent;
+	}
+}
+
+/*
+===============
+SV_InsertWorldLeaf
+===============
+*/
+static void SV_InsertWorldLeaf( int leaf ) {
+	worldNode_t	*l, *node;
+	int			n, sibling, parent, oldParent;
+	float		cost, cost0, cost1, inherit, area, combined;
+	int			i;
+
+	l = &sv_worldNodes[leaf];
+	if ( sv_worldRoot == -1 ) {
+		sv_worldRoot = leaf;
+		l->parent = -1;
+		return;
+	}
+
+	// walk down to the sibling that grows the tree's surface the least
+	n = sv_worldRoot;
+	while ( sv_worldNodes[n].children[0] != -1 ) {
+		node = &sv_worldNodes[n];
+		area = SV_BoxCost( node->mins, node->maxs );
+		combined = SV_UnionCost( node, l );
+
+		// cost of making a new parent for this node and the leaf
+		cost = 2 * combined;
+		// minimum cost of pushing the leaf further down
+		inherit = 2 * ( combined - area );
+
+		for ( i = 0 ; i < 2 ; i++ ) {
+			worldNode_t	*child;
+			float		c;
+
+			child = &sv_worldNodes[ node->children[i] ];
+			c = SV_UnionCost( child, l ) + inherit;
+			if ( child->children[0] != -1 ) {
+				c -= SV_BoxCost( child->mins, child->maxs );
+			}
+			if ( i == 0 ) {
+				cost0 = c;
+			} else {
+				cost1 = c;
+			}
+		}
+
+		if ( cost < cost0 && cost < cost1 ) {
+			break;
+		}
+		n = cost0 < cost1 ? node->children[0] : node->children[1];
+	}
+	sibling = n;
+
+	// create a new parent over the sibling and the leaf
+	oldParent = sv_worldNodes[sibling].parent;
+	parent = SV_AllocWorldNode();
+	sv_worldNodes[parent].parent = oldParent;
+	sv_worldNodes[parent].children[0] = sibling;
+	sv_worldNodes[parent].children[1] = leaf;
+	sv_worldNodes[sibling].parent = parent;
+	l->parent = parent;
+	if ( oldParent != -1 ) {
+		if ( sv_worldNodes[oldParent].children[0] == sibling ) {
+			sv_worldNodes[oldParent].children[0] = parent;
+		} else {
+			sv_worldNodes[oldParent].children[1] = parent;
+		}
+	} else {
+		sv_worldRoot = parent;
+	}
+
+	SV_RefitWorldAncestors( parent );
+}
+
+/*
+===============
+SV_RemoveWorldLeaf
+===============
+*/
+static void SV_RemoveWorldLeaf( int leaf ) {
+	int		parent, grandParent, sibling;
+
+	if ( leaf == sv_worldRoot ) {
+		sv_worldRoot = -1;
+		return;
+	}
+
+	parent = sv_worldNodes[leaf].parent;
+	grandParent = sv_worldNodes[parent].parent;
+	if ( sv_worldNodes[parent].children[0] == leaf ) {
+		sibling = sv_worldNodes[parent].children[1];
+	} else {
+		sibling = sv_worldNodes[parent].children[0];
+	}
+
+	// the sibling takes the parent's place
+	sv_worldNodes[sibling].parent = grandParent;
+	if ( grandParent != -1 ) {
+		if ( sv_worldNodes[grandParent].children[0] == parent ) {
+			sv_worldNodes[grandParent].children[0] = sibling;
+		} else {
+			sv_worldNodes[grandParent].children[1] = sibling;
+		}
+		SV_RefitWorldAncestors( grandParent );
+	} else {
+		sv_worldRoot = sibling;
+	}
+	SV_FreeWorldNode( parent );
+}
+
+/*
+===============
+SV_LinkWorldLeaf
+
+Keeps the entity's leaf where it is if the new bounds still fit
+inside the padded box, otherwise moves it in the tree
+===============
+*/
+static void SV_LinkWorldLeaf( svEntity_t *ent, sharedEntity_t *gEnt ) {
+	worldNode_t	*leaf;
+	int			i;
+
+	if ( ent->worldNode != -1 ) {
+		leaf = &sv_worldNodes[ ent->worldNode ];
+		for ( i = 0 ; i < 3 ; i++ ) {
+			if ( gEnt->r.absmin[i] < leaf->mins[i] || gEnt->r.absmax[i] > leaf->maxs[i] ) {
+				break;
+			}
+		}
+		if ( i == 3 ) {
+			sv_worldStats.refits++;
+			return;
+		}
+		sv_worldStats.reinserts++;
+		SV_RemoveWorldLeaf( ent->worldNode );
+	} else {
+		ent->worldNode = SV_AllocWorldNode();
+		sv_worldNodes[ ent->worldNode ].entityNum = ent - sv.svEntities;
+	}
+
+	leaf = &sv_worldNodes[ ent->worldNode ];
+	for ( i = 0 ; i < 3 ; i++ ) {
+		leaf->mins[i] = gEnt->r.absmin[i] - WORLD_TREE_MARGIN;
+		leaf->maxs[i] = gEnt->r.absmax[i] + WORLD_TREE_MARGIN;
+	}
+	SV_InsertWorldLeaf( ent->worldNode );
+}
+
+/*
+===============
+SV_UnlinkWorldLeaf
+===============
+*/
+static void SV_UnlinkWorldLeaf( svEntity_t *ent ) {
+	SV_RemoveWorldLeaf( ent->worldNode );
+	SV_FreeWorldNode( ent->worldNode );
+	ent->worldNode = -1;
+}
+
+/*
+===============
+SV_WorldTreeDepth_r
+===============
+*/
+static void SV_WorldTreeDepth_r( int n, int depth, int *leafs, int *depthSum ) {
+	if ( sv_worldNodes[n].children[0] == -1 ) {
+		(*leafs)++;
+		*depthSum += depth;
+		return;
+	}
+	SV_WorldTreeDepth_r( sv_worldNodes[n].children[0], depth + 1, leafs, depthSum );
+	SV_WorldTreeDepth_r( sv_worldNodes[n].children[1], depth + 1, leafs, depthSum );
+}
+
+/*
+===============
+SV_WorldStats_f
+
+Reports how the spatial index is doing since the map was loaded
+===============
+*/
+void SV_WorldStats_f( void ) {
+	int		leafs, depthSum, queries;
+
+	if ( sv_worldTreeActive ) {
+		leafs = depthSum = 0;
+		if ( sv_worldRoot != -1 ) {
+			SV_WorldTreeDepth_r( sv_worldRoot, 0, &leafs, &depthSum );
+		}
+		Com_Printf( "dynamic AABB tree: %i entities, %i nodes, height %i, average depth %.1f\n",
+			leafs, sv_numWorldNodes, sv_worldRoot != -1 ? sv_worldNodes[sv_worldRoot].height : 0,
+			leafs ? (float)depthSum / leafs : 0 );
+		Com_Printf( "%i links: %i inside padding, %i reinserted\n",
+			sv_worldStats.links, sv_worldStats.refits, sv_worldStats.reinserts );
+	} else {
+		Com_Printf( "sector tree: %i sectors, depth %i\n", AREA_NODES, AREA_DEPTH );
+		Com_Printf( "%i links\n", sv_worldStats.links );
+	}
+
+	queries = sv_worldStats.queries ? sv_worldStats.queries : 1;
+	Com_Printf( "%i area queries: %.1f nodes visited, %.1f boxes tested, %.1f entities found per query\n",
+		sv_worldStats.queries, (float)sv_worldStats.nodesVisited / queries,
+		(float)sv_worldStats.boxesTested / queries, (float)sv_worldStats.entitiesFound / queries );
+
+	if ( sv_traceCache->integer || sv_traceCacheStats.traces ) {
+		Com_Printf( "trace cache: %i/%i traces, %i/%i point contents hit, %i invalidations\n",
+			sv_traceCacheStats.traceHits, sv_traceCacheStats.traces,
+			sv_traceCacheStats.contentsHits, sv_traceCacheStats.pointContents,
+			sv_traceCacheStats.invalidations );
+	}
 }
 
 
@@ -171,14 +792,24 @@ void SV_UnlinkEntity( sharedEntity_t *gEnt ) {
 
 	ent = SV_SvEntityForGentity( gEnt );
 
+	SV_ClearTraceCache();
+
 	gEnt->r.linked = qfalse;
 
+	if ( ent->worldNode != -1 ) {
+		SV_UnlinkClusterEntity( ent );
+		SV_UnlinkWorldLeaf( ent );
+		return;
+	}
+
 	ws = ent->worldSector;
 	if ( !ws ) {
 		return;		// not linked in anywhere
 	}
 	ent->worldSector = NULL;
 
+	SV_UnlinkClusterEntity( ent );
+
 	if ( ws->entities == ent ) {
 		ws->entities = ent->nextEntityInWorldSector;
 		return;
@@ -210,12 +841,19 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	int			i, j, k;
 	int			area;
 	int			lastLeaf;
+	qboolean	overflowed;
 	float		*origin, *angles;
 	svEntity_t	*ent;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
+	SV_ClearTraceCache();
+
+	if ( ent->worldNode != -1 ) {
+		// keep the tree leaf, small moves won't need it changed
+		SV_UnlinkClusterEntity( ent );
+		gEnt->r.linked = qfalse;
+	} else if ( ent->worldSector ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -281,7 +919,6 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	// link to PVS leafs
 	ent->numClusters = 0;
-	ent->lastCluster = 0;
 	ent->areanum = -1;
 	ent->areanum2 = -1;
 
@@ -292,6 +929,9 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	// if none of the leafs were inside the map, the
 	// entity is outside the world and can be considered unlinked
 	if ( !num_leafs ) {
+		if ( ent->worldNode != -1 ) {
+			SV_UnlinkWorldLeaf( ent );
+		}
 		return;
 	}
 
@@ -314,24 +954,57 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 		}
 	}
 
-	// store as many explicit clusters as we can
+	// store the distinct clusters, neighbouring leafs usually share one
 	ent->numClusters = 0;
+	overflowed = ( num_leafs == MAX_TOTAL_ENT_LEAFS );
+	ent->firstCluster = CM_LeafCluster( lastLeaf );
+	ent->lastCluster = ent->firstCluster;
 	for (i=0 ; i < num_leafs ; i++) {
 		cluster = CM_LeafCluster( leafs[i] );
-		if ( cluster != -1 ) {
-			ent->clusternums[ent->numClusters++] = cluster;
-			if ( ent->numClusters == MAX_ENT_CLUSTERS ) {
+		if ( cluster == -1 ) {
+			continue;
+		}
+		if ( ent->lastCluster == -1 ) {
+			ent->firstCluster = ent->lastCluster = cluster;
+		} else if ( cluster < ent->firstCluster ) {
+			ent->firstCluster = cluster;
+		} else if ( cluster > ent->lastCluster ) {
+			ent->lastCluster = cluster;
+		}
+		for ( j = 0 ; j < ent->numClusters ; j++ ) {
+			if ( ent->clusternums[j] == cluster ) {
 				break;
 			}
 		}
+		if ( j != ent->numClusters ) {
+			continue;
+		}
+		if ( ent->numClusters == MAX_ENT_CLUSTERS ) {
+			overflowed = qtrue;
+			continue;
+		}
+		ent->clusternums[ent->numClusters++] = cluster;
 	}
 
-	// store off a last cluster if we need to
-	if ( i != num_leafs ) {
-		ent->lastCluster = CM_LeafCluster( lastLeaf );
+	// if they don't all fit, or the leaf list itself overflowed, the
+	// snapshot tests the whole cluster range against the client pvs
+	if ( overflowed ) {
+		ent->numClusters = -1;
+		if ( ent->lastCluster == -1 ) {
+			ent->firstCluster = 0;	// no clusters at all, never visible
+		}
 	}
 
 	gEnt->r.linkcount++;
+	sv_worldStats.links++;
+
+	SV_LinkClusterEntity( ent );
+
+	if ( sv_worldTreeActive ) {
+		SV_LinkWorldLeaf( ent, gEnt );
+		gEnt->r.linked = qtrue;
+		return;
+	}
 
 	// find the first world sector node that the ent's box crosses
 	node = sv_worldSectors;
@@ -370,6 +1043,7 @@ typedef struct {
 	const float	*maxs;
 	int			*list;
 	int			count, maxcount;
+	int			nodesVisited, boxesTested;	// added to sv_worldStats at the end
 } areaParms_t;
 
 
@@ -385,11 +1059,13 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	int			count;
 
 	count = 0;
+	ap->nodesVisited++;
 
 	for ( check = node->entities  ; check ; check = next ) {
 		next = check->nextEntityInWorldSector;
 
 		gcheck = SV_GEntityForSvEntity( check );
+		ap->boxesTested++;
 
 		if ( gcheck->r.absmin[0] > ap->maxs[0]
 		|| gcheck->r.absmin[1] > ap->maxs[1]
@@ -422,6 +1098,72 @@ void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesTree
+
+Same as SV_AreaEntities_r for the dynamic tree, the padded node boxes
+only cull, the entity's own bounds decide
+====================
+*/
+static void SV_AreaEntitiesTree( areaParms_t *ap ) {
+	int			stack[WORLD_TREE_STACK];
+	int			sp, n;
+	worldNode_t	*node;
+	sharedEntity_t *gcheck;
+
+	if ( sv_worldRoot == -1 ) {
+		return;
+	}
+
+	sp = 0;
+	stack[sp++] = sv_worldRoot;
+	while ( sp ) {
+		n = stack[--sp];
+		node = &sv_worldNodes[n];
+		ap->nodesVisited++;
+
+		if ( node->mins[0] > ap->maxs[0]
+		|| node->mins[1] > ap->maxs[1]
+		|| node->mins[2] > ap->maxs[2]
+		|| node->maxs[0] < ap->mins[0]
+		|| node->maxs[1] < ap->mins[1]
+		|| node->maxs[2] < ap->mins[2]) {
+			continue;
+		}
+
+		if ( node->children[0] != -1 ) {
+			if ( sp + 2 > WORLD_TREE_STACK ) {
+				Com_Printf ("SV_AreaEntities: tree too deep\n");
+				return;
+			}
+			stack[sp++] = node->children[1];
+			stack[sp++] = node->children[0];
+			continue;
+		}
+
+		gcheck = SV_GentityNum( node->entityNum );
+		ap->boxesTested++;
+
+		if ( gcheck->r.absmin[0] > ap->maxs[0]
+		|| gcheck->r.absmin[1] > ap->maxs[1]
+		|| gcheck->r.absmin[2] > ap->maxs[2]
+		|| gcheck->r.absmax[0] < ap->mins[0]
+		|| gcheck->r.absmax[1] < ap->mins[1]
+		|| gcheck->r.absmax[2] < ap->mins[2]) {
+			continue;
+		}
+
+		if ( ap->count == ap->maxcount ) {
+			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
+			return;
+		}
+
+		ap->list[ap->count] = node->entityNum;
+		ap->count++;
+	}
+}
+
 /*
 ================
 SV_AreaEntities
@@ -435,8 +1177,27 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.list = entityList;
 	ap.count = 0;
 	ap.maxcount = maxcount;
+	ap.nodesVisited = 0;
+	ap.boxesTested = 0;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( sv_worldTreeActive ) {
+		SV_AreaEntitiesTree( &ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
+
+	// bots thinking on the job threads query at the same time
+	if ( sv_botThinking ) {
+		Sys_AtomicAdd( &sv_worldStats.queries, 1 );
+		Sys_AtomicAdd( &sv_worldStats.nodesVisited, ap.nodesVisited );
+		Sys_AtomicAdd( &sv_worldStats.boxesTested, ap.boxesTested );
+		Sys_AtomicAdd( &sv_worldStats.entitiesFound, ap.count );
+	} else {
+		sv_worldStats.queries++;
+		sv_worldStats.nodesVisited += ap.nodesVisited;
+		sv_worldStats.boxesTested += ap.boxesTested;
+		sv_worldStats.entitiesFound += ap.count;
+	}
 
 	return ap.count;
 }
@@ -589,35 +1350,27 @@ void SV_ClipMoveToEntities( moveclip_t *clip ) {
 }
 
 
+
 /*
 ==================
-SV_Trace
+SV_ClipTraceToEntities
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+Takes a trace that has already been clipped to the world and clips the
+rest of it to the solid entities.
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+static void SV_ClipTraceToEntities( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
 	moveclip_t	clip;
 	int			i;
 
-	if ( !mins ) {
-		mins = vec3_origin;
-	}
-	if ( !maxs ) {
-		maxs = vec3_origin;
+	results->entityNum = results->fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+	if ( results->fraction == 0 ) {
+		return;		// blocked immediately by the world
 	}
 
 	Com_Memset ( &clip, 0, sizeof ( moveclip_t ) );
 
-	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
-	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
-	if ( clip.trace.fraction == 0 ) {
-		*results = clip.trace;
-		return;		// blocked immediately by the world
-	}
-
+	clip.trace = *results;
 	clip.contentmask = contentmask;
 	clip.start = start;
 //	VectorCopy( clip.trace.endpos, clip.end );
@@ -647,6 +1400,83 @@ void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, c
 	*results = clip.trace;
 }
 
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, int capsule ) {
+	traceKey_t			key;
+	traceCacheEntry_t	*entry;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	entry = NULL;
+	if ( sv_traceCache->integer && !sv_botThinking ) {
+		VectorCopy( start, key.start );
+		VectorCopy( end, key.end );
+		VectorCopy( mins, key.mins );
+		VectorCopy( maxs, key.maxs );
+		key.passEntityNum = passEntityNum;
+		key.contentmask = contentmask;
+		key.capsule = capsule;
+
+		sv_traceCacheStats.traces++;
+		entry = &sv_traceEntries[ SV_HashWords( (int *)&key, sizeof( key ) / 4 ) & ( TRACE_CACHE_SIZE - 1 ) ];
+		if ( entry->generation == sv_traceGeneration && !memcmp( &entry->key, &key, sizeof( key ) ) ) {
+			sv_traceCacheStats.traceHits++;
+			*results = entry->trace;
+			return;
+		}
+	}
+
+	// clip to world
+	CM_BoxTrace( results, start, end, mins, maxs, 0, contentmask, capsule );
+
+	SV_ClipTraceToEntities( results, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+
+	if ( entry ) {
+		entry->generation = sv_traceGeneration;
+		entry->key = key;
+		entry->trace = *results;
+	}
+}
+
+/*
+==================
+SV_TraceBatch
+
+SV_Trace for a group of rays that share a box size, content mask and
+pass entity.  The world part is done as one batch, which lets rays that
+are nowhere near any brushes skip the BSP walk.
+==================
+*/
+void SV_TraceBatch( trace_t *results, const traceRay_t *rays, int numRays, vec3_t mins, vec3_t maxs, int passEntityNum, int contentmask, int capsule ) {
+	int			i;
+
+	if ( !mins ) {
+		mins = vec3_origin;
+	}
+	if ( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	// clip to world
+	CM_BoxTraceBatch( results, rays, numRays, mins, maxs, 0, contentmask, capsule );
+
+	for ( i = 0 ; i < numRays ; i++ ) {
+		SV_ClipTraceToEntities( &results[i], rays[i].start, mins, maxs, rays[i].end, passEntityNum, contentmask, capsule );
+	}
+}
+
 
 
 /*
@@ -661,6 +1491,22 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 	int			contents, c2;
 	clipHandle_t	clipHandle;
 	float		*angles;
+	int			key[4];
+	contentsCacheEntry_t	*entry;
+
+	entry = NULL;
+	if ( sv_traceCache->integer && !sv_botThinking ) {
+		VectorCopy( p, (float *)key );
+		key[3] = passEntityNum;
+
+		sv_traceCacheStats.pointContents++;
+		entry = &sv_contentsEntries[ SV_HashWords( key, 4 ) & ( CONTENTS_CACHE_SIZE - 1 ) ];
+		if ( entry->generation == sv_traceGeneration && entry->passEntityNum == passEntityNum
+			&& !memcmp( entry->point, key, sizeof( entry->point ) ) ) {
+			sv_traceCacheStats.contentsHits++;
+			return entry->contents;
+		}
+	}
 
 	// get base contents from world
 	contents = CM_PointContents( p, 0 );
@@ -685,6 +1531,13 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 		contents |= c2;
 	}
 
+	if ( entry ) {
+		entry->generation = sv_traceGeneration;
+		VectorCopy( p, entry->point );
+		entry->passEntityNum = passEntityNum;
+		entry->contents = contents;
+	}
+
 	return contents;
 }
 
@@ -0,0 +1,84 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// unix_local.h: POSIX-specific Quake3 header file for the dedicated server
+
+#ifndef __UNIX_LOCAL_H__
+#define __UNIX_LOCAL_H__
+
+/*
+========================================================================
+
+EVENT LOOP
+
+========================================================================
+*/
+
+#define	MAX_QUED_EVENTS		256
+#define	MASK_QUED_EVENTS	( MAX_QUED_EVENTS - 1 )
+
+extern sysEvent_t	eventQue[MAX_QUED_EVENTS];
+extern int			eventHead, eventTail;
+
+void	Sys_QueEvent( int time, sysEventType_t type, int value, int value2, int ptrLength, void *ptr );
+int		Sys_EventsPending( void );
+
+/*
+========================================================================
+
+CONSOLE
+
+========================================================================
+*/
+
+void	Sys_ConsoleInputInit( void );
+void	Sys_ConsoleInputShutdown( void );
+char	*Sys_ConsoleInput( void );
+
+/*
+========================================================================
+
+NETWORK
+
+========================================================================
+*/
+
+// drains every datagram currently readable on the server socket into
+// the event queue, using as few syscalls as the platform allows
+void	Sys_GetPackets( void );
+
+// the network layer owns the poll set; the console registers its
+// descriptor so typed commands wake NET_Sleep just like packets do
+void	NET_WatchDescriptor( int fd, qboolean watch );
+
+void	Sys_Net_Restart_f( void );
+
+/*
+========================================================================
+
+SHARED SYSTEM FUNCTIONS
+
+========================================================================
+*/
+
+char	*Sys_DefaultBasePath( void );
+
+#endif
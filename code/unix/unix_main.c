@@ -0,0 +1,578 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// unix_main.c -- POSIX system layer for the headless dedicated server
+
+#include "../game/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "unix_local.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+
+static char		sys_cmdline[MAX_STRING_CHARS];
+
+//============================================
+
+/*
+================
+Sys_GetCurrentUser
+================
+*/
+char *Sys_GetCurrentUser( void ) {
+	struct passwd	*p;
+
+	if ( ( p = getpwuid( getuid() ) ) == NULL || !p->pw_name[0] ) {
+		return "player";
+	}
+	return p->pw_name;
+}
+
+/*
+================
+Sys_Milliseconds
+================
+*/
+int			sys_timeBase;
+int Sys_Milliseconds (void)
+{
+	struct timeval	tp;
+	int				sys_curtime;
+
+	gettimeofday( &tp, NULL );
+
+	if ( !sys_timeBase ) {
+		sys_timeBase = tp.tv_sec;
+		return tp.tv_usec / 1000;
+	}
+
+	sys_curtime = ( tp.tv_sec - sys_timeBase ) * 1000 + tp.tv_usec / 1000;
+
+	return sys_curtime;
+}
+
+/*
+==================
+Sys_LowPhysicalMemory()
+==================
+*/
+#define MEM_THRESHOLD 96*1024*1024
+
+qboolean Sys_LowPhysicalMemory() {
+	long long	pages, pageSize;
+
+	pages = sysconf( _SC_PHYS_PAGES );
+	pageSize = sysconf( _SC_PAGESIZE );
+	if ( pages <= 0 || pageSize <= 0 ) {
+		return qfalse;
+	}
+	return ( pages * pageSize <= MEM_THRESHOLD ) ? qtrue : qfalse;
+}
+
+/*
+==================
+Sys_ProcessorCount
+==================
+*/
+unsigned int Sys_ProcessorCount() {
+	long	count;
+
+	count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (unsigned int) count : 1;
+}
+
+/*
+=============
+Sys_Error
+=============
+*/
+void QDECL Sys_Error( const char *error, ... ) {
+	va_list		argptr;
+	char		text[4096];
+
+	va_start (argptr, error);
+	Q_vsnprintf (text, sizeof( text ), error, argptr);
+	va_end (argptr);
+
+	Sys_ConsoleInputShutdown();
+
+	fprintf( stderr, "Sys_Error: %s\n", text );
+
+	exit (1);
+}
+
+/*
+==============
+Sys_Quit
+==============
+*/
+void Sys_Quit( void ) {
+	Sys_ConsoleInputShutdown();
+	NET_Shutdown();
+
+	exit (0);
+}
+
+/*
+==============
+Sys_Print
+==============
+*/
+void Sys_Print( const char *msg ) {
+	fputs( msg, stdout );
+	fflush( stdout );
+}
+
+/*
+==============
+Sys_Cwd
+==============
+*/
+char *Sys_Cwd( void ) {
+	static char cwd[MAX_OSPATH];
+
+	if ( !getcwd( cwd, sizeof( cwd ) - 1 ) ) {
+		cwd[0] = 0;
+	}
+	cwd[MAX_OSPATH-1] = 0;
+
+	return cwd;
+}
+
+/*
+==============
+Sys_GetClipboardData
+
+There is no clipboard on a headless server
+==============
+*/
+char *Sys_GetClipboardData( void ) {
+	return NULL;
+}
+
+/*
+==============
+Sys_ShowConsole
+
+stdout is the console, so there is nothing to show or hide
+==============
+*/
+void Sys_ShowConsole( int visLevel, qboolean quitOnClose ) {
+}
+
+void Sys_SetErrorText( const char *text ) {
+}
+
+void Sys_DisplaySystemConsole( qboolean show ) {
+}
+
+
+/*
+========================================================================
+
+CONSOLE INPUT
+
+========================================================================
+*/
+
+static qboolean	stdinActive;
+static int		stdinFlags;
+
+/*
+================
+Sys_ConsoleInputInit
+
+Put stdin into non-blocking mode and register it with the network
+poll set, so a typed command wakes a sleeping server frame
+================
+*/
+void Sys_ConsoleInputInit( void ) {
+	stdinFlags = fcntl( STDIN_FILENO, F_GETFL, 0 );
+	fcntl( STDIN_FILENO, F_SETFL, stdinFlags | O_NONBLOCK );
+	stdinActive = qtrue;
+
+	NET_WatchDescriptor( STDIN_FILENO, qtrue );
+}
+
+/*
+================
+Sys_ConsoleInputShutdown
+================
+*/
+void Sys_ConsoleInputShutdown( void ) {
+	if ( !stdinActive ) {
+		return;
+	}
+	NET_WatchDescriptor( STDIN_FILENO, qfalse );
+	fcntl( STDIN_FILENO, F_SETFL, stdinFlags );
+	stdinActive = qfalse;
+}
+
+/*
+================
+Sys_ConsoleInput
+
+Returns a complete line typed at the terminal, or NULL
+================
+*/
+char *Sys_ConsoleInput( void ) {
+	static char	text[MAX_EDIT_LINE];
+	int			len;
+
+	if ( !stdinActive ) {
+		return NULL;
+	}
+
+	len = read( STDIN_FILENO, text, sizeof( text ) - 1 );
+	if ( len == 0 ) {
+		// EOF, the terminal went away
+		Sys_ConsoleInputShutdown();
+		return NULL;
+	}
+	if ( len < 0 ) {
+		if ( errno != EAGAIN && errno != EINTR ) {
+			Sys_ConsoleInputShutdown();
+		}
+		return NULL;
+	}
+
+	text[len] = 0;
+	if ( len > 0 && text[len-1] == '\n' ) {
+		text[len-1] = 0;
+	}
+
+	return text;
+}
+
+
+/*
+========================================================================
+
+LOAD/UNLOAD DLL
+
+========================================================================
+*/
+
+/*
+=================
+Sys_UnloadDll
+
+=================
+*/
+void Sys_UnloadDll( void *dllHandle ) {
+	if ( !dllHandle ) {
+		return;
+	}
+	if ( dlclose( dllHandle ) ) {
+		Com_Error (ERR_FATAL, "Sys_UnloadDll dlclose failed: %s", dlerror());
+	}
+}
+
+/*
+=================
+Sys_LoadDll
+
+Used to load a development dll instead of a virtual machine
+=================
+*/
+extern char		*FS_BuildOSPath( const char *base, const char *game, const char *qpath );
+
+// fqpath will be empty if dll not loaded, otherwise will hold fully qualified path of dll module loaded
+// fqpath buffersize must be at least MAX_QPATH+1 bytes long
+void * QDECL Sys_LoadDll( const char *name, char *fqpath , int (QDECL **entryPoint)(size_t, ...),
+				  int (QDECL *systemcalls)(size_t, ...) ) {
+	void	*libHandle;
+	void	(QDECL *dllEntry)( int (QDECL *syscallptr)(size_t, ...) );
+	char	*basepath;
+	char	*homepath;
+	char	*cdpath;
+	char	*gamedir;
+	char	*fn;
+	char	filename[MAX_QPATH];
+
+	*fqpath = 0;
+
+#if defined __x86_64__
+	Com_sprintf( filename, sizeof( filename ), "%sx64.so", name );
+#elif defined __i386__
+	Com_sprintf( filename, sizeof( filename ), "%sx86.so", name );
+#elif defined __arm__ || defined __aarch64__
+	Com_sprintf( filename, sizeof( filename ), "%sarm.so", name );
+#else
+	Com_sprintf( filename, sizeof( filename ), "%s.so", name );
+#endif
+
+	basepath = Cvar_VariableString( "fs_basepath" );
+	homepath = Cvar_VariableString( "fs_homepath" );
+	cdpath = Cvar_VariableString( "fs_cdpath" );
+	gamedir = Cvar_VariableString( "fs_game" );
+
+	// search the same paths the filesystem does, highest priority first
+	fn = FS_BuildOSPath( homepath, gamedir, filename );
+	libHandle = dlopen( fn, RTLD_NOW );
+	if ( !libHandle ) {
+		Com_Printf( "dlopen '%s' failed: %s\n", fn, dlerror() );
+		fn = FS_BuildOSPath( basepath, gamedir, filename );
+		libHandle = dlopen( fn, RTLD_NOW );
+	}
+	if ( !libHandle && cdpath[0] ) {
+		Com_Printf( "dlopen '%s' failed: %s\n", fn, dlerror() );
+		fn = FS_BuildOSPath( cdpath, gamedir, filename );
+		libHandle = dlopen( fn, RTLD_NOW );
+	}
+	if ( !libHandle ) {
+		Com_Printf( "dlopen '%s' failed: %s\n", fn, dlerror() );
+		return NULL;
+	}
+	Com_Printf( "dlopen '%s' ok\n", fn );
+
+	dllEntry = ( void (QDECL *)( int (QDECL *)( size_t, ... ) ) )dlsym( libHandle, "dllEntry" );
+	*entryPoint = (int (QDECL *)(size_t,...))dlsym( libHandle, "vmMain" );
+	if ( !*entryPoint || !dllEntry ) {
+		Com_Printf( "Sys_LoadDll(%s) failed to find vmMain or dllEntry\n", fn );
+		dlclose( libHandle );
+		return NULL;
+	}
+	dllEntry( systemcalls );
+
+	Q_strncpyz( fqpath, filename, MAX_QPATH );
+	return libHandle;
+}
+
+
+/*
+========================================================================
+
+EVENT LOOP
+
+========================================================================
+*/
+
+sysEvent_t	eventQue[MAX_QUED_EVENTS];
+int			eventHead, eventTail;
+
+/*
+================
+Sys_QueEvent
+
+A time of 0 will get the current time
+Ptr should either be null, or point to a block of data that can
+be freed by the game later.
+================
+*/
+void Sys_QueEvent( int time, sysEventType_t type, int value, int value2, int ptrLength, void *ptr ) {
+	sysEvent_t	*ev;
+
+	ev = &eventQue[ eventHead & MASK_QUED_EVENTS ];
+	if ( eventHead - eventTail >= MAX_QUED_EVENTS ) {
+		Com_Printf("Sys_QueEvent: overflow\n");
+		// we are discarding an event, but don't leak memory
+		if ( ev->evPtr ) {
+			Z_Free( ev->evPtr );
+		}
+		eventTail++;
+	}
+
+	eventHead++;
+
+	if ( time == 0 ) {
+		time = Sys_Milliseconds();
+	}
+
+	ev->evTime = time;
+	ev->evType = type;
+	ev->evValue = value;
+	ev->evValue2 = value2;
+	ev->evPtrLength = ptrLength;
+	ev->evPtr = ptr;
+}
+
+/*
+================
+Sys_EventsPending
+================
+*/
+int Sys_EventsPending( void ) {
+	return eventHead - eventTail;
+}
+
+/*
+================
+Sys_GetEvent
+
+================
+*/
+sysEvent_t Sys_GetEvent( void ) {
+	sysEvent_t	ev;
+	char		*s;
+
+	// return if we have data
+	if ( eventHead > eventTail ) {
+		eventTail++;
+		return eventQue[ ( eventTail - 1 ) & MASK_QUED_EVENTS ];
+	}
+
+	// check for console commands
+	s = Sys_ConsoleInput();
+	if ( s ) {
+		char	*b;
+		int		len;
+
+		len = (int) strlen( s ) + 1;
+		b = Z_Malloc( len );
+		Q_strncpyz( b, s, len );
+		Sys_QueEvent( 0, SE_CONSOLE, 0, 0, len, b );
+	}
+
+	// check for network packets, queueing everything that is readable
+	Sys_GetPackets();
+
+	// return if we have data
+	if ( eventHead > eventTail ) {
+		eventTail++;
+		return eventQue[ ( eventTail - 1 ) & MASK_QUED_EVENTS ];
+	}
+
+	// create an empty event to return
+
+	memset( &ev, 0, sizeof( ev ) );
+	ev.evTime = Sys_Milliseconds();
+
+	return ev;
+}
+
+//================================================================
+
+/*
+=================
+Sys_Net_Restart_f
+
+Restart the network subsystem
+=================
+*/
+void Sys_Net_Restart_f( void ) {
+	NET_Restart();
+}
+
+/*
+================
+Sys_Init
+
+Called after the common systems (cvars, files, etc)
+are initialized
+================
+*/
+void Sys_Init( void ) {
+	Cmd_AddCommand ("net_restart", Sys_Net_Restart_f);
+
+#if defined __linux__
+	Cvar_Set( "arch", "linux" );
+#elif defined __FreeBSD__
+	Cvar_Set( "arch", "freebsd" );
+#else
+	Cvar_Set( "arch", "unix" );
+#endif
+
+	Cvar_Set( "sys_cpustring", "generic" );
+	Cvar_SetValue( "sys_cpuid", Sys_GetProcessorId() );
+
+	Cvar_Set( "username", Sys_GetCurrentUser() );
+}
+
+/*
+=================
+Sys_SigHandler
+=================
+*/
+static void Sys_SigHandler( int signum ) {
+	static qboolean	signalcaught = qfalse;
+
+	if ( signalcaught ) {
+		fprintf( stderr, "DOUBLE SIGNAL FAULT: Received signal %d, exiting...\n", signum );
+		_exit( 1 );
+	}
+
+	signalcaught = qtrue;
+	fprintf( stderr, "Received signal %d, exiting...\n", signum );
+	Sys_ConsoleInputShutdown();
+	_exit( signum == SIGTERM || signum == SIGINT ? 0 : 1 );
+}
+
+//=======================================================================
+
+/*
+==================
+main
+
+==================
+*/
+int main( int argc, char **argv ) {
+	int		i;
+
+	// merge the command line, this is kinda silly
+	sys_cmdline[0] = 0;
+	for ( i = 1 ; i < argc ; i++ ) {
+		if ( i > 1 ) {
+			Q_strcat( sys_cmdline, sizeof( sys_cmdline ), " " );
+		}
+		Q_strcat( sys_cmdline, sizeof( sys_cmdline ), argv[i] );
+	}
+
+	signal( SIGHUP, Sys_SigHandler );
+	signal( SIGQUIT, Sys_SigHandler );
+	signal( SIGILL, Sys_SigHandler );
+	signal( SIGTRAP, Sys_SigHandler );
+	signal( SIGIOT, Sys_SigHandler );
+	signal( SIGBUS, Sys_SigHandler );
+	signal( SIGFPE, Sys_SigHandler );
+	signal( SIGSEGV, Sys_SigHandler );
+	signal( SIGTERM, Sys_SigHandler );
+	signal( SIGINT, Sys_SigHandler );
+	// a client vanishing mid-send must not kill the process
+	signal( SIGPIPE, SIG_IGN );
+
+	// get the initial time base
+	Sys_Milliseconds();
+
+	Com_Init( sys_cmdline );
+	NET_Init();
+
+	Sys_ConsoleInputInit();
+
+	Com_Printf( "Working directory: %s\n", Sys_Cwd() );
+
+	// main game loop; there is no sleep here, Com_Frame blocks in
+	// NET_Sleep until a packet, a console line or the next server
+	// frame is due
+	while( 1 ) {
+		Com_Frame();
+	}
+
+	// never gets here
+	return 0;
+}
@@ -0,0 +1,807 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// unix_net.c -- BSD sockets with an epoll / recvmmsg packet loop on Linux
+
+#ifdef __linux__
+#define _GNU_SOURCE		// recvmmsg
+#endif
+
+#include "../game/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "unix_local.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <ifaddrs.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define NET_USE_EPOLL
+#define NET_USE_RECVMMSG
+#define NET_USE_SENDMMSG
+#endif
+
+static qboolean networkingEnabled = qfalse;
+
+static cvar_t	*net_noudp;
+
+static int		ip_socket = -1;
+
+#define	MAX_IPS		16
+static	int		numIP;
+static	byte	localIP[MAX_IPS][4];
+
+// descriptors that wake NET_Sleep: the server socket and the console
+#define	MAX_WATCHED_FDS		4
+static	int		net_watched[MAX_WATCHED_FDS];
+static	int		net_numWatched;
+
+#ifdef NET_USE_EPOLL
+static	int		net_epoll = -1;
+#endif
+
+// datagrams pulled off the socket per receive or send call
+#define	NET_BATCH_PACKETS	32
+static	byte	net_batchData[NET_BATCH_PACKETS][MAX_MSGLEN];
+
+//=============================================================================
+
+
+/*
+====================
+NET_ErrorString
+====================
+*/
+static const char *NET_ErrorString( void ) {
+	return strerror( errno );
+}
+
+static void NetadrToSockadr( netadr_t *a, struct sockaddr_in *s ) {
+	memset( s, 0, sizeof(*s) );
+
+	if( a->type == NA_BROADCAST ) {
+		s->sin_family = AF_INET;
+		s->sin_port = a->port;
+		s->sin_addr.s_addr = INADDR_BROADCAST;
+	}
+	else if( a->type == NA_IP ) {
+		s->sin_family = AF_INET;
+		memcpy( &s->sin_addr.s_addr, a->ip, 4 );
+		s->sin_port = a->port;
+	}
+}
+
+
+static void SockadrToNetadr( struct sockaddr_in *s, netadr_t *a ) {
+	Com_Memset( a, 0, sizeof( *a ) );
+	a->type = NA_IP;
+	memcpy( a->ip, &s->sin_addr.s_addr, 4 );
+	a->port = s->sin_port;
+}
+
+
+/*
+=============
+Sys_StringToSockaddr
+
+idnewt
+192.246.40.70
+=============
+*/
+static qboolean Sys_StringToSockaddr( const char *s, struct sockaddr_in *sadr ) {
+	struct hostent	*h;
+
+	memset( sadr, 0, sizeof( *sadr ) );
+	sadr->sin_family = AF_INET;
+	sadr->sin_port = 0;
+
+	if( s[0] >= '0' && s[0] <= '9' ) {
+		sadr->sin_addr.s_addr = inet_addr( s );
+	} else {
+		if( ( h = gethostbyname( s ) ) == 0 ) {
+			return qfalse;
+		}
+		memcpy( &sadr->sin_addr.s_addr, h->h_addr_list[0], 4 );
+	}
+
+	return qtrue;
+}
+
+/*
+=============
+Sys_StringToAdr
+
+idnewt
+192.246.40.70
+=============
+*/
+qboolean Sys_StringToAdr( const char *s, netadr_t *a ) {
+	struct sockaddr_in sadr;
+
+	if ( !Sys_StringToSockaddr( s, &sadr ) ) {
+		return qfalse;
+	}
+
+	SockadrToNetadr( &sadr, a );
+	return qtrue;
+}
+
+//=============================================================================
+
+/*
+====================
+NET_WatchDescriptor
+
+Adds or removes a descriptor from the set NET_Sleep blocks on
+====================
+*/
+void NET_WatchDescriptor( int fd, qboolean watch ) {
+	int		i;
+
+	for ( i = 0 ; i < net_numWatched ; i++ ) {
+		if ( net_watched[i] == fd ) {
+			break;
+		}
+	}
+
+	if ( watch ) {
+		if ( i < net_numWatched ) {
+			return;
+		}
+		if ( net_numWatched == MAX_WATCHED_FDS ) {
+			Com_Printf( "WARNING: NET_WatchDescriptor: too many descriptors\n" );
+			return;
+		}
+		net_watched[net_numWatched++] = fd;
+#ifdef NET_USE_EPOLL
+		if ( net_epoll >= 0 ) {
+			struct epoll_event	ev;
+
+			memset( &ev, 0, sizeof( ev ) );
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			if ( epoll_ctl( net_epoll, EPOLL_CTL_ADD, fd, &ev ) == -1 ) {
+				Com_Printf( "WARNING: NET_WatchDescriptor: epoll_ctl: %s\n", NET_ErrorString() );
+			}
+		}
+#endif
+	} else {
+		if ( i == net_numWatched ) {
+			return;
+		}
+		net_watched[i] = net_watched[--net_numWatched];
+#ifdef NET_USE_EPOLL
+		if ( net_epoll >= 0 ) {
+			// the descriptor may already be closed, which removes it implicitly
+			epoll_ctl( net_epoll, EPOLL_CTL_DEL, fd, NULL );
+		}
+#endif
+	}
+}
+
+/*
+==================
+NET_QueuePacket
+
+Copies a received datagram out to a seperate buffer for queueing
+==================
+*/
+static void NET_QueuePacket( struct sockaddr_in *from, const byte *data, int length ) {
+	netadr_t	*buf;
+	int			len;
+
+	if ( length >= MAX_MSGLEN ) {
+		netadr_t	adr;
+
+		SockadrToNetadr( from, &adr );
+		Com_Printf( "Oversize packet from %s\n", NET_AdrToString( adr ) );
+		return;
+	}
+
+	len = sizeof( netadr_t ) + length;
+	buf = Z_Malloc( len );
+	SockadrToNetadr( from, buf );
+	memcpy( buf+1, data, length );
+	Sys_QueEvent( 0, SE_PACKET, 0, 0, len, buf );
+}
+
+/*
+==================
+Sys_GetPackets
+
+Never called by the game logic, just the system event queing.
+Everything readable is queued at once so a burst of client packets
+costs one syscall instead of one per datagram.
+==================
+*/
+void Sys_GetPackets( void ) {
+	struct sockaddr_in	from[NET_BATCH_PACKETS];
+	int					room;
+	int					i;
+
+	if ( ip_socket < 0 ) {
+		return;
+	}
+
+	room = MAX_QUED_EVENTS - Sys_EventsPending();
+	if ( room > NET_BATCH_PACKETS ) {
+		room = NET_BATCH_PACKETS;
+	}
+	if ( room <= 0 ) {
+		return;
+	}
+
+#ifdef NET_USE_RECVMMSG
+	{
+		struct mmsghdr	msgs[NET_BATCH_PACKETS];
+		struct iovec	iovecs[NET_BATCH_PACKETS];
+		int				count;
+
+		memset( msgs, 0, sizeof( msgs[0] ) * room );
+		for ( i = 0 ; i < room ; i++ ) {
+			iovecs[i].iov_base = net_batchData[i];
+			iovecs[i].iov_len = MAX_MSGLEN;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &from[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof( from[i] );
+		}
+
+		count = recvmmsg( ip_socket, msgs, room, MSG_DONTWAIT, NULL );
+		if ( count < 0 ) {
+			if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED && errno != EINTR ) {
+				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+			}
+			return;
+		}
+
+		for ( i = 0 ; i < count ; i++ ) {
+			NET_QueuePacket( &from[i], net_batchData[i], (int) msgs[i].msg_len );
+		}
+	}
+#else
+	for ( i = 0 ; i < room ; i++ ) {
+		socklen_t	fromlen;
+		int			ret;
+
+		fromlen = sizeof( from[i] );
+		ret = recvfrom( ip_socket, net_batchData[i], MAX_MSGLEN, 0, (struct sockaddr *)&from[i], &fromlen );
+		if ( ret == -1 ) {
+			if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED && errno != EINTR ) {
+				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+			}
+			return;
+		}
+
+		NET_QueuePacket( &from[i], net_batchData[i], ret );
+	}
+#endif
+}
+
+//=============================================================================
+
+/*
+==================
+NET_SendFailed
+==================
+*/
+static void NET_SendFailed( const netadr_t *to ) {
+	// wouldblock is silent
+	if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+		return;
+	}
+
+	// some PPP links do not allow broadcasts and return an error
+	if( ( errno == EADDRNOTAVAIL || errno == EACCES ) && to->type == NA_BROADCAST ) {
+		return;
+	}
+
+	Com_Printf( "NET_SendPacket: %s\n", NET_ErrorString() );
+}
+
+/*
+==================
+Sys_SendPacket
+==================
+*/
+void Sys_SendPacket( int length, const void *data, netadr_t to ) {
+	int					ret;
+	struct sockaddr_in	addr;
+
+	if( to.type != NA_BROADCAST && to.type != NA_IP ) {
+		Com_Error( ERR_FATAL, "Sys_SendPacket: bad address type" );
+		return;
+	}
+
+	if( ip_socket < 0 ) {
+		return;
+	}
+
+	NetadrToSockadr( &to, &addr );
+
+	ret = sendto( ip_socket, data, length, 0, (struct sockaddr *)&addr, sizeof(addr) );
+	if( ret == -1 ) {
+		NET_SendFailed( &to );
+	}
+}
+
+/*
+==================
+Sys_SendPackets
+
+A failed datagram is dropped the same way Sys_SendPacket drops it,
+and the rest still go out.
+==================
+*/
+void Sys_SendPackets( const sysPacket_t *packets, int count ) {
+#ifdef NET_USE_SENDMMSG
+	struct mmsghdr		msgs[NET_BATCH_PACKETS];
+	struct iovec		iovecs[NET_BATCH_PACKETS];
+	struct sockaddr_in	addrs[NET_BATCH_PACKETS];
+	netadr_t			to;
+	int					i, batch, sent, ret;
+
+	if( ip_socket < 0 ) {
+		return;
+	}
+
+	while ( count > 0 ) {
+		batch = count;
+		if ( batch > NET_BATCH_PACKETS ) {
+			batch = NET_BATCH_PACKETS;
+		}
+
+		memset( msgs, 0, sizeof( msgs[0] ) * batch );
+		for ( i = 0 ; i < batch ; i++ ) {
+			to = packets[i].to;
+			if( to.type != NA_BROADCAST && to.type != NA_IP ) {
+				Com_Error( ERR_FATAL, "Sys_SendPacket: bad address type" );
+				return;
+			}
+			NetadrToSockadr( &to, &addrs[i] );
+			iovecs[i].iov_base = (void *)packets[i].data;
+			iovecs[i].iov_len = packets[i].length;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof( addrs[i] );
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		sent = 0;
+		while ( sent < batch ) {
+			ret = sendmmsg( ip_socket, msgs + sent, batch - sent, 0 );
+			if ( ret > 0 ) {
+				sent += ret;
+				continue;
+			}
+			if ( ret < 0 && errno == EINTR ) {
+				continue;
+			}
+			// the call stops at the datagram that failed
+			if ( ret < 0 ) {
+				NET_SendFailed( &packets[sent].to );
+			}
+			sent++;
+		}
+
+		packets += batch;
+		count -= batch;
+	}
+#else
+	int		i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		Sys_SendPacket( packets[i].length, packets[i].data, packets[i].to );
+	}
+#endif
+}
+
+
+//=============================================================================
+
+/*
+==================
+Sys_IsLANAddress
+
+LAN clients will have their rate var ignored
+==================
+*/
+qboolean Sys_IsLANAddress( netadr_t adr ) {
+	int		i;
+
+	if( adr.type == NA_LOOPBACK ) {
+		return qtrue;
+	}
+
+	if( adr.type != NA_IP ) {
+		return qfalse;
+	}
+
+	// choose which comparison to use based on the class of the address being tested
+	// any local adresses of a different class than the address being tested will fail based on the first byte
+
+	if( adr.ip[0] == 127 && adr.ip[1] == 0 && adr.ip[2] == 0 && adr.ip[3] == 1 ) {
+		return qtrue;
+	}
+
+	// Class A
+	if( (adr.ip[0] & 0x80) == 0x00 ) {
+		for ( i = 0 ; i < numIP ; i++ ) {
+			if( adr.ip[0] == localIP[i][0] ) {
+				return qtrue;
+			}
+		}
+		// the RFC1918 class a block will pass the above test
+		return qfalse;
+	}
+
+	// Class B
+	if( (adr.ip[0] & 0xc0) == 0x80 ) {
+		for ( i = 0 ; i < numIP ; i++ ) {
+			if( adr.ip[0] == localIP[i][0] && adr.ip[1] == localIP[i][1] ) {
+				return qtrue;
+			}
+			// also check against the RFC1918 class b blocks
+			if( adr.ip[0] == 172 && localIP[i][0] == 172 && (adr.ip[1] & 0xf0) == 16 && (localIP[i][1] & 0xf0) == 16 ) {
+				return qtrue;
+			}
+		}
+		return qfalse;
+	}
+
+	// Class C
+	for ( i = 0 ; i < numIP ; i++ ) {
+		if( adr.ip[0] == localIP[i][0] && adr.ip[1] == localIP[i][1] && adr.ip[2] == localIP[i][2] ) {
+			return qtrue;
+		}
+		// also check against the RFC1918 class c blocks
+		if( adr.ip[0] == 192 && localIP[i][0] == 192 && adr.ip[1] == 168 && localIP[i][1] == 168 ) {
+			return qtrue;
+		}
+	}
+	return qfalse;
+}
+
+/*
+==================
+Sys_ShowIP
+==================
+*/
+void Sys_ShowIP(void) {
+	int i;
+
+	for (i = 0; i < numIP; i++) {
+		Com_Printf( "IP: %i.%i.%i.%i\n", localIP[i][0], localIP[i][1], localIP[i][2], localIP[i][3] );
+	}
+}
+
+
+//=============================================================================
+
+
+/*
+====================
+NET_IPSocket
+====================
+*/
+static int NET_IPSocket( char *net_interface, int port ) {
+	int					newsocket;
+	struct sockaddr_in	address;
+	int					i = 1;
+
+	if( net_interface ) {
+		Com_Printf( "Opening IP socket: %s:%i\n", net_interface, port );
+	}
+	else {
+		Com_Printf( "Opening IP socket: localhost:%i\n", port );
+	}
+
+	if( ( newsocket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP ) ) == -1 ) {
+		if( errno != EAFNOSUPPORT ) {
+			Com_Printf( "WARNING: UDP_OpenSocket: socket: %s\n", NET_ErrorString() );
+		}
+		return -1;
+	}
+
+	// make it non-blocking
+	if( fcntl( newsocket, F_SETFL, fcntl( newsocket, F_GETFL, 0 ) | O_NONBLOCK ) == -1 ) {
+		Com_Printf( "WARNING: UDP_OpenSocket: fcntl O_NONBLOCK: %s\n", NET_ErrorString() );
+		close( newsocket );
+		return -1;
+	}
+
+	// make it broadcast capable
+	if( setsockopt( newsocket, SOL_SOCKET, SO_BROADCAST, (char *)&i, sizeof(i) ) == -1 ) {
+		Com_Printf( "WARNING: UDP_OpenSocket: setsockopt SO_BROADCAST: %s\n", NET_ErrorString() );
+		close( newsocket );
+		return -1;
+	}
+
+	if( !net_interface || !net_interface[0] || !Q_stricmp(net_interface, "localhost") ) {
+		memset( &address, 0, sizeof( address ) );
+		address.sin_addr.s_addr = INADDR_ANY;
+	}
+	else {
+		Sys_StringToSockaddr( net_interface, &address );
+	}
+
+	if( port == PORT_ANY ) {
+		address.sin_port = 0;
+	}
+	else {
+		address.sin_port = htons( (short)port );
+	}
+
+	address.sin_family = AF_INET;
+
+	if( bind( newsocket, (struct sockaddr *)&address, sizeof(address) ) == -1 ) {
+		Com_Printf( "WARNING: UDP_OpenSocket: bind: %s\n", NET_ErrorString() );
+		close( newsocket );
+		return -1;
+	}
+
+	return newsocket;
+}
+
+
+/*
+=====================
+NET_GetLocalAddress
+=====================
+*/
+static void NET_GetLocalAddress( void ) {
+	struct ifaddrs		*ifap, *ifa;
+	byte				*p;
+
+	if( getifaddrs( &ifap ) == -1 ) {
+		Com_Printf( "WARNING: NET_GetLocalAddress: getifaddrs: %s\n", NET_ErrorString() );
+		return;
+	}
+
+	numIP = 0;
+	for( ifa = ifap ; ifa && numIP < MAX_IPS ; ifa = ifa->ifa_next ) {
+		if( !ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET ) {
+			continue;
+		}
+		p = (byte *)&((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr;
+		localIP[ numIP ][0] = p[0];
+		localIP[ numIP ][1] = p[1];
+		localIP[ numIP ][2] = p[2];
+		localIP[ numIP ][3] = p[3];
+		Com_Printf( "IP: %i.%i.%i.%i (%s)\n", p[0], p[1], p[2], p[3], ifa->ifa_name );
+		numIP++;
+	}
+
+	freeifaddrs( ifap );
+}
+
+/*
+====================
+NET_OpenIP
+====================
+*/
+static void NET_OpenIP( void ) {
+	cvar_t	*ip;
+	int		port;
+	int		i;
+
+	ip = Cvar_Get( "net_ip", "localhost", CVAR_LATCH );
+	port = Cvar_Get( "net_port", va( "%i", PORT_SERVER ), CVAR_LATCH )->integer;
+
+	// automatically scan for a valid port, so multiple
+	// dedicated servers can be started without requiring
+	// a different net_port for each one
+	for( i = 0 ; i < 10 ; i++ ) {
+		ip_socket = NET_IPSocket( ip->string, port + i );
+		if ( ip_socket >= 0 ) {
+			Cvar_SetValue( "net_port", port + i );
+			NET_GetLocalAddress();
+			NET_WatchDescriptor( ip_socket, qtrue );
+			return;
+		}
+	}
+	Com_Printf( "WARNING: Couldn't allocate IP port\n");
+}
+
+
+//===================================================================
+
+
+/*
+====================
+NET_GetCvars
+====================
+*/
+static qboolean NET_GetCvars( void ) {
+	qboolean	modified;
+
+	modified = qfalse;
+
+	if( net_noudp && net_noudp->modified ) {
+		modified = qtrue;
+	}
+	net_noudp = Cvar_Get( "net_noudp", "0", CVAR_LATCH | CVAR_ARCHIVE );
+
+	return modified;
+}
+
+
+/*
+====================
+NET_Config
+====================
+*/
+void NET_Config( qboolean enableNetworking ) {
+	qboolean	modified;
+	qboolean	stop;
+	qboolean	start;
+
+	// get any latched changes to cvars
+	modified = NET_GetCvars();
+
+	if( net_noudp->integer ) {
+		enableNetworking = qfalse;
+	}
+
+	// if enable state is the same and no cvars were modified, we have nothing to do
+	if( enableNetworking == networkingEnabled && !modified ) {
+		return;
+	}
+
+	if( enableNetworking == networkingEnabled ) {
+		if( enableNetworking ) {
+			stop = qtrue;
+			start = qtrue;
+		}
+		else {
+			stop = qfalse;
+			start = qfalse;
+		}
+	}
+	else {
+		if( enableNetworking ) {
+			stop = qfalse;
+			start = qtrue;
+		}
+		else {
+			stop = qtrue;
+			start = qfalse;
+		}
+		networkingEnabled = enableNetworking;
+	}
+
+	if( stop ) {
+		if ( ip_socket >= 0 ) {
+			NET_WatchDescriptor( ip_socket, qfalse );
+			close( ip_socket );
+			ip_socket = -1;
+		}
+	}
+
+	if( start ) {
+		if (! net_noudp->integer ) {
+			NET_OpenIP();
+		}
+	}
+}
+
+
+/*
+====================
+NET_Init
+====================
+*/
+void NET_Init( void ) {
+#ifdef NET_USE_EPOLL
+	net_epoll = epoll_create1( EPOLL_CLOEXEC );
+	if ( net_epoll == -1 ) {
+		Com_Printf( "WARNING: epoll_create1 failed, falling back to select: %s\n", NET_ErrorString() );
+	}
+#endif
+
+	// this is really just to get the cvars registered
+	NET_GetCvars();
+
+	NET_Config( qtrue );
+}
+
+
+/*
+====================
+NET_Shutdown
+====================
+*/
+void NET_Shutdown( void ) {
+	NET_Config( qfalse );
+
+#ifdef NET_USE_EPOLL
+	if ( net_epoll >= 0 ) {
+		close( net_epoll );
+		net_epoll = -1;
+	}
+#endif
+}
+
+
+/*
+====================
+NET_Sleep
+
+sleeps msec or until net socket is ready
+====================
+*/
+void NET_Sleep( int msec ) {
+	fd_set			fdset;
+	struct timeval	timeout;
+	int				highestfd;
+	int				i;
+
+	if ( msec < 0 ) {
+		return;
+	}
+
+	// anything already queued must be handled before blocking
+	if ( Sys_EventsPending() ) {
+		return;
+	}
+
+#ifdef NET_USE_EPOLL
+	if ( net_epoll >= 0 ) {
+		struct epoll_event	events[MAX_WATCHED_FDS];
+
+		// level triggered, so data that arrived before the call
+		// returns immediately and nothing can be missed
+		epoll_wait( net_epoll, events, MAX_WATCHED_FDS, msec );
+		return;
+	}
+#endif
+
+	FD_ZERO( &fdset );
+	highestfd = -1;
+	for ( i = 0 ; i < net_numWatched ; i++ ) {
+		FD_SET( net_watched[i], &fdset );
+		if ( net_watched[i] > highestfd ) {
+			highestfd = net_watched[i];
+		}
+	}
+
+	timeout.tv_sec = msec / 1000;
+	timeout.tv_usec = ( msec % 1000 ) * 1000;
+	select( highestfd + 1, &fdset, NULL, NULL, &timeout );
+}
+
+
+/*
+====================
+NET_Restart_f
+====================
+*/
+void NET_Restart( void ) {
+	NET_Config( networkingEnabled );
+}
@@ -0,0 +1,511 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Foobar; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// unix_shared.c -- filesystem and misc services shared by the POSIX builds
+
+#include "../game/q_shared.h"
+#include "../qcommon/qcommon.h"
+#include "unix_local.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+/*
+================
+Com_Memcpy / Com_Memset
+
+common.c only carries the x86 MSVC versions; libc is as good as
+anything we'd hand-write here
+================
+*/
+void Com_Memcpy( void* dest, const void* src, const size_t count ) {
+	memcpy( dest, src, count );
+}
+
+void Com_Memset( void* dest, const int val, const size_t count ) {
+	memset( dest, val, count );
+}
+
+/*
+================
+Sys_SnapVector
+================
+*/
+void Sys_SnapVector( float *v ) {
+	v[0] = rintf( v[0] );
+	v[1] = rintf( v[1] );
+	v[2] = rintf( v[2] );
+}
+
+/*
+================
+Sys_GetProcessorId
+================
+*/
+int Sys_GetProcessorId( void ) {
+	return CPUID_GENERIC;
+}
+
+/*
+==================
+Sys_BeginProfiling
+==================
+*/
+void Sys_BeginProfiling( void ) {
+	// this is just used on the mac build
+}
+
+/*
+==============
+Sys_Mkdir
+==============
+*/
+void Sys_Mkdir( const char *path ) {
+	mkdir( path, 0777 );
+}
+
+/*
+==============
+Sys_MapFile
+==============
+*/
+void *Sys_MapFile( const char *ospath, int *length ) {
+	struct stat	st;
+	void		*data;
+	int			fd;
+
+	fd = open( ospath, O_RDONLY );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+	if ( fstat( fd, &st ) == -1 || st.st_size <= 0 || st.st_size > 0x7fffffff ) {
+		close( fd );
+		return NULL;
+	}
+	data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		return NULL;
+	}
+
+	*length = (int)st.st_size;
+	return data;
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *data, int length ) {
+	munmap( data, length );
+}
+
+/*
+==============
+Sys_DefaultCDPath
+==============
+*/
+char *Sys_DefaultCDPath( void ) {
+	return "";
+}
+
+/*
+==============
+Sys_DefaultBasePath
+==============
+*/
+char *Sys_DefaultBasePath( void ) {
+	return Sys_Cwd();
+}
+
+char *Sys_DefaultInstallPath( void ) {
+	return Sys_Cwd();
+}
+
+/*
+==============
+Sys_DefaultHomePath
+
+Writable files go under ~/.q3a so several servers can share a
+read-only install directory
+==============
+*/
+char *Sys_DefaultHomePath( void ) {
+	static char	homePath[MAX_OSPATH];
+	char		*p;
+
+	if ( homePath[0] ) {
+		return homePath;
+	}
+
+	if ( ( p = getenv( "HOME" ) ) == NULL || !p[0] ) {
+		return NULL;
+	}
+
+	Com_sprintf( homePath, sizeof( homePath ), "%s%c.q3a", p, PATH_SEP );
+	if ( mkdir( homePath, 0777 ) && errno != EEXIST ) {
+		Com_Printf( "WARNING: couldn't create home path %s\n", homePath );
+		homePath[0] = 0;
+		return NULL;
+	}
+
+	return homePath;
+}
+
+/*
+==============================================================
+
+DIRECTORY SCANNING
+
+==============================================================
+*/
+
+#define	MAX_FOUND_FILES	0x1000
+
+static void Sys_ListFilteredFiles( const char *basedir, char *subdirs, char *filter, char **list, int *numfiles ) {
+	char			search[MAX_OSPATH], newsubdirs[MAX_OSPATH];
+	char			filename[MAX_OSPATH];
+	DIR				*fdir;
+	struct dirent	*d;
+	struct stat		st;
+
+	if ( *numfiles >= MAX_FOUND_FILES - 1 ) {
+		return;
+	}
+
+	if (strlen(subdirs)) {
+		Com_sprintf( search, sizeof(search), "%s/%s", basedir, subdirs );
+	}
+	else {
+		Com_sprintf( search, sizeof(search), "%s", basedir );
+	}
+
+	if ( ( fdir = opendir( search ) ) == NULL ) {
+		return;
+	}
+
+	while ( ( d = readdir( fdir ) ) != NULL ) {
+		Com_sprintf( filename, sizeof(filename), "%s/%s", search, d->d_name );
+		if ( stat( filename, &st ) == -1 ) {
+			continue;
+		}
+
+		if ( S_ISDIR( st.st_mode ) ) {
+			if ( Q_stricmp( d->d_name, "." ) && Q_stricmp( d->d_name, ".." ) ) {
+				if ( strlen(subdirs) ) {
+					Com_sprintf( newsubdirs, sizeof(newsubdirs), "%s/%s", subdirs, d->d_name );
+				}
+				else {
+					Com_sprintf( newsubdirs, sizeof(newsubdirs), "%s", d->d_name );
+				}
+				Sys_ListFilteredFiles( basedir, newsubdirs, filter, list, numfiles );
+			}
+		}
+		if ( *numfiles >= MAX_FOUND_FILES - 1 ) {
+			break;
+		}
+		Com_sprintf( filename, sizeof(filename), "%s/%s", subdirs, d->d_name );
+		if ( !Com_FilterPath( filter, filename, qfalse ) ) {
+			continue;
+		}
+		list[ *numfiles ] = CopyString( filename );
+		(*numfiles)++;
+	}
+
+	closedir( fdir );
+}
+
+static int QDECL Sys_SortFileList( const void *a, const void *b ) {
+	return strcmp( *(const char **)a, *(const char **)b );
+}
+
+char **Sys_ListFiles( const char *directory, const char *extension, char *filter, int *numfiles, qboolean wantsubs ) {
+	DIR				*fdir;
+	struct dirent	*d;
+	struct stat		st;
+	char			search[MAX_OSPATH];
+	int				nfiles;
+	char			**listCopy;
+	char			*list[MAX_FOUND_FILES];
+	qboolean		dironly;
+	int				extLen;
+	int				i;
+
+	if ( filter ) {
+
+		nfiles = 0;
+		Sys_ListFilteredFiles( directory, "", filter, list, &nfiles );
+
+		list[ nfiles ] = 0;
+		*numfiles = nfiles;
+
+		if (!nfiles)
+			return NULL;
+
+		listCopy = Z_Malloc( ( nfiles + 1 ) * sizeof( *listCopy ) );
+		for ( i = 0 ; i < nfiles ; i++ ) {
+			listCopy[i] = list[i];
+		}
+		listCopy[i] = NULL;
+
+		return listCopy;
+	}
+
+	if ( !extension ) {
+		extension = "";
+	}
+
+	// passing a slash as extension will find directories
+	dironly = wantsubs;
+	if ( extension[0] == '/' && extension[1] == 0 ) {
+		extension = "";
+		dironly = qtrue;
+	}
+	extLen = (int) strlen( extension );
+
+	// search
+	nfiles = 0;
+
+	if ( ( fdir = opendir( directory ) ) == NULL ) {
+		*numfiles = 0;
+		return NULL;
+	}
+
+	while ( ( d = readdir( fdir ) ) != NULL ) {
+		Com_sprintf( search, sizeof(search), "%s/%s", directory, d->d_name );
+		if ( stat( search, &st ) == -1 ) {
+			continue;
+		}
+		if ( ( dironly && !S_ISDIR( st.st_mode ) ) || ( !dironly && S_ISDIR( st.st_mode ) ) ) {
+			continue;
+		}
+
+		if ( extLen ) {
+			int len = (int) strlen( d->d_name );
+			if ( len < extLen || Q_stricmp( d->d_name + len - extLen, extension ) ) {
+				continue;
+			}
+		}
+
+		if ( nfiles == MAX_FOUND_FILES - 1 ) {
+			break;
+		}
+		list[ nfiles ] = CopyString( d->d_name );
+		nfiles++;
+	}
+
+	list[ nfiles ] = 0;
+
+	closedir( fdir );
+
+	// return a copy of the list
+	*numfiles = nfiles;
+
+	if ( !nfiles ) {
+		return NULL;
+	}
+
+	listCopy = Z_Malloc( ( nfiles + 1 ) * sizeof( *listCopy ) );
+	for ( i = 0 ; i < nfiles ; i++ ) {
+		listCopy[i] = list[i];
+	}
+	listCopy[i] = NULL;
+
+	// readdir order is arbitrary, pak precedence depends on a sorted list
+	qsort( listCopy, nfiles, sizeof( *listCopy ), Sys_SortFileList );
+
+	return listCopy;
+}
+
+void	Sys_FreeFileList( char **list ) {
+	int		i;
+
+	if ( !list ) {
+		return;
+	}
+
+	for ( i = 0 ; list[i] ; i++ ) {
+		Z_Free( list[i] );
+	}
+
+	Z_Free( list );
+}
+
+//========================================================
+
+
+/*
+================
+Sys_CheckCD
+
+Return true if the proper CD is in the drive
+================
+*/
+qboolean	Sys_CheckCD( void ) {
+	return qtrue;
+}
+
+
+
+/*
+========================================================================
+
+BACKGROUND FILE STREAMING
+
+========================================================================
+*/
+
+void Sys_BeginStreamedFile( fileHandle_t f, int readAhead ) {
+}
+
+void Sys_EndStreamedFile( fileHandle_t f ) {
+}
+
+int Sys_StreamedRead( void *buffer, int size, int count, fileHandle_t f ) {
+	return FS_Read( buffer, size * count, f );
+}
+
+void Sys_StreamSeek( fileHandle_t f, int offset, int origin ) {
+	FS_Seek( f, offset, origin );
+}
+
+
+/*
+========================================================================
+
+THREADS
+
+========================================================================
+*/
+
+typedef struct {
+	void	(*function)( void *data );
+	void	*data;
+} sysThreadStart_t;
+
+static void *Sys_ThreadStart( void *parm ) {
+	sysThreadStart_t	start;
+
+	start = *(sysThreadStart_t *)parm;
+	free( parm );
+
+	start.function( start.data );
+	return NULL;
+}
+
+/*
+================
+Sys_CreateThread
+================
+*/
+qboolean Sys_CreateThread( void (*function)( void *data ), void *data ) {
+	sysThreadStart_t	*start;
+	pthread_t			thread;
+	pthread_attr_t		attr;
+	int					err;
+
+	start = malloc( sizeof( *start ) );
+	if ( !start ) {
+		return qfalse;
+	}
+	start->function = function;
+	start->data = data;
+
+	pthread_attr_init( &attr );
+	pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+	err = pthread_create( &thread, &attr, Sys_ThreadStart, start );
+	pthread_attr_destroy( &attr );
+
+	if ( err ) {
+		free( start );
+		return qfalse;
+	}
+	return qtrue;
+}
+
+/*
+================
+Sys_CreateSemaphore
+================
+*/
+void *Sys_CreateSemaphore( int initialCount ) {
+	sem_t	*sem;
+
+	sem = malloc( sizeof( *sem ) );
+	if ( !sem ) {
+		return NULL;
+	}
+	if ( sem_init( sem, 0, initialCount ) ) {
+		free( sem );
+		return NULL;
+	}
+	return sem;
+}
+
+/*
+================
+Sys_DestroySemaphore
+================
+*/
+void Sys_DestroySemaphore( void *sem ) {
+	sem_destroy( (sem_t *)sem );
+	free( sem );
+}
+
+/*
+================
+Sys_SemaphoreWait
+================
+*/
+void Sys_SemaphoreWait( void *sem ) {
+	while ( sem_wait( (sem_t *)sem ) && errno == EINTR ) {
+	}
+}
+
+/*
+================
+Sys_SemaphorePost
+================
+*/
+void Sys_SemaphorePost( void *sem, int count ) {
+	while ( count-- > 0 ) {
+		sem_post( (sem_t *)sem );
+	}
+}
+
+/*
+================
+Sys_AtomicAdd
+================
+*/
+int Sys_AtomicAdd( volatile int *value, int add ) {
+	return __sync_add_and_fetch( value, add );
+}
@@ -374,6 +374,22 @@ void Sys_SendPacket( int length, const void *data, netadr_t to ) {
 	}
 }
 
+/*
+==================
+Sys_SendPackets
+
+Winsock has no batched send, so each datagram goes out on its own;
+the socks relay still applies.
+==================
+*/
+void Sys_SendPackets( const sysPacket_t *packets, int count ) {
+	int		i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		Sys_SendPacket( packets[i].length, packets[i].data, packets[i].to );
+	}
+}
+
 
 //=============================================================================
 
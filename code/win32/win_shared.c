@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "../qcommon/qcommon.h"
 #include "../client/client.h"
 #include "win_shared.h"
+#include <windows.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -341,6 +342,56 @@ void Sys_Mkdir( const char *path ) {
 	_mkdir (path);
 }
 
+/*
+==============
+Sys_MapFile
+==============
+*/
+void *Sys_MapFile( const char *ospath, int *length ) {
+#ifdef WIN8
+	// store apps can't map arbitrary files, reads go through unzip
+	return NULL;
+#else
+	HANDLE			file, mapping;
+	LARGE_INTEGER	size;
+	void			*data;
+
+	file = CreateFileA( ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	if ( !GetFileSizeEx( file, &size ) || size.QuadPart <= 0 || size.QuadPart > 0x7fffffff ) {
+		CloseHandle( file );
+		return NULL;
+	}
+	mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( file );
+	if ( !mapping ) {
+		return NULL;
+	}
+	// the view keeps the mapping alive
+	data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( !data ) {
+		return NULL;
+	}
+
+	*length = (int)size.QuadPart;
+	return data;
+#endif
+}
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile( void *data, int length ) {
+#ifndef WIN8
+	UnmapViewOfFile( data );
+#endif
+}
+
 /*
 ==============
 Sys_DefaultCDPath
@@ -564,6 +615,113 @@ qboolean	Sys_CheckCD( void ) {
 
 
 
+/*
+========================================================================
+
+THREADS
+
+========================================================================
+*/
+
+#ifdef WIN8
+extern void Sys_CreateThreadWin8( void (* function)( void* ), void* data );
+#else
+typedef struct {
+	void	(*function)( void *data );
+	void	*data;
+} sysThreadStart_t;
+
+static DWORD WINAPI Sys_ThreadStart( LPVOID parm ) {
+	sysThreadStart_t	start;
+
+	start = *(sysThreadStart_t *)parm;
+	free( parm );
+
+	start.function( start.data );
+	return 0;
+}
+#endif
+
+/*
+================
+Sys_CreateThread
+================
+*/
+qboolean Sys_CreateThread( void (*function)( void *data ), void *data ) {
+#ifdef WIN8
+	Sys_CreateThreadWin8( function, data );
+	return qtrue;
+#else
+	sysThreadStart_t	*start;
+	HANDLE				thread;
+
+	start = malloc( sizeof( *start ) );
+	if ( !start ) {
+		return qfalse;
+	}
+	start->function = function;
+	start->data = data;
+
+	thread = CreateThread( NULL, 0, Sys_ThreadStart, start, 0, NULL );
+	if ( !thread ) {
+		free( start );
+		return qfalse;
+	}
+
+	// the thread is never joined
+	CloseHandle( thread );
+	return qtrue;
+#endif
+}
+
+/*
+================
+Sys_CreateSemaphore
+================
+*/
+void *Sys_CreateSemaphore( int initialCount ) {
+	return CreateSemaphoreEx( NULL, initialCount, 0x7fffffff, NULL, 0, SEMAPHORE_ALL_ACCESS );
+}
+
+/*
+================
+Sys_DestroySemaphore
+================
+*/
+void Sys_DestroySemaphore( void *sem ) {
+	CloseHandle( (HANDLE)sem );
+}
+
+/*
+================
+Sys_SemaphoreWait
+================
+*/
+void Sys_SemaphoreWait( void *sem ) {
+	WaitForSingleObjectEx( (HANDLE)sem, INFINITE, FALSE );
+}
+
+/*
+================
+Sys_SemaphorePost
+================
+*/
+void Sys_SemaphorePost( void *sem, int count ) {
+	if ( count > 0 ) {
+		ReleaseSemaphore( (HANDLE)sem, count, NULL );
+	}
+}
+
+/*
+================
+Sys_AtomicAdd
+================
+*/
+int Sys_AtomicAdd( volatile int *value, int add ) {
+	return InterlockedExchangeAdd( (volatile LONG *)value, add ) + add;
+}
+
+
 /*
 ========================================================================
 
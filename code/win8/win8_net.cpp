@@ -399,6 +399,23 @@ C_EXPORT void Sys_SendPacket( int length, const void *data, netadr_t to )
     }
 }
 
+/*
+==================
+Sys_SendPackets
+
+No batched send here either, each datagram goes out on its own
+==================
+*/
+C_EXPORT void Sys_SendPackets( const sysPacket_t *packets, int count )
+{
+    int i;
+
+    for ( i = 0 ; i < count ; i++ )
+    {
+        Sys_SendPacket( packets[i].length, packets[i].data, packets[i].to );
+    }
+}
+
 /*
 ==================
 Sys_IsLANAddress